@@ -28,107 +28,613 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "ndofdev_backend.h"
 #include "ndofdev_external.h"
+#include "ndofdev_hotplug.h"
 #include "ndofdev_internal.h"
+#include "ndofdev_mpsc.h"
+#include "ndofdev_stream.h"
+#include "ndofdev_sync.h"
 
+/* --------------------------------------------------------------------------
+    Global/Static Variables                                                   */
+
+/*	Backends compiled in, the native one first. */
+static const NDOF_Backend *const s_backends[] = {
 #if TARGET_OS_MAC
-#include "ndofdev_internal_osx.h"
+    &ndof_backend_osx,
 #elif defined(_WIN32) || defined(WIN32)
-#include "ndofdev_internal_win.h"
+    &ndof_backend_win,
 #else /* linux */
-#include "ndofdev_internal_linux.h"
+    &ndof_backend_linux,
+    &ndof_backend_hidraw,
+    &ndof_backend_evdev,
+#endif
+    &ndof_backend_synthetic,
+    &ndof_backend_replay,
+#if !defined(_WIN32) && !defined(WIN32)
+    &ndof_backend_shm,
 #endif
+    NULL
+};
 
-/* --------------------------------------------------------------------------
-    Global/Static Variables                                                   */
+/*	Instance used by the functions taking no context, set up on first use:
+	0, then 1 while being set up, then 2. */
+static NDOF_Context         s_default_context;
+static volatile uint32_t    s_default_once = 0;
 
-/*	This library maintains a list of all the allocated NDOF_Device structures
-	to reliably and transparently maintain memory.  */
-NDOF_DeviceListNode *g_ndof_list_head = NULL;
-static int s_ndof_list_len = 0;
+/*	Hot-plug notification waiting for ndof_dispatch_events. */
+typedef struct NDOF_Notice {
+    NDOF_MpscNode               node;
+    NDOF_Device                *dev;    /* NULL once discarded */
+    NDOF_DeviceAddCallback      add;    /* one of them */
+    NDOF_DeviceRemovalCallback  removal;
+} NDOF_Notice;
 
 /* --------------------------------------------------------------------------
 	Static Function Prototypes                                                */
 
+static void ndof_context_setup(NDOF_Context *ctx);
+static int ndof_context_start(NDOF_Context *ctx,
+                              NDOF_DeviceAddCallback in_add_cb, 
+                              NDOF_DeviceRemovalCallback in_removal_cb,
+                              void *platform_specific, 
+                              NDOF_ReadyCallback ready_cb, void *ready_ctx,
+                              int async);
 static void ndof_devdispose(NDOF_Device *dev);
+static void ndof_devreclaim(void *dev);
+static int ndof_devlist_without(NDOF_DeviceListNode *head, 
+                                NDOF_DeviceListNode *node,
+                                NDOF_DeviceListNode **out);
+static int ndof_notice_post(NDOF_Device *dev, NDOF_DeviceAddCallback add,
+                            NDOF_DeviceRemovalCallback removal);
+
+/* -------------------------------------------------------------------------- */
+NDOF_Context *ndof_context_create()
+{
+    NDOF_Context *ctx = (NDOF_Context *) malloc(sizeof(NDOF_Context));
+    
+    if (ctx)
+        ndof_context_setup(ctx);
+    return ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_context_destroy(NDOF_Context *ctx)
+{
+    if (ctx == NULL || ctx == &s_default_context)
+        return;
+    
+    ndof_context_libcleanup(ctx);
+    free(ctx);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_Context *ndof_default_context()
+{
+    if (ndof_atomic_load32(&s_default_once) != 2)
+    {
+        if (ndof_atomic_cas32(&s_default_once, 0, 1))
+        {
+            ndof_context_setup(&s_default_context);
+            ndof_context_set_backend(&s_default_context, 
+                                     getenv("NDOF_BACKEND"));
+            ndof_atomic_store32(&s_default_once, 2);
+        }
+        else
+        {
+            while (ndof_atomic_load32(&s_default_once) != 2)
+                ndof_cpu_relax();
+        }
+    }
+    return &s_default_context;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_context_setup(NDOF_Context *ctx)
+{
+    memset(ctx, 0, sizeof(NDOF_Context));
+    ndof_epoch_init(&ctx->epoch);
+    ctx->ops = s_backends[0];
+    ctx->init_status = NDOF_INIT_NONE;
+    ctx->hotplug_window = NDOF_HOTPLUG_WINDOW_DEFAULT;
+    ctx->callback_mode = NDOF_CALLBACKS_DIRECT;
+    ndof_mpsc_init(&ctx->notices);
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_Backend *ndof_backend_find(const char *name)
+{
+    int i;
+    
+    for (i = 0; name && s_backends[i]; i++)
+        if (strcmp(s_backends[i]->name, name) == 0)
+            break;
+    return s_backends[i];
+}
+
+/* -------------------------------------------------------------------------- 
+    The devices already created have the private data of the backend they
+    were created with: too late then. */
+int ndof_context_set_backend(NDOF_Context *ctx, const char *name)
+{
+    const NDOF_Backend *ops = ndof_backend_find(name);
+    
+    if (ops == NULL
+        || ndof_atomic_load32(&ctx->init_status) != NDOF_INIT_NONE
+        || ndof_atomic_loadptr((void *const volatile *) &ctx->list_head))
+        return -1;
+    
+    ctx->ops = ops;
+    return 0;
+}
 
 /* -------------------------------------------------------------------------- */
 NDOF_Device *ndof_create()
+{
+    return ndof_context_create_device(ndof_default_context());
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_Device *ndof_context_create_device(NDOF_Context *ctx)
 {
     NDOF_Device *dev = (NDOF_Device *) malloc(sizeof(NDOF_Device));
-    
-    /* head insert */
     NDOF_DeviceListNode *node = 
         (NDOF_DeviceListNode*) malloc(sizeof(NDOF_DeviceListNode));
-    node->dev = dev;
-    node->next = g_ndof_list_head;
-    g_ndof_list_head = node;
-    s_ndof_list_len++;
-	
+    
+    if (dev == NULL || node == NULL)
+    {
+        free(dev);
+        free(node);
+        return NULL;
+    }
+    
     memset(dev, 0, sizeof(NDOF_Device));
     dev->btn_count = -1;  /* we could have an ndof device with no btns */
     dev->axes_min = -500; /* reasonable default value */
     dev->axes_max = +500; /* reasonable default value */
+    dev->context = ctx;
     
     /* initialize platform data */
-    dev->private_data = 
-        (NDOF_DevicePrivate*) malloc(sizeof(NDOF_DevicePrivate));
-	memset(dev->private_data, 0, sizeof(NDOF_DevicePrivate));
+    dev->private_data = calloc(1, ctx->ops->private_size);
+    
+    /* initialize cross platform sample pipeline */
+    dev->stream_data = ndof_stream_create();
+    
+    if (dev->private_data == NULL || dev->stream_data == NULL)
+    {
+        free(dev->private_data);
+        ndof_stream_dispose((NDOF_DeviceStream *) dev->stream_data);
+        free(dev);
+        free(node);
+        return NULL;
+    }
+    
+    /* head insert, once the device is ready to be seen */
+    node->dev = dev;
+    do
+    {
+        node->next = (NDOF_DeviceListNode *) 
+            ndof_atomic_loadptr((void *const volatile *) &ctx->list_head);
+    }
+    while (!ndof_atomic_casptr((void *volatile *) &ctx->list_head, 
+                               node->next, node));
+    ndof_atomic_add32(&ctx->list_len, 1);
     return dev;
 }
 
 /* -------------------------------------------------------------------------- */
 void ndof_destroy(NDOF_Device *in_device)
 {
-	NDOF_DeviceListNode *prev = NULL, *node = g_ndof_list_head;
-	while (node)
-	{
-		if (node->dev == in_device)
-		{
-			if (prev)
-				prev->next = node->next;
-			else
-				g_ndof_list_head = node->next; /* head delete */
-
-			free(node);
-			ndof_devdispose(in_device);
-			break;
-		}
-		else
-		{
-			prev = node;
-			node = node->next;
-		}
-	}
+    NDOF_Context *ctx = in_device->context;
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *head, *node, *list, *next, *after;
+    int done = 0;
+    
+    while (!done)
+    {
+        ndof_epoch_enter(&ctx->epoch, &guard);
+        head = (NDOF_DeviceListNode *) 
+            ndof_atomic_loadptr((void *const volatile *) &ctx->list_head);
+        for (node = head; node && node->dev != in_device; node = node->next)
+            ;
+        
+        /* destroyed twice, or after ndof_libcleanup freed it */
+        assert(node != NULL);
+        if (node == NULL)
+        {
+            ndof_epoch_exit(&guard);
+            return;
+        }
+        
+        if (ndof_devlist_without(head, node, &list) != 0)
+        {
+            /* out of memory: tried again once retired memory is freed */
+            ndof_epoch_exit(&guard);
+            ndof_epoch_collect(&ctx->epoch);
+            ndof_sleep_ns(1000000);
+            continue;
+        }
+        
+        if (ndof_atomic_casptr((void *volatile *) &ctx->list_head, 
+                               head, list))
+        {
+            /* readers may still be walking the old nodes */
+            for (next = head; next != node->next; next = after)
+            {
+                after = next->next;
+                ndof_epoch_retire(&ctx->epoch, free, next);
+            }
+            ndof_epoch_retire(&ctx->epoch, ndof_devreclaim, in_device);
+            ndof_atomic_add32(&ctx->list_len, (uint32_t) -1);
+            done = 1;
+        }
+        else
+        {
+            /* the list changed meanwhile */
+            for (next = list; next != node->next; next = after)
+            {
+                after = next->next;
+                free(next);
+            }
+        }
+        ndof_epoch_exit(&guard);
+    }
+    
+    /* freed right away if no reader is in */
+    ndof_epoch_collect(&ctx->epoch);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_DeviceListNode *ndof_devlist_enter(NDOF_Context *ctx, 
+                                        NDOF_EpochGuard *guard)
+{
+    ndof_epoch_enter(&ctx->epoch, guard);
+    return (NDOF_DeviceListNode *) 
+        ndof_atomic_loadptr((void *const volatile *) &ctx->list_head);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_devlist_exit(NDOF_EpochGuard *guard)
+{
+    ndof_epoch_exit(guard);
+}
+
+/* -------------------------------------------------------------------------- 
+    Copies the nodes before `node' into a new list, that shares the nodes 
+    after it with the old one. Returns -1 if out of memory. */
+static int ndof_devlist_without(NDOF_DeviceListNode *head, 
+                                NDOF_DeviceListNode *node,
+                                NDOF_DeviceListNode **out)
+{
+    NDOF_DeviceListNode **link = out, *next, *after;
+    
+    for (; head != node; head = head->next)
+    {
+        NDOF_DeviceListNode *copy = 
+            (NDOF_DeviceListNode*) malloc(sizeof(NDOF_DeviceListNode));
+        if (copy == NULL)
+        {
+            *link = NULL;
+            for (next = *out; next; next = after)
+            {
+                after = next->next;
+                free(next);
+            }
+            return -1;
+        }
+        copy->dev = head->dev;
+        *link = copy;
+        link = &copy->next;
+    }
+    *link = node->next;
+    return 0;
 }
 
 /* -------------------------------------------------------------------------- */
 static void ndof_devdispose(NDOF_Device *dev)
 {
-    ndof_dev_private_dispose((NDOF_DevicePrivate *)dev->private_data);
+    dev->context->ops->dispose(dev->private_data);
+    ndof_stream_dispose((NDOF_DeviceStream *)dev->stream_data);
     free(dev);
 }
 
+/* -------------------------------------------------------------------------- */
+static void ndof_devreclaim(void *dev)
+{
+    ndof_devdispose((NDOF_Device *) dev);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_libinit(NDOF_DeviceAddCallback in_add_cb, 
+                 NDOF_DeviceRemovalCallback in_removal_cb,
+                 void *platform_specific)
+{
+    return ndof_context_start(ndof_default_context(), in_add_cb, 
+                              in_removal_cb, platform_specific, NULL, NULL, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_context_libinit(NDOF_Context *ctx,
+                         NDOF_DeviceAddCallback in_add_cb, 
+                         NDOF_DeviceRemovalCallback in_removal_cb,
+                         void *platform_specific)
+{
+    return ndof_context_start(ctx, in_add_cb, in_removal_cb, 
+                              platform_specific, NULL, NULL, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_libinit_async(NDOF_DeviceAddCallback in_add_cb, 
+                       NDOF_DeviceRemovalCallback in_removal_cb,
+                       void *platform_specific,
+                       NDOF_ReadyCallback ready_cb, void *ready_ctx)
+{
+    return ndof_context_start(ndof_default_context(), in_add_cb, 
+                              in_removal_cb, platform_specific, 
+                              ready_cb, ready_ctx, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_context_libinit_async(NDOF_Context *ctx,
+                               NDOF_DeviceAddCallback in_add_cb, 
+                               NDOF_DeviceRemovalCallback in_removal_cb,
+                               void *platform_specific,
+                               NDOF_ReadyCallback ready_cb, void *ready_ctx)
+{
+    return ndof_context_start(ctx, in_add_cb, in_removal_cb, 
+                              platform_specific, ready_cb, ready_ctx, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_context_start(NDOF_Context *ctx,
+                              NDOF_DeviceAddCallback in_add_cb, 
+                              NDOF_DeviceRemovalCallback in_removal_cb,
+                              void *platform_specific, 
+                              NDOF_ReadyCallback ready_cb, void *ready_ctx,
+                              int async)
+{
+    int err;
+    
+    ctx->ready_cb = ready_cb;
+    ctx->ready_ctx = ready_ctx;
+    ndof_atomic_store32(&ctx->init_status, NDOF_INIT_PENDING);
+    err = ctx->ops->libinit(ctx, in_add_cb, in_removal_cb, 
+                            platform_specific, async);
+    if (err)
+        ndof_atomic_store32(&ctx->init_status, NDOF_INIT_FAILED);
+    return err;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_init_first(NDOF_Device *dev, void *param)
+{
+    return dev->context->ops->init_first(dev, param);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_devcount()
+{
+    NDOF_Context *ctx = ndof_default_context();
+    
+    return (ctx->ops->devcount ? ctx->ops->devcount(ctx) : -1);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_init_done(NDOF_Context *ctx, int err)
+{
+    NDOF_InitStatus status = (err ? NDOF_INIT_FAILED : NDOF_INIT_READY);
+    
+    ndof_atomic_store32(&ctx->init_status, status);
+    ndof_wake_address(&ctx->init_status);
+    if (ctx->ready_cb)
+        ctx->ready_cb(status, ctx->ready_ctx);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_InitStatus ndof_init_status()
+{
+    return ndof_context_init_status(ndof_default_context());
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_InitStatus ndof_context_init_status(NDOF_Context *ctx)
+{
+    return (NDOF_InitStatus) ndof_atomic_load32(&ctx->init_status);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_InitStatus ndof_wait_ready(uint64_t timeout_ns)
+{
+    return ndof_context_wait_ready(ndof_default_context(), timeout_ns);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_InitStatus ndof_context_wait_ready(NDOF_Context *ctx, uint64_t timeout_ns)
+{
+    uint64_t deadline = ndof_time_ns() + timeout_ns;
+    uint32_t status = ndof_atomic_load32(&ctx->init_status);
+    
+    while (status == NDOF_INIT_PENDING && timeout_ns > 0
+           && !ndof_wait_on_address(&ctx->init_status, status, deadline))
+    {
+        status = ndof_atomic_load32(&ctx->init_status);
+    }
+    return (NDOF_InitStatus) ndof_atomic_load32(&ctx->init_status);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_set_hotplug_window(uint64_t window_ns)
+{
+    ndof_context_set_hotplug_window(ndof_default_context(), window_ns);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_context_set_hotplug_window(NDOF_Context *ctx, uint64_t window_ns)
+{
+    ndof_atomic_store64(&ctx->hotplug_window, window_ns);
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_hotplug_window(NDOF_Context *ctx)
+{
+    return ndof_atomic_load64(&ctx->hotplug_window);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_set_callback_mode(NDOF_CallbackMode mode)
+{
+    ndof_context_set_callback_mode(ndof_default_context(), mode);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_context_set_callback_mode(NDOF_Context *ctx, NDOF_CallbackMode mode)
+{
+    ndof_atomic_store32(&ctx->callback_mode, mode);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_dispatch_events()
+{
+    return ndof_context_dispatch_events(ndof_default_context());
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_context_dispatch_events(NDOF_Context *ctx)
+{
+    NDOF_Notice *batch = NULL, **last = &batch, *notice;
+    int count = 0;
+    
+    if (!ndof_atomic_cas32(&ctx->dispatching, 0, 1))
+        return 0;
+    
+    /* taken out first, so that the notices of a device discarded by its 
+       add callback can be dropped */
+    while ((notice = (NDOF_Notice *) ndof_mpsc_pop(&ctx->notices)) != NULL)
+    {
+        notice->node.next = NULL;
+        *last = notice;
+        last = (NDOF_Notice **) &notice->node.next;
+    }
+    
+    while (batch)
+    {
+        notice = batch;
+        batch = (NDOF_Notice *) notice->node.next;
+        
+        if (notice->dev == NULL)
+            ;
+        else if (notice->removal)
+            notice->removal(notice->dev);
+        else if (notice->add(notice->dev) == NDOF_DISCARD_HOTPLUGGED)
+        {
+            NDOF_Notice *later;
+            
+            for (later = batch; later; later = (NDOF_Notice *) later->node.next)
+                if (later->dev == notice->dev)
+                    later->dev = NULL;
+            ndof_destroy(notice->dev);
+        }
+        
+        if (notice->dev)
+            count++;
+        free(notice);
+    }
+    
+    ndof_atomic_store32(&ctx->dispatching, 0);
+    return count;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_update(NDOF_Device *in_dev)
+{
+    NDOF_Context *ctx = in_dev->context;
+    
+    ctx->ops->update(in_dev);
+    
+    /* after the update: the callbacks may destroy in_dev */
+    if (ndof_atomic_load32(&ctx->callback_mode) == NDOF_CALLBACKS_IN_UPDATE)
+        ndof_context_dispatch_events(ctx);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_HotPlugResult ndof_notify_added(NDOF_DeviceAddCallback cb, 
+                                     NDOF_Device *dev)
+{
+    if (ndof_atomic_load32(&dev->context->callback_mode) 
+        == NDOF_CALLBACKS_DIRECT
+        || ndof_notice_post(dev, cb, NULL) != 0)
+        return cb(dev);
+    return NDOF_KEEP_HOTPLUGGED;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_notify_removed(NDOF_DeviceRemovalCallback cb, NDOF_Device *dev)
+{
+    if (ndof_atomic_load32(&dev->context->callback_mode) 
+        == NDOF_CALLBACKS_DIRECT
+        || ndof_notice_post(dev, NULL, cb) != 0)
+        cb(dev);
+}
+
+/* -------------------------------------------------------------------------- 
+    Queues a notification in the device's context. Returns -1 if out of 
+    memory: the callback is then called directly. */
+static int ndof_notice_post(NDOF_Device *dev, NDOF_DeviceAddCallback add,
+                            NDOF_DeviceRemovalCallback removal)
+{
+    NDOF_Notice *notice = (NDOF_Notice *) malloc(sizeof(NDOF_Notice));
+    
+    if (notice == NULL)
+        return -1;
+    
+    notice->dev = dev;
+    notice->add = add;
+    notice->removal = removal;
+    ndof_mpsc_push(&dev->context->notices, &notice->node);
+    return 0;
+}
+
 /* -------------------------------------------------------------------------- */
 void ndof_libcleanup()
+{
+    ndof_context_libcleanup(ndof_default_context());
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_context_libcleanup(NDOF_Context *ctx)
 {
     NDOF_DeviceListNode *node;
+    NDOF_Notice *notice;
 
 #ifdef NDOF_DEBUG
     fprintf(NDOF_DEBUG, "libndofdev: cleaning up...\n");
 #endif
 
-    while (g_ndof_list_head)
+    ctx->ops->stop(ctx);
+    
+    /* notifications never dispatched */
+    while ((notice = (NDOF_Notice *) ndof_mpsc_pop(&ctx->notices)) != NULL)
+        free(notice);
+    
+    node = (NDOF_DeviceListNode *) 
+        ndof_atomic_xchgptr((void *volatile *) &ctx->list_head, NULL);
+    while (node)
     {
-        ndof_devdispose(g_ndof_list_head->dev);
-        node = g_ndof_list_head->next;
-        free(g_ndof_list_head);
-        g_ndof_list_head = node;
+        NDOF_DeviceListNode *next = node->next;
+        
+        ndof_epoch_retire(&ctx->epoch, ndof_devreclaim, node->dev);
+        ndof_epoch_retire(&ctx->epoch, free, node);
+        node = next;
     }
+    ndof_atomic_store32(&ctx->list_len, 0);
+    ndof_epoch_barrier(&ctx->epoch);
     
-    ndof_cleanup_internal();
+    ctx->ops->cleanup(ctx);
+    ndof_atomic_store32(&ctx->init_status, NDOF_INIT_NONE);
 
 #ifdef NDOF_DEBUG
     fprintf(NDOF_DEBUG, "libndofdev: clean up completed.\n");
@@ -138,18 +644,36 @@ void ndof_libcleanup()
 /* -------------------------------------------------------------------------- */
 unsigned char ndof_match(NDOF_Device *dev1, NDOF_Device *dev2)
 {
-    if (dev1 && dev2)
+    if (dev1 && dev2 && dev1->context->ops == dev2->context->ops)
     {
-        size_t lenm1 = strlen(dev1->manufacturer);
-        size_t lenp1 = strlen(dev1->product);
+        NDOF_DeviceKey key1 = ndof_stream_key(dev1);
+        NDOF_DeviceKey key2 = ndof_stream_key(dev2);
+        size_t lenm1;
+        size_t lenp1;
+        
+        // identified devices: the keys say it all
+        if (!ndof_key_is_null(&key1) && !ndof_key_is_null(&key2))
+            return (unsigned char) ndof_key_equal(&key1, &key2);
+        
+        lenm1 = strlen(dev1->manufacturer);
+        lenp1 = strlen(dev1->product);
         
         if (strncmp(dev1->manufacturer, dev2->manufacturer, lenm1) == 0
             && strncmp(dev1->product, dev2->product, lenp1) == 0
             && dev1->axes_count == dev2->axes_count 
             && dev1->btn_count == dev2->btn_count)
         {
-            return ndof_match_private((NDOF_DevicePrivate*)dev1->private_data, 
-                                      (NDOF_DevicePrivate*)dev2->private_data);
+            /* backends may look at what they retire through the epochs */
+            NDOF_EpochGuard guard1, guard2;
+            unsigned char same;
+            
+            ndof_epoch_enter(&dev1->context->epoch, &guard1);
+            ndof_epoch_enter(&dev2->context->epoch, &guard2);
+            same = dev1->context->ops->match(dev1->private_data, 
+                                             dev2->private_data);
+            ndof_epoch_exit(&guard2);
+            ndof_epoch_exit(&guard1);
+            return same;
         }
     }
     
@@ -159,7 +683,14 @@ unsigned char ndof_match(NDOF_Device *dev1, NDOF_Device *dev2)
 /* -------------------------------------------------------------------------- */
 void ndof_dump_list(FILE* stream)
 {
-    NDOF_DeviceListNode *node = g_ndof_list_head;
+    ndof_context_dump_list(ndof_default_context(), stream);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_context_dump_list(NDOF_Context *ctx, FILE* stream)
+{
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node = ndof_devlist_enter(ctx, &guard);
     
     fprintf(stream, "libndofdev: List of currently used NDOF devices:\n");
  
@@ -168,6 +699,7 @@ void ndof_dump_list(FILE* stream)
         ndof_dump(stream, node->dev);
         node = node->next;
     }
+    ndof_devlist_exit(&guard);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -186,27 +718,8 @@ void ndof_dump(FILE* stream, NDOF_Device *dev)
 			dev->axes_min, dev->axes_max, dev->absolute, dev->valid, 
             dev->private_data);
 	
-#if TARGET_OS_MAC
-    {
-        int i;
-        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*)dev->private_data;
-        fprintf(stream, "    curr_loc_id=%08lX\n", priv->curr_loc_id);
-        
-        fprintf(stream, "    scales:  [");
-        for (i=0; i<NDOF_MAX_AXES_COUNT; i++)
-             fprintf(stream, "%f ", priv->scale[i]);
-        
-        fprintf(stream, "]\n    offsets: [");
-        for (i=0; i<NDOF_MAX_AXES_COUNT; i++)
-            fprintf(stream, "%f ", priv->offset[i]);
-
-        fprintf(stream, "]\n");
-    }
-#elif defined(_WIN32) || defined(WIN32)
-	fprintf(stream, "type=%hd; subtype=%hd\n", 
-			((NDOF_DevicePrivate*)dev->private_data)->type,
-			((NDOF_DevicePrivate*)dev->private_data)->subtype);
-#endif	
+    if (dev->context->ops->dump)
+        dev->context->ops->dump(stream, dev);
 }
 
 /* -------------------------------------------------------------------------- */
@@ -216,19 +729,21 @@ void test_device_list_add()
 	/* Run this test before the others */
 	
     NDOF_Device *dev1, *dev2;
-	NDOF_DeviceListNode *node;
+	NDOF_DeviceListNode *node, *head;
+	NDOF_EpochGuard guard;
 	int n, m, err1, err2;
 	
     fprintf(stderr, "____ test_device_list_add ____________________________\n");
 	
 	/* count device list nodes before adding new nodes */ 
-	node = g_ndof_list_head;
+	node = ndof_devlist_enter(ndof_default_context(), &guard);
 	n = 0;
 	while (node)
 	{
 		n++;
 		node = node->next;
 	}		
+	ndof_devlist_exit(&guard);
 	
     dev1 = ndof_create();
     dev2 = ndof_create();
@@ -236,7 +751,7 @@ void test_device_list_add()
     assert(dev2);
     
 	/* test length of device list after additions */
-	node = g_ndof_list_head;
+	head = node = ndof_devlist_enter(ndof_default_context(), &guard);
 	m = 0;
 	while (node)
 	{
@@ -246,7 +761,7 @@ void test_device_list_add()
 		node = node->next;
 	}		
 	assert(m == n + 2);
-	assert(m == s_ndof_list_len);
+	assert(m == (int) ndof_atomic_load32(&ndof_default_context()->list_len));
 	
 	/* compare 2 additions, they should be the same (init'ed to 0's) */
 	assert(strcmp(dev1->manufacturer, dev2->manufacturer) == 0);
@@ -262,9 +777,10 @@ void test_device_list_add()
     assert(dev1->axes_min == dev2->axes_min);
     assert(dev1->axes_max == dev2->axes_max);
 	
-	assert(g_ndof_list_head);
-	assert(g_ndof_list_head->next);
-	assert(g_ndof_list_head->next->next == NULL);
+	assert(head);
+	assert(head->next);
+	assert(head->next->next == NULL);
+	ndof_devlist_exit(&guard);
 	
 	/* now init the devices proxies */
 	err1 = ndof_init_first(dev1, NULL);
@@ -0,0 +1,102 @@
+/*
+ @file ndofdev_backend.h
+ @brief Table of the functions through which a backend reads devices.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_backend_h__
+#define __ndofdev_backend_h__
+
+#include <stdio.h>
+#include "ndofdev_external.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  A backend finds devices and reads them. Each context uses one, chosen
+    before it is initialized (see ndof_context_set_backend): the devices of
+    a context have its backend's private data. Backends set up nothing 
+    until their libinit is called, so those compiled in but not chosen 
+    cost nothing. */
+
+typedef struct NDOF_Backend {
+    const char *name;
+    size_t      private_size;   /* of private_data, zeroed by ndof_create */
+    int         variant;        /* backend specific, see the tables */
+    
+    /* part of ndof_libinit. When `async' is set it must not block: it 
+       starts the enumeration on its own thread. Either way the backend 
+       calls ndof_init_done once the devices attached at startup are known */
+    int  (*libinit)(NDOF_Context *ctx, NDOF_DeviceAddCallback in_add_cb, 
+                    NDOF_DeviceRemovalCallback in_removal_cb,
+                    void *platform_specific, int async);
+    /* stops the hot-plug notifications, so that ndof_libcleanup can dispose
+       of the devices */
+    void (*stop)(NDOF_Context *ctx);
+    /* releases what libinit set up, ctx->backend; called for contexts 
+       never initialized too */
+    void (*cleanup)(NDOF_Context *ctx);
+    
+    /* devices attached, -1 if unknown */
+    int  (*devcount)(NDOF_Context *ctx);
+    /* enumerates and opens the first device, see ndof_init_first */
+    int  (*init_first)(NDOF_Device *dev, void *param);
+    /* reads what the device queued, then ndof_stream_publish */
+    void (*update)(NDOF_Device *dev);
+    /* closes the device and frees its private data */
+    void (*dispose)(void *priv);
+    /* 1 if both are the same device at the same port; called in read-side
+       sections of both devices' contexts */
+    unsigned char (*match)(void *priv1, void *priv2);
+    /* backend specific lines of ndof_dump, may be NULL */
+    void (*dump)(FILE *stream, NDOF_Device *dev);
+} NDOF_Backend;
+
+#if TARGET_OS_MAC
+extern const NDOF_Backend ndof_backend_osx;
+#elif defined(_WIN32) || defined(WIN32)
+extern const NDOF_Backend ndof_backend_win;
+#else /* linux */
+extern const NDOF_Backend ndof_backend_linux;   /* hidraw, else evdev */
+extern const NDOF_Backend ndof_backend_hidraw;
+extern const NDOF_Backend ndof_backend_evdev;
+#endif
+extern const NDOF_Backend ndof_backend_synthetic;
+extern const NDOF_Backend ndof_backend_replay;
+#if !defined(_WIN32) && !defined(WIN32)
+extern const NDOF_Backend ndof_backend_shm;
+#endif
+
+/** The backend called `name', NULL if not compiled in. NULL names the 
+ *  native backend of the platform. */
+const NDOF_Backend *ndof_backend_find(const char *name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_backend_h__ */
@@ -0,0 +1,258 @@
+/*
+ @file ndofdev_capcache.c
+ @brief Persistent cache of device capabilities, mapped in memory.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_capcache.h"
+#include "ndofdev_quirks.h"
+
+#if defined(_WIN32) || defined(WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_caprecord_cmp(const void *a, const void *b);
+static int ndof_capcache_map(NDOF_CapCache *cache, const char *path);
+static int ndof_capcache_replace(const char *tmp_path, const char *path);
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_descriptor_hash(const unsigned char *desc, size_t len)
+{
+    uint64_t h = 14695981039346656037ULL; /* FNV-1a */
+    size_t i;
+    
+    for (i = 0; i < len; i++)
+    {
+        h ^= desc[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_capcache_open(NDOF_CapCache *cache, const char *path)
+{
+    const NDOF_CapHeader *hdr;
+    
+    memset(cache, 0, sizeof(NDOF_CapCache));
+    if (path == NULL || ndof_capcache_map(cache, path) != 0)
+        return -1;
+    
+    hdr = (const NDOF_CapHeader *) cache->base;
+    if (cache->size < sizeof(NDOF_CapHeader)
+        || hdr->magic != NDOF_CAPCACHE_MAGIC
+        || hdr->format != NDOF_CAPCACHE_FORMAT
+        || hdr->record_size != sizeof(NDOF_CapRecord)
+        || cache->size != sizeof(NDOF_CapHeader) 
+                          + (size_t) hdr->count * sizeof(NDOF_CapRecord))
+    {
+        ndof_capcache_close(cache);
+        return -1;
+    }
+    
+    cache->records = (const NDOF_CapRecord *) (hdr + 1);
+    cache->count = hdr->count;
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_capcache_close(NDOF_CapCache *cache)
+{
+#if defined(_WIN32) || defined(WIN32)
+    if (cache->base)
+        UnmapViewOfFile(cache->base);
+    if (cache->mapping)
+        CloseHandle((HANDLE) cache->mapping);
+#else
+    if (cache->base)
+        munmap(cache->base, cache->size);
+#endif
+    memset(cache, 0, sizeof(NDOF_CapCache));
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_DeviceLayout *ndof_capcache_find(const NDOF_CapCache *cache,
+                                            long vendor_id, long product_id,
+                                            long version, uint64_t desc_hash)
+{
+    NDOF_CapRecord key;
+    const NDOF_CapRecord *rec;
+    
+    if (cache->count == 0)
+        return NULL;
+    
+    key.model = NDOF_QUIRKS_KEY(vendor_id, product_id);
+    key.version = (uint32_t) version;
+    key.desc_hash = desc_hash;
+    rec = (const NDOF_CapRecord *) bsearch(&key, cache->records, cache->count,
+                                           sizeof(NDOF_CapRecord), 
+                                           ndof_caprecord_cmp);
+    return (rec ? &rec->layout : NULL);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_capcache_store(NDOF_CapCache *cache, const char *path, 
+                        const NDOF_CapRecord *records, size_t count)
+{
+    NDOF_CapHeader hdr;
+    NDOF_CapRecord *all;
+    char *tmp_path;
+    size_t n = 0, fresh, i;
+    FILE *f;
+    int err = -1;
+    
+    all = (NDOF_CapRecord *) malloc((cache->count + count + 1) 
+                                    * sizeof(NDOF_CapRecord));
+    tmp_path = (char *) malloc(strlen(path) + 5);
+    if (all == NULL || tmp_path == NULL)
+    {
+        free(all);
+        free(tmp_path);
+        return -1;
+    }
+    
+    /* the new records, then the old ones they do not replace */
+    memcpy(all, records, count * sizeof(NDOF_CapRecord));
+    qsort(all, count, sizeof(NDOF_CapRecord), ndof_caprecord_cmp);
+    for (i = 0; i < count; i++)
+        if (n == 0 || ndof_caprecord_cmp(&all[n - 1], &all[i]) != 0)
+            all[n++] = all[i];
+    fresh = n;
+    for (i = 0; i < cache->count; i++)
+        if (!bsearch(&cache->records[i], all, fresh, sizeof(NDOF_CapRecord), 
+                     ndof_caprecord_cmp))
+            all[n++] = cache->records[i];
+    qsort(all, n, sizeof(NDOF_CapRecord), ndof_caprecord_cmp);
+    
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NDOF_CAPCACHE_MAGIC;
+    hdr.format = NDOF_CAPCACHE_FORMAT;
+    hdr.record_size = sizeof(NDOF_CapRecord);
+    hdr.count = (uint32_t) n;
+    
+    sprintf(tmp_path, "%s.new", path);
+    f = fopen(tmp_path, "wb");
+    if (f)
+    {
+        if (fwrite(&hdr, sizeof(hdr), 1, f) == 1
+            && fwrite(all, sizeof(NDOF_CapRecord), n, f) == n)
+            err = 0;
+        if (fclose(f) != 0)
+            err = -1;
+    }
+    free(all);
+    
+    ndof_capcache_close(cache);
+    if (err == 0)
+        err = ndof_capcache_replace(tmp_path, path);
+    else
+        remove(tmp_path);
+    free(tmp_path);
+    
+    ndof_capcache_open(cache, path);
+    return err;
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_caprecord_cmp(const void *a, const void *b)
+{
+    const NDOF_CapRecord *ra = (const NDOF_CapRecord *) a;
+    const NDOF_CapRecord *rb = (const NDOF_CapRecord *) b;
+    
+    if (ra->model != rb->model)
+        return (ra->model < rb->model ? -1 : 1);
+    if (ra->version != rb->version)
+        return (ra->version < rb->version ? -1 : 1);
+    if (ra->desc_hash != rb->desc_hash)
+        return (ra->desc_hash < rb->desc_hash ? -1 : 1);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_capcache_map(NDOF_CapCache *cache, const char *path)
+{
+#if defined(_WIN32) || defined(WIN32)
+    HANDLE file;
+    LARGE_INTEGER size;
+    
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                       NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return -1;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return -1;
+    }
+    cache->mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (cache->mapping == NULL)
+        return -1;
+    cache->base = MapViewOfFile((HANDLE) cache->mapping, FILE_MAP_READ, 0, 0, 0);
+    cache->size = (size_t) size.QuadPart;
+    return (cache->base ? 0 : -1);
+#else
+    struct stat st;
+    void *base;
+    int fd = open(path, O_RDONLY);
+    
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return -1;
+    cache->base = base;
+    cache->size = (size_t) st.st_size;
+    return 0;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_capcache_replace(const char *tmp_path, const char *path)
+{
+#if defined(_WIN32) || defined(WIN32)
+    return (MoveFileExA(tmp_path, path, MOVEFILE_REPLACE_EXISTING) ? 0 : -1);
+#else
+    return (rename(tmp_path, path) == 0 ? 0 : -1);
+#endif
+}
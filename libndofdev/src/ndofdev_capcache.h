@@ -0,0 +1,100 @@
+/*
+ @file ndofdev_capcache.h
+ @brief Persistent cache of device capabilities, mapped in memory.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_capcache_h__
+#define __ndofdev_capcache_h__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ndofdev_reconnect.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_CAPCACHE_MAGIC     0x4343444eu /* "NDCC" */
+#define NDOF_CAPCACHE_FORMAT    1
+
+/** Layout of one model, keyed by what can change it: model, firmware 
+ *  version and report descriptor. */
+typedef struct NDOF_CapRecord {
+    uint32_t          model;        /* NDOF_QUIRKS_KEY(vendor_id, product_id) */
+    uint32_t          version;
+    uint64_t          desc_hash;    /* ndof_descriptor_hash */
+    NDOF_DeviceLayout layout;
+} NDOF_CapRecord;
+
+/** File header, followed by `count' records sorted by key. The record size
+ *  guards against files written by another build of the library. */
+typedef struct NDOF_CapHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t record_size;
+    uint32_t count;
+} NDOF_CapHeader;
+
+/** Read only mapping of a cache file. */
+typedef struct NDOF_CapCache {
+    void                 *base;
+    size_t                size;
+    const NDOF_CapRecord *records;
+    size_t                count;
+#if defined(_WIN32) || defined(WIN32)
+    void                 *mapping;
+#endif
+} NDOF_CapCache;
+
+uint64_t ndof_descriptor_hash(const unsigned char *desc, size_t len);
+
+/** Maps the cache file at `path'. A missing or invalid file leaves an
+ *  empty cache. Returns 0 if the file was mapped, -1 otherwise. */
+int ndof_capcache_open(NDOF_CapCache *cache, const char *path);
+void ndof_capcache_close(NDOF_CapCache *cache);
+
+/** Layout of the model in the cache, or NULL: a full parse is needed. */
+const NDOF_DeviceLayout *ndof_capcache_find(const NDOF_CapCache *cache,
+                                            long vendor_id, long product_id,
+                                            long version, uint64_t desc_hash);
+
+/* --------------------------------------------------------------------------
+    Purpose:    Adds or replaces records in the cache file.
+    Parameters: cache - mapping of `path', remapped on return
+                records - `count' records to add
+    Notes:      The new file is written aside, then renamed over the old
+                one: concurrent readers see either file, never a mix.
+    Returns:    0 on success, -1 on I/O errors.
+*/
+int ndof_capcache_store(NDOF_CapCache *cache, const char *path, 
+                        const NDOF_CapRecord *records, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_capcache_h__ */
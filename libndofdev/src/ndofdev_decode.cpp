@@ -0,0 +1,228 @@
+/*
+ @file ndofdev_decode.cpp
+ @brief Decode kernels specialized for the fixed report layouts of known devices.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include "ndofdev_report.h"
+#include "ndofdev_quirks.h"
+
+/*  Most 3Dconnexion devices send their axes as little endian 16 bit values
+    at fixed places, either split over a translation and a rotation report
+    or in a single report, and their buttons as a bitmap in another report.
+    Each NDOF_ReportLayout of the quirks database is described below by
+    compile time traits, from which the templates generate decode functions
+    with every offset and shift folded into straight line code. A device 
+    only gets a specialized kernel if its parsed descriptor agrees with the
+    traits, so an unexpected firmware still goes through the generic plan. */
+
+namespace {
+
+/* -------------------------------------------------------------------------- 
+    Compile time traits of a report layout. Offsets are in bytes from the
+    byte following the report ID. */
+template <unsigned char TranslationReport, unsigned TranslationOffset,
+          unsigned char RotationReport, unsigned RotationOffset,
+          unsigned char ButtonReport, unsigned ButtonOffset, 
+          unsigned ButtonCount>
+struct ReportLayout
+{
+    static constexpr unsigned char kTranslationReport = TranslationReport;
+    static constexpr unsigned      kTranslationOffset = TranslationOffset;
+    static constexpr unsigned char kRotationReport    = RotationReport;
+    static constexpr unsigned      kRotationOffset    = RotationOffset;
+    static constexpr unsigned char kButtonReport      = ButtonReport;
+    static constexpr unsigned      kButtonOffset      = ButtonOffset;
+    static constexpr unsigned      kButtonCount       = ButtonCount;
+    static constexpr unsigned      kAxisBits          = 16;
+    
+    static_assert(ButtonCount <= NDOF_MAX_BUTTONS_COUNT, "too many buttons");
+};
+
+/* one per NDOF_ReportLayout */
+typedef ReportLayout<1, 0, 2, 0, 3, 0, 2>  SplitLayout2;
+typedef ReportLayout<1, 0, 2, 0, 3, 0, 15> SplitLayout15;
+typedef ReportLayout<1, 0, 2, 0, 3, 0, 21> SplitLayout21;
+typedef ReportLayout<1, 0, 2, 0, 3, 0, 31> SplitLayout31;
+typedef ReportLayout<1, 0, 1, 6, 3, 0, 2>  SingleLayout2;
+typedef ReportLayout<1, 0, 1, 6, 3, 0, 15> SingleLayout15;
+
+/* -------------------------------------------------------------------------- 
+    Reads Count int16 axes from p + Offset into axes[First...], unrolled. */
+template <unsigned Offset, unsigned First, unsigned Count>
+struct Int16Axes
+{
+    static inline void read(const unsigned char *p, long *axes)
+    {
+        axes[First] = (short)(p[Offset] | (p[Offset + 1] << 8));
+        Int16Axes<Offset + 2, First + 1, Count - 1>::read(p, axes);
+    }
+};
+
+template <unsigned Offset, unsigned First>
+struct Int16Axes<Offset, First, 0>
+{
+    static inline void read(const unsigned char *, long *) {}
+};
+
+/* -------------------------------------------------------------------------- 
+    Reads Count button bits from the bitmap at p + Offset, unrolled. */
+template <unsigned Offset, unsigned First, unsigned Count>
+struct ButtonBits
+{
+    static inline void read(const unsigned char *p, long *buttons)
+    {
+        buttons[First] = (p[Offset + First / 8] >> (First % 8)) & 1;
+        ButtonBits<Offset, First + 1, Count - 1>::read(p, buttons);
+    }
+};
+
+template <unsigned Offset, unsigned First>
+struct ButtonBits<Offset, First, 0>
+{
+    static inline void read(const unsigned char *, long *) {}
+};
+
+/* -------------------------------------------------------------------------- */
+template <class L>
+struct Kernel
+{
+    static constexpr size_t kButtonBytes = (L::kButtonCount + 7) / 8;
+    
+    static int decode(const NDOF_ReportPlan *, const unsigned char *report,
+                      size_t len, long *axes, long *buttons)
+    {
+        int decoded = 0;
+        const unsigned char *p = report + 1;
+        
+        if (len == 0)
+            return 0;
+        len--;
+        
+        if (report[0] == L::kTranslationReport 
+            && len >= L::kTranslationOffset + 6)
+        {
+            Int16Axes<L::kTranslationOffset, 0, 3>::read(p, axes);
+            decoded |= NDOF_DECODED_AXES;
+        }
+        if (report[0] == L::kRotationReport 
+            && len >= L::kRotationOffset + 6)
+        {
+            Int16Axes<L::kRotationOffset, 3, 3>::read(p, axes);
+            decoded |= NDOF_DECODED_AXES;
+        }
+        if (report[0] == L::kButtonReport 
+            && len >= L::kButtonOffset + kButtonBytes)
+        {
+            ButtonBits<L::kButtonOffset, 0, L::kButtonCount>::read(p, buttons);
+            decoded |= NDOF_DECODED_BUTTONS;
+        }
+        
+        return decoded;
+    }
+    
+    /* true if the parsed descriptor puts every value where L says */
+    static bool matches(const NDOF_ReportPlan *plan)
+    {
+        unsigned found_axes = 0;
+        unsigned long found_buttons = 0;
+        
+        if (!plan->uses_report_ids)
+            return false;
+        
+        for (int i = 0; i < plan->field_count; i++)
+        {
+            const NDOF_ReportField &f = plan->fields[i];
+            
+            if (f.target >= NDOF_FIELD_BUTTON)
+            {
+                unsigned b = f.target - NDOF_FIELD_BUTTON;
+                if (b >= L::kButtonCount || f.report_id != L::kButtonReport 
+                    || f.bit_size != 1 || f.bit_offset != L::kButtonOffset * 8 + b)
+                    return false;
+                found_buttons |= 1UL << b;
+            }
+            else
+            {
+                unsigned a = f.target - NDOF_FIELD_AXIS;
+                unsigned char id = (a < 3 ? L::kTranslationReport 
+                                          : L::kRotationReport);
+                unsigned offset = (a < 3 ? L::kTranslationOffset 
+                                         : L::kRotationOffset) + 2 * (a % 3);
+                if (f.report_id != id || f.bit_size != L::kAxisBits 
+                    || !f.is_signed || f.bit_offset != offset * 8)
+                    return false;
+                found_axes |= 1U << a;
+            }
+        }
+        
+        return found_axes == 0x3f 
+               && found_buttons == (L::kButtonCount == 32 ? ~0UL 
+                                    : (1UL << L::kButtonCount) - 1);
+    }
+};
+
+/* -------------------------------------------------------------------------- */
+struct KernelEntry
+{
+    NDOF_DecodeFn decode;
+    bool (*matches)(const NDOF_ReportPlan *plan);
+};
+
+#define NDOF_KERNEL(layout) { &Kernel<layout>::decode, &Kernel<layout>::matches }
+
+/* indexed by NDOF_ReportLayout */
+const KernelEntry kKernels[] = {
+    { &ndof_report_decode, NULL },
+    NDOF_KERNEL(SplitLayout2),
+    NDOF_KERNEL(SplitLayout15),
+    NDOF_KERNEL(SplitLayout21),
+    NDOF_KERNEL(SplitLayout31),
+    NDOF_KERNEL(SingleLayout2),
+    NDOF_KERNEL(SingleLayout15)
+};
+
+static_assert(sizeof(kKernels) / sizeof(kKernels[0]) == NDOF_LAYOUT_COUNT,
+              "one kernel per NDOF_ReportLayout");
+
+#undef NDOF_KERNEL
+
+} // namespace
+
+/* -------------------------------------------------------------------------- */
+extern "C" NDOF_DecodeFn ndof_decode_select(long vendor_id, long product_id,
+                                            const NDOF_ReportPlan *plan)
+{
+    const NDOF_DeviceQuirks *q = ndof_quirks_lookup(vendor_id, product_id);
+    
+    if (q && plan && q->layout != NDOF_LAYOUT_GENERIC 
+        && q->layout < NDOF_LAYOUT_COUNT && kKernels[q->layout].matches(plan))
+        return kKernels[q->layout].decode;
+    
+    return &ndof_report_decode;
+}
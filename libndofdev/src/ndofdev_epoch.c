@@ -0,0 +1,185 @@
+/*
+ @file ndofdev_epoch.c
+ @brief Epoch based reclamation of memory shared with lock-free readers.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_epoch.h"
+
+typedef struct NDOF_Retired {
+    struct NDOF_Retired *next;
+    NDOF_ReclaimFn       reclaim;
+    void                *p;
+    uint64_t             epoch;     /* when it was retired */
+} NDOF_Retired;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_epoch_advance(NDOF_EpochDomain *d);
+static void ndof_epoch_push(NDOF_EpochDomain *d, NDOF_Retired *first, 
+                            NDOF_Retired *last);
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_init(NDOF_EpochDomain *d)
+{
+    memset(d, 0, sizeof(NDOF_EpochDomain));
+    d->epoch = 1;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_enter(NDOF_EpochDomain *d, NDOF_EpochGuard *guard)
+{
+    /* threads start looking at different slots: their stacks differ */
+    unsigned start = (unsigned) ((uintptr_t) guard >> 6), n;
+    uint64_t e = ndof_atomic_load64(&d->epoch), now;
+    
+    guard->domain = d;
+    for (n = 0; ; n++)
+    {
+        guard->slot = (start + n) % NDOF_EPOCH_SLOTS;
+        if (ndof_atomic_cas64(&d->slots[guard->slot].epoch, 0, e))
+            break;
+        if (n % NDOF_EPOCH_SLOTS == NDOF_EPOCH_SLOTS - 1)
+            ndof_sleep_ns(1000);
+    }
+    
+    /* the epoch announced must be the current one once visible, or a 
+       writer could have moved on twice in between */
+    ndof_atomic_fence();
+    while ((now = ndof_atomic_load64(&d->epoch)) != e)
+    {
+        ndof_atomic_cas64(&d->slots[guard->slot].epoch, e, now);
+        ndof_atomic_fence();
+        e = now;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_exit(NDOF_EpochGuard *guard)
+{
+    ndof_atomic_store64(&guard->domain->slots[guard->slot].epoch, 0);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_retire(NDOF_EpochDomain *d, NDOF_ReclaimFn reclaim, void *p)
+{
+    NDOF_Retired *r = (NDOF_Retired *) malloc(sizeof(NDOF_Retired));
+    
+    /* better leaked than freed under a reader */
+    if (r == NULL)
+        return;
+    
+    r->reclaim = reclaim;
+    r->p = p;
+    r->epoch = ndof_atomic_load64(&d->epoch);
+    ndof_atomic_add32(&d->pending, 1);
+    ndof_epoch_push(d, r, r);
+    ndof_epoch_collect(d);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_collect(NDOF_EpochDomain *d)
+{
+    NDOF_Retired *r, *next, *kept = NULL, *kept_last = NULL;
+    uint64_t epoch;
+    
+    /* twice if the readers allow: what was retired now is then due */
+    if (ndof_epoch_advance(d))
+        ndof_epoch_advance(d);
+    epoch = ndof_atomic_load64(&d->epoch);
+    
+    r = (NDOF_Retired *) ndof_atomic_xchgptr((void *volatile *) &d->retired, 
+                                             NULL);
+    for (; r; r = next)
+    {
+        next = r->next;
+        if (r->epoch + 2 <= epoch)
+        {
+            r->reclaim(r->p);
+            free(r);
+            ndof_atomic_add32(&d->pending, (uint32_t) -1);
+        }
+        else
+        {
+            if (kept == NULL)
+                kept_last = r;
+            r->next = kept;
+            kept = r;
+        }
+    }
+    
+    if (kept)
+        ndof_epoch_push(d, kept, kept_last);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_epoch_barrier(NDOF_EpochDomain *d)
+{
+    for (;;)
+    {
+        ndof_epoch_collect(d);
+        if (ndof_atomic_load32(&d->pending) == 0)
+            break;
+        ndof_sleep_ns(1000);
+    }
+}
+
+/* -------------------------------------------------------------------------- 
+    Moves the epoch on if all the readers in have seen the current one. 
+    Returns 1 if it did. */
+static int ndof_epoch_advance(NDOF_EpochDomain *d)
+{
+    uint64_t e = ndof_atomic_load64(&d->epoch), v;
+    unsigned i;
+    
+    ndof_atomic_fence();
+    for (i = 0; i < NDOF_EPOCH_SLOTS; i++)
+    {
+        v = ndof_atomic_load64(&d->slots[i].epoch);
+        if (v != 0 && v != e)
+            return 0;
+    }
+    return ndof_atomic_cas64(&d->epoch, e, e + 1);
+}
+
+/* -------------------------------------------------------------------------- 
+    Pushes the chain first..last on the retired stack. */
+static void ndof_epoch_push(NDOF_EpochDomain *d, NDOF_Retired *first, 
+                            NDOF_Retired *last)
+{
+    NDOF_Retired *head;
+    
+    do
+    {
+        head = (NDOF_Retired *) 
+            ndof_atomic_loadptr((void *const volatile *) &d->retired);
+        last->next = head;
+    }
+    while (!ndof_atomic_casptr((void *volatile *) &d->retired, head, first));
+}
@@ -0,0 +1,92 @@
+/*
+ @file ndofdev_epoch.h
+ @brief Epoch based reclamation of memory shared with lock-free readers.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_epoch_h__
+#define __ndofdev_epoch_h__
+
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  Readers announce themselves for the time they hold pointers to shared
+    memory. Writers unlink memory first, then retire it: it is freed once
+    every reader that could still see it has left, i.e. after the domain's
+    epoch moved on twice. Readers never wait for writers, writers never 
+    wait for readers, except in ndof_epoch_barrier.                          */
+
+#define NDOF_EPOCH_SLOTS    64  /* readers at the same time */
+
+typedef void (*NDOF_ReclaimFn)(void *p);
+
+typedef struct NDOF_EpochSlot {
+    volatile uint64_t epoch;    /* of the reader in, 0 if free */
+    char pad[64 - sizeof(uint64_t)];
+} NDOF_EpochSlot;
+
+/** Readers and retired memory of one shared structure, or of several. */
+typedef struct NDOF_EpochDomain {
+    volatile uint64_t       epoch;
+    NDOF_EpochSlot          slots[NDOF_EPOCH_SLOTS];
+    struct NDOF_Retired *volatile retired;  /* lock-free stack */
+    volatile uint32_t       pending;        /* not reclaimed yet */
+} NDOF_EpochDomain;
+
+typedef struct NDOF_EpochGuard {
+    NDOF_EpochDomain *domain;
+    unsigned slot;
+} NDOF_EpochGuard;
+
+void ndof_epoch_init(NDOF_EpochDomain *d);
+
+/** Starts a read-side section. Sections may nest, each with its guard. If
+ *  NDOF_EPOCH_SLOTS readers are in, waits for one to leave. */
+void ndof_epoch_enter(NDOF_EpochDomain *d, NDOF_EpochGuard *guard);
+void ndof_epoch_exit(NDOF_EpochGuard *guard);
+
+/** Calls reclaim(p) once no reader may see `p' anymore. `p' must already 
+ *  be unreachable for new readers. Also frees what is due. */
+void ndof_epoch_retire(NDOF_EpochDomain *d, NDOF_ReclaimFn reclaim, void *p);
+
+/** Frees what is due without waiting. */
+void ndof_epoch_collect(NDOF_EpochDomain *d);
+
+/* --------------------------------------------------------------------------
+    Purpose:    Frees all that was retired.
+    Notes:      Waits for the readers in to leave: must not be called from
+                a read-side section.
+*/
+void ndof_epoch_barrier(NDOF_EpochDomain *d);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_epoch_h__ */
@@ -30,6 +30,9 @@
 #ifndef __ndofdev_external_h__
 #define __ndofdev_external_h__
 
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -42,6 +45,9 @@ typedef enum NDOF_HotPlugResult {
     NDOF_DISCARD_HOTPLUGGED
 } NDOF_HotPlugResult;
 
+/** Opaque instance of the library, see ndof_context_create. */
+typedef struct NDOF_Context NDOF_Context;
+
 /** Do NOT create NDOF_Device variables manually. Always use ndof_create. */
 typedef struct NDOF_Device {
     long axes[NDOF_MAX_AXES_COUNT];           /* axes current values */
@@ -55,8 +61,68 @@ typedef struct NDOF_Device {
 	char manufacturer[256]; /* name of device manufacturer */
     char product[256];      /* name of the device */
     void *private_data;     /* ptr to platform specific/private data */
+    void *stream_data;      /* ptr to cross platform sample pipeline data */
+    NDOF_Context *context;  /* instance of the library the device belongs to */
 } NDOF_Device;
 
+/** Element formats accepted by ndof_bind_state. */
+typedef enum NDOF_StateFormat {
+    NDOF_FORMAT_INT16       = 1,
+    NDOF_FORMAT_INT32       = 2,
+    NDOF_FORMAT_FLOAT32     = 3,
+    /* OR with one of the above to map [axes_min, axes_max] onto [-1, 1] for
+       NDOF_FORMAT_FLOAT32, or onto the full signed range for integer types. */
+    NDOF_FORMAT_NORMALIZED  = 0x100
+} NDOF_StateFormat;
+
+/** Consistent snapshot of a device's latest state, see ndof_read_state. */
+typedef struct NDOF_State {
+    uint64_t seq;           /* # samples published so far, 0 if none yet */
+    uint64_t time_ns;       /* ndof_time_ns() when the sample was read */
+    long axes[NDOF_MAX_AXES_COUNT];
+    unsigned long buttons;  /* bit i is set if button i is pressed */
+    unsigned char valid;    /* same meaning as NDOF_Device's valid */
+} NDOF_State;
+
+/** One timestamped sample, as stored in the per device sample ring. */
+typedef struct NDOF_Sample {
+    uint64_t seq;           /* sample number, starting at 1 */
+    uint64_t time_ns;       /* ndof_time_ns() when the sample was read */
+    long axes[NDOF_MAX_AXES_COUNT];
+    unsigned long buttons;  /* bit i is set if button i is pressed */
+} NDOF_Sample;
+
+/** Opaque consumer cursor on a device's sample ring. */
+typedef struct NDOF_Subscriber NDOF_Subscriber;
+
+/** Configuration of the pose integration, see ndof_pose_configure. */
+typedef struct NDOF_PoseConfig {
+    /* velocity per axis unit: position units per second for X, Y and Z,
+       radians per second for RX, RY and RZ; 0 ignores an axis */
+    double gains[NDOF_MAX_AXES_COUNT];
+    /* rotation from the device axes to the application axes, applied to 
+       both the translation and the rotation; row major */
+    double frame[3][3];
+} NDOF_PoseConfig;
+
+/** Motion integrated since the previous ndof_pose_fetch. Both parts are 
+ *  relative to the pose at that time: apply as pose = pose * delta. */
+typedef struct NDOF_PoseDelta {
+    double position[3];
+    double orientation[4];  /* unit quaternion w, x, y, z */
+    uint64_t duration_ns;   /* time integrated */
+    uint64_t samples;       /* # samples integrated */
+} NDOF_PoseDelta;
+
+/** Interpolation modes of ndof_resampler_create. */
+typedef enum NDOF_ResampleMode {
+    NDOF_RESAMPLE_LINEAR    = 1,
+    NDOF_RESAMPLE_CUBIC     = 2     /* one more input sample of latency */
+} NDOF_ResampleMode;
+
+/** Opaque fixed rate view of a device's samples, see ndof_resampler_create. */
+typedef struct NDOF_Resampler NDOF_Resampler;
+
 /** Callback type for new hot-plugged devices. 
  *  Parameters: dev - pointer to the newly added NDOF device. A new NDOF_Device
  *                    struct is allocated for the client. Clients can express
@@ -67,6 +133,26 @@ typedef NDOF_HotPlugResult (*NDOF_DeviceAddCallback)(NDOF_Device *dev);
 /** Removal callback type. Parameter points to the removed device.  */
 typedef void (*NDOF_DeviceRemovalCallback)(NDOF_Device *device);
 
+/** State of the library initialization, see ndof_libinit_async. */
+typedef enum NDOF_InitStatus {
+    NDOF_INIT_NONE      = 0,    /* not initialized */
+    NDOF_INIT_PENDING   = 1,    /* enumeration in progress */
+    NDOF_INIT_READY     = 2,    /* all the devices attached at startup known */
+    NDOF_INIT_FAILED    = 3
+} NDOF_InitStatus;
+
+/** Where the hot-plug callbacks are called, see ndof_set_callback_mode. */
+typedef enum NDOF_CallbackMode {
+    NDOF_CALLBACKS_DIRECT    = 0,   /* on the library's thread, as it sees
+                                       devices come and go */
+    NDOF_CALLBACKS_QUEUED    = 1,   /* in ndof_dispatch_events */
+    NDOF_CALLBACKS_IN_UPDATE = 2    /* in ndof_update as well */
+} NDOF_CallbackMode;
+
+/** Callback type for the end of an asynchronous initialization. Called once
+ *  on the library's thread, with NDOF_INIT_READY or NDOF_INIT_FAILED. */
+typedef void (*NDOF_ReadyCallback)(NDOF_InitStatus status, void *ctx);
+
 /** Purpose:    Initializes the library. 
  *  Parameters: in_add_cb - Callback invoked when a new	device is hotplugged in.
  *                          Pass NULL if you don't care.
@@ -74,15 +160,81 @@ typedef void (*NDOF_DeviceRemovalCallback)(NDOF_Device *device);
  *                              Pass NULL if you don't care.
  *              platform_specific - On Windows, it can be a pointer to a already
  *                                  initialized LPDIRECTINPUT8 value; pass NULL 
- *                                  for full initialization. Unused on OS X.
+ *                                  for full initialization. On Linux, it may
+ *                                  name a directory holding the sys and dev 
+ *                                  trees to use in place of the root one.
+ *                                  Unused on OS X. See also
+ *                                  ndof_context_set_backend.
  *  Notes:      The callbacks functionality is currently implemented on Mac OS X
- *              only.  The callbacks functions are currently ignored on Windows.
+ *              and Linux, where they are called on the library's I/O thread
+ *              unless queued, see ndof_set_callback_mode.
+ *              The callbacks functions are currently ignored on Windows.
+ *              On Linux, the layouts of the devices are kept in the file
+ *              named by the NDOF_CAPCACHE environment variable, if any, so
+ *              that known devices are not parsed again on the next start.
  *  Returns:    0 if ok. 
  */
 extern int ndof_libinit(NDOF_DeviceAddCallback in_add_cb, 
                         NDOF_DeviceRemovalCallback in_removal_cb,
                         void *platform_specific);
 
+/** Purpose:    Initializes the library without blocking the caller.
+ *  Parameters: in_add_cb, in_removal_cb, platform_specific - as for 
+ *                  ndof_libinit.
+ *              ready_cb - Called when the initial enumeration is over. 
+ *                         May be NULL: poll ndof_init_status or block in
+ *                         ndof_wait_ready instead.
+ *              ready_ctx - Passed to ready_cb.
+ *  Notes:      Enumeration runs on the library's thread. Where add callbacks
+ *              are implemented, in_add_cb is called for each device found
+ *              during the enumeration as soon as it is found, exactly as
+ *              for a hot-plugged device.
+ *  Returns:    0 if the initialization started.
+ */
+extern int ndof_libinit_async(NDOF_DeviceAddCallback in_add_cb, 
+                              NDOF_DeviceRemovalCallback in_removal_cb,
+                              void *platform_specific,
+                              NDOF_ReadyCallback ready_cb, void *ready_ctx);
+
+/** Purpose:    Current state of the library initialization. Never blocks. */
+extern NDOF_InitStatus ndof_init_status();
+
+/** Purpose:    Waits until the library initialization is over.
+ *  Parameters: timeout_ns - Longest wait; 0 does not wait.
+ *  Returns:    The state of the initialization, NDOF_INIT_PENDING if the
+ *              timeout expired first.
+ */
+extern NDOF_InitStatus ndof_wait_ready(uint64_t timeout_ns);
+
+/** Purpose:    Chooses the thread the hot-plug callbacks are called on.
+ *  Parameters: mode - NDOF_CALLBACKS_DIRECT, the default, calls them on the
+ *                     library's thread. Otherwise the notifications are 
+ *                     queued, and the callbacks are called on the thread 
+ *                     that calls ndof_dispatch_events, or ndof_update with
+ *                     NDOF_CALLBACKS_IN_UPDATE. A device is then never 
+ *                     added or removed while the client is using it.
+ *  Notes:      Call before ndof_libinit. When queued, a hot-plugged device
+ *              is kept by the library until the add callback is called, and
+ *              destroyed then if it returns NDOF_DISCARD_HOTPLUGGED.
+ */
+extern void ndof_set_callback_mode(NDOF_CallbackMode mode);
+
+/** Purpose:    Calls the hot-plug callbacks queued, in the order the
+ *              library noticed the devices come and go. Never blocks: 
+ *              returns at once if another thread is dispatching.
+ *  Returns:    The number of callbacks called.
+ */
+extern int ndof_dispatch_events();
+
+/** Purpose:    Sets how hot-plug notifications are coalesced.
+ *  Parameters: window_ns - Quiet time that ends a burst of notifications;
+ *                          0 reports each one as it comes. A device added
+ *                          and removed within a burst is not reported.
+ *  Notes:      Defaults to 50 ms. Applies from the next ndof_libinit, on
+ *              Linux only for now.
+ */
+extern void ndof_set_hotplug_window(uint64_t window_ns);
+
 /** Purpose:    Clean up.  Must be called before program termination. 
  */
 extern void ndof_libcleanup();
@@ -91,7 +243,7 @@ extern void ndof_libcleanup();
  *              it with default values. 
  *  Notes:      Always use this function to allocate a new NDOF_Device. 
  *              Call ndof_libcleanup to free the memory. 
- *  Returns:    Pointer to a mallocated struct.
+ *  Returns:    Pointer to a mallocated struct, NULL if out of memory.
  */
 extern NDOF_Device *ndof_create();
 
@@ -112,19 +264,282 @@ extern int ndof_init_first(NDOF_Device *in_out_dev, void *param);
 
 /** Purpose:    Reads the current status of the input device. 
  *  Parameters: Must be initialized with ndof_create(). 
+ *  Notes:      On Linux, an I/O thread of the library reads the devices
+ *              and publishes a sample for each report as it arrives, to the
+ *              sample ring, ndof_get_history, the subscribers and ndof_wait:
+ *              this only copies the state published last into in_dev.
+ *              Elsewhere, devices are read only here: a sample is published
+ *              for each report the device sent since the previous call. One
+ *              thread must keep calling it, at least once per frame; the 
+ *              kernel only queues a limited number of reports meanwhile.
  */
 extern void ndof_update(NDOF_Device *in_dev);
 
+/** Purpose:    Binds caller owned memory as destination of the axes state.
+ *              Every time a new sample is read, the library converts the
+ *              NDOF_MAX_AXES_COUNT axes values to `format' and writes them
+ *              directly into `dst', in addition to updating dev->axes.
+ *  Parameters: dev - Must be initialized with ndof_create().
+ *              dst - First axis destination. Pass NULL to remove the binding.
+ *              stride - Distance in bytes between two consecutive axes values
+ *                       in `dst'. Pass 0 for tightly packed values.
+ *              format - One of NDOF_StateFormat, optionally OR'ed with
+ *                       NDOF_FORMAT_NORMALIZED.
+ *  Notes:      `dst' must stay valid until the binding is removed or the
+ *              device is destroyed. Can be called from any thread: once it
+ *              returns, the previous destination is no longer written to.
+ *  Returns:    0 if ok, -1 if the format or stride are not valid or if out
+ *              of memory.
+ */
+extern int ndof_bind_state(NDOF_Device *dev, void *dst, size_t stride, 
+                           int format);
+
+/** Purpose:    Takes a consistent snapshot of the latest sample read from
+ *              the device.
+ *  Notes:      Safe to call from any number of threads concurrently with the
+ *              thread updating the device: readers never lock and never 
+ *              delay the writer.
+ *  Returns:    0 if ok, -1 if dev was not created with ndof_create().
+ */
+extern int ndof_read_state(NDOF_Device *dev, NDOF_State *out);
+
+/** Purpose:    Enables the per device ring retaining the last `capacity'
+ *              samples, so that consumers can see every sample and not just
+ *              the latest one.
+ *  Notes:      Can be called while the device is streaming. Once enabled, 
+ *              the ring lives until the device is destroyed; calling again 
+ *              does not resize it.
+ *  Returns:    0 if ok, -1 on error.
+ */
+extern int ndof_enable_ring(NDOF_Device *dev, size_t capacity);
+
+/** Purpose:    Creates a consumer with its own cursor on dev's ring. It will
+ *              read samples published from now on.
+ *  Notes:      Enables the ring with a default capacity if needed. 
+ *              Subscribing and unsubscribing never disturb the producer or
+ *              other consumers. Subscribers must be released before dev
+ *              is destroyed.
+ *  Returns:    NULL on error.
+ */
+extern NDOF_Subscriber *ndof_subscribe(NDOF_Device *dev);
+
+/** Purpose:    Copies up to `cap' samples not yet seen by `sub' into `out',
+ *              oldest first.
+ *  Parameters: dropped - If not NULL, receives the # samples overwritten 
+ *                        before `sub' could read them since the last call.
+ *  Notes:      Each subscriber must be used by one thread at a time.
+ *  Returns:    The number of samples copied.
+ */
+extern size_t ndof_subscriber_read(NDOF_Subscriber *sub, NDOF_Sample *out, 
+                                   size_t cap, uint64_t *dropped);
+
+/** Purpose:    Releases a subscriber created by ndof_subscribe. */
+extern void ndof_unsubscribe(NDOF_Subscriber *sub);
+
+/** Purpose:    Copies the samples read after since_ns, oldest first, from 
+ *              the per device ring (see ndof_enable_ring).
+ *  Parameters: since_ns - Time in the ndof_time_ns() time base. Only samples
+ *                         with a greater time_ns are returned. Pass 0 to get
+ *                         all the samples retained.
+ *              out, cap - Destination buffer and its capacity in samples.
+ *  Notes:      When more than `cap' samples qualify, the oldest ones are
+ *              returned: call again with the time_ns of the last one to get
+ *              the rest. The ring is enabled with a default capacity on first
+ *              use, so enable it beforehand to get history from the start.
+ *              The ring holds a sample per device report, with the time
+ *              the report was sent where the platform keeps it, but only
+ *              once ndof_update has read it.
+ *  Returns:    The number of samples copied into `out'.
+ */
+extern size_t ndof_get_history(NDOF_Device *dev, uint64_t since_ns, 
+                               NDOF_Sample *out, size_t cap);
+
+/** Purpose:    Shares dev with other processes on this machine: its state
+ *              and its last samples are copied, as they are published, to
+ *              the POSIX shared memory object `name', such as "/ndofdev".
+ *              The other processes read it as a device of an instance with
+ *              the "shm" backend (see ndof_context_set_backend).
+ *  Notes:      Readers map the object read only and read it without any
+ *              system call, so there can be any number of them: they never
+ *              delay this process. Fails if the object exists, as when a
+ *              process died while publishing: remove it with shm_unlink.
+ *              The object is removed when dev is destroyed; publishing 
+ *              again does nothing. Not available on Windows.
+ *  Returns:    0 if ok, -1 on error.
+ */
+extern int ndof_shm_publish(NDOF_Device *dev, const char *name);
+
+/** Purpose:    Blocks the calling thread until a new sample is published 
+ *              for dev, or until the deadline passes.
+ *  Parameters: deadline_ns - Absolute time in the ndof_time_ns() time base.
+ *                            Pass UINT64_MAX to wait without a deadline.
+ *  Notes:      The thread reading the device wakes the waiters as soon as it
+ *              publishes a sample or the validity of the device changes; the
+ *              waiters do not poll. Any number of threads can wait. On 
+ *              Linux, that thread is the library's I/O thread, woken by the
+ *              device's reports: nothing else needs to run. Elsewhere, 
+ *              samples are only published by ndof_update (see there), which
+ *              another thread must keep calling.
+ *  Returns:    0 if a new sample (or validity) was published since the call,
+ *              1 if the deadline passed first, -1 on error.
+ */
+extern int ndof_wait(NDOF_Device *dev, uint64_t deadline_ns);
+
+/** Purpose:    Sets the transform applied to dev's axes as soon as they are
+ *              read: axes = matrix * axes + offset, rounded and limited to
+ *              [axes_min, axes_max].
+ *  Parameters: matrix - 36 coefficients, row major: row i holds the weights
+ *                       of the read axes in axis i. Use it to permute, 
+ *                       invert or decouple axes. NULL means the default for
+ *                       the device model, usually the identity.
+ *              offset - NDOF_MAX_AXES_COUNT values, or NULL for none.
+ *  Notes:      Applies to dev->axes and to all the sample consumers. Can be
+ *              called from any thread, even while dev is being updated.
+ *  Returns:    0 on success, -1 on error.
+ */
+extern int ndof_set_transform(NDOF_Device *dev, const float *matrix, 
+                              const float *offset);
+
+/** Purpose:    Extrapolates the axes of dev to a time in the near future, 
+ *              such as the expected display time of the frame being built.
+ *  Parameters: target_time_ns - Time in the ndof_time_ns() time base.
+ *              out            - Receives the predicted state. time_ns is 
+ *                               set to target_time_ns, seq to the latest 
+ *                               sample the prediction is based on.
+ *  Notes:      Velocity and acceleration of the axes are tracked as samples
+ *              are published, so a query costs the same whatever the rate.
+ *              Predictions are limited to 50 ms past the latest sample, and
+ *              to the axes range. A target in the past returns the tracked
+ *              position at the latest sample.
+ *  Returns:    0 on success, -1 on error.
+ */
+extern int ndof_predict(NDOF_Device *dev, uint64_t target_time_ns, 
+                        NDOF_State *out);
+
+/** Purpose:    Enables, reconfigures or disables the integration of dev's
+ *              samples into a pose, as they are read.
+ *  Parameters: config - Axis gains and frame, copied. NULL disables.
+ *  Notes:      Every sample moves the pose at its velocity until the next
+ *              sample's time (at most 100 ms), in double precision, so the
+ *              result does not depend on the application's frame rate. 
+ *              Any pending delta is discarded.
+ *  Returns:    0 on success, -1 on error.
+ */
+extern int ndof_pose_configure(NDOF_Device *dev, const NDOF_PoseConfig *config);
+
+/** Purpose:    Returns the motion integrated since the previous call, and
+ *              restarts the integration from there.
+ *  Parameters: now_ns - Time in the ndof_time_ns() time base up to which the
+ *                       latest sample's velocity applies, typically the
+ *                       frame time. Pass 0 to stop at the latest sample.
+ *  Returns:    0 on success, -1 on error or if integration is disabled.
+ */
+extern int ndof_pose_fetch(NDOF_Device *dev, uint64_t now_ns, 
+                           NDOF_PoseDelta *out);
+
+/** Purpose:    Creates a resampler producing samples of dev at uniformly
+ *              spaced times, for consumers stepping at a fixed rate.
+ *  Parameters: rate_hz - Output rate. Output sample times are the multiples
+ *                        of 1/rate_hz seconds in the ndof_time_ns() base.
+ *              mode    - A NDOF_ResampleMode, used when the device reports
+ *                        slower than rate_hz. When it reports faster, each
+ *                        output is the average of the input over its period.
+ *  Notes:      The resampler subscribes to dev's ring (see ndof_subscribe)
+ *              and must be destroyed before dev is.
+ *  Returns:    NULL on error.
+ */
+extern NDOF_Resampler *ndof_resampler_create(NDOF_Device *dev, 
+                                             unsigned rate_hz, int mode);
+
+/** Purpose:    Copies up to `cap' output samples into `out', oldest first.
+ *  Notes:      An output is available once the input reaches its time (and 
+ *              one more input sample in NDOF_RESAMPLE_CUBIC mode). Input 
+ *              samples lost to ring overruns restart the output after the 
+ *              gap. seq counts the output samples, starting at 1.
+ *  Returns:    The number of samples copied.
+ */
+extern size_t ndof_resampler_read(NDOF_Resampler *rs, NDOF_Sample *out, 
+                                  size_t cap);
+
+/** Purpose:    Releases a resampler created by ndof_resampler_create. */
+extern void ndof_resampler_destroy(NDOF_Resampler *rs);
+
+/** Purpose:    Returns the monotonic time base used by the library to 
+ *              timestamp samples, in nanoseconds. */
+extern uint64_t ndof_time_ns();
+
 /** Purpose:    Dumps device info on specified FILE*. */
 extern void ndof_dump(FILE* stream, NDOF_Device *dev);
 
 /** Purpose:    Dumps list of NDOF devices currently in use on specified FILE*. */
 extern void ndof_dump_list(FILE* stream);
 
-#if TARGET_OS_MAC
-/** Returns the number of connected NDOF devices. Implemented only on OS X. */
+/** Purpose:    Creates an instance of the library, with its own devices, 
+ *              callbacks, notification queue and initialization state.
+ *              Instances share no data and no lock: independent subsystems
+ *              can each run theirs on their own threads.
+ *  Notes:      The functions taking no context use the default instance,
+ *              see ndof_default_context. On OS X, where HID Utilities
+ *              and its run loop are process wide, a single instance at a 
+ *              time can be initialized.
+ *  Returns:    NULL if out of memory.
+ */
+extern NDOF_Context *ndof_context_create();
+
+/** Purpose:    Cleans up an instance if needed, then releases it.
+ *  Notes:      The default instance is never destroyed.
+ */
+extern void ndof_context_destroy(NDOF_Context *ctx);
+
+/** Purpose:    Returns the instance used by the functions taking no context,
+ *              created on first use. */
+extern NDOF_Context *ndof_default_context();
+
+/** Purpose:    Chooses how the devices of an instance are found and read.
+ *  Parameters: name - "synthetic" for generated devices: platform_specific
+ *                     may then be a string holding their number, 1 by 
+ *                     default. "replay" for samples recorded in a text 
+ *                     file, whose path is platform_specific; each line 
+ *                     holds a time in ns, the axes and the buttons mask.
+ *                     "shm" for the device another process publishes with
+ *                     ndof_shm_publish, whose name is platform_specific.
+ *                     Otherwise a native backend: "linux", or "hidraw" or
+ *                     "evdev" for one kind of node only, on Linux; "osx"
+ *                     on OS X; "win" on Windows. NULL names the native one.
+ *  Notes:      Call before the instance is initialized or has devices.
+ *              The default instance starts with the backend named by the
+ *              NDOF_BACKEND environment variable, if any.
+ *  Returns:    0 if ok, -1 if not compiled in or too late.
+ */
+extern int ndof_context_set_backend(NDOF_Context *ctx, const char *name);
+
+/** The functions above, for a given instance. Devices are created in an
+ *  instance and used with the functions taking a device as before. */
+extern int ndof_context_libinit(NDOF_Context *ctx,
+                                NDOF_DeviceAddCallback in_add_cb, 
+                                NDOF_DeviceRemovalCallback in_removal_cb,
+                                void *platform_specific);
+extern int ndof_context_libinit_async(NDOF_Context *ctx,
+                                      NDOF_DeviceAddCallback in_add_cb, 
+                                      NDOF_DeviceRemovalCallback in_removal_cb,
+                                      void *platform_specific,
+                                      NDOF_ReadyCallback ready_cb, 
+                                      void *ready_ctx);
+extern NDOF_InitStatus ndof_context_init_status(NDOF_Context *ctx);
+extern NDOF_InitStatus ndof_context_wait_ready(NDOF_Context *ctx, 
+                                               uint64_t timeout_ns);
+extern void ndof_context_set_callback_mode(NDOF_Context *ctx, 
+                                           NDOF_CallbackMode mode);
+extern int ndof_context_dispatch_events(NDOF_Context *ctx);
+extern void ndof_context_set_hotplug_window(NDOF_Context *ctx, 
+                                            uint64_t window_ns);
+extern void ndof_context_libcleanup(NDOF_Context *ctx);
+extern NDOF_Device *ndof_context_create_device(NDOF_Context *ctx);
+extern void ndof_context_dump_list(NDOF_Context *ctx, FILE* stream);
+
+/** Returns the number of connected NDOF devices, -1 where the backend
+ *  cannot tell, as on Windows. */
 extern int ndof_devcount();
-#endif
 
 #ifdef __cplusplus
 }
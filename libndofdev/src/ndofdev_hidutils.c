@@ -46,6 +46,7 @@
 #include <IOKit/hid/IOHIDUsageTables.h>
 #include "ndofdev_hidutils_err.h"
 #include "ndofdev_hidutils.h"
+#include "ndofdev_probe.h"
 
 /*****************************************************/
 #pragma mark - local ( static ) function prototypes
@@ -67,8 +68,9 @@ static hu_device_t* hu_MoveDevice( hu_device_t **inDeviceListHead, hu_device_t*
 static hu_device_t* hu_BuildDevice( io_object_t inHIDDevice );
 static hu_device_t* hu_CreateSingleTypeDeviceList( io_iterator_t inHIDObjectIterator );
 static hu_device_t* hu_CreateMultiTypeDeviceList( UInt32 *inUsagePage, UInt32 *inUsage, UInt32 inNumDeviceTypes );
-static Boolean hu_FindDeviceInList( hu_device_t* inDeviceList, hu_device_t* inFindDevice );
 static void hu_MergeDeviceList( hu_device_t **inNewDeviceList, hu_device_t **inDeviceList );
+static void* hu_ProbeDevice( void* inContext, void* inHIDDevice );
+static void hu_XMLPreload( void );
 static void hu_AddDevices(hu_device_t **inDeviceListHead, 
                           io_iterator_t inIODeviceIterator,
                           Boolean inIsHotPlugEvent);
@@ -99,18 +101,20 @@ static void hu_HotPlugAddNotification(void *inRefCon, io_iterator_t inIODeviceIt
 
 static CFPropertyListRef		gCookieCFPropertyListRef = NULL;
 static CFPropertyListRef		gUsageCFPropertyListRef = NULL;
+static Boolean					gXMLPreloaded = FALSE;
 
 #if USE_HOTPLUGGING
 static HotPlugCallbackProcPtr	gHotPlugAddCallbackPtr = NULL;
 static HotUnplugCallbackProcPtr	gHotPlugRemovalCallbackPtr = NULL;
+static Boolean					gHotPlugInitialDevices = FALSE;
 static IONotificationPortRef	gNotifyPort;
 static CFRunLoopRef				gRunLoop;
 #endif // USE_HOTPLUGGING
 
-// for element retrieval
-static hu_device_t*				gCurrentDevice  = NULL;
-static Boolean					gAddAsChild		= FALSE;
-static int						gDepth			= FALSE;
+// for element retrieval, per thread since devices are built in parallel
+static __thread hu_device_t*		gCurrentDevice  = NULL;
+static __thread Boolean			gAddAsChild		= FALSE;
+static __thread int				gDepth			= FALSE;
 
 // our global list of HID devices
 static hu_device_t*				gDeviceList		= NULL;
@@ -642,6 +646,24 @@ static CFPropertyListRef hu_XMLLoad( CFStringRef inResourceName, CFStringRef inR
 	return tCFPropertyListRef;
 }	// hu_XMLLoad
 
+/*************************************************************************
+*
+* hu_XMLPreload( )
+*
+* Purpose:  Loads the resource( XML ) files of the element names once, so
+*			that devices built in parallel only read them
+*/
+static void hu_XMLPreload( void )
+{
+	if ( gXMLPreloaded )
+		return;
+	if ( !gCookieCFPropertyListRef )
+		gCookieCFPropertyListRef = hu_XMLLoad( CFSTR( "HID_cookie_strings" ), CFSTR( "plist" ) );
+	if ( !gUsageCFPropertyListRef )
+		gUsageCFPropertyListRef = hu_XMLLoad( CFSTR( "HID_device_usage_strings" ), CFSTR( "plist" ) );
+	gXMLPreloaded = TRUE;	// missing files are not looked for again
+}	// hu_XMLPreload
+
 /*************************************************************************
 *
 * hu_XMLSearchForElementNameByCookie( inVendorID, inProductID, inCookie, outCStr )
@@ -659,7 +681,7 @@ static Boolean hu_XMLSearchForElementNameByCookie( long inVendorID, long inProdu
 {
 	Boolean results = FALSE;
 	
-	if ( !gCookieCFPropertyListRef )
+	if ( !gCookieCFPropertyListRef && !gXMLPreloaded )
 		gCookieCFPropertyListRef = hu_XMLLoad( CFSTR( "HID_cookie_strings" ), CFSTR( "plist" ) );
 	
 	if ( gCookieCFPropertyListRef ) {
@@ -736,7 +758,7 @@ static Boolean hu_XMLSearchForElementNameByUsage( long inVendorID, long inProduc
 {
 	Boolean results = FALSE;
 	
-	if ( !gUsageCFPropertyListRef )
+	if ( !gUsageCFPropertyListRef && !gXMLPreloaded )
 		gUsageCFPropertyListRef = hu_XMLLoad( CFSTR( "HID_device_usage_strings" ), CFSTR( "plist" ) );
 	
 	if ( gUsageCFPropertyListRef ) {
@@ -934,6 +956,19 @@ OSStatus HIDSetHotPlugCallback(HotPlugCallbackProcPtr inAddCallbackPtr,
 	return noErr;
 }
 
+/*************************************************************************
+* Purpose:  makes the hot plug add callback also report the devices found
+*			by the following device list builds, as each one is built
+*
+* Inputs:   inNotify	- TRUE to report them, FALSE( default ) otherwise
+*/
+void HIDSetHotPlugInitialDevices(Boolean inNotify)
+{
+#if USE_HOTPLUGGING
+	gHotPlugInitialDevices = inNotify;
+#endif
+}
+
 #pragma mark - Hotplug / Notifications Callbacks
 
 #if USE_HOTPLUGGING
@@ -1916,6 +1951,8 @@ static hu_device_t* hu_BuildDevice( io_object_t inHIDDevice )
 			// extract all the device info from the device dictionary into our device struct
 			//( inHIDDevice is used to find parents in registry tree )
 			hu_GetDeviceInfo( inHIDDevice, deviceCFDictRef, tDevice );
+			tDevice->key = ndof_device_key( tDevice->vendorID, tDevice->productID, tDevice->usagePage,
+											tDevice->usage, tDevice->locID, tDevice->serial );
 			
 			// set current device for use in getting elements
 			gCurrentDevice = tDevice;
@@ -2055,36 +2092,6 @@ static hu_device_t* hu_CreateMultiTypeDeviceList( UInt32 *pUsagePages, UInt32 *p
 	return newDeviceList;
 }
 
-/*************************************************************************
-*
-* hu_FindDeviceInList( inDeviceList, inFindDevice )
-*
-* Purpose:  given a device list and a device find if device is in list
-*
-* Notes:	called by hu_CompareUpdateDeviceList & hu_MergeDeviceList
-*
-* Inputs:   inDeviceList - the device list
-*			inFindDevice - the device
-*
-* Returns:  Boolean		- TRUE if device in list
-*/
-static Boolean hu_FindDeviceInList( hu_device_t* inDeviceList, hu_device_t* inFindDevice )
-{
-	Boolean found = FALSE; // not found
-	hu_device_t* tDevice = inDeviceList; // not really needed but is clearer this way
-	while ( tDevice && !found ) {	// while we still have device to look at and have not found the target device
-		if ( ( tDevice->vendorID == inFindDevice->vendorID ) && // if we match same vendor, product & location
-			 ( tDevice->productID == inFindDevice->productID ) && // this is not quite right for same tyes plugged into the same location but different physical devices
-			 ( tDevice->locID == inFindDevice->locID ) &&      // since this is a corner and impossible to detect without serial numbers case we will ignore it
-			 ( tDevice->usage == inFindDevice->usage ) )
-		{
-			found = TRUE; // found device
-		}
-		tDevice = tDevice->pNext; // step to next device
-	}
-	return found;
-}
-
 /*************************************************************************
 *
 * hu_MergeDeviceList( inNewDeviceList, inDeviceList )
@@ -2092,7 +2099,8 @@ static Boolean hu_FindDeviceInList( hu_device_t* inDeviceList, hu_device_t* inFi
 * Purpose:  merges two devicelist into single *inNewDeviceList
 *
 * Notes:	inNewDeviceList may have head device modified( such as if it is NULL ) thus pointer to pointer to device.
-*			devices are matched on vendorID, productID, locID by hu_FindDeviceInList.
+*			devices are matched on their key( vendorID, productID, usage, locID & serial ) through
+*			a hash set of the new list, so merging is linear in the size of both lists.
 *			device record in inNewDeviceList maintained.
 *
 * Inputs:   inNewDeviceList  - the new list
@@ -2103,15 +2111,22 @@ static Boolean hu_FindDeviceInList( hu_device_t* inDeviceList, hu_device_t* inFi
 
 static void hu_MergeDeviceList( hu_device_t **inNewDeviceList, hu_device_t **inDeviceList )
 {
-	hu_device_t* tDevice = *inDeviceList;
+	NDOF_KeySet present;
+	hu_device_t* tDevice;
+	
+	ndof_keyset_init( &present, 0 );
+	for ( tDevice = *inNewDeviceList; tDevice; tDevice = tDevice->pNext )
+		ndof_keyset_insert( &present, &tDevice->key );
+	
+	tDevice = *inDeviceList;
 	while ( tDevice ) { // for all the devices in old list
-		Boolean present = hu_FindDeviceInList( *inNewDeviceList, tDevice ); // ensure they are in new list
-		if ( !present ) { // not found in new list
+		if ( ndof_keyset_insert( &present, &tDevice->key ) ) { // not found in new list
 			tDevice = hu_MoveDevice( inNewDeviceList, tDevice, inDeviceList ); // move to new list and get next
 		} else { // found in new list( so don't do anything
 			tDevice = tDevice->pNext; // just step to next device
 		}
 	}
+	ndof_keyset_dispose( &present );
 }
 
 /*************************************************************************
@@ -2130,10 +2145,34 @@ static void hu_AddDevices(hu_device_t **inDeviceListHead,
 {
 	IOReturn result = kIOReturnSuccess;	// assume success( optimist! )
 	io_object_t ioHIDDeviceObject = 0;
+	void **objects = NULL, **devices = NULL;
+	size_t count = 0, capacity = 0, i;
 	
+	// collect the devices, then open and interrogate them in parallel
 	while ( 0 != (ioHIDDeviceObject = IOIteratorNext( inIODeviceIterator ) ) ) {
+		if ( count == capacity ) {
+			void **grown = ( void** ) realloc( objects, ( capacity ? 2 * capacity : 16 ) * sizeof( void* ) );
+			if ( !grown ) {
+				HIDReportError( "realloc error when collecting devices." );
+				IOObjectRelease( ioHIDDeviceObject );
+				break;
+			}
+			objects = grown;
+			capacity = ( capacity ? 2 * capacity : 16 );
+		}
+		objects[count++] = ( void* )( uintptr_t ) ioHIDDeviceObject;
+	}
+	devices = ( void** ) calloc( count ? count : 1, sizeof( void* ) );
+	if ( devices ) {
+		hu_XMLPreload( );	// before the workers look element names up
+		ndof_probe_all( hu_ProbeDevice, NULL, objects, devices, count, 0 );
+	}
+	
+	// merge them in the order of the iterator
+	for ( i = 0; i < count; i++ ) {
 		hu_device_t **newDeviceAt = NULL;
-		hu_device_t* newDevice = hu_BuildDevice( ioHIDDeviceObject );
+		hu_device_t* newDevice = ( devices ? ( hu_device_t* ) devices[i] : NULL );
+		ioHIDDeviceObject = ( io_object_t )( uintptr_t ) objects[i];
 		if ( newDevice ) {
 #ifdef LOG_DEVICES
 #if 0 // verbose
@@ -2179,7 +2218,7 @@ static void hu_AddDevices(hu_device_t **inDeviceListHead,
 						
 			newDeviceAt = hu_AddDevice(inDeviceListHead, newDevice);
             
-            if (inHotplugFlag && gHotPlugAddCallbackPtr)
+            if ((inHotplugFlag || gHotPlugInitialDevices) && gHotPlugAddCallbackPtr)
                 gHotPlugAddCallbackPtr(newDevice);
                 
 #if USE_NOTIFICATIONS
@@ -2228,6 +2267,16 @@ static void hu_AddDevices(hu_device_t **inDeviceListHead,
 		if ( KERN_SUCCESS != result )
 			HIDReportErrorNum( "\nhu_AddDevices: IOObjectRelease error with ioHIDDeviceObject.", result );
 	}
+	free( devices );
+	free( objects );
+}
+
+/*************************************************************************
+* Purpose:  builds the device record of an io_object_t, on a probing thread
+*/
+static void* hu_ProbeDevice( void* inContext, void* inHIDDevice )
+{
+	return hu_BuildDevice( ( io_object_t )( uintptr_t ) inHIDDevice );
 }
 
 /*************************************************************************
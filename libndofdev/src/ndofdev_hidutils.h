@@ -53,6 +53,7 @@
 #endif // TARGET_RT_MAC_CFM
 
 #include <stdio.h>
+#include "ndofdev_identity.h"
 
 /*****************************************************/
 #if PRAGMA_ONCE
@@ -181,6 +182,7 @@ struct hu_device_t
 	long sliders;							// number of sliders( calculated, not reported by device )
 	long dials;								// number of dials( calculated, not reported by device )
 	long wheels;							// number of wheels( calculated, not reported by device )
+	NDOF_DeviceKey key;						// packed vendorID, productID, usagePage, usage, locID and serial hash( calculated once )
 	hu_element_t* pListElements;			// head of linked list of elements
 	struct hu_device_t* pNext; 				// next device
 };
@@ -254,6 +256,9 @@ extern hu_element_t* HIDGetNextDeviceElement( hu_element_t* inElement, HIDElemen
 extern OSStatus HIDSetHotPlugCallback(HotPlugCallbackProcPtr inAddCallbackPtr,
 									  HotUnplugCallbackProcPtr inRemoveCallbackPtr);
 
+// Also calls the hot plug add callback for the devices of the next device list builds
+extern void HIDSetHotPlugInitialDevices(Boolean inNotify);
+
 /*****************************************************/
 #pragma mark Name Lookup Interfaces
 /*****************************************************/
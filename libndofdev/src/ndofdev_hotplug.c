@@ -0,0 +1,266 @@
+/*
+ @file ndofdev_hotplug.c
+ @brief Coalescing of bursts of hot-plug notifications.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_hotplug.h"
+
+#define NDOF_COALESCER_MIN_CAPACITY 16
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_coalescer_grow(NDOF_Coalescer *c);
+static NDOF_PendingDevice *ndof_coalescer_find(NDOF_Coalescer *c, 
+                                               uint64_t id);
+static void ndof_coalescer_apply(NDOF_Coalescer *c);
+static void ndof_coalescer_release(NDOF_Coalescer *c, void *payload);
+
+/* -------------------------------------------------------------------------- */
+void ndof_coalescer_init(NDOF_Coalescer *c, uint64_t window_ns,
+                         NDOF_HotplugApplyFn apply, 
+                         NDOF_HotplugReleaseFn release, void *ctx)
+{
+    memset(c, 0, sizeof(NDOF_Coalescer));
+    c->window_ns = window_ns;
+    c->apply = apply;
+    c->release = release;
+    c->ctx = ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_coalescer_dispose(NDOF_Coalescer *c)
+{
+    size_t i;
+    
+    for (i = 0; i < c->count; i++)
+    {
+        ndof_coalescer_release(c, c->pending[i].removal);
+        ndof_coalescer_release(c, c->pending[i].add);
+    }
+    free(c->pending);
+    free(c->events);
+    free(c->slots);
+    c->pending = NULL;
+    c->events = NULL;
+    c->slots = NULL;
+    c->count = c->capacity = 0;
+    c->mask = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_coalescer_push(NDOF_Coalescer *c, int kind, uint64_t id, 
+                         void *payload, uint64_t now_ns)
+{
+    NDOF_PendingDevice *p;
+    
+    c->received++;
+    
+    /* out of memory: the burst ends early rather than losing events, 
+       unless there never was any room */
+    if (c->count == c->capacity && !ndof_coalescer_grow(c))
+    {
+        ndof_coalescer_apply(c);
+        if (c->capacity == 0)
+        {
+            ndof_coalescer_release(c, payload);
+            return;
+        }
+    }
+    
+    if (c->count == 0)
+        c->first_ns = now_ns;
+    c->last_ns = now_ns;
+    
+    p = ndof_coalescer_find(c, id);
+    if (p->first == 0)
+        p->first = kind;
+    p->last = kind;
+    if (kind == NDOF_HOTPLUG_REMOVE)
+    {
+        ndof_coalescer_release(c, p->removal);
+        p->removal = payload;
+    }
+    else
+    {
+        ndof_coalescer_release(c, p->add);
+        p->add = payload;
+    }
+    
+    if (c->window_ns == 0)
+        ndof_coalescer_apply(c);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_coalescer_flush(NDOF_Coalescer *c, uint64_t now_ns)
+{
+    if (c->count == 0 || now_ns < ndof_coalescer_deadline(c))
+        return 0;
+    
+    ndof_coalescer_apply(c);
+    return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_coalescer_deadline(const NDOF_Coalescer *c)
+{
+    uint64_t quiet, longest;
+    
+    if (c->count == 0)
+        return 0;
+    
+    quiet = c->last_ns + c->window_ns;
+    longest = c->first_ns + NDOF_HOTPLUG_MAX_WINDOWS * c->window_ns;
+    return (quiet < longest ? quiet : longest);
+}
+
+/* --------------------------------------------------------------------------
+    Doubles the room for pending devices; the index stays at most half full.
+    Returns 0 if out of memory. */
+static int ndof_coalescer_grow(NDOF_Coalescer *c)
+{
+    size_t capacity = (c->capacity ? 2 * c->capacity 
+                                   : NDOF_COALESCER_MIN_CAPACITY);
+    NDOF_PendingDevice *pending;
+    NDOF_HotplugEvent *events;
+    size_t *slots, mask = 2 * capacity - 1, i;
+    
+    pending = (NDOF_PendingDevice *) realloc(c->pending, 
+                                    capacity * sizeof(NDOF_PendingDevice));
+    if (pending == NULL)
+        return 0;
+    c->pending = pending;
+    
+    /* a removal and an add per device at most */
+    events = (NDOF_HotplugEvent *) realloc(c->events, 
+                                    2 * capacity * sizeof(NDOF_HotplugEvent));
+    if (events == NULL)
+        return 0;
+    c->events = events;
+    
+    slots = (size_t *) calloc(mask + 1, sizeof(size_t));
+    if (slots == NULL)
+        return 0;
+    free(c->slots);
+    c->slots = slots;
+    c->mask = mask;
+    c->capacity = capacity;
+    
+    for (i = 0; i < c->count; i++)
+    {
+        size_t s = (size_t) (c->pending[i].id * 0x9e3779b97f4a7c15ULL) & mask;
+        
+        while (slots[s])
+            s = (s + 1) & mask;
+        slots[s] = i + 1;
+    }
+    return 1;
+}
+
+/* --------------------------------------------------------------------------
+    Linear probing: the pending notifications of `id', added if new. There 
+    must be room for one more. */
+static NDOF_PendingDevice *ndof_coalescer_find(NDOF_Coalescer *c, 
+                                               uint64_t id)
+{
+    size_t s = (size_t) (id * 0x9e3779b97f4a7c15ULL) & c->mask;
+    NDOF_PendingDevice *p;
+    
+    while (c->slots[s])
+    {
+        p = &c->pending[c->slots[s] - 1];
+        if (p->id == id)
+            return p;
+        s = (s + 1) & c->mask;
+    }
+    
+    p = &c->pending[c->count++];
+    memset(p, 0, sizeof(NDOF_PendingDevice));
+    p->id = id;
+    c->slots[s] = c->count;
+    return p;
+}
+
+/* --------------------------------------------------------------------------
+    Hands the net events of the burst to the backend, all the removals 
+    first so that an add may take over the device struct of a removal, 
+    then starts a new burst. */
+static void ndof_coalescer_apply(NDOF_Coalescer *c)
+{
+    NDOF_HotplugEvent *events = c->events;
+    size_t count = 0, i;
+    
+    if (c->count == 0)
+        return;
+    
+    /* added then removed: nothing happened */
+    for (i = 0; i < c->count; i++)
+    {
+        NDOF_PendingDevice *p = &c->pending[i];
+        
+        if (p->first == NDOF_HOTPLUG_REMOVE)
+        {
+            events[count].kind = NDOF_HOTPLUG_REMOVE;
+            events[count].id = p->id;
+            events[count++].payload = p->removal;
+        }
+    }
+    for (i = 0; i < c->count; i++)
+    {
+        NDOF_PendingDevice *p = &c->pending[i];
+        
+        if (p->last == NDOF_HOTPLUG_ADD)
+        {
+            events[count].kind = NDOF_HOTPLUG_ADD;
+            events[count].id = p->id;
+            events[count++].payload = p->add;
+        }
+    }
+    
+    if (count > 0)
+        c->apply(c->ctx, events, count);
+    
+    c->applied += count;
+    c->bursts++;
+    
+    for (i = 0; i < c->count; i++)
+    {
+        ndof_coalescer_release(c, c->pending[i].removal);
+        ndof_coalescer_release(c, c->pending[i].add);
+    }
+    memset(c->slots, 0, (c->mask + 1) * sizeof(size_t));
+    c->count = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_coalescer_release(NDOF_Coalescer *c, void *payload)
+{
+    if (payload != NULL && c->release != NULL)
+        c->release(c->ctx, payload);
+}
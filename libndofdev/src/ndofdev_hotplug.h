@@ -0,0 +1,120 @@
+/*
+ @file ndofdev_hotplug.h
+ @brief Coalescing of bursts of hot-plug notifications.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_hotplug_h__
+#define __ndofdev_hotplug_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_HOTPLUG_WINDOW_DEFAULT 50000000ull /* ns */
+#define NDOF_HOTPLUG_MAX_WINDOWS    8   /* longest burst, in windows */
+
+typedef enum NDOF_HotplugKind {
+    NDOF_HOTPLUG_ADD    = 1,
+    NDOF_HOTPLUG_REMOVE = 2
+} NDOF_HotplugKind;
+
+/** A notification about the device `id': a hash of whatever identifies it
+ *  to the backend, e.g. its node path. The payload is the backend's. */
+typedef struct NDOF_HotplugEvent {
+    int       kind;             /* NDOF_HotplugKind */
+    uint64_t  id;
+    void     *payload;
+} NDOF_HotplugEvent;
+
+/** Applies the net events of a burst, removals first. The payloads are 
+ *  released when it returns. */
+typedef void (*NDOF_HotplugApplyFn)(void *ctx, const NDOF_HotplugEvent *events,
+                                    size_t count);
+typedef void (*NDOF_HotplugReleaseFn)(void *ctx, void *payload);
+
+/** Notifications of one device within the current burst. */
+typedef struct NDOF_PendingDevice {
+    uint64_t  id;
+    int       first;            /* kinds of its first and last events */
+    int       last;
+    void     *removal;          /* payloads of its last removal and add */
+    void     *add;
+} NDOF_PendingDevice;
+
+typedef struct NDOF_Coalescer {
+    NDOF_PendingDevice   *pending;  /* in the order they were first seen */
+    NDOF_HotplugEvent    *events;   /* room for the net events */
+    size_t                count;
+    size_t                capacity;
+    size_t               *slots;    /* index + 1 in pending, 0 if free */
+    size_t                mask;
+    uint64_t              window_ns;
+    uint64_t              first_ns; /* times of the burst's events */
+    uint64_t              last_ns;
+    NDOF_HotplugApplyFn   apply;
+    NDOF_HotplugReleaseFn release;
+    void                 *ctx;
+    /* statistics */
+    uint64_t              received;
+    uint64_t              applied;
+    uint64_t              bursts;
+} NDOF_Coalescer;
+
+/** window_ns - quiet time ending a burst; 0 applies each event at once. */
+void ndof_coalescer_init(NDOF_Coalescer *c, uint64_t window_ns,
+                         NDOF_HotplugApplyFn apply, 
+                         NDOF_HotplugReleaseFn release, void *ctx);
+
+/** Releases the payloads of the burst in progress, without applying it. */
+void ndof_coalescer_dispose(NDOF_Coalescer *c);
+
+/* --------------------------------------------------------------------------
+    Purpose:    Adds a notification received at `now_ns' to the burst.
+    Notes:      An add then a removal of the same device cancel out; a 
+                removal then an add make a removal and an add. Otherwise
+                the last event of a device stands for all of them. Out of
+                memory, the notification is released and dropped.
+*/
+void ndof_coalescer_push(NDOF_Coalescer *c, int kind, uint64_t id, 
+                         void *payload, uint64_t now_ns);
+
+/** Applies the burst once it is over: the window elapsed since its last 
+ *  event, or NDOF_HOTPLUG_MAX_WINDOWS since its first one, so that a storm
+ *  does not hold changes back forever. Returns 1 if the burst was applied. */
+int ndof_coalescer_flush(NDOF_Coalescer *c, uint64_t now_ns);
+
+/** Time at which the burst will be over, 0 if there is none. */
+uint64_t ndof_coalescer_deadline(const NDOF_Coalescer *c);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_hotplug_h__ */
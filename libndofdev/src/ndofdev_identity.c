@@ -0,0 +1,176 @@
+/*
+ @file ndofdev_identity.c
+ @brief Compact identity keys of devices, and a hash set of them.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_identity.h"
+
+#define NDOF_KEYSET_MIN_CAPACITY 16
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static void ndof_keyset_alloc(NDOF_KeySet *set, size_t capacity);
+static size_t ndof_keyset_find(const NDOF_KeySet *set, 
+                               const NDOF_DeviceKey *key);
+
+/* -------------------------------------------------------------------------- */
+NDOF_DeviceKey ndof_device_key(long vendor_id, long product_id, 
+                               long usage_page, long usage, 
+                               long location_id, const char *serial)
+{
+    NDOF_DeviceKey k;
+    uint32_t h = 0;
+    
+    /* FNV-1a; 0 is kept for "no serial number" */
+    if (serial && *serial)
+    {
+        h = 2166136261u;
+        while (*serial)
+        {
+            h ^= (unsigned char) *serial++;
+            h *= 16777619u;
+        }
+        if (h == 0)
+            h = 1;
+    }
+    
+    k.hi = ((uint64_t)(vendor_id & 0xffff) << 48) 
+         | ((uint64_t)(product_id & 0xffff) << 32)
+         | ((uint64_t)(usage_page & 0xffff) << 16) 
+         | (uint64_t)(usage & 0xffff);
+    k.lo = ((uint64_t)(uint32_t) location_id << 32) | h;
+    return k;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_key_equal(const NDOF_DeviceKey *a, const NDOF_DeviceKey *b)
+{
+    return (a->hi == b->hi && a->lo == b->lo);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_key_is_null(const NDOF_DeviceKey *k)
+{
+    return (k->hi == 0 && k->lo == 0);
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_key_hash(const NDOF_DeviceKey *k)
+{
+    /* splitmix64 finalizer over both halves */
+    uint64_t x = k->hi ^ (k->lo * 0x9e3779b97f4a7c15ULL);
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_keyset_init(NDOF_KeySet *set, size_t expected)
+{
+    size_t capacity = NDOF_KEYSET_MIN_CAPACITY;
+    
+    /* stay at most half full */
+    while (capacity < 2 * expected)
+        capacity <<= 1;
+    ndof_keyset_alloc(set, capacity);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_keyset_dispose(NDOF_KeySet *set)
+{
+    free(set->keys);
+    free(set->used);
+    memset(set, 0, sizeof(NDOF_KeySet));
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_keyset_insert(NDOF_KeySet *set, const NDOF_DeviceKey *key)
+{
+    size_t i = ndof_keyset_find(set, key);
+    
+    if (set->used[i])
+        return 0;
+    
+    if (2 * (set->count + 1) > set->mask + 1)
+    {
+        NDOF_KeySet grown;
+        size_t j;
+        
+        ndof_keyset_alloc(&grown, 2 * (set->mask + 1));
+        for (j = 0; j <= set->mask; j++)
+        {
+            if (set->used[j])
+            {
+                size_t k = ndof_keyset_find(&grown, &set->keys[j]);
+                grown.keys[k] = set->keys[j];
+                grown.used[k] = 1;
+                grown.count++;
+            }
+        }
+        ndof_keyset_dispose(set);
+        *set = grown;
+        i = ndof_keyset_find(set, key);
+    }
+    
+    set->keys[i] = *key;
+    set->used[i] = 1;
+    set->count++;
+    return 1;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_keyset_contains(const NDOF_KeySet *set, const NDOF_DeviceKey *key)
+{
+    return set->used[ndof_keyset_find(set, key)];
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_keyset_alloc(NDOF_KeySet *set, size_t capacity)
+{
+    set->keys = (NDOF_DeviceKey *) malloc(capacity * sizeof(NDOF_DeviceKey));
+    set->used = (unsigned char *) calloc(capacity, 1);
+    set->mask = capacity - 1;
+    set->count = 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Linear probing: index of `key', or of the free slot where it would go. */
+static size_t ndof_keyset_find(const NDOF_KeySet *set, 
+                               const NDOF_DeviceKey *key)
+{
+    size_t i = (size_t) ndof_key_hash(key) & set->mask;
+    
+    while (set->used[i] && !ndof_key_equal(&set->keys[i], key))
+        i = (i + 1) & set->mask;
+    return i;
+}
@@ -0,0 +1,82 @@
+/*
+ @file ndofdev_identity.h
+ @brief Compact identity keys of devices, and a hash set of them.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_identity_h__
+#define __ndofdev_identity_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** 128 bit identity of a device, computed once when it is found:
+ *  hi = vendor ID | product ID | usage page | usage, 16 bits each;
+ *  lo = location ID (32 bits) | hash of the serial number (32 bits). */
+typedef struct NDOF_DeviceKey {
+    uint64_t hi;
+    uint64_t lo;
+} NDOF_DeviceKey;
+
+#define NDOF_KEY_VENDOR_ID(k)   ((long)(((k).hi >> 48) & 0xffff))
+#define NDOF_KEY_PRODUCT_ID(k)  ((long)(((k).hi >> 32) & 0xffff))
+#define NDOF_KEY_MODEL(k)       ((uint32_t)((k).hi >> 32))
+#define NDOF_KEY_LOCATION(k)    ((uint32_t)((k).lo >> 32))
+#define NDOF_KEY_SERIAL(k)      ((uint32_t)(k).lo)
+
+NDOF_DeviceKey ndof_device_key(long vendor_id, long product_id, 
+                               long usage_page, long usage, 
+                               long location_id, const char *serial);
+
+/** 1 if the keys are equal. An all zero key identifies no device. */
+int ndof_key_equal(const NDOF_DeviceKey *a, const NDOF_DeviceKey *b);
+int ndof_key_is_null(const NDOF_DeviceKey *k);
+uint64_t ndof_key_hash(const NDOF_DeviceKey *k);
+
+/** Open addressing set of keys, growing as needed. */
+typedef struct NDOF_KeySet {
+    NDOF_DeviceKey *keys;
+    unsigned char  *used;
+    size_t          mask;   /* capacity - 1, a power of two */
+    size_t          count;
+} NDOF_KeySet;
+
+void ndof_keyset_init(NDOF_KeySet *set, size_t expected);
+void ndof_keyset_dispose(NDOF_KeySet *set);
+
+/** Returns 1 if `key' was added, 0 if it was already in the set. */
+int ndof_keyset_insert(NDOF_KeySet *set, const NDOF_DeviceKey *key);
+int ndof_keyset_contains(const NDOF_KeySet *set, const NDOF_DeviceKey *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_identity_h__ */
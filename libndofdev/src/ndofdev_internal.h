@@ -31,24 +31,78 @@
 #define __ndofhid_internal_h__
 
 #include "ndofdev_external.h"
+#include "ndofdev_backend.h"
+#include "ndofdev_epoch.h"
+#include "ndofdev_mpsc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 	
+/** The list of devices is never modified in place: ndof_create and 
+ *  ndof_destroy publish a new one, sharing what they can with the old one,
+ *  whose nodes and devices are freed once no reader is left. */
 typedef struct NDOF_DeviceListNode {
     NDOF_Device					*dev;
     struct NDOF_DeviceListNode	*next;
 } NDOF_DeviceListNode;
 
-extern NDOF_DeviceListNode *g_ndof_list_head;
+/** All the state of an instance of the library. Nothing in it is shared 
+ *  with the other instances. */
+struct NDOF_Context {
+    NDOF_DeviceListNode *volatile list_head;
+    volatile uint32_t   list_len;
+    NDOF_EpochDomain    epoch;          /* readers of the list */
+    
+    /* initialization state, an NDOF_InitStatus, and who to tell when it
+       ends */
+    volatile uint32_t   init_status;
+    NDOF_ReadyCallback  ready_cb;
+    void               *ready_ctx;
+    
+    volatile uint64_t   hotplug_window; /* ns */
+    
+    /* hot-plug notifications waiting for ndof_dispatch_events, unless the
+       callbacks are called directly; one thread dispatches at a time */
+    volatile uint32_t   callback_mode;
+    NDOF_MpscQueue      notices;
+    volatile uint32_t   dispatching;
+    
+    const NDOF_Backend *ops;            /* reads the devices */
+    void               *backend;        /* its state, or NULL */
+};
 
+/** Returns the current list, to walk with no lock until ndof_devlist_exit.
+ *  Devices may still be created and destroyed in between: the nodes and
+ *  devices seen stay valid. */
+NDOF_DeviceListNode *ndof_devlist_enter(NDOF_Context *ctx, 
+                                        NDOF_EpochGuard *guard);
+void ndof_devlist_exit(NDOF_EpochGuard *guard);
+
+/** Unlinks dev from its context's list, then frees it once no reader is 
+ *  left. It must still be in the list: destroying a device twice, or 
+ *  after ndof_libcleanup, is an error. May be called in a read-side 
+ *  section; the device is then freed after the section ends. */
 void ndof_destroy(NDOF_Device *dev);
 
 /** Determines if dev1 and dev2 describe the same device in the current
  *  topology. */
 unsigned char ndof_match(NDOF_Device *dev1, NDOF_Device *dev2);
 
+/** Ends the initialization: `err' is 0 on success. Wakes ndof_wait_ready
+ *  and calls the ready callback. */
+void ndof_init_done(NDOF_Context *ctx, int err);
+
+/** Backends report devices through these rather than calling the client's
+ *  callbacks, which may have to wait for ndof_dispatch_events. A device 
+ *  queued for the client is kept: NDOF_KEEP_HOTPLUGGED is returned. */
+NDOF_HotPlugResult ndof_notify_added(NDOF_DeviceAddCallback cb, 
+                                     NDOF_Device *dev);
+void ndof_notify_removed(NDOF_DeviceRemovalCallback cb, NDOF_Device *dev);
+
+/** Coalescing window of hot-plug notifications set by the client, in ns. */
+uint64_t ndof_hotplug_window(NDOF_Context *ctx);
+
 
 #ifdef __cplusplus
 }
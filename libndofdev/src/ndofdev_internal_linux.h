@@ -1,6 +1,6 @@
 /*
  @file ndofdev_internal_linux.h
- @brief UNMAINTAINED Linux implementation
+ @brief Linux implementation: hidraw or evdev nodes found in sysfs.
  Created by Ettore Pasquini on 8/7/07.
  
  Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
@@ -31,22 +31,41 @@
 #ifndef __ndofdev_internal_linux_h__
 #define __ndofdev_internal_linux_h__
 
-/* libhid include */
-#include "hid.h"
+#include "ndofdev_external.h"
+#include "ndofdev_identity.h"
+#include "ndofdev_report.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 	
+/** The node a device is read through. ndof_open_node builds it whole and
+ *  swaps it in: once published, only the decoding state changes, on the 
+ *  thread reading the device. Replaced ones are retired through the 
+ *  context's epoch, which closes them. */
+typedef struct NDOF_LinuxLink {
+    int             fd;
+    uint32_t        serial;         /* tells it from the links before */
+    volatile uint32_t attached;     /* 0 once the node is gone */
+    char            node[256];      /* path of the node */
+    int             kind;           /* NDOF_NodeKind */
+    int             event_clock;    /* evdev: events in ndof_time_ns() time */
+    NDOF_ReportPlan plan;           /* hidraw: where the axes are */
+    NDOF_DecodeFn   decode;
+    NDOF_DeviceKey  key;            /* model, serial and port of the device */
+    float           scale[NDOF_MAX_AXES_COUNT];
+    float           offset[NDOF_MAX_AXES_COUNT];
+    unsigned        axis_report[NDOF_MAX_AXES_COUNT]; /* evdev: see */
+    unsigned        rel_axes;                         /* ndof_end_frame */
+    unsigned        frame_axes;
+    long            raw[NDOF_MAX_AXES_COUNT];   /* last values read */
+    long            buttons[NDOF_MAX_BUTTONS_COUNT];
+} NDOF_LinuxLink;
+
 typedef struct NDOF_DevicePrivate {
-    void* dev;
-    void* /*pRecElement*/ axesElem[6];
-    void* /*pRecElement*/ btnElem[32];
+    NDOF_LinuxLink *volatile link;  /* NULL until a node is opened */
 } NDOF_DevicePrivate;
 
-void ndof_cleanup_internal();
-void ndof_dev_private_dispose(NDOF_DevicePrivate *priv);
-
 #ifdef __cplusplus
 }
 #endif
@@ -47,19 +47,9 @@ typedef struct NDOF_DevicePrivate {
     hu_element_t *hid_btn[NDOF_MAX_BUTTONS_COUNT];
 	float scale[NDOF_MAX_AXES_COUNT];
 	float offset[NDOF_MAX_AXES_COUNT];
-    long curr_loc_id; /* identifies where the device is currently connected */
-    long curr_vendor_id;
-    long curr_product_id;
+    NDOF_DeviceKey curr_key; /* model, serial and port of the device */
 } NDOF_DevicePrivate;
 
-void ndof_cleanup_internal();
-
-/** Makes sure everything related to `priv' is tidily disposed. */
-void ndof_dev_private_dispose(NDOF_DevicePrivate *priv);
-
-/** Returns 1 if d1 and d2 are the same device at the same port. */
-unsigned char ndof_match_private(NDOF_DevicePrivate *d1, NDOF_DevicePrivate *d2);
-
 #ifdef __cplusplus
 }
 #endif
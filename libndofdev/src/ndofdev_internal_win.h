@@ -47,14 +47,6 @@ typedef struct NDOF_DevicePrivate {
 	//long measured_max;
 } NDOF_DevicePrivate;
 
-void ndof_cleanup_internal();
-
-/** Makes sure everything related to `priv' is tidily disposed. */
-void ndof_dev_private_dispose(NDOF_DevicePrivate *priv);
-
-/** Returns 1 if d1 and d2 are the same device at the same port. */
-unsigned char ndof_match_private(NDOF_DevicePrivate *d1, NDOF_DevicePrivate *d2);
-
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,6 @@
 /*
  @file ndofdev_linux.c
- @brief UNMAINTAINED Linux implementation
+ @brief Linux implementation: hidraw or evdev nodes found in sysfs.
  Created by Ettore Pasquini on 8/7/07.
  
  Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
@@ -28,220 +28,1271 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include "ndofhid_external.h"
-#include "ndofhid_internal_linux.h"
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include "ndofdev_capcache.h"
+#include "ndofdev_external.h"
+#include "ndofdev_hotplug.h"
+#include "ndofdev_internal.h"
+#include "ndofdev_internal_linux.h"
+#include "ndofdev_quirks.h"
+#include "ndofdev_reconnect.h"
+#include "ndofdev_registry.h"
+#include "ndofdev_stream.h"
+#include "ndofdev_sync.h"
+#include "ndofdev_sysfs.h"
 
-typedef enum ndof_vendor_id {
-    kNdof3Dconnexion = 0x046d, //1133
-} ndof_vendor_id;
+/* with a 64 bit time_t on 32 bit systems, input_event has no timeval */
+#ifndef input_event_sec
+#define input_event_sec     time.tv_sec
+#define input_event_usec    time.tv_usec
+#endif
+
+/* --------------------------------------------------------------------------
+    Global/Static Variables                                                   */
+
+/*  The backend of a context, its `backend'. The I/O thread reads the 
+    devices opened as their reports arrive, and waits for nodes to come and
+    go in /dev and /dev/input. A byte on `wake' has it look at the devices
+    opened again, or stop once `stopping' is set. The layouts of the devices opened are kept in the capability
+    cache, if NDOF_CAPCACHE names its file, and those of the devices 
+    removed in `reconnect'. The devices found by the last scan of 
+    ndof_linux_devcount or ndof_linux_init_first are in `registry'. */
+typedef struct NDOF_LinuxBackend {
+    NDOF_DeviceAddCallback      add_callback;
+    NDOF_DeviceRemovalCallback  removal_callback;
+    char            root[256];  /* where the sys and dev trees are, "" for 
+                                   the root directory */
+    ndof_thread_t   io_thread;
+    int             io_thread_on;
+    int             async;
+    int             inotify;
+    int             wd_dev;
+    int             wd_input;
+    int             wake[2];
+    volatile uint32_t stopping;
+    volatile uint32_t link_serial;  /* of the last link built */
+    ndof_mutex_t    cache_lock;     /* devices are opened on both threads */
+    NDOF_CapCache   capcache;
+    char            capcache_path[256];     /* "" if none */
+    NDOF_ReconnectCache reconnect;
+    ndof_mutex_t    registry_lock;
+    NDOF_Registry   registry;       /* of NDOF_LinuxEntry */
+} NDOF_LinuxBackend;
+
+/*  A device found by a scan, built when it first appears: the later scans
+    do not parse its report descriptor again. */
+typedef struct NDOF_LinuxEntry {
+    int             parsed;     /* 0 if `plan' is unknown */
+    NDOF_ReportPlan plan;
+} NDOF_LinuxEntry;
+
+/*  A device the I/O thread reads. It polls a duplicate of the descriptor
+    of the device's link, which stays open when the link is retired. */
+typedef struct NDOF_LinuxWatch {
+    NDOF_Device    *dev;
+    uint32_t        serial;     /* of the link read */
+    int             fd;
+    int             eof;        /* nothing left to read: no longer polled */
+    int             seen;
+} NDOF_LinuxWatch;
 
-typedef enum ndof_product_id {
-    kNdofSpaceNavigator = 0xc626, //50726,
-} ndof_product_id;
+/*  The devices the I/O thread reads, and what it polls: inotify, `wake' 
+    and then the devices not at their end of file. */
+typedef struct NDOF_LinuxWatchList {
+    NDOF_LinuxWatch *items;
+    struct pollfd   *fds;       /* cap + 2 of them */
+    size_t          count;
+    size_t          cap;
+} NDOF_LinuxWatchList;
 
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_linux_libinit(NDOF_Context *ctx,
+                              NDOF_DeviceAddCallback in_add_cb, 
+                              NDOF_DeviceRemovalCallback in_removal_cb,
+                              void *platform_specific, int async);
+static void ndof_linux_stop(NDOF_Context *ctx);
+static void ndof_linux_cleanup(NDOF_Context *ctx);
+static int ndof_linux_devcount(NDOF_Context *ctx);
+static int ndof_linux_init_first(NDOF_Device *dev, void *param);
+static void ndof_linux_update(NDOF_Device *in_dev);
+static void ndof_linux_dispose(void *priv);
+static unsigned char ndof_linux_match(void *priv1, void *priv2);
+static int ndof_linux_accepts(NDOF_Context *ctx, const NDOF_SysfsNode *node);
+static int ndof_linux_rescan(NDOF_Context *ctx, NDOF_SysfsNode **nodes);
+static void *ndof_registry_added(void *ctx, const NDOF_DeviceKey *key, 
+                                 void *handle);
+static void ndof_registry_removed(void *ctx, const NDOF_DeviceKey *key, 
+                                  void *object);
+static const char *ndof_linux_root(NDOF_Context *ctx);
+static void ndof_io_thread(void *arg);
+static void ndof_io_wake(NDOF_LinuxBackend *be);
+static int ndof_watch_grow(NDOF_LinuxWatchList *w);
+static void ndof_watch_refresh(NDOF_Context *ctx, NDOF_LinuxWatchList *w);
+static void ndof_watch_read(NDOF_Context *ctx, NDOF_LinuxWatch *watch);
+static void ndof_hotplug_enumerate(NDOF_Context *ctx);
+static void ndof_hotplug_apply(void *ctx, const NDOF_HotplugEvent *events,
+                               size_t count);
+static void ndof_hotplug_release(void *ctx, void *payload);
+static uint64_t ndof_path_id(const char *path);
+static void ndof_hotplug_added(NDOF_Context *ctx, const char *name);
+static void ndof_hotplug_removed(NDOF_Context *ctx, const char *path);
+static void ndof_attach(NDOF_Context *ctx, const NDOF_SysfsNode *node);
+static void ndof_detach(NDOF_Device *dev, NDOF_LinuxLink *link);
+static int ndof_open_node(NDOF_Device *dev, const NDOF_SysfsNode *node,
+                          const NDOF_ReportPlan *plan);
+static int ndof_parse_cached(NDOF_Context *ctx, const NDOF_SysfsNode *node,
+                             NDOF_ReportPlan *plan);
+static int ndof_read_link(NDOF_Device *dev, NDOF_LinuxLink *link);
+static int ndof_read_hidraw(NDOF_Device *dev, NDOF_LinuxLink *link);
+static int ndof_read_evdev(NDOF_Device *dev, NDOF_LinuxLink *link);
+static void ndof_end_frame(NDOF_LinuxLink *link);
+static void ndof_publish_raw(NDOF_Device *dev, NDOF_LinuxLink *link, 
+                             uint64_t time_ns);
+static void ndof_group_axes(NDOF_LinuxLink *link);
+static void ndof_close_link(void *link);
+static void ndof_save_layout(NDOF_Device *dev, const NDOF_LinuxLink *link);
+static NDOF_DeviceKey ndof_link_key(const NDOF_LinuxLink *link);
+
+/* -------------------------------------------------------------------------- 
+    Devices are looked for in sysfs. Hot-plugging is watched for with inotify
+    on the I/O thread, which also enumerates the devices when `async' is 
+    set. `platform_specific' may name a directory holding the sys and dev 
+    trees in place of the root directory. */
+static int ndof_linux_libinit(NDOF_Context *ctx,
+                              NDOF_DeviceAddCallback in_add_cb, 
+                              NDOF_DeviceRemovalCallback in_removal_cb,
+                              void *platform_specific, int async)
+{
+    NDOF_LinuxBackend *be;
+    char path[300];
+    
+    /* initialized again */
+    ndof_linux_cleanup(ctx);
+    be = (NDOF_LinuxBackend *) calloc(1, sizeof(NDOF_LinuxBackend));
+    if (be == NULL)
+        return -1;
+    
+    be->add_callback = in_add_cb;
+    be->removal_callback = in_removal_cb;
+    be->async = async;
+    be->wd_dev = be->wd_input = -1;
+    be->wake[0] = be->wake[1] = -1;
+    snprintf(be->root, sizeof(be->root), "%s", 
+             (platform_specific ? (const char *) platform_specific : ""));
+    ctx->backend = be;
+    
+    ndof_mutex_init(&be->cache_lock);
+    snprintf(be->capcache_path, sizeof(be->capcache_path), "%s", 
+             (getenv("NDOF_CAPCACHE") ? getenv("NDOF_CAPCACHE") : ""));
+    ndof_capcache_open(&be->capcache, be->capcache_path);
+    ndof_reconnect_init(&be->reconnect);
+    ndof_mutex_init(&be->registry_lock);
+    ndof_registry_init(&be->registry, ndof_registry_added, 
+                       ndof_registry_removed, ctx);
+    
+    be->inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (be->inotify >= 0)
+    {
+        snprintf(path, sizeof(path), "%s/dev", be->root);
+        be->wd_dev = inotify_add_watch(be->inotify, path, 
+                                       IN_CREATE | IN_ATTRIB | IN_DELETE);
+        snprintf(path, sizeof(path), "%s/dev/input", be->root);
+        be->wd_input = inotify_add_watch(be->inotify, path, 
+                                         IN_CREATE | IN_ATTRIB | IN_DELETE);
+    }
+    
+    if (be->inotify >= 0 && pipe(be->wake) == 0
+        && fcntl(be->wake[0], F_SETFL, O_NONBLOCK) == 0
+        && fcntl(be->wake[1], F_SETFL, O_NONBLOCK) == 0
+        && ndof_thread_create(&be->io_thread, ndof_io_thread, ctx) == 0)
+    {
+        be->io_thread_on = 1;
+    }
+    else
+    {
+        fprintf(stderr, "libndofdev: hot-plugging unavailable (%s)\n", 
+                strerror(errno));
+        if (async)
+            ndof_hotplug_enumerate(ctx);
+        be->async = 0;
+    }
+    
+    if (!be->async)
+        ndof_init_done(ctx, 0);
+    return 0;
+}
 
 /* -------------------------------------------------------------------------- */
-int ndof_libinit()
+static void ndof_linux_stop(NDOF_Context *ctx)
 {
-    #if NDOF_DEBUG
-    HIDDebugLevel debug_level = HID_DEBUG_ERRORS;
-    #else
-    HIDDebugLevel debug_level = HID_DEBUG_ALL;
-    #endif
-    int err;
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
     
-    /* see include/debug.h for possible values */
-    hid_set_debug(debug_level);
-    hid_set_debug_stream(stderr);
-    /* passed directly to libusb */
-    hid_set_usb_debug(0);
+    if (be && be->io_thread_on)
+    {
+        ndof_atomic_store32(&be->stopping, 1);
+        ndof_io_wake(be);
+        ndof_thread_join(be->io_thread);
+        be->io_thread_on = 0;
+    }
+}
 
-    err = hid_init();
-    if (err != HID_RET_SUCCESS) {
-        fprintf(stderr, "hid_init failed with return code %d\n", err);
+/* -------------------------------------------------------------------------- */
+static void ndof_linux_cleanup(NDOF_Context *ctx)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    
+    if (be == NULL)
+        return;
+    
+    ndof_linux_stop(ctx);
+    if (be->inotify >= 0)
+        close(be->inotify);
+    if (be->wake[0] >= 0)
+    {
+        close(be->wake[0]);
+        close(be->wake[1]);
     }
+    ndof_capcache_close(&be->capcache);
+    ndof_mutex_destroy(&be->cache_lock);
+    ndof_reconnect_dispose(&be->reconnect);
+    ndof_registry_dispose(&be->registry);
+    ndof_mutex_destroy(&be->registry_lock);
+    free(be);
+    ctx->backend = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_linux_devcount(NDOF_Context *ctx)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    NDOF_SysfsNode *nodes;
+    int count;
     
-    return err;
+    if (be == NULL)
+        return -1;
+    
+    count = ndof_linux_rescan(ctx, &nodes);
+    free(nodes);
+    if (count < 0)
+        return -1;
+    
+    ndof_mutex_lock(&be->registry_lock);
+    count = (int) be->registry.count;
+    ndof_mutex_unlock(&be->registry_lock);
+    return count;
 }
 
 /* -------------------------------------------------------------------------- */
-/*static short ndof_isndof(pRecDevice dev)
+static int ndof_linux_init_first(NDOF_Device *dev, void *param)
 {
-    if (dev && 
-        (dev->axis > 2
-         || strstr(dev->manufacturer, "3Dconnexion")))
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) dev->context->backend;
+    NDOF_SysfsNode *nodes;
+    NDOF_ReportPlan plan;
+    int notfound = -1, count, i;
+    size_t lenm = strlen(dev->manufacturer), lenp = strlen(dev->product);
+    
+    (void) param;
+    count = ndof_linux_rescan(dev->context, &nodes);
+    for (i = 0; i < count && notfound; i++)
     {
-#ifdef NDOF_DEBUG
-        fprintf(NDOF_DEBUG, "  NDOF device found: %s %s: #inputs=%ld; #axes=%ld; "
-                "#buttons=%ld\n", dev->manufacturer, dev->product, 
-                dev->inputs, dev->axis, dev->buttons);
-#endif
+        const NDOF_LinuxEntry *entry = NULL;
         
-        return 1;
+        if (!ndof_linux_accepts(dev->context, &nodes[i])
+            || (lenm && strncmp(dev->manufacturer, nodes[i].manufacturer, 
+                                lenm) != 0)
+            || (lenp && strncmp(dev->product, nodes[i].product, lenp) != 0))
+            continue;
+        
+        /* copied: another thread may scan again meanwhile */
+        if (be)
+        {
+            ndof_mutex_lock(&be->registry_lock);
+            entry = (const NDOF_LinuxEntry *) 
+                ndof_registry_find(&be->registry, &nodes[i].key);
+            if (entry && entry->parsed)
+                plan = entry->plan;
+            else
+                entry = NULL;
+            ndof_mutex_unlock(&be->registry_lock);
+        }
+        notfound = ndof_open_node(dev, &nodes[i], (entry ? &plan : NULL));
     }
+    free(nodes);
     
-    return 0;
-}*/
+    if (notfound)
+    {
+        fprintf(stderr, "libndofdev: no NDOF HID device found.\n");
+    }
+    else
+    {
+        fprintf(stderr, "libndofdev: using device:\n");
+        ndof_dump(stderr, dev);
+    }
+    
+    return notfound;
+}
 
-/* -------------------------------------------------------------------------- */
-int ndof_dev_count()
+/* -------------------------------------------------------------------------- 
+    1 if the node is of a kind read by the context's backend. */
+static int ndof_linux_accepts(NDOF_Context *ctx, const NDOF_SysfsNode *node)
 {
-    /*    
-    int num = 0;
-    pRecDevice dev = HIDGetFirstDevice();
+    return (ctx->ops->variant & (1 << node->kind)) != 0;
+}
 
-    while (dev)
+/* -------------------------------------------------------------------------- 
+    Scans sysfs and brings the registry in line with the devices found, 
+    building only the ones that were not there at the previous scan. 
+    Returns the number of nodes found, or -1. */
+static int ndof_linux_rescan(NDOF_Context *ctx, NDOF_SysfsNode **nodes)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    NDOF_DeviceKey *keys;
+    void **handles;
+    int count, n = 0, i;
+    
+    count = ndof_sysfs_scan(ndof_linux_root(ctx), nodes);
+    if (count < 0 || be == NULL)
+        return count;
+    
+    keys = (NDOF_DeviceKey *) malloc((count + 1) * sizeof(NDOF_DeviceKey));
+    handles = (void **) malloc((count + 1) * sizeof(void *));
+    if (keys && handles)
     {
-        if (ndof_isndof(dev))
-            num++;
-        
-        dev = HIDGetNextDevice(dev);
+        /* the nodes of a device share its key: the first one builds it */
+        for (i = 0; i < count; i++)
+        {
+            if (ndof_linux_accepts(ctx, &(*nodes)[i]))
+            {
+                keys[n] = (*nodes)[i].key;
+                handles[n++] = &(*nodes)[i];
+            }
+        }
+        ndof_mutex_lock(&be->registry_lock);
+        ndof_registry_reconcile(&be->registry, keys, handles, n, NULL);
+        ndof_mutex_unlock(&be->registry_lock);
     }
-    */
-    return -1;
+    free(keys);
+    free(handles);
+    return count;
+}
+
+/* -------------------------------------------------------------------------- 
+    A device appeared in a scan, `handle' is its first NDOF_SysfsNode. */
+static void *ndof_registry_added(void *ctx, const NDOF_DeviceKey *key, 
+                                 void *handle)
+{
+    const NDOF_SysfsNode *node = (const NDOF_SysfsNode *) handle;
+    NDOF_LinuxEntry *entry;
+    
+    (void) key;
+    entry = (NDOF_LinuxEntry *) calloc(1, sizeof(NDOF_LinuxEntry));
+    if (entry && node->desc_len)
+        entry->parsed = (ndof_parse_cached((NDOF_Context *) ctx, node, 
+                                           &entry->plan) == 0);
+    return entry;
 }
 
 /* -------------------------------------------------------------------------- */
-int ndof_firstdev(NDOF_Device *dev)
+static void ndof_registry_removed(void *ctx, const NDOF_DeviceKey *key, 
+                                  void *object)
 {
-    int notfound = -1;
-    HIDInterface *hid;
-    hid_return ret;
+    (void) ctx;
+    (void) key;
+    free(object);
+}
+
+/* -------------------------------------------------------------------------- 
+    Directory holding the sys and dev trees the context was initialized
+    with, NULL for the root directory. */
+static const char *ndof_linux_root(NDOF_Context *ctx)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    
+    return (be ? be->root : NULL);
+}
 
-    HIDInterfaceMatcher matcher = { kNdof3Dconnexion, kNdofSpaceNavigator, NULL, NULL, 0 };
+/* -------------------------------------------------------------------------- 
+    Opens the node of a device found in sysfs, the first one we are allowed
+    to read. `plan' is that of its report descriptor if already known, 
+    NULL to parse it. Returns 0 if ok. 
+    The node is read through a new NDOF_LinuxLink, swapped in whole: the 
+    I/O thread opens the nodes of the devices hot-plugged while another
+    thread may be reading through the previous one. */
+static int ndof_open_node(NDOF_Device *dev, const NDOF_SysfsNode *node,
+                          const NDOF_ReportPlan *plan)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) dev->private_data;
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) dev->context->backend;
+    const NDOF_DeviceQuirks *q;
+    NDOF_DeviceLayout layout;
+    NDOF_LinuxLink *link, *old;
+    long logical_min = 0, logical_max = 0;
+    int axes_count, btn_count, fd, i, clock_id = CLOCK_MONOTONIC, replugged;
+    
+    link = (NDOF_LinuxLink *) calloc(1, sizeof(NDOF_LinuxLink));
+    if (link == NULL)
+        return -1;
+    if ((fd = open(node->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC)) < 0)
+    {
+#ifdef NDOF_DEBUG
+        fprintf(NDOF_DEBUG, "libndofdev: cannot open %s (%s)\n", 
+                node->path, strerror(errno));
+#endif
+        free(link);
+        return -1;
+    }
+    
+    /* events stamped in the time base of ndof_time_ns, if the kernel can */
+    link->event_clock = (node->kind == NDOF_NODE_EVDEV 
+                         && ioctl(fd, EVIOCSCLOCKID, &clock_id) == 0);
     
-    hid = hid_new_HIDInterface();
-    if (hid == 0) {
-        fprintf(stderr, "hid_new_HIDInterface() failed, out of memory?\n");
-        return notfound;
+    /* replugged devices: resume with the plan and calibration they had */
+    replugged = (be && ndof_reconnect_take(&be->reconnect, &node->key, &layout)
+                 && layout.axes_min == dev->axes_min 
+                 && layout.axes_max == dev->axes_max);
+    
+    if (plan)
+        link->plan = *plan;
+    if (replugged)
+    {
+        link->plan = layout.plan;
+        axes_count = layout.axes_count;
+        btn_count = layout.btn_count;
+    }
+    else if (plan 
+             || (node->desc_len 
+                 && ndof_parse_cached(dev->context, node, &link->plan) == 0))
+    {
+        axes_count = link->plan.axes_count;
+        btn_count = link->plan.btn_count;
+        logical_min = link->plan.axes_min;
+        logical_max = link->plan.axes_max;
+    }
+    else if (node->kind == NDOF_NODE_EVDEV)
+    {
+        axes_count = NDOF_MAX_AXES_COUNT;
+        btn_count = node->btn_count;
+    }
+    else
+    {
+        close(fd);
+        free(link);
+        return -1;
+    }
+    
+    q = ndof_quirks_lookup(node->vendor_id, node->product_id);
+    if (q && !replugged && q->logical_min != q->logical_max)
+    {
+        logical_min = q->logical_min;
+        logical_max = q->logical_max;
+    }
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        if (replugged)
+        {
+            link->scale[i] = layout.scale[i];
+            link->offset[i] = layout.offset[i];
+        }
+        else if (logical_max > logical_min)
+        {
+            /*  y_min = offset + scale*x_min; 
+                y_max = offset + scale*x_max */
+            link->scale[i] = (float) 
+                (dev->axes_max - dev->axes_min) / (logical_max - logical_min);
+            link->offset[i] = dev->axes_min - link->scale[i] * logical_min;
+        }
+        else
+        {
+            /* no range known: the values as they come */
+            link->scale[i] = 1;
+            link->offset[i] = 0;
+        }
     }
+    
+    link->fd = fd;
+    link->serial = (be ? ndof_atomic_add32(&be->link_serial, 1) : 0);
+    link->attached = 1;
+    snprintf(link->node, sizeof(link->node), "%s", node->path);
+    link->kind = node->kind;
+    link->decode = ndof_decode_select(node->vendor_id, node->product_id, 
+                                      &link->plan);
+    ndof_group_axes(link);
+    link->key = node->key;
+    
+    dev->axes_count = axes_count;
+    dev->btn_count = btn_count;
+    snprintf(dev->manufacturer, sizeof(dev->manufacturer), "%s", 
+             node->manufacturer);
+    snprintf(dev->product, sizeof(dev->product), "%s", node->product);
+    ndof_stream_identify(dev, &node->key);
+    
+    /* closed once no reader is left */
+    old = (NDOF_LinuxLink *) ndof_atomic_xchgptr((void **) &priv->link, link);
+    if (old)
+        ndof_epoch_retire(&dev->context->epoch, ndof_close_link, old);
+    ndof_stream_set_valid(dev, 1);
+    
+    /* to be read from now on */
+    if (be)
+        ndof_io_wake(be);
+    return 0;
+}
 
-    ret = hid_force_open(hid, 0, &matcher, 3);
-    //ret = hid_open(hid, 0, &matcher);
-    if (ret != HID_RET_SUCCESS) {
-        fprintf(stderr, "hid_force_open failed with return code %d\n", ret);
-        return notfound;
+/* -------------------------------------------------------------------------- 
+    Extraction plan of a node's report descriptor: found in the capability
+    cache if the model, firmware and descriptor are known, otherwise parsed
+    and added to it. Returns 0 if ok. */
+static int ndof_parse_cached(NDOF_Context *ctx, const NDOF_SysfsNode *node,
+                             NDOF_ReportPlan *plan)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    const NDOF_DeviceLayout *layout;
+    NDOF_CapRecord rec;
+    uint64_t h;
+    int err;
+    
+    if (be == NULL || be->capcache_path[0] == 0)
+        return ndof_report_parse(node->desc, node->desc_len, plan);
+    
+    h = ndof_descriptor_hash(node->desc, node->desc_len);
+    ndof_mutex_lock(&be->cache_lock);
+    layout = ndof_capcache_find(&be->capcache, node->vendor_id, 
+                                node->product_id, node->version, h);
+    if (layout)
+    {
+        *plan = layout->plan;
+        err = 0;
     }
+    else if ((err = ndof_report_parse(node->desc, node->desc_len, plan)) == 0)
+    {
+        /* the cache is only a shortcut: I/O errors are ignored */
+        memset(&rec, 0, sizeof(rec));
+        rec.model = NDOF_QUIRKS_KEY(node->vendor_id, node->product_id);
+        rec.version = (uint32_t) node->version;
+        rec.desc_hash = h;
+        rec.layout.axes_count = plan->axes_count;
+        rec.layout.btn_count = plan->btn_count;
+        rec.layout.axes_min = plan->axes_min;
+        rec.layout.axes_max = plan->axes_max;
+        rec.layout.plan = *plan;
+        ndof_capcache_store(&be->capcache, be->capcache_path, &rec, 1);
+    }
+    ndof_mutex_unlock(&be->cache_lock);
+    return err;
+}
 
-    ret = hid_write_identification(stderr, hid);
-    if (ret != HID_RET_SUCCESS) {
-        fprintf(stderr, "hid_write_identification failed with return code %d\n", ret);
-        return notfound;
+/* -------------------------------------------------------------------------- 
+    The devices are read by the I/O thread as their reports arrive: only 
+    the state it published last is copied into in_dev. They are read here
+    if there is no I/O thread. */
+static void ndof_linux_update(NDOF_Device *in_dev)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) in_dev->private_data;
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) in_dev->context->backend;
+    NDOF_EpochGuard guard;
+    NDOF_LinuxLink *link;
+    
+    if (!ndof_stream_is_valid(in_dev))
+        return; // attempting to read status from uninitialized structure
+    
+    if (be == NULL || !be->io_thread_on)
+    {
+        /* the I/O thread may swap in another node meanwhile: this one 
+           stays open until the guard is left */
+        ndof_epoch_enter(&in_dev->context->epoch, &guard);
+        link = (NDOF_LinuxLink *) ndof_atomic_loadptr((void **) &priv->link);
+        if (link && ndof_read_link(in_dev, link) < 0)
+            ndof_detach(in_dev, link);
+        ndof_epoch_exit(&guard);
     }
-  
-    ret = hid_dump_tree(stderr, hid);
-    if (ret != HID_RET_SUCCESS) {
-        fprintf(stderr, "hid_dump_tree failed with return code %d\n", ret);
-        return notfound;
+    ndof_stream_fetch(in_dev);
+}
+
+/* -------------------------------------------------------------------------- 
+    Publishes the values decoded so far as one sample read at time_ns. 
+    dev->axes and dev->buttons belong to the thread updating dev. */
+static void ndof_publish_raw(NDOF_Device *dev, NDOF_LinuxLink *link, 
+                             uint64_t time_ns)
+{
+    long axes[NDOF_MAX_AXES_COUNT];
+    int i;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        axes[i] = (i < dev->axes_count 
+                   ? (long) (link->offset[i] + link->scale[i] * link->raw[i])
+                   : 0);
+    ndof_stream_publish_values(dev, axes, link->buttons, time_ns);
+}
+
+/* -------------------------------------------------------------------------- 
+    Reads what the kernel queued for the node of `link'. Returns -1 if the
+    device is gone (unplugged: ENODEV, or EIO from hidraw), 1 at the end of
+    file, 0 once nothing is left to read. */
+static int ndof_read_link(NDOF_Device *dev, NDOF_LinuxLink *link)
+{
+    if (link->kind == NDOF_NODE_HIDRAW)
+        return ndof_read_hidraw(dev, link);
+    return ndof_read_evdev(dev, link);
+}
+
+/* -------------------------------------------------------------------------- 
+    Decodes the input reports queued by the kernel, one per read, and 
+    publishes a sample per report. hidraw keeps no time for the reports:
+    they are stamped when read, by the I/O thread as soon as they arrive. 
+    Returns as ndof_read_link. */
+static int ndof_read_hidraw(NDOF_Device *dev, NDOF_LinuxLink *link)
+{
+    unsigned char report[64];
+    ssize_t len;
+    
+    while ((len = read(link->fd, report, sizeof(report))) > 0)
+    {
+        link->decode(&link->plan, report, len, link->raw, link->buttons);
+        ndof_publish_raw(dev, link, ndof_time_ns());
     }
-    /*
-    pRecDevice d = HIDGetFirstDevice();
     
-    while (d)
+    if (len == 0)
+        return 1;
+    return (len < 0 && errno != EAGAIN && errno != EINTR ? -1 : 0);
+}
+
+/* -------------------------------------------------------------------------- 
+    Applies the queued input events, publishing a sample per SYN_REPORT at
+    the time the kernel gave it. Returns as ndof_read_link. */
+static int ndof_read_evdev(NDOF_Device *dev, NDOF_LinuxLink *link)
+{
+    struct input_event ev[64];
+    ssize_t len;
+    int i, n;
+    
+    while ((len = read(link->fd, ev, sizeof(ev))) > 0)
     {
-        if (ndof_isndof(d) && 
-            ((dev->axes_count == 0 || dev->axes_count == d->axis)
-             && (dev->btn_count == -1 || dev->btn_count == d->buttons)))
+        n = (int)(len / sizeof(ev[0]));
+        for (i = 0; i < n; i++)
         {
-            size_t lenm = strlen(d->manufacturer);
-            size_t lenp = strlen(d->product);
-
-            if ((*dev->manufacturer == '\0'
-                 || strncmp(dev->manufacturer, d->manufacturer, lenm) == 0)
-                && (*dev->product == '\0'
-                    || strncmp(dev->product, d->product, lenp) == 0))
+            switch (ev[i].type)
             {
-                NDOF_DevicePrivate *priv;
-                pRecElement elem = NULL;
-                long axesCnt = 0, btnCnt = 0;
-                #ifdef NDOF_DEBUG
-                int debug_miscCnt = 0;
-                #endif
-                
-                dev->axes_count = d->axis;
-                dev->btn_count  = d->buttons;
-                strncpy(dev->manufacturer, d->manufacturer, lenm);
-                strncpy(dev->product, d->product, lenp);
-                priv = (NDOF_DevicePrivate*) dev->private_data;
-                priv->dev = d;
-                
-                // now save all elements relative to the axes and buttons
-                // to speed up future access (ndof_update_status)
-                elem = HIDGetFirstDeviceElement(d, kHIDElementTypeIO);
-                while (elem && !(axesCnt == d->axis && btnCnt == d->buttons))
-                {
-                    // know how many axes and buttons we are looking for,
-                    // make sure this is respected
-                    // to do: what about kIOHIDElementTypeInput_Axis elements?
-                    if (elem->type == kIOHIDElementTypeInput_Misc
-                        && axesCnt < d->axis 
-                        && elem->size > 1 && (elem->max - elem->min > 2))
-                        priv->axesElem[axesCnt++] = elem;
-                    else if (elem->type == kIOHIDElementTypeInput_Button
-                             && btnCnt < d->buttons)
-                        priv->btnElem[btnCnt++] = elem;
-                    
-                    #ifdef NDOF_DEBUG
-                    if (elem->type == kIOHIDElementTypeInput_Misc
-                        && elem->size > 1 && (elem->max - elem->min > 2)
-                        )
+                case EV_REL:
+                    if (ev[i].code >= NDOF_MAX_AXES_COUNT)
+                        break;
+                    link->rel_axes |= 1u << ev[i].code;
+                    /* fall through */
+                case EV_ABS:
+                    if (ev[i].code >= NDOF_MAX_AXES_COUNT)
+                        break;
+                    link->raw[ev[i].code] = ev[i].value;
+                    link->frame_axes |= 1u << ev[i].code;
+                    break;
+                case EV_KEY:
+                    if (ev[i].code >= BTN_0 
+                        && ev[i].code < BTN_0 + NDOF_MAX_BUTTONS_COUNT)
+                        link->buttons[ev[i].code - BTN_0] = (ev[i].value != 0);
+                    break;
+                case EV_SYN:
+                    if (ev[i].code == SYN_REPORT)
                     {
-                        debug_miscCnt++;
-                        fprintf(NDOF_DEBUG, "tmp_miscCnt=%d;\n", debug_miscCnt);
+                        ndof_end_frame(link);
+                        ndof_publish_raw(dev, link, (link->event_clock 
+                            ? (uint64_t) ev[i].input_event_sec * 1000000000ULL
+                              + (uint64_t) ev[i].input_event_usec * 1000ULL
+                            : ndof_time_ns()));
                     }
-                    #endif
-                    
-                    elem = HIDGetNextDeviceElement(elem, kHIDElementTypeAll);
-                }
-                assert(axesCnt == d->axis);
-                assert(btnCnt == d->buttons);
-                #ifdef NDOF_DEBUG
-                assert(debug_miscCnt == d->axis);
-                #endif
-                
-                notfound = 0;
+                    break;
+            }
+        }
+    }
+    
+    if (len == 0)
+        return 1;
+    return (len < 0 && errno != EAGAIN && errno != EINTR ? -1 : 0);
+}
+
+/* -------------------------------------------------------------------------- 
+    The kernel drops relative events of value 0: the relative axes of the
+    reports of a frame that it did not carry are at rest. Frames where all
+    of them are 0 are dropped too, so the last step to rest may be missed. */
+static void ndof_end_frame(NDOF_LinuxLink *link)
+{
+    unsigned reported = 0;
+    int i;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        if (link->frame_axes & (1u << i))
+            reported |= link->axis_report[i];
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        if (link->rel_axes & reported & ~link->frame_axes & (1u << i))
+            link->raw[i] = 0;
+    
+    link->frame_axes = 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Axes sent in the same report as each axis, as bit masks: all of them if
+    the device has no report descriptor. */
+static void ndof_group_axes(NDOF_LinuxLink *link)
+{
+    const NDOF_ReportPlan *plan = &link->plan;
+    int i, j;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        link->axis_report[i] = (plan->field_count ? 1u << i 
+                                : (1u << NDOF_MAX_AXES_COUNT) - 1);
+    
+    for (i = 0; i < plan->field_count; i++)
+        for (j = 0; j < plan->field_count; j++)
+        {
+            const NDOF_ReportField *a = &plan->fields[i], *b = &plan->fields[j];
+            
+            if (a->target < NDOF_MAX_AXES_COUNT && b->target < NDOF_MAX_AXES_COUNT
+                && a->report_id == b->report_id)
+                link->axis_report[a->target] |= 1u << b->target;
+        }
+}
+
+/* -------------------------------------------------------------------------- 
+    Reclaims a link no one reads through anymore. */
+static void ndof_close_link(void *p)
+{
+    NDOF_LinuxLink *link = (NDOF_LinuxLink *) p;
+    
+    close(link->fd);
+    free(link);
+}
+
+/* -------------------------------------------------------------------------- 
+    Identity of the device read through `link', the null key if none. */
+static NDOF_DeviceKey ndof_link_key(const NDOF_LinuxLink *link)
+{
+    NDOF_DeviceKey null_key;
+    
+    if (link)
+        return link->key;
+    memset(&null_key, 0, sizeof(null_key));
+    return null_key;
+}
+
+/*  **********************
+    Hot-plugging use cases
+    **********************
+
+    As on OS X (see ndofdev_osx.c), with the callbacks called on the I/O 
+    thread. A device has a hidraw and an event node: the first one that can
+    be opened is used, the other one is ignored.
+*/
+
+/* -------------------------------------------------------------------------- 
+    Reads the devices opened as their reports arrive, so that each one is
+    published, and stamped for hidraw, with no delay: ndof_update only 
+    copies the state published last.
+    Also waits for nodes to be created, made readable or deleted. Plugging a 
+    device creates its nodes one by one, and udev then changes their 
+    permissions: the notifications are coalesced so that the devices are 
+    looked at once per burst, and not at all if they are already gone. */
+static void ndof_io_thread(void *arg)
+{
+    NDOF_Context *ctx = (NDOF_Context *) arg;
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    union {
+        struct inotify_event ev;
+        char bytes[4096];
+    } buf;
+    struct pollfd *fds;
+    NDOF_LinuxWatchList watched;
+    NDOF_Coalescer coalescer;
+    ssize_t len;
+    size_t i, n;
+    
+    memset(&watched, 0, sizeof(watched));
+    if (ndof_watch_grow(&watched) != 0)
+        return;
+    
+    if (be->async)
+    {
+        ndof_hotplug_enumerate(ctx);
+        ndof_init_done(ctx, 0);
+    }
+    
+    ndof_coalescer_init(&coalescer, ndof_hotplug_window(ctx), 
+                        ndof_hotplug_apply, ndof_hotplug_release, ctx);
+    
+    for (;;)
+    {
+        uint64_t deadline = ndof_coalescer_deadline(&coalescer);
+        int timeout_ms = -1;
+        
+        if (deadline != 0)
+        {
+            uint64_t now = ndof_time_ns();
+            timeout_ms = (deadline > now 
+                          ? (int) ((deadline - now + 999999) / 1000000) : 0);
+        }
+        
+        ndof_watch_refresh(ctx, &watched);
+        fds = watched.fds;
+        fds[0].fd = be->inotify;
+        fds[1].fd = be->wake[0];
+        for (i = 0, n = 2; i < watched.count; i++)
+        {
+            if (!watched.items[i].eof)
+                fds[n++].fd = watched.items[i].fd;
+        }
+        for (i = 0; i < n; i++)
+        {
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+        }
+        
+        if (poll(fds, (nfds_t) n, timeout_ms) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+        {
+            while (read(be->wake[0], buf.bytes, sizeof(buf)) > 0)
+                ;
+            if (ndof_atomic_load32(&be->stopping))
                 break;
+        }
+        
+        for (i = 0, n = 2; i < watched.count; i++)
+        {
+            if (!watched.items[i].eof && fds[n++].revents)
+                ndof_watch_read(ctx, &watched.items[i]);
+        }
+        
+        while ((len = read(be->inotify, &buf, sizeof(buf))) > 0)
+        {
+            uint64_t now = ndof_time_ns();
+            char *p;
+            
+            for (p = buf.bytes; p < buf.bytes + len; 
+                 p += sizeof(struct inotify_event) + ((struct inotify_event *) p)->len)
+            {
+                const struct inotify_event *ev = (struct inotify_event *) p;
+                char path[600];
+                char *copy;
+                
+                if (ev->len == 0 
+                    || (ev->wd != be->wd_dev && ev->wd != be->wd_input))
+                    continue;
+                
+                snprintf(path, sizeof(path), "%s/dev%s/%s", be->root, 
+                         (ev->wd == be->wd_input ? "/input" : ""), ev->name);
+                copy = strdup(path);
+                if (copy == NULL)
+                    continue;
+                ndof_coalescer_push(&coalescer, (ev->mask & IN_DELETE 
+                                                 ? NDOF_HOTPLUG_REMOVE 
+                                                 : NDOF_HOTPLUG_ADD),
+                                    ndof_path_id(path), copy, now);
             }
         }
+        ndof_coalescer_flush(&coalescer, ndof_time_ns());
+    }
+    
+    ndof_coalescer_dispose(&coalescer);
+    for (i = 0; i < watched.count; i++)
+        close(watched.items[i].fd);
+    free(watched.items);
+    free(watched.fds);
+}
+
+/* -------------------------------------------------------------------------- 
+    Has the I/O thread look at the devices opened again. */
+static void ndof_io_wake(NDOF_LinuxBackend *be)
+{
+    /* a full pipe has it woken already */
+    if (be->wake[1] >= 0)
+        while (write(be->wake[1], "", 1) < 0 && errno == EINTR)
+            ;
+}
+
+/* -------------------------------------------------------------------------- 
+    Makes room for twice as many devices. Returns 0 if ok. */
+static int ndof_watch_grow(NDOF_LinuxWatchList *w)
+{
+    size_t cap = (w->cap ? 2 * w->cap : 4);
+    NDOF_LinuxWatch *items;
+    struct pollfd *fds;
+    
+    items = (NDOF_LinuxWatch *) realloc(w->items, cap * sizeof(*items));
+    if (items == NULL)
+        return -1;
+    w->items = items;
+    fds = (struct pollfd *) realloc(w->fds, (cap + 2) * sizeof(*fds));
+    if (fds == NULL)
+        return -1;
+    w->fds = fds;
+    w->cap = cap;
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Brings the devices read in line with the links attached, which the 
+    other threads swap in and out. */
+static void ndof_watch_refresh(NDOF_Context *ctx, NDOF_LinuxWatchList *w)
+{
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    size_t i, n;
+    int fd;
+    
+    for (i = 0; i < w->count; i++)
+        w->items[i].seen = 0;
+    
+    for (node = ndof_devlist_enter(ctx, &guard); node; node = node->next)
+    {
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_LinuxLink *link = (NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link);
+        
+        if (link == NULL || !ndof_atomic_load32(&link->attached))
+            continue;
         
-        d = HIDGetNextDevice(d);
+        for (i = 0; i < w->count; i++)
+            if (w->items[i].dev == node->dev 
+                && w->items[i].serial == link->serial)
+                break;
+        
+        if (i < w->count)
+            w->items[i].seen = 1;
+        else if ((w->count < w->cap || ndof_watch_grow(w) == 0)
+                 && (fd = fcntl(link->fd, F_DUPFD_CLOEXEC, 0)) >= 0)
+        {
+            NDOF_LinuxWatch *watch = &w->items[w->count++];
+            
+            watch->dev = node->dev;
+            watch->serial = link->serial;
+            watch->fd = fd;
+            watch->eof = 0;
+            watch->seen = 1;
+        }
     }
+    ndof_devlist_exit(&guard);
     
-    */
+    /* gone, replaced or detached */
+    for (i = 0, n = 0; i < w->count; i++)
+    {
+        if (w->items[i].seen)
+            w->items[n++] = w->items[i];
+        else
+            close(w->items[i].fd);
+    }
+    w->count = n;
+}
+
+/* -------------------------------------------------------------------------- 
+    Reads a device polled readable, through its link if still the same. */
+static void ndof_watch_read(NDOF_Context *ctx, NDOF_LinuxWatch *watch)
+{
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    int err;
     
-    return notfound;
+    for (node = ndof_devlist_enter(ctx, &guard); node; node = node->next)
+    {
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_LinuxLink *link = (NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link);
+        
+        if (node->dev != watch->dev || link == NULL 
+            || link->serial != watch->serial)
+            continue;
+        
+        err = ndof_read_link(node->dev, link);
+        if (err < 0)
+            ndof_detach(node->dev, link);
+        else if (err > 0)
+            watch->eof = 1;
+        break;
+    }
+    ndof_devlist_exit(&guard);
+}
+
+/* -------------------------------------------------------------------------- 
+    Looks at the nodes that came or went during a burst. The payloads are
+    the nodes' paths, `ctx' the NDOF_Context. */
+static void ndof_hotplug_apply(void *ctx, const NDOF_HotplugEvent *events,
+                               size_t count)
+{
+    size_t i;
+    
+    for (i = 0; i < count; i++)
+    {
+        const char *path = (const char *) events[i].payload;
+        
+        if (events[i].kind == NDOF_HOTPLUG_REMOVE)
+            ndof_hotplug_removed((NDOF_Context *) ctx, path);
+        else
+            ndof_hotplug_added((NDOF_Context *) ctx, strrchr(path, '/') + 1);
+    }
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_update_status(NDOF_Device *in_dev)
+static void ndof_hotplug_release(void *ctx, void *payload)
 {
-    /*
-    int i;
-    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) in_dev->private_data;
+    (void) ctx;
+    free(payload);
+}
+
+/* -------------------------------------------------------------------------- 
+    FNV-1a of a node's path. */
+static uint64_t ndof_path_id(const char *path)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
     
-    if (priv->dev == NULL)
-        return; // attempting to read status from uninitialized structure
+    while (*path)
+        h = (h ^ (unsigned char) *path++) * 0x100000001b3ULL;
+    return h;
+}
+
+/* -------------------------------------------------------------------------- 
+    Reports the devices attached at startup, as if they were hot-plugged. */
+static void ndof_hotplug_enumerate(NDOF_Context *ctx)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    NDOF_SysfsNode *nodes;
+    int count, i;
+    
+    count = ndof_sysfs_scan(be->root, &nodes);
+    for (i = 0; i < count; i++)
+        if (ndof_linux_accepts(ctx, &nodes[i]))
+            ndof_attach(ctx, &nodes[i]);
+    free(nodes);
+}
+
+/* -------------------------------------------------------------------------- 
+	Purpose:    A node was created in /dev or /dev/input, or its permissions
+                changed: udev sets them up after the node is created.
+*/
+static void ndof_hotplug_added(NDOF_Context *ctx, const char *name)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    NDOF_SysfsNode node;
     
-    for (i = 0; i < in_dev->axes_count; i++)
+    if (ndof_sysfs_node(be->root, name, &node) == 0
+        && ndof_linux_accepts(ctx, &node))
+        ndof_attach(ctx, &node);
+}
+
+/* -------------------------------------------------------------------------- 
+	Purpose:    A node was deleted from /dev or /dev/input.
+    Notes:      Covers Hot Plug Use Case #1.
+*/
+static void ndof_hotplug_removed(NDOF_Context *ctx, const char *path)
+{
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    
+    for (node = ndof_devlist_enter(ctx, &guard); node; node = node->next)
     {
-        // get raw values
-        in_dev->axes[i] = HIDGetElementValue(priv->dev, priv->axesElem[i]);
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_LinuxLink *link = (NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link);
         
-        // get calibrated values
-        //SInt32 valueCal = HIDCalibrateValue(valueRaw, priv->axesElem[i]);
+        if (link && ndof_atomic_load32(&link->attached) 
+            && strcmp(link->node, path) == 0)
+        {
+            ndof_detach(node->dev, link);
+            break;
+        }
     }
+    ndof_devlist_exit(&guard);
+}
 
-    for (i = 0; i < in_dev->btn_count; i++)
+/* -------------------------------------------------------------------------- 
+	Purpose:    Takes a device whose node just appeared.
+    Notes:      Covers Hot Plug Use Cases #2, #3 and #4.
+*/
+static void ndof_attach(NDOF_Context *ctx, const NDOF_SysfsNode *sysnode)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) ctx->backend;
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *head = ndof_devlist_enter(ctx, &guard), *node;
+    NDOF_Device *dev = NULL, *discard = NULL;
+    int in_use = 0;
+    
+    /* already in use through another node */
+    for (node = head; node && !in_use; node = node->next)
     {
-        in_dev->buttons[i] = HIDGetElementValue(priv->dev, priv->btnElem[i]);
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_LinuxLink *link = (NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link);
+        
+        in_use = (link && ndof_atomic_load32(&link->attached)
+                  && ndof_key_equal(&link->key, &sysnode->key));
     }
-    */
+    
+    /* let's see if we were already using the same device (Use Case #2) */
+    for (node = head; node && !dev && !in_use; node = node->next)
+    {
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_DeviceKey key = ndof_link_key((NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link));
+        
+        if (!ndof_stream_is_valid(node->dev) 
+            && !ndof_key_is_null(&key)
+            && NDOF_KEY_MODEL(key) == NDOF_KEY_MODEL(sysnode->key))
+            dev = node->dev;
+    }
+    
+    /* let's see if we were using a device at the same port (Use Case #3) */
+    for (node = head; node && !dev && !in_use; node = node->next)
+    {
+        NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) node->dev->private_data;
+        NDOF_DeviceKey key = ndof_link_key((NDOF_LinuxLink *) 
+            ndof_atomic_loadptr((void **) &priv->link));
+        
+        if (!ndof_stream_is_valid(node->dev) 
+            && !ndof_key_is_null(&key)
+            && NDOF_KEY_LOCATION(key) == NDOF_KEY_LOCATION(sysnode->key))
+            dev = node->dev;
+    }
+    
+    if (in_use)
+        ;
+    else if (dev)
+    {
+        /* not readable yet: retried when its permissions change */
+        if (ndof_open_node(dev, sysnode, NULL) == 0)
+        {
+            fprintf(stderr, "libndofdev: hot-plugged device:\n");
+            if (be->add_callback 
+                && ndof_notify_added(be->add_callback, dev) 
+                   == NDOF_DISCARD_HOTPLUGGED)
+                discard = dev;
+        }
+    }
+    else if (be->add_callback)
+    {
+        /* (Use Case #4) */
+        dev = ndof_context_create_device(ctx);
+        if (dev == NULL)
+            ;
+        else if (ndof_open_node(dev, sysnode, NULL) != 0)
+            discard = dev;
+        else
+        {
+            fprintf(stderr, "libndofdev: hot-plugged device:\n");
+            if (ndof_notify_added(be->add_callback, dev) 
+                == NDOF_DISCARD_HOTPLUGGED)
+                discard = dev;
+        }
+    }
+    ndof_devlist_exit(&guard);
+    
+    /* destroyed once out of the read-side section */
+    if (discard)
+        ndof_destroy(discard);
 }
 
-/* -------------------------------------------------------------------------- */
-void ndof_cleanup_internal()
+/* -------------------------------------------------------------------------- 
+    Disables a device whose node, that of `link', is gone, once whoever 
+    notices it first: ndof_update or the I/O thread. Links replaced since
+    were detached already. The node is closed when the device is 
+    reinitialized or destroyed. */
+static void ndof_detach(NDOF_Device *dev, NDOF_LinuxLink *link)
 {
-    hid_cleanup();
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) dev->context->backend;
+    
+    if (ndof_atomic_cas32(&link->attached, 1, 0))
+    {
+        fprintf(stderr, "libndofdev: removed device:\n");
+        ndof_stream_set_valid(dev, 0);
+        ndof_save_layout(dev, link);
+        if (be && be->removal_callback)
+            ndof_notify_removed(be->removal_callback, dev);
+    }
+}
+
+/* -------------------------------------------------------------------------- 
+    Remembers the plan and calibration of a device being removed, for 
+    ndof_open_node. */
+static void ndof_save_layout(NDOF_Device *dev, const NDOF_LinuxLink *link)
+{
+    NDOF_LinuxBackend *be = (NDOF_LinuxBackend *) dev->context->backend;
+    NDOF_DeviceLayout layout;
+    
+    if (be == NULL)
+        return;
+    
+    memset(&layout, 0, sizeof(layout));
+    layout.axes_count = dev->axes_count;
+    layout.btn_count = dev->btn_count;
+    layout.axes_min = dev->axes_min;
+    layout.axes_max = dev->axes_max;
+    layout.plan = link->plan;
+    memcpy(layout.scale, link->scale, sizeof(layout.scale));
+    memcpy(layout.offset, link->offset, sizeof(layout.offset));
+    ndof_reconnect_store(&be->reconnect, &link->key, &layout);
+}
+
+/* -------------------------------------------------------------------------- 
+    No one reads the device anymore: its link goes with it. */
+static void ndof_linux_dispose(void *p)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) p;
+    
+    if (priv && priv->link)
+        ndof_close_link(priv->link);
+    free(priv);
 }
+
+/* -------------------------------------------------------------------------- 
+    Called in read-side sections of the devices' contexts. */
+static unsigned char ndof_linux_match(void *priv1, void *priv2)
+{
+    NDOF_DevicePrivate *d1 = (NDOF_DevicePrivate*) priv1;
+    NDOF_DevicePrivate *d2 = (NDOF_DevicePrivate*) priv2;
+    NDOF_DeviceKey k1, k2;
+    
+    if (d1 == NULL || d2 == NULL)
+        return 0;
+    
+    k1 = ndof_link_key((NDOF_LinuxLink *) 
+                       ndof_atomic_loadptr((void **) &d1->link));
+    k2 = ndof_link_key((NDOF_LinuxLink *) 
+                       ndof_atomic_loadptr((void **) &d2->link));
+    return (unsigned char) ndof_key_equal(&k1, &k2);
+}
+
+/* -------------------------------------------------------------------------- 
+    The same backend reading the nodes of one kind, or of both: the hidraw
+    node of a device if it can be opened, else its event node. */
+const NDOF_Backend ndof_backend_linux = {
+    "linux", sizeof(NDOF_DevicePrivate), 
+    (1 << NDOF_NODE_HIDRAW) | (1 << NDOF_NODE_EVDEV),
+    ndof_linux_libinit, ndof_linux_stop, ndof_linux_cleanup, 
+    ndof_linux_devcount, ndof_linux_init_first, ndof_linux_update, 
+    ndof_linux_dispose, ndof_linux_match, NULL
+};
+
+const NDOF_Backend ndof_backend_hidraw = {
+    "hidraw", sizeof(NDOF_DevicePrivate), 1 << NDOF_NODE_HIDRAW,
+    ndof_linux_libinit, ndof_linux_stop, ndof_linux_cleanup, 
+    ndof_linux_devcount, ndof_linux_init_first, ndof_linux_update, 
+    ndof_linux_dispose, ndof_linux_match, NULL
+};
+
+const NDOF_Backend ndof_backend_evdev = {
+    "evdev", sizeof(NDOF_DevicePrivate), 1 << NDOF_NODE_EVDEV,
+    ndof_linux_libinit, ndof_linux_stop, ndof_linux_cleanup, 
+    ndof_linux_devcount, ndof_linux_init_first, ndof_linux_update, 
+    ndof_linux_dispose, ndof_linux_match, NULL
+};
@@ -0,0 +1,94 @@
+/*
+ @file ndofdev_mpsc.c
+ @brief Lock-free queue with many producers and a single consumer.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stddef.h>
+#include "ndofdev_mpsc.h"
+
+/*  After D. Vyukov's intrusive MPSC node-based queue: the list runs from
+    tail to head, the stub keeps it from ever being empty so that producers 
+    and the consumer never touch the same pointer.                           */
+
+/* -------------------------------------------------------------------------- */
+void ndof_mpsc_init(NDOF_MpscQueue *q)
+{
+    q->stub.next = NULL;
+    q->head = &q->stub;
+    q->tail = &q->stub;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_mpsc_push(NDOF_MpscQueue *q, NDOF_MpscNode *node)
+{
+    NDOF_MpscNode *prev;
+    
+    ndof_atomic_storeptr((void *volatile *) &node->next, NULL);
+    prev = (NDOF_MpscNode *) ndof_atomic_xchgptr((void *volatile *) &q->head,
+                                                 node);
+    /* the consumer stops at prev until this store */
+    ndof_atomic_storeptr((void *volatile *) &prev->next, node);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_MpscNode *ndof_mpsc_pop(NDOF_MpscQueue *q)
+{
+    NDOF_MpscNode *tail = q->tail;
+    NDOF_MpscNode *next = (NDOF_MpscNode *) 
+        ndof_atomic_loadptr((void *const volatile *) &tail->next);
+    
+    if (tail == &q->stub)
+    {
+        if (next == NULL)
+            return NULL;
+        q->tail = next;
+        tail = next;
+        next = (NDOF_MpscNode *) 
+            ndof_atomic_loadptr((void *const volatile *) &tail->next);
+    }
+    
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+    
+    /* a push is in progress */
+    if (tail != ndof_atomic_loadptr((void *const volatile *) &q->head))
+        return NULL;
+    
+    /* tail is the last node: the stub goes behind it so that it can leave */
+    ndof_mpsc_push(q, &q->stub);
+    next = (NDOF_MpscNode *) 
+        ndof_atomic_loadptr((void *const volatile *) &tail->next);
+    if (next)
+    {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
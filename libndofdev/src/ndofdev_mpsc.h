@@ -0,0 +1,66 @@
+/*
+ @file ndofdev_mpsc.h
+ @brief Lock-free queue with many producers and a single consumer.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_mpsc_h__
+#define __ndofdev_mpsc_h__
+
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  Intrusive: nodes are embedded in the items queued, as their first member.
+    Producers never wait: a push is one exchange. The consumer may see the 
+    queue empty while a push is halfway through, it gets the item at its 
+    next pop.                                                                 */
+
+typedef struct NDOF_MpscNode {
+    struct NDOF_MpscNode *volatile next;
+} NDOF_MpscNode;
+
+typedef struct NDOF_MpscQueue {
+    NDOF_MpscNode *volatile head;   /* last pushed, producers' side */
+    NDOF_MpscNode          *tail;   /* next to pop, consumer's side */
+    NDOF_MpscNode           stub;
+} NDOF_MpscQueue;
+
+void ndof_mpsc_init(NDOF_MpscQueue *q);
+
+/** Any thread. */
+void ndof_mpsc_push(NDOF_MpscQueue *q, NDOF_MpscNode *node);
+
+/** Consumer side, one thread at a time. Oldest node, or NULL. */
+NDOF_MpscNode *ndof_mpsc_pop(NDOF_MpscQueue *q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_mpsc_h__ */
@@ -42,6 +42,9 @@
 #include "ndofdev_external.h"
 #include "ndofdev_internal.h"
 #include "ndofdev_internal_osx.h"
+#include "ndofdev_stream.h"
+#include "ndofdev_quirks.h"
+#include "ndofdev_reconnect.h"
 
 #define _REENTRANT 
 
@@ -53,15 +56,40 @@ static NDOF_DeviceAddCallback		s_add_callback;
 static NDOF_DeviceRemovalCallback	s_removal_callback;
 static dispatch_semaphore_t         s_init_sem = nil;
 static dispatch_queue_t             s_hotplug_queue = nil;
+static NDOF_ReconnectCache          s_reconnect;
+
+/* HID Utilities and the run loop are process wide: one context at a time 
+   owns them, from ndof_osx_libinit to ndof_osx_cleanup. */
+static NDOF_Context *volatile       s_owner = NULL;
 
 /* -------------------------------------------------------------------------- */
 #pragma mark * Function prototypes for local functions
 
-static NDOF_Device *ndof_idsearch(long loc_id);
+static int ndof_osx_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *param, int async);
+static void ndof_osx_stop(NDOF_Context *ctx);
+static void ndof_osx_cleanup(NDOF_Context *ctx);
+static int ndof_osx_devcount(NDOF_Context *ctx);
+static int ndof_osx_init_first(NDOF_Device *dev, void *param);
+static void ndof_osx_update(NDOF_Device *in_dev);
+static void ndof_osx_dispose(void *priv);
+static unsigned char ndof_osx_match(void *priv1, void *priv2);
+static void ndof_osx_dump(FILE *stream, NDOF_Device *dev);
+static NDOF_Device *ndof_idsearch(NDOF_DeviceListNode *node, 
+                                  const NDOF_DeviceKey *key);
 static OSStatus ndof_add_callback(hu_device_t *d);
 static OSStatus ndof_removal_callback(hu_device_t *d);
 static short ndof_isndof(hu_device_t *dev);
 static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev);
+static Boolean ndof_init_known(NDOF_Device *dev, hu_device_t *hiddev,
+                               const NDOF_DeviceQuirks *q);
+static void ndof_init_axis(NDOF_Device *dev, int axis, hu_element_t *elem,
+                           long logical_min, long logical_max);
+static Boolean ndof_init_cached(NDOF_Device *dev, hu_device_t *hiddev,
+                                const NDOF_DeviceLayout *layout);
+static void ndof_save_layout(NDOF_Device *dev);
 static Boolean ndof_equivalent(NDOF_Device *dev1, hu_device_t *hiddev2);
 
 #pragma mark * Function implementations *
@@ -69,16 +97,25 @@ static Boolean ndof_equivalent(NDOF_Device *dev1, hu_device_t *hiddev2);
 /* -------------------------------------------------------------------------- */
 static short ndof_isndof(hu_device_t *dev)
 {   
+    const NDOF_DeviceQuirks *q;
+    
+    if (dev == NULL)
+        return 0;
+    
+    /* known models need no guessing */
+    q = ndof_quirks_lookup(dev->vendorID, dev->productID);
+    if (q)
+        return (q->device_class != NDOF_CLASS_NONE);
+    
     /* see IOKit/hid/IOHIDUsageTables.h */
-    if (dev && 
-        (dev->axis >= 3
-         || (dev->usagePage == kHIDPage_GenericDesktop 
-             && (dev->usage == kHIDUsage_GD_MultiAxisController
-                 || dev->usage == kHIDUsage_GD_GamePad
-                 || dev->usage == kHIDUsage_GD_Joystick))
-         || (dev->usagePage == kHIDPage_Game
-             && (dev->usage == kHIDUsage_Game_3DGameController))
-         || strstr(dev->manufacturer, "3Dconnexion")))
+    if (dev->axis >= 3
+        || (dev->usagePage == kHIDPage_GenericDesktop 
+            && (dev->usage == kHIDUsage_GD_MultiAxisController
+                || dev->usage == kHIDUsage_GD_GamePad
+                || dev->usage == kHIDUsage_GD_Joystick))
+        || (dev->usagePage == kHIDPage_Game
+            && (dev->usage == kHIDUsage_Game_3DGameController))
+        || dev->vendorID == NDOF_VENDOR_3DCONNEXION)
     {
         return 1;
     }
@@ -87,14 +124,14 @@ static short ndof_isndof(hu_device_t *dev)
 }
 
 /* -------------------------------------------------------------------------- */
-static NDOF_Device *ndof_idsearch(long loc_id)
+static NDOF_Device *ndof_idsearch(NDOF_DeviceListNode *node, 
+                                  const NDOF_DeviceKey *key)
 {
-	NDOF_DeviceListNode *node = g_ndof_list_head;
 	while (node)
     {
         if (node->dev && node->dev->private_data &&
-           ((NDOF_DevicePrivate*)node->dev->private_data)->dev &&
-		   ((NDOF_DevicePrivate*)node->dev->private_data)->dev->locID == loc_id)
+            ndof_key_equal(
+                &((NDOF_DevicePrivate*)node->dev->private_data)->curr_key, key))
         {
             break;
         }
@@ -113,11 +150,10 @@ static NDOF_Device *ndof_idsearch(long loc_id)
 /* -------------------------------------------------------------------------- */
 static Boolean ndof_equivalent(NDOF_Device *dev1, hu_device_t *hiddev2)
 {
-    if (dev1 && dev1->private_data)
+    if (dev1 && dev1->private_data && hiddev2)
     {
-        hu_device_t *hiddev1 = ((NDOF_DevicePrivate*)dev1->private_data)->dev;
-        return (hiddev1 && hiddev2 && hiddev1->vendorID == hiddev2->vendorID 
-                && hiddev1->productID == hiddev2->productID);
+        NDOF_DevicePrivate *priv1 = (NDOF_DevicePrivate*)dev1->private_data;
+        return (NDOF_KEY_MODEL(priv1->curr_key) == NDOF_KEY_MODEL(hiddev2->key));
     }
     
     return FALSE;
@@ -128,6 +164,8 @@ static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev)
 {
     NDOF_DevicePrivate *priv;
     hu_element_t *elem = NULL;
+    const NDOF_DeviceQuirks *q;
+    NDOF_DeviceLayout layout;
     long axes_cnt = 0, btn_cnt = 0;
     size_t lenm, lenp;
     
@@ -139,9 +177,24 @@ static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev)
     strncpy(dev->product, hiddev->product, lenp + 1);
     priv = (NDOF_DevicePrivate*) dev->private_data;
     priv->dev = hiddev;
-    priv->curr_loc_id = hiddev->locID;
-    priv->curr_vendor_id = hiddev->vendorID;
-    priv->curr_product_id = hiddev->productID;
+    priv->curr_key = hiddev->key;
+    ndof_stream_identify(dev, &hiddev->key);
+    
+    // replugged devices: resume with the elements and calibration they had
+    if (ndof_reconnect_take(&s_reconnect, &hiddev->key, &layout)
+        && ndof_init_cached(dev, hiddev, &layout))
+    {
+        ndof_stream_set_valid(dev, 1);
+        return;
+    }
+    
+    // known models: the elements are found by usage, with their true range
+    q = ndof_quirks_lookup(hiddev->vendorID, hiddev->productID);
+    if (q && ndof_init_known(dev, hiddev, q))
+    {
+        ndof_stream_set_valid(dev, 1);
+        return;
+    }
         
     // save all elements info relative to axes and buttons into the
     // 'priv' space (to avoid searching them each time we need them)
@@ -165,16 +218,7 @@ static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev)
                         || elem->usage == kHIDUsage_GD_Ry
                         || elem->usage == kHIDUsage_GD_Rz))))
         {
-            priv->hid_axes[axes_cnt] = elem;
-            
-            /*  y_min = offset + scale*x_min; 
-            y_max = offset + scale*x_max */
-            priv->scale[axes_cnt] = (float) 
-                (dev->axes_max - dev->axes_min) / 
-                (elem->max - elem->min);
-            priv->offset[axes_cnt] = 
-                dev->axes_min - priv->scale[axes_cnt] * elem->min;
-            
+            ndof_init_axis(dev, axes_cnt, elem, elem->min, elem->max);
             axes_cnt++;
         } 
         else if (elem->type == kIOHIDElementTypeInput_Button
@@ -188,7 +232,164 @@ static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev)
     
     dev->axes_count = axes_cnt;
     dev->btn_count  = btn_cnt;
-    dev->valid = 1;
+    ndof_stream_set_valid(dev, 1);
+}
+
+/* -------------------------------------------------------------------------- 
+    Maps the elements of a model of the quirks database by their usage, 
+    without classifying them. Returns FALSE if the device does not have the
+    expected axes, in which case the generic classification applies.
+*/
+static Boolean ndof_init_known(NDOF_Device *dev, hu_device_t *hiddev,
+                               const NDOF_DeviceQuirks *q)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) dev->private_data;
+    hu_element_t *elem;
+    long axes_cnt = 0, btn_cnt = 0;
+    
+    memset(priv->hid_axes, 0, sizeof(priv->hid_axes));
+    memset(priv->hid_btn, 0, sizeof(priv->hid_btn));
+    
+    for (elem = HIDGetFirstDeviceElement(hiddev, kHIDElementTypeInput); elem;
+         elem = HIDGetNextDeviceElement(elem, kHIDElementTypeInput))
+    {
+        if (elem->usagePage == kHIDPage_GenericDesktop
+            && elem->usage >= kHIDUsage_GD_X && elem->usage <= kHIDUsage_GD_Rz)
+        {
+            int axis = q->axis_map[elem->usage - kHIDUsage_GD_X];
+            if (axis >= 0 && axis < q->axes_count 
+                && priv->hid_axes[axis] == NULL)
+            {
+                if (q->logical_max > q->logical_min)
+                    ndof_init_axis(dev, axis, elem, 
+                                   q->logical_min, q->logical_max);
+                else
+                    ndof_init_axis(dev, axis, elem, elem->min, elem->max);
+                axes_cnt++;
+            }
+        }
+        else if (elem->usagePage == kHIDPage_Button 
+                 && elem->usage >= 1 && elem->usage <= q->btn_count)
+        {
+            priv->hid_btn[elem->usage - 1] = elem;
+        }
+    }
+    
+    if (axes_cnt != q->axes_count)
+        return FALSE;
+    
+    // ndof_update reads buttons 0 to btn_count - 1
+    while (btn_cnt < q->btn_count && priv->hid_btn[btn_cnt])
+        btn_cnt++;
+    
+    dev->axes_count = axes_cnt;
+    dev->btn_count  = btn_cnt;
+    return TRUE;
+}
+
+/* -------------------------------------------------------------------------- 
+    Scales the element's [logical_min, logical_max] to the device's range. */
+static void ndof_init_axis(NDOF_Device *dev, int axis, hu_element_t *elem,
+                           long logical_min, long logical_max)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) dev->private_data;
+    
+    priv->hid_axes[axis] = elem;
+    
+    /*  y_min = offset + scale*x_min; 
+        y_max = offset + scale*x_max */
+    priv->scale[axis] = (float) 
+        (dev->axes_max - dev->axes_min) / (logical_max - logical_min);
+    priv->offset[axis] = dev->axes_min - priv->scale[axis] * logical_min;
+}
+
+/* -------------------------------------------------------------------------- 
+    Maps the elements of a replugged device by the cookies they had, and 
+    restores their calibration. Returns FALSE if the layout does not apply,
+    e.g. if the client changed the range of the axes in the meantime.
+*/
+static Boolean ndof_init_cached(NDOF_Device *dev, hu_device_t *hiddev,
+                                const NDOF_DeviceLayout *layout)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) dev->private_data;
+    hu_element_t *elem;
+    long found = 0;
+    int i;
+    
+    if (dev->axes_min != layout->axes_min || dev->axes_max != layout->axes_max)
+        return FALSE;
+    
+    memset(priv->hid_axes, 0, sizeof(priv->hid_axes));
+    memset(priv->hid_btn, 0, sizeof(priv->hid_btn));
+    
+    for (elem = HIDGetFirstDeviceElement(hiddev, kHIDElementTypeInput); elem;
+         elem = HIDGetNextDeviceElement(elem, kHIDElementTypeInput))
+    {
+        uintptr_t id = (uintptr_t) elem->cookie;
+        
+        for (i = 0; i < layout->axes_count; i++)
+        {
+            if (layout->axis_ids[i] == id && priv->hid_axes[i] == NULL)
+            {
+                priv->hid_axes[i] = elem;
+                elem->minReport = layout->min_report[i];
+                elem->maxReport = layout->max_report[i];
+                found++;
+            }
+        }
+        for (i = 0; i < layout->btn_count; i++)
+        {
+            if (layout->btn_ids[i] == id && priv->hid_btn[i] == NULL)
+            {
+                priv->hid_btn[i] = elem;
+                found++;
+            }
+        }
+    }
+    
+    if (found != layout->axes_count + layout->btn_count)
+        return FALSE;
+    
+    memcpy(priv->scale, layout->scale, sizeof(priv->scale));
+    memcpy(priv->offset, layout->offset, sizeof(priv->offset));
+    dev->axes_count = layout->axes_count;
+    dev->btn_count  = layout->btn_count;
+    return TRUE;
+}
+
+/* -------------------------------------------------------------------------- 
+    Remembers the elements and calibration of a device being removed, 
+    for ndof_init_cached. */
+static void ndof_save_layout(NDOF_Device *dev)
+{
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*) dev->private_data;
+    NDOF_DeviceLayout layout;
+    int i;
+    
+    memset(&layout, 0, sizeof(layout));
+    layout.axes_count = dev->axes_count;
+    layout.btn_count = (dev->btn_count > 0 ? dev->btn_count : 0);
+    layout.axes_min = dev->axes_min;
+    layout.axes_max = dev->axes_max;
+    
+    for (i = 0; i < layout.axes_count; i++)
+    {
+        if (priv->hid_axes[i] == NULL)
+            return;
+        layout.axis_ids[i] = (uintptr_t) priv->hid_axes[i]->cookie;
+        layout.min_report[i] = priv->hid_axes[i]->minReport;
+        layout.max_report[i] = priv->hid_axes[i]->maxReport;
+    }
+    for (i = 0; i < layout.btn_count; i++)
+    {
+        if (priv->hid_btn[i] == NULL)
+            return;
+        layout.btn_ids[i] = (uintptr_t) priv->hid_btn[i]->cookie;
+    }
+    memcpy(layout.scale, priv->scale, sizeof(layout.scale));
+    memcpy(layout.offset, priv->offset, sizeof(layout.offset));
+    
+    ndof_reconnect_store(&s_reconnect, &priv->curr_key, &layout);
 }
 
 /* -------------------------------------------------------------------------- 
@@ -197,7 +398,7 @@ static void ndof_init(NDOF_Device *dev, hu_device_t *hiddev)
 	devices found on the USB bus. It actually works here, but it's
 	unlikely it will be developed on other platforms.
 */
-int ndof_init_first(NDOF_Device *dev, void *param)
+static int ndof_osx_init_first(NDOF_Device *dev, void *param)
 {
     int notfound = -1;
     hu_device_t *d = HIDGetFirstDevice();
@@ -243,7 +444,7 @@ int ndof_init_first(NDOF_Device *dev, void *param)
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_update(NDOF_Device *in_dev)
+static void ndof_osx_update(NDOF_Device *in_dev)
 {
     int i;
     static Boolean log_error_flag = TRUE; 
@@ -257,7 +458,7 @@ void ndof_update(NDOF_Device *in_dev)
         return; // attempting to read status from uninitialized structure
     }
     
-    if (in_dev->valid == 0)
+    if (!ndof_stream_is_valid(in_dev))
     {
         if (log_error_flag)
             fprintf(stderr, "libndofdev: unable to read input (invalid structure)\n");
@@ -279,6 +480,8 @@ void ndof_update(NDOF_Device *in_dev)
         in_dev->buttons[i] = HIDGetElementValue(priv->dev, priv->hid_btn[i]);
     }
     
+    ndof_stream_publish(in_dev);
+    
 #ifdef NDOF_DEBUG
     if (in_dev->axes[0] || in_dev->axes[1] || in_dev->axes[2] 
         || in_dev->axes[3] || in_dev->axes[4] || in_dev->axes[5]
@@ -294,7 +497,7 @@ void ndof_update(NDOF_Device *in_dev)
 }
 
 /* -------------------------------------------------------------------------- */
-int ndof_devcount()
+static int ndof_osx_devcount(NDOF_Context *ctx)
 {
     int num = 0;
     hu_device_t *dev = HIDGetFirstDevice();
@@ -311,25 +514,53 @@ int ndof_devcount()
 }
 
 /* -------------------------------------------------------------------------- */
-unsigned char ndof_match_private(NDOF_DevicePrivate *dev1, 
-								 NDOF_DevicePrivate *dev2)
+static unsigned char ndof_osx_match(void *priv1, void *priv2)
+{
+    NDOF_DevicePrivate *dev1 = (NDOF_DevicePrivate*) priv1;
+    NDOF_DevicePrivate *dev2 = (NDOF_DevicePrivate*) priv2;
+    
+    return (dev1 && dev2 && ndof_key_equal(&dev1->curr_key, &dev2->curr_key));
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_osx_dump(FILE *stream, NDOF_Device *dev)
 {
-    return (dev1 && dev2 && dev1->curr_loc_id == dev2->curr_loc_id 
-            && dev1->curr_product_id == dev2->curr_product_id
-            && dev1->curr_vendor_id == dev2->curr_product_id);
+    int i;
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*)dev->private_data;
+    fprintf(stream, "    curr_loc_id=%08lX\n", 
+            (unsigned long) NDOF_KEY_LOCATION(priv->curr_key));
+    
+    fprintf(stream, "    scales:  [");
+    for (i=0; i<NDOF_MAX_AXES_COUNT; i++)
+         fprintf(stream, "%f ", priv->scale[i]);
+    
+    fprintf(stream, "]\n    offsets: [");
+    for (i=0; i<NDOF_MAX_AXES_COUNT; i++)
+        fprintf(stream, "%f ", priv->offset[i]);
+
+    fprintf(stream, "]\n");
 }
 
 #pragma mark * Library initialization and cleanup *
 
 /* -------------------------------------------------------------------------- */
-int ndof_libinit(NDOF_DeviceAddCallback in_add_cb, 
-				 NDOF_DeviceRemovalCallback in_removal_cb,
-				 void *param)
+static int ndof_osx_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *param, int async)
 {
+    if (!ndof_atomic_casptr((void *volatile *) &s_owner, NULL, ctx))
+    {
+        fprintf(stderr, "libndofdev: already initialized by another "
+                "context.\n");
+        return -1;
+    }
+    
 	fprintf(stderr, "libndofdev: initializing...\n");
 
     s_add_callback = in_add_cb;
 	s_removal_callback = in_removal_cb;
+    ndof_reconnect_init(&s_reconnect);
     
     // setup dispatch serial queue
     // creating a semaphore with count 0 causes wait() to block until signal()
@@ -339,11 +570,16 @@ int ndof_libinit(NDOF_DeviceAddCallback in_add_cb,
     // initialize the hotplug loop
     dispatch_async(s_hotplug_queue, ^{
         HIDSetHotPlugCallback(ndof_add_callback, ndof_removal_callback);
+        
+        /* asynchronous clients learn about each device as it is built */
+        HIDSetHotPlugInitialDevices(async ? TRUE : FALSE);
         HIDBuildDeviceList(0, 0);
+        HIDSetHotPlugInitialDevices(FALSE);
         s_runloop = CFRunLoopGetCurrent();
         
         /* signal father that we are about to start the runloop */
         fprintf(stderr, "libndofdev: starting runloop...\n");
+        ndof_init_done(ctx, 0);
         dispatch_semaphore_signal(s_init_sem);
         
         /* Start the run loop. Now we'll receive hotplugging notifications. */
@@ -353,6 +589,9 @@ int ndof_libinit(NDOF_DeviceAddCallback in_add_cb,
         HIDReleaseDeviceList();
     });
 
+    if (async)
+        return 0;
+    
     // block until the other thread has completed initialization
     dispatch_semaphore_wait(
         s_init_sem,
@@ -363,9 +602,19 @@ int ndof_libinit(NDOF_DeviceAddCallback in_add_cb,
     return 0;
 }
 
+/* -------------------------------------------------------------------------- 
+    Notifications are handled on the client's run loop, never concurrently
+    with ndof_libcleanup. */
+static void ndof_osx_stop(NDOF_Context *ctx)
+{
+}
+
 /* -------------------------------------------------------------------------- */
-void ndof_cleanup_internal()
+static void ndof_osx_cleanup(NDOF_Context *ctx)
 {
+    if (ndof_atomic_loadptr((void *const volatile *) &s_owner) != ctx)
+        return;
+    
 	if (s_runloop)
 	{
 		fprintf(stderr, "libndofdev: stopping runloop\n");
@@ -373,10 +622,12 @@ void ndof_cleanup_internal()
 	}
     
     dispatch_release(s_init_sem);
+    ndof_reconnect_dispose(&s_reconnect);
+    ndof_atomic_storeptr((void *volatile *) &s_owner, NULL);
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_dev_private_dispose(NDOF_DevicePrivate *priv)
+static void ndof_osx_dispose(void *priv)
 {
     if (priv) {
         free(priv);
@@ -407,7 +658,9 @@ void ndof_dev_private_dispose(NDOF_DevicePrivate *priv)
 */
 static OSStatus ndof_add_callback(hu_device_t *in_dev)
 {
-    NDOF_DeviceListNode *node;
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *head, *node;
+    NDOF_Device *discard = NULL;
     Boolean found = FALSE;
     
 	fprintf(stderr, "libndofdev: hot-plugged device:\n");
@@ -416,11 +669,11 @@ static OSStatus ndof_add_callback(hu_device_t *in_dev)
     // device list should be okay. No need to refresh it.
 	
     /* let's see if we were already using the same device (Use Case #2) */
-    node = g_ndof_list_head;
+    node = head = ndof_devlist_enter(s_owner, &guard);
 	while (node)
 	{
         if (node->dev
-            && !node->dev->valid /* nothing to change for a valid device */
+            && !ndof_stream_is_valid(node->dev) /* nothing to change for a valid device */
             && ndof_equivalent(node->dev, in_dev)) 
         {
             found = TRUE;
@@ -435,13 +688,14 @@ static OSStatus ndof_add_callback(hu_device_t *in_dev)
     if (!found)
     {
         /* let's see if we were usinga device at the same port (Use Case #3) */
-        node = g_ndof_list_head;
+        node = head;
         while (node)
         {
             if (node->dev
-                && !node->dev->valid /* nothing to change for a valid device */
-                && ((NDOF_DevicePrivate*)node->dev->private_data)->curr_loc_id 
-                    == in_dev->locID)
+                && !ndof_stream_is_valid(node->dev) /* nothing to change for a valid device */
+                && NDOF_KEY_LOCATION(
+                       ((NDOF_DevicePrivate*)node->dev->private_data)->curr_key)
+                    == NDOF_KEY_LOCATION(in_dev->key))
             {
                 found = TRUE;
                 break;
@@ -457,9 +711,10 @@ static OSStatus ndof_add_callback(hu_device_t *in_dev)
     {
         ndof_init(node->dev, in_dev);
         if (s_add_callback
-            && s_add_callback(node->dev) == NDOF_DISCARD_HOTPLUGGED)
+            && ndof_notify_added(s_add_callback, node->dev) 
+               == NDOF_DISCARD_HOTPLUGGED)
         {
-            ndof_destroy(node->dev);
+            discard = node->dev;
         }
     }
     else
@@ -470,17 +725,25 @@ static OSStatus ndof_add_callback(hu_device_t *in_dev)
             NDOF_Device *new_device;
             
             /* create new device ... */
-            new_device = ndof_create();
-            ndof_init(new_device, in_dev);
+            new_device = ndof_context_create_device(s_owner);
+            if (new_device)
+                ndof_init(new_device, in_dev);
             
             /* ...get client interest in new device and eventually clip it */
-            if (s_add_callback(new_device) == NDOF_DISCARD_HOTPLUGGED)
-                ndof_destroy(new_device);
+            if (new_device
+                && ndof_notify_added(s_add_callback, new_device) 
+                == NDOF_DISCARD_HOTPLUGGED)
+                discard = new_device;
         }
     }
+    ndof_devlist_exit(&guard);
+    
+    /* destroyed once out of the read-side section */
+    if (discard)
+        ndof_destroy(discard);
 
 #ifdef NDOF_DEBUG
-    ndof_dump_list(NDOF_DEBUG);
+    ndof_context_dump_list(s_owner, NDOF_DEBUG);
 #if 0
 	hu_device_t *d = HIDGetFirstDevice();
 	fprintf(NDOF_DEBUG, "libndofdev: new device list:\n");
@@ -508,18 +771,30 @@ static OSStatus ndof_add_callback(hu_device_t *in_dev)
 */
 static OSStatus ndof_removal_callback(hu_device_t *removed_dev)
 {
+    NDOF_EpochGuard guard;
     NDOF_Device *ndof_dev;
     
 	fprintf(stderr, "libndofdev: removed device:\n");
     
     /* verify it's actually a device we care about */
-    ndof_dev = ndof_idsearch(removed_dev->locID);
+    ndof_dev = ndof_idsearch(ndof_devlist_enter(s_owner, &guard), 
+                             &removed_dev->key);
     if (ndof_dev)
     {
-        ndof_dev->valid = 0;
+        ndof_save_layout(ndof_dev);
+        ndof_stream_set_valid(ndof_dev, 0);
         if (s_removal_callback)
-            s_removal_callback(ndof_dev);
+            ndof_notify_removed(s_removal_callback, ndof_dev);
     }
+    ndof_devlist_exit(&guard);
         
 	return 0;
 }
+
+/* -------------------------------------------------------------------------- */
+const NDOF_Backend ndof_backend_osx = {
+    "osx", sizeof(NDOF_DevicePrivate), 0,
+    ndof_osx_libinit, ndof_osx_stop, ndof_osx_cleanup, ndof_osx_devcount,
+    ndof_osx_init_first, ndof_osx_update, ndof_osx_dispose, ndof_osx_match,
+    ndof_osx_dump
+};
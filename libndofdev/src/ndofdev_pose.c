@@ -0,0 +1,205 @@
+/*
+ @file ndofdev_pose.c
+ @brief Integration of the samples into a pose, see ndof_pose_configure.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "ndofdev_external.h"
+#include "ndofdev_stream.h"
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static void ndof_pose_advance(NDOF_PoseIntegrator *p, uint64_t to_ns);
+static void ndof_quat_rotate(const double q[4], const double v[3], double out[3]);
+
+/* -------------------------------------------------------------------------- */
+void ndof_pose_init(NDOF_PoseIntegrator *p)
+{
+    memset(p, 0, sizeof(NDOF_PoseIntegrator));
+    ndof_mutex_init(&p->lock);
+    p->delta.orientation[0] = 1.0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_pose_dispose(NDOF_PoseIntegrator *p)
+{
+    ndof_mutex_destroy(&p->lock);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_pose_integrate(NDOF_PoseIntegrator *p, const NDOF_Sample *sample)
+{
+    int i, j;
+    
+    /* the common case of a disabled integrator costs no lock */
+    if (!ndof_atomic_load32(&p->enabled))
+        return;
+    
+    ndof_mutex_lock(&p->lock);
+    if (p->enabled)
+    {
+        if (p->until_ns)
+            ndof_pose_advance(p, sample->time_ns);
+        
+        /* a fetch may have integrated past this sample already, up to a 
+           future frame time or as samples come late: not a second time */
+        if (sample->time_ns > p->until_ns)
+            p->until_ns = sample->time_ns;
+        p->sample_ns = sample->time_ns;
+        p->delta.samples++;
+        
+        /* scaled, then expressed in the application frame */
+        for (j = 0; j < 6; j += 3)
+        {
+            double v[3];
+            for (i = 0; i < 3; i++)
+                v[i] = p->config.gains[j + i] * (double) sample->axes[j + i];
+            for (i = 0; i < 3; i++)
+            {
+                p->velocity[j + i] = p->config.frame[i][0] * v[0]
+                                   + p->config.frame[i][1] * v[1]
+                                   + p->config.frame[i][2] * v[2];
+            }
+        }
+    }
+    ndof_mutex_unlock(&p->lock);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_pose_configure(NDOF_Device *dev, const NDOF_PoseConfig *config)
+{
+    NDOF_PoseIntegrator *p;
+    
+    if (dev == NULL || dev->stream_data == NULL)
+        return -1;
+    
+    p = &((NDOF_DeviceStream *) dev->stream_data)->pose;
+    ndof_mutex_lock(&p->lock);
+    if (config)
+        p->config = *config;
+    memset(p->velocity, 0, sizeof(p->velocity));
+    memset(&p->delta, 0, sizeof(p->delta));
+    p->delta.orientation[0] = 1.0;
+    p->until_ns = 0;
+    ndof_atomic_store32(&p->enabled, config != NULL);
+    ndof_mutex_unlock(&p->lock);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_pose_fetch(NDOF_Device *dev, uint64_t now_ns, NDOF_PoseDelta *out)
+{
+    NDOF_PoseIntegrator *p;
+    
+    if (dev == NULL || dev->stream_data == NULL || out == NULL)
+        return -1;
+    
+    p = &((NDOF_DeviceStream *) dev->stream_data)->pose;
+    ndof_mutex_lock(&p->lock);
+    if (!p->enabled)
+    {
+        ndof_mutex_unlock(&p->lock);
+        return -1;
+    }
+    
+    /* the latest velocity still holds until now */
+    if (p->until_ns && now_ns > p->until_ns)
+    {
+        ndof_pose_advance(p, now_ns);
+        p->until_ns = now_ns;
+    }
+    
+    *out = p->delta;
+    memset(&p->delta, 0, sizeof(p->delta));
+    p->delta.orientation[0] = 1.0;
+    ndof_mutex_unlock(&p->lock);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Moves the pose from until_ns to to_ns at the held velocity, but not 
+    further than NDOF_POSE_MAX_HOLD_NS past the latest sample. Both the 
+    translation and the rotation are in the frame of the moving pose, so
+    the translation uses the orientation reached at the start of the step.
+*/
+static void ndof_pose_advance(NDOF_PoseIntegrator *p, uint64_t to_ns)
+{
+    int i;
+    double dt, move[3], step[3], angle;
+    double *q = p->delta.orientation;
+    
+    if (to_ns > p->sample_ns + NDOF_POSE_MAX_HOLD_NS)
+        to_ns = p->sample_ns + NDOF_POSE_MAX_HOLD_NS;
+    if (to_ns <= p->until_ns)
+        return;
+    dt = (double)(to_ns - p->until_ns) * 1e-9;
+    p->delta.duration_ns += to_ns - p->until_ns;
+    
+    for (i = 0; i < 3; i++)
+        move[i] = p->velocity[i] * dt;
+    ndof_quat_rotate(q, move, step);
+    for (i = 0; i < 3; i++)
+        p->delta.position[i] += step[i];
+    
+    /* exact rotation by the rotation vector velocity * dt */
+    for (i = 0; i < 3; i++)
+        step[i] = p->velocity[3 + i] * dt;
+    angle = sqrt(step[0] * step[0] + step[1] * step[1] + step[2] * step[2]);
+    if (angle > 0.0)
+    {
+        double s = sin(0.5 * angle) / angle, c = cos(0.5 * angle);
+        double r[4], n;
+        double x = step[0] * s, y = step[1] * s, z = step[2] * s;
+        
+        r[0] = q[0] * c - q[1] * x - q[2] * y - q[3] * z;
+        r[1] = q[0] * x + q[1] * c + q[2] * z - q[3] * y;
+        r[2] = q[0] * y - q[1] * z + q[2] * c + q[3] * x;
+        r[3] = q[0] * z + q[1] * y - q[2] * x + q[3] * c;
+        
+        /* keep it a unit quaternion over many steps */
+        n = sqrt(r[0] * r[0] + r[1] * r[1] + r[2] * r[2] + r[3] * r[3]);
+        for (i = 0; i < 4; i++)
+            q[i] = r[i] / n;
+    }
+}
+
+/* -------------------------------------------------------------------------- 
+    out = q v q*, for a unit quaternion q = (w, x, y, z). */
+static void ndof_quat_rotate(const double q[4], const double v[3], double out[3])
+{
+    /* t = 2 (q.xyz x v); out = v + w t + q.xyz x t */
+    double t[3];
+    t[0] = 2.0 * (q[2] * v[2] - q[3] * v[1]);
+    t[1] = 2.0 * (q[3] * v[0] - q[1] * v[2]);
+    t[2] = 2.0 * (q[1] * v[1] - q[2] * v[0]);
+    out[0] = v[0] + q[0] * t[0] + (q[2] * t[2] - q[3] * t[1]);
+    out[1] = v[1] + q[0] * t[1] + (q[3] * t[0] - q[1] * t[2]);
+    out[2] = v[2] + q[0] * t[2] + (q[1] * t[1] - q[2] * t[0]);
+}
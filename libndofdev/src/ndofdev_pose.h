@@ -0,0 +1,67 @@
+/*
+ @file ndofdev_pose.h
+ @brief Integration of the samples into a pose, see ndof_pose_configure.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_pose_h__
+#define __ndofdev_pose_h__
+
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* longest time a sample's velocity is held without a newer sample */
+#define NDOF_POSE_MAX_HOLD_NS  100000000ULL
+
+/** Pose accumulator of a device. Samples are integrated by the publishing
+ *  thread and the delta fetched by the application, under `lock'. */
+typedef struct NDOF_PoseIntegrator {
+    ndof_mutex_t lock;
+    volatile uint32_t enabled;
+    NDOF_PoseConfig config;
+    
+    double velocity[6];     /* of the latest sample, in the application frame */
+    uint64_t sample_ns;     /* time of the latest sample */
+    uint64_t until_ns;      /* time integrated so far, 0 before any sample */
+    NDOF_PoseDelta delta;
+} NDOF_PoseIntegrator;
+
+void ndof_pose_init(NDOF_PoseIntegrator *p);
+void ndof_pose_dispose(NDOF_PoseIntegrator *p);
+
+/** Integrates the previous sample's velocity up to this one's time, then 
+ *  holds this sample's velocity. Called by ndof_stream_publish. */
+void ndof_pose_integrate(NDOF_PoseIntegrator *p, const NDOF_Sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_pose_h__ */
@@ -0,0 +1,133 @@
+/*
+ @file ndofdev_predict.c
+ @brief Short horizon motion model of the axes, for ndof_predict.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "ndofdev_external.h"
+#include "ndofdev_stream.h"
+
+/*  Gains of the tracker: how much of the residual between a sample and the
+    prediction goes into the position, velocity and acceleration estimates.
+    Within the stability region (0 < beta < 4 - 2 alpha, 
+    0 < gamma < 4 alpha beta / (2 - alpha)), favoring a quick response over
+    noise rejection since the device reports are not noisy.                  */
+#define NDOF_PREDICT_ALPHA  0.5
+#define NDOF_PREDICT_BETA   0.3
+#define NDOF_PREDICT_GAMMA  0.05
+
+/* shortest interval used to derive rates, reports may come in bursts */
+#define NDOF_PREDICT_MIN_DT 0.0001
+
+/* -------------------------------------------------------------------------- */
+void ndof_predictor_update(NDOF_Predictor *p, const NDOF_Sample *sample)
+{
+    int i;
+    NDOF_PredictModel *m = &p->current;
+    
+    if (m->seq == 0 || sample->time_ns < m->time_ns
+        || sample->time_ns - m->time_ns > NDOF_PREDICT_RESET_NS)
+    {
+        /* first sample, or the device was idle: start from rest */
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        {
+            m->x[i] = (double) sample->axes[i];
+            m->v[i] = 0.0;
+            m->a[i] = 0.0;
+        }
+    }
+    else
+    {
+        double dt = (double)(sample->time_ns - m->time_ns) * 1e-9;
+        if (dt < NDOF_PREDICT_MIN_DT)
+            dt = NDOF_PREDICT_MIN_DT;
+        
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        {
+            double xp = m->x[i] + m->v[i] * dt + 0.5 * m->a[i] * dt * dt;
+            double vp = m->v[i] + m->a[i] * dt;
+            double r = (double) sample->axes[i] - xp;
+            
+            m->x[i] = xp + NDOF_PREDICT_ALPHA * r;
+            m->v[i] = vp + NDOF_PREDICT_BETA * r / dt;
+            m->a[i] += 2.0 * NDOF_PREDICT_GAMMA * r / (dt * dt);
+        }
+    }
+    
+    m->seq = sample->seq;
+    m->time_ns = sample->time_ns;
+    m->buttons = sample->buttons;
+    ndof_seqlock_write(&p->lock, p->model, m, sizeof(NDOF_PredictModel));
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_predict(NDOF_Device *dev, uint64_t target_time_ns, NDOF_State *out)
+{
+    int i;
+    double dt;
+    NDOF_PredictModel m;
+    NDOF_DeviceStream *s;
+    
+    if (dev == NULL || dev->stream_data == NULL || out == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    ndof_seqlock_read(&s->predictor.lock, s->predictor.model, &m, 
+                      sizeof(NDOF_PredictModel));
+    
+    /* no extrapolation backwards, nor further than the model is good for */
+    dt = 0.0;
+    if (target_time_ns > m.time_ns)
+    {
+        uint64_t ahead = target_time_ns - m.time_ns;
+        if (ahead > NDOF_PREDICT_MAX_HORIZON_NS)
+            ahead = NDOF_PREDICT_MAX_HORIZON_NS;
+        dt = (double) ahead * 1e-9;
+    }
+    
+    memset(out, 0, sizeof(NDOF_State));
+    out->seq = m.seq;
+    out->time_ns = target_time_ns;
+    out->buttons = m.buttons;
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        double v = m.x[i] + m.v[i] * dt + 0.5 * m.a[i] * dt * dt;
+        
+        if (dev->axes_max > dev->axes_min)
+        {
+            if (v > (double) dev->axes_max)
+                v = (double) dev->axes_max;
+            else if (v < (double) dev->axes_min)
+                v = (double) dev->axes_min;
+        }
+        out->axes[i] = (long) floor(v + 0.5);
+    }
+    out->valid = ndof_stream_is_valid(dev);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*
+ @file ndofdev_predict.h
+ @brief Short horizon motion model of the axes, for ndof_predict.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_predict_h__
+#define __ndofdev_predict_h__
+
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_PREDICT_MAX_HORIZON_NS  50000000ULL  /* never extrapolate further */
+#define NDOF_PREDICT_RESET_NS       100000000ULL  /* input gap restarting the model */
+
+/** Position, velocity and acceleration of every axis at time_ns, in axis 
+ *  units and seconds. */
+typedef struct NDOF_PredictModel {
+    uint64_t seq;           /* sample the model was last updated with */
+    uint64_t time_ns;
+    double x[NDOF_MAX_AXES_COUNT];
+    double v[NDOF_MAX_AXES_COUNT];
+    double a[NDOF_MAX_AXES_COUNT];
+    unsigned long buttons;
+} NDOF_PredictModel;
+
+/** Alpha-beta-gamma tracker of the axes. The model is updated by the thread 
+ *  publishing the samples and read by ndof_predict through a seqlock. */
+typedef struct NDOF_Predictor {
+    NDOF_PredictModel current;  /* private to the publishing thread */
+    NDOF_SeqLock lock;
+    ndof_word_t  model[NDOF_WORD_COUNT(sizeof(NDOF_PredictModel))];
+} NDOF_Predictor;
+
+/** Corrects the model with a new sample; O(1). */
+void ndof_predictor_update(NDOF_Predictor *p, const NDOF_Sample *sample);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_predict_h__ */
@@ -0,0 +1,88 @@
+/*
+ @file ndofdev_probe.c
+ @brief Bounded pool of threads probing devices in parallel.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include "ndofdev_external.h"
+#include "ndofdev_probe.h"
+#include "ndofdev_sync.h"
+
+typedef struct NDOF_ProbeBatch {
+    NDOF_ProbeFn      probe;
+    void             *ctx;
+    void *const      *items;
+    void            **results;
+    size_t            count;
+    volatile uint32_t next;     /* next item to probe, plus 1 */
+} NDOF_ProbeBatch;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static void ndof_probe_worker(void *arg);
+
+/* -------------------------------------------------------------------------- */
+void ndof_probe_all(NDOF_ProbeFn probe, void *ctx, void *const *items, 
+                    void **results, size_t count, int max_workers)
+{
+    NDOF_ProbeBatch batch;
+    ndof_thread_t threads[NDOF_PROBE_MAX_WORKERS];
+    int started = 0, i;
+    
+    if (max_workers <= 0 || max_workers > NDOF_PROBE_MAX_WORKERS)
+        max_workers = NDOF_PROBE_MAX_WORKERS;
+    if ((size_t) max_workers > count)
+        max_workers = (int) count;
+    
+    batch.probe = probe;
+    batch.ctx = ctx;
+    batch.items = items;
+    batch.results = results;
+    batch.count = count;
+    batch.next = 0;
+    
+    for (i = 1; i < max_workers; i++)
+        if (ndof_thread_create(&threads[started], ndof_probe_worker, 
+                               &batch) == 0)
+            started++;
+    
+    ndof_probe_worker(&batch);
+    for (i = 0; i < started; i++)
+        ndof_thread_join(threads[i]);
+}
+
+/* -------------------------------------------------------------------------- 
+    Takes items until there are none left. */
+static void ndof_probe_worker(void *arg)
+{
+    NDOF_ProbeBatch *batch = (NDOF_ProbeBatch *) arg;
+    size_t i;
+    
+    while ((i = ndof_atomic_add32(&batch->next, 1) - 1) < batch->count)
+        batch->results[i] = batch->probe(batch->ctx, batch->items[i]);
+}
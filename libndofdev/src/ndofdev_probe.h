@@ -0,0 +1,62 @@
+/*
+ @file ndofdev_probe.h
+ @brief Bounded pool of threads probing devices in parallel.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_probe_h__
+#define __ndofdev_probe_h__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_PROBE_MAX_WORKERS  8   /* threads, the caller's included */
+
+/** Opens and interrogates the device `item'. Called concurrently: it must
+ *  only touch the item and thread safe state. */
+typedef void *(*NDOF_ProbeFn)(void *ctx, void *item);
+
+/* --------------------------------------------------------------------------
+    Purpose:    Sets results[i] = probe(ctx, items[i]) for the `count' items.
+    Parameters: max_workers - most threads to use, the caller's included;
+                  0 for NDOF_PROBE_MAX_WORKERS
+    Notes:      Returns when all the items are probed. Each result is at 
+                the index of its item, whatever the completion order, so 
+                callers merge them in a deterministic order. Falls back to
+                fewer threads, down to the caller's alone, if threads 
+                cannot be started.
+*/
+void ndof_probe_all(NDOF_ProbeFn probe, void *ctx, void *const *items, 
+                    void **results, size_t count, int max_workers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_probe_h__ */
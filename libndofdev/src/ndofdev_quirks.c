@@ -0,0 +1,125 @@
+/*
+ @file ndofdev_quirks.c
+ @brief Static database of the known devices and their quirks.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include "ndofdev_quirks.h"
+
+/* axes in HID usage order, the library's order */
+#define NDOF_AXES_XYZ_RXRYRZ    { 0, 1, 2, 3, 4, 5 }
+
+/* the models older than the SpaceTraveler swap and negate Y and Z, and their
+   rotations, compared to the later ones, whose frame is the library's */
+static const float kNDOFSwapInvertYZ[36] = {
+    1,  0,  0,  0,  0,  0,
+    0,  0, -1,  0,  0,  0,
+    0, -1,  0,  0,  0,  0,
+    0,  0,  0,  1,  0,  0,
+    0,  0,  0,  0,  0, -1,
+    0,  0,  0,  0, -1,  0
+};
+
+/* --------------------------------------------------------------------------
+    Sorted by key, lookups are a binary search: test_ndof_quirks checks
+    the order, which C cannot do at compile time. Ranges are left to the
+    descriptors of the older models, which vary with the firmware. */
+static const NDOF_DeviceQuirks kNDOFQuirks[] = {
+    { NDOF_QUIRKS_KEY(0x046d, 0xc603), NDOF_CLASS_6DOF, NDOF_LAYOUT_GENERIC,
+      6, 11, NDOF_AXES_XYZ_RXRYRZ, 0, 0, 0, kNDOFSwapInvertYZ,
+      "SpaceMouse Plus XT" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc605), NDOF_CLASS_6DOF, NDOF_LAYOUT_GENERIC,
+      6, 4, NDOF_AXES_XYZ_RXRYRZ, 0, 0, 0, kNDOFSwapInvertYZ,
+      "CADman" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc606), NDOF_CLASS_6DOF, NDOF_LAYOUT_GENERIC,
+      6, 9, NDOF_AXES_XYZ_RXRYRZ, 0, 0, 0, kNDOFSwapInvertYZ,
+      "SpaceMouse Classic" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc621), NDOF_CLASS_6DOF, NDOF_LAYOUT_GENERIC,
+      6, 12, NDOF_AXES_XYZ_RXRYRZ, 0, 0, 0, kNDOFSwapInvertYZ,
+      "SpaceBall 5000" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc623), NDOF_CLASS_6DOF, NDOF_LAYOUT_GENERIC,
+      6, 8, NDOF_AXES_XYZ_RXRYRZ, 0, 0, 0, NULL, "SpaceTraveler" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc625), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_21,
+      6, 21, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, "SpacePilot" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc626), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_2,
+      6, 2, NDOF_AXES_XYZ_RXRYRZ, -350, 350, NDOF_QUIRK_LED, NULL, 
+      "SpaceNavigator" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc627), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_15,
+      6, 15, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, "SpaceExplorer" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc628), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_2,
+      6, 2, NDOF_AXES_XYZ_RXRYRZ, -350, 350, NDOF_QUIRK_LED, NULL,
+      "SpaceNavigator for Notebooks" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc629), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_31,
+      6, 31, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, "SpacePilot Pro" },
+    { NDOF_QUIRKS_KEY(0x046d, 0xc62b), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_15,
+      6, 15, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, "SpaceMouse Pro" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc62e), NDOF_CLASS_6DOF, NDOF_LAYOUT_SINGLE_2,
+      6, 2, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, 
+      "SpaceMouse Wireless (cabled)" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc62f), NDOF_CLASS_6DOF, NDOF_LAYOUT_SINGLE_2,
+      6, 2, NDOF_AXES_XYZ_RXRYRZ, -350, 350, NDOF_QUIRK_WIRELESS, NULL,
+      "SpaceMouse Wireless" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc631), NDOF_CLASS_6DOF, NDOF_LAYOUT_SINGLE_15,
+      6, 15, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, 
+      "SpaceMouse Pro Wireless (cabled)" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc632), NDOF_CLASS_6DOF, NDOF_LAYOUT_SINGLE_15,
+      6, 15, NDOF_AXES_XYZ_RXRYRZ, -350, 350, NDOF_QUIRK_WIRELESS, NULL,
+      "SpaceMouse Pro Wireless" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc635), NDOF_CLASS_6DOF, NDOF_LAYOUT_SPLIT_2,
+      6, 2, NDOF_AXES_XYZ_RXRYRZ, -350, 350, 0, NULL, "SpaceMouse Compact" },
+    { NDOF_QUIRKS_KEY(0x256f, 0xc652), NDOF_CLASS_RECEIVER, NDOF_LAYOUT_GENERIC,
+      6, 32, NDOF_AXES_XYZ_RXRYRZ, 0, 0, NDOF_QUIRK_WIRELESS, NULL,
+      "Universal Receiver" }
+};
+
+/* -------------------------------------------------------------------------- */
+const NDOF_DeviceQuirks *ndof_quirks_lookup(long vendor_id, long product_id)
+{
+    uint32_t key = NDOF_QUIRKS_KEY(vendor_id, product_id);
+    size_t lo = 0, hi = sizeof(kNDOFQuirks) / sizeof(kNDOFQuirks[0]);
+    
+    while (lo < hi)
+    {
+        size_t mid = lo + (hi - lo) / 2;
+        if (kNDOFQuirks[mid].key < key)
+            lo = mid + 1;
+        else if (kNDOFQuirks[mid].key > key)
+            hi = mid;
+        else
+            return &kNDOFQuirks[mid];
+    }
+    
+    return NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_DeviceQuirks *ndof_quirks_table(size_t *count)
+{
+    if (count)
+        *count = sizeof(kNDOFQuirks) / sizeof(kNDOFQuirks[0]);
+    return kNDOFQuirks;
+}
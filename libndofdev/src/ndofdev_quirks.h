@@ -0,0 +1,94 @@
+/*
+ @file ndofdev_quirks.h
+ @brief Static database of the known devices and their quirks.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_quirks_h__
+#define __ndofdev_quirks_h__
+
+#include "ndofdev_external.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_VENDOR_LOGITECH        0x046d  /* 3Dconnexion's older models */
+#define NDOF_VENDOR_3DCONNEXION     0x256f
+
+#define NDOF_QUIRKS_KEY(vid, pid) \
+    ((uint32_t)(((unsigned long)(vid) & 0xffff) << 16 \
+                | ((unsigned long)(pid) & 0xffff)))
+
+typedef enum NDOF_DeviceClass {
+    NDOF_CLASS_NONE     = 0,    /* known, but not an NDOF device */
+    NDOF_CLASS_6DOF     = 1,    /* 6 degrees of freedom controller */
+    NDOF_CLASS_RECEIVER = 2     /* wireless receiver of 6DOF controllers */
+} NDOF_DeviceClass;
+
+/** Fixed input report layouts, each with a decode kernel in 
+ *  ndofdev_decode.cpp. Axes are little endian int16 in X Y Z RX RY RZ order. */
+typedef enum NDOF_ReportLayout {
+    NDOF_LAYOUT_GENERIC = 0,    /* no kernel: use the descriptor's plan */
+    NDOF_LAYOUT_SPLIT_2,        /* reports 1: X Y Z, 2: rotations, 3: buttons */
+    NDOF_LAYOUT_SPLIT_15,
+    NDOF_LAYOUT_SPLIT_21,
+    NDOF_LAYOUT_SPLIT_31,
+    NDOF_LAYOUT_SINGLE_2,       /* reports 1: 6 axes, 3: buttons */
+    NDOF_LAYOUT_SINGLE_15,
+    NDOF_LAYOUT_COUNT
+} NDOF_ReportLayout;
+
+/* quirk flags */
+#define NDOF_QUIRK_WIRELESS     0x1     /* may lose the link while plugged */
+#define NDOF_QUIRK_LED          0x2     /* has an LED output report */
+
+/** What is known of a device model. */
+typedef struct NDOF_DeviceQuirks {
+    uint32_t      key;          /* NDOF_QUIRKS_KEY(vendor_id, product_id) */
+    unsigned char device_class; /* NDOF_DeviceClass */
+    unsigned char layout;       /* NDOF_ReportLayout */
+    unsigned char axes_count;
+    unsigned char btn_count;
+    signed char   axis_map[NDOF_MAX_AXES_COUNT]; /* X..Rz usage -> axis, -1 */
+    short         logical_min;  /* true range of the axes, both 0 if */
+    short         logical_max;  /* the descriptor's is to be trusted */
+    unsigned      flags;        /* NDOF_QUIRK_* */
+    const float  *transform;    /* default axes transform, NULL if none */
+    const char   *name;
+} NDOF_DeviceQuirks;
+
+/** Binary search of the database. Returns NULL for an unknown model. */
+const NDOF_DeviceQuirks *ndof_quirks_lookup(long vendor_id, long product_id);
+
+/** Entries of the database, sorted by key. */
+const NDOF_DeviceQuirks *ndof_quirks_table(size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_quirks_h__ */
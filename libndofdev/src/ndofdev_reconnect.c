@@ -0,0 +1,113 @@
+/*
+ @file ndofdev_reconnect.c
+ @brief Layout and calibration of recently removed devices.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ndofdev_reconnect.h"
+
+/* -------------------------------------------------------------------------- */
+NDOF_DeviceKey ndof_key_stable(const NDOF_DeviceKey *key)
+{
+    NDOF_DeviceKey k = *key;
+    
+    if (NDOF_KEY_SERIAL(k))
+        k.lo &= 0xffffffffULL; /* any port */
+    return k;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_reconnect_init(NDOF_ReconnectCache *cache)
+{
+    memset(cache, 0, sizeof(NDOF_ReconnectCache));
+    ndof_mutex_init(&cache->lock);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_reconnect_dispose(NDOF_ReconnectCache *cache)
+{
+    ndof_mutex_destroy(&cache->lock);
+    cache->count = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_reconnect_store(NDOF_ReconnectCache *cache, 
+                          const NDOF_DeviceKey *key, 
+                          const NDOF_DeviceLayout *layout)
+{
+    NDOF_DeviceKey k = ndof_key_stable(key);
+    int i;
+    
+    ndof_mutex_lock(&cache->lock);
+    
+    /* replace the older layout of the same device, or drop the oldest */
+    for (i = 0; i < cache->count; i++)
+        if (ndof_key_equal(&cache->keys[i], &k))
+            break;
+    if (i == cache->count)
+    {
+        if (cache->count < NDOF_RECONNECT_CAPACITY)
+            cache->count++;
+        i = cache->count - 1;
+    }
+    
+    memmove(&cache->keys[1], &cache->keys[0], i * sizeof(NDOF_DeviceKey));
+    memmove(&cache->layouts[1], &cache->layouts[0], 
+            i * sizeof(NDOF_DeviceLayout));
+    cache->keys[0] = k;
+    cache->layouts[0] = *layout;
+    
+    ndof_mutex_unlock(&cache->lock);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_reconnect_take(NDOF_ReconnectCache *cache, const NDOF_DeviceKey *key,
+                        NDOF_DeviceLayout *out)
+{
+    NDOF_DeviceKey k = ndof_key_stable(key);
+    int i, found = 0;
+    
+    ndof_mutex_lock(&cache->lock);
+    for (i = 0; i < cache->count; i++)
+    {
+        if (ndof_key_equal(&cache->keys[i], &k))
+        {
+            *out = cache->layouts[i];
+            cache->count--;
+            memmove(&cache->keys[i], &cache->keys[i + 1], 
+                    (cache->count - i) * sizeof(NDOF_DeviceKey));
+            memmove(&cache->layouts[i], &cache->layouts[i + 1], 
+                    (cache->count - i) * sizeof(NDOF_DeviceLayout));
+            found = 1;
+            break;
+        }
+    }
+    ndof_mutex_unlock(&cache->lock);
+    
+    return found;
+}
@@ -0,0 +1,98 @@
+/*
+ @file ndofdev_reconnect.h
+ @brief Layout and calibration of recently removed devices.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_reconnect_h__
+#define __ndofdev_reconnect_h__
+
+#include <stdint.h>
+#include "ndofdev_external.h"
+#include "ndofdev_identity.h"
+#include "ndofdev_report.h"
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_RECONNECT_CAPACITY     8   /* devices remembered */
+
+/** What a backend learned about a device when it opened it, and the 
+ *  calibration gathered while it was attached. */
+typedef struct NDOF_DeviceLayout {
+    int             axes_count;
+    int             btn_count;
+    long            axes_min;
+    long            axes_max;
+    
+    /* report based backends: the compiled extraction plan */
+    NDOF_ReportPlan plan;
+    
+    /* element based backends: the ids (e.g. IOHID cookies) of the elements
+       read for each axis and button, and how an axis value is scaled */
+    uintptr_t       axis_ids[NDOF_MAX_AXES_COUNT];
+    uintptr_t       btn_ids[NDOF_MAX_BUTTONS_COUNT];
+    float           scale[NDOF_MAX_AXES_COUNT];
+    float           offset[NDOF_MAX_AXES_COUNT];
+    
+    /* extreme raw values seen so far on each axis */
+    long            min_report[NDOF_MAX_AXES_COUNT];
+    long            max_report[NDOF_MAX_AXES_COUNT];
+} NDOF_DeviceLayout;
+
+/** Least recently used set of the layouts of removed devices. */
+typedef struct NDOF_ReconnectCache {
+    ndof_mutex_t      lock;
+    int               count;
+    NDOF_DeviceKey    keys[NDOF_RECONNECT_CAPACITY];    /* newest first */
+    NDOF_DeviceLayout layouts[NDOF_RECONNECT_CAPACITY];
+} NDOF_ReconnectCache;
+
+/** Identity surviving a replug: the serial number when the device has 
+ *  one, so it is recognized on any port; otherwise model and port. */
+NDOF_DeviceKey ndof_key_stable(const NDOF_DeviceKey *key);
+
+void ndof_reconnect_init(NDOF_ReconnectCache *cache);
+void ndof_reconnect_dispose(NDOF_ReconnectCache *cache);
+
+/** Remembers the layout of a device being removed, forgetting the least
+ *  recently removed device if the cache is full. */
+void ndof_reconnect_store(NDOF_ReconnectCache *cache, 
+                          const NDOF_DeviceKey *key, 
+                          const NDOF_DeviceLayout *layout);
+
+/** Returns 1 and moves the layout of the device with `key' to `out' if it
+ *  was remembered, 0 otherwise. */
+int ndof_reconnect_take(NDOF_ReconnectCache *cache, const NDOF_DeviceKey *key,
+                        NDOF_DeviceLayout *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_reconnect_h__ */
@@ -0,0 +1,188 @@
+/*
+ @file ndofdev_registry.c
+ @brief Incremental reconciliation of enumeration snapshots.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_registry.h"
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static size_t *ndof_registry_slots(size_t count, size_t *mask);
+static size_t ndof_registry_probe(const NDOF_RegistryEntry *entries, 
+                                  const size_t *slots, size_t mask, 
+                                  const NDOF_DeviceKey *key);
+
+/* -------------------------------------------------------------------------- */
+void ndof_registry_init(NDOF_Registry *reg, NDOF_RegistryAddFn add, 
+                        NDOF_RegistryRemoveFn remove, void *ctx)
+{
+    memset(reg, 0, sizeof(NDOF_Registry));
+    reg->add = add;
+    reg->remove = remove;
+    reg->ctx = ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_registry_dispose(NDOF_Registry *reg)
+{
+    size_t i;
+    
+    if (reg->remove)
+        for (i = 0; i < reg->count; i++)
+            reg->remove(reg->ctx, &reg->entries[i].key, 
+                        reg->entries[i].object);
+    
+    free(reg->entries);
+    free(reg->slots);
+    memset(reg, 0, sizeof(NDOF_Registry));
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_registry_reconcile(NDOF_Registry *reg, const NDOF_DeviceKey *keys, 
+                            void *const *handles, size_t count, 
+                            NDOF_RegistryDiff *diff)
+{
+    NDOF_RegistryEntry *entries;
+    size_t *slots, mask, n = 0, i, j;
+    size_t *origin;
+    unsigned char *kept;
+    NDOF_RegistryDiff d = { 0, 0, 0 };
+    
+    entries = (NDOF_RegistryEntry *) malloc(
+        (count ? count : 1) * sizeof(NDOF_RegistryEntry));
+    slots = ndof_registry_slots(count, &mask);
+    kept = (unsigned char *) calloc(reg->count ? reg->count : 1, 1);
+    origin = (size_t *) calloc(count ? count : 1, sizeof(size_t));
+    if (entries == NULL || slots == NULL || kept == NULL || origin == NULL)
+    {
+        free(entries);
+        free(slots);
+        free(kept);
+        free(origin);
+        return -1;
+    }
+    
+    /* split the snapshot into known and new devices */
+    for (i = 0; i < count; i++)
+    {
+        size_t s = ndof_registry_probe(entries, slots, mask, &keys[i]);
+        if (slots[s])
+            continue; /* repeated */
+        
+        j = (reg->count ? 
+             ndof_registry_probe(reg->entries, reg->slots, reg->mask, 
+                                 &keys[i]) : 0);
+        if (reg->count && reg->slots[j])
+        {
+            j = reg->slots[j] - 1;
+            entries[n] = reg->entries[j];
+            kept[j] = 1;
+            d.unchanged++;
+        }
+        else
+        {
+            entries[n].key = keys[i];
+            entries[n].object = NULL;
+            origin[n] = i + 1; /* built below, after the removals */
+        }
+        slots[s] = ++n;
+    }
+    
+    for (j = 0; j < reg->count; j++)
+    {
+        if (!kept[j])
+        {
+            if (reg->remove)
+                reg->remove(reg->ctx, &reg->entries[j].key, 
+                            reg->entries[j].object);
+            d.removed++;
+        }
+    }
+    
+    for (i = 0; i < n; i++)
+    {
+        if (origin[i])
+        {
+            void *handle = (handles ? handles[origin[i] - 1] : NULL);
+            if (reg->add)
+                entries[i].object = reg->add(reg->ctx, &entries[i].key, handle);
+            d.added++;
+        }
+    }
+    
+    free(reg->entries);
+    free(reg->slots);
+    free(kept);
+    free(origin);
+    reg->entries = entries;
+    reg->count = n;
+    reg->slots = slots;
+    reg->mask = mask;
+    if (diff)
+        *diff = d;
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void *ndof_registry_find(const NDOF_Registry *reg, const NDOF_DeviceKey *key)
+{
+    size_t s;
+    
+    if (reg->count == 0)
+        return NULL;
+    
+    s = ndof_registry_probe(reg->entries, reg->slots, reg->mask, key);
+    return (reg->slots[s] ? reg->entries[reg->slots[s] - 1].object : NULL);
+}
+
+/* -------------------------------------------------------------------------- 
+    Index table at most half full for `count' entries. */
+static size_t *ndof_registry_slots(size_t count, size_t *mask)
+{
+    size_t capacity = 16;
+    
+    while (capacity < 2 * count)
+        capacity <<= 1;
+    *mask = capacity - 1;
+    return (size_t *) calloc(capacity, sizeof(size_t));
+}
+
+/* -------------------------------------------------------------------------- 
+    Slot holding `key', or the free slot where it would go. */
+static size_t ndof_registry_probe(const NDOF_RegistryEntry *entries, 
+                                  const size_t *slots, size_t mask, 
+                                  const NDOF_DeviceKey *key)
+{
+    size_t s = (size_t) ndof_key_hash(key) & mask;
+    
+    while (slots[s] && !ndof_key_equal(&entries[slots[s] - 1].key, key))
+        s = (s + 1) & mask;
+    return s;
+}
@@ -0,0 +1,101 @@
+/*
+ @file ndofdev_registry.h
+ @brief Incremental reconciliation of enumeration snapshots.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_registry_h__
+#define __ndofdev_registry_h__
+
+#include <stddef.h>
+#include "ndofdev_identity.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Builds the object of a device that appeared in a snapshot, from the 
+ *  backend's `handle' of it. May return NULL for devices of no interest:
+ *  they are tracked anyway, so they are not probed again at the next scan. */
+typedef void *(*NDOF_RegistryAddFn)(void *ctx, const NDOF_DeviceKey *key, 
+                                    void *handle);
+
+/** Releases the object of a device missing from a snapshot. */
+typedef void (*NDOF_RegistryRemoveFn)(void *ctx, const NDOF_DeviceKey *key, 
+                                      void *object);
+
+typedef struct NDOF_RegistryEntry {
+    NDOF_DeviceKey  key;
+    void           *object;   /* as returned by the add function */
+} NDOF_RegistryEntry;
+
+/** Set of the devices currently attached, in the order of the last 
+ *  snapshot, indexed by key. */
+typedef struct NDOF_Registry {
+    NDOF_RegistryEntry   *entries;
+    size_t                count;
+    size_t               *slots;  /* index + 1 in entries, 0 if free */
+    size_t                mask;
+    NDOF_RegistryAddFn    add;
+    NDOF_RegistryRemoveFn remove;
+    void                 *ctx;
+} NDOF_Registry;
+
+typedef struct NDOF_RegistryDiff {
+    size_t added;
+    size_t removed;
+    size_t unchanged;
+} NDOF_RegistryDiff;
+
+void ndof_registry_init(NDOF_Registry *reg, NDOF_RegistryAddFn add, 
+                        NDOF_RegistryRemoveFn remove, void *ctx);
+
+/** Removes all the devices, then frees the registry. */
+void ndof_registry_dispose(NDOF_Registry *reg);
+
+/* --------------------------------------------------------------------------
+    Purpose:    Brings the registry in line with an enumeration snapshot.
+    Parameters: keys, handles - `count' devices just enumerated; handles 
+                  are only passed to the add function and may be NULL
+                diff - optional, receives the size of each part of the diff
+    Notes:      Runs in O(count + reg->count). Devices found in both sets
+                keep their object and are not rebuilt. All the removals 
+                are done before the additions, so a device replaced at the
+                same port is released first. Repeated keys count once.
+    Returns:    0, or -1 when out of memory, leaving the registry unchanged.
+*/
+int ndof_registry_reconcile(NDOF_Registry *reg, const NDOF_DeviceKey *keys, 
+                            void *const *handles, size_t count, 
+                            NDOF_RegistryDiff *diff);
+
+/** Object of the device with `key', or NULL if it is not attached. */
+void *ndof_registry_find(const NDOF_Registry *reg, const NDOF_DeviceKey *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_registry_h__ */
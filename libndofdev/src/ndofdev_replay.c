@@ -0,0 +1,278 @@
+/*
+ @file ndofdev_replay.c
+ @brief Backend playing back samples recorded in a file.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_backend.h"
+#include "ndofdev_external.h"
+#include "ndofdev_internal.h"
+#include "ndofdev_stream.h"
+
+/*  The recording is a text file, one sample per line: its time in ns, the
+    NDOF_MAX_AXES_COUNT axes and the buttons mask, separated by blanks. 
+    Lines starting with '#' are comments. It is read whole by libinit, and
+    played back by the one device of the context in real time, from when 
+    it is opened: each update publishes all the samples due since the 
+    previous one, in order. The device stays at the last sample. */
+
+typedef struct NDOF_ReplayPrivate {
+    int             opened;
+    uint64_t        start_ns;   /* ndof_time_ns() of the first sample */
+    size_t          next;       /* first sample not published yet */
+    NDOF_DeviceKey  curr_key;
+} NDOF_ReplayPrivate;
+
+typedef struct NDOF_ReplayBackend {
+    NDOF_Sample    *samples;    /* time_ns relative to the first one */
+    size_t          count;
+    char            name[256];  /* of the file, without the directories */
+} NDOF_ReplayBackend;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_replay_libinit(NDOF_Context *ctx,
+                               NDOF_DeviceAddCallback in_add_cb, 
+                               NDOF_DeviceRemovalCallback in_removal_cb,
+                               void *platform_specific, int async);
+static void ndof_replay_stop(NDOF_Context *ctx);
+static void ndof_replay_cleanup(NDOF_Context *ctx);
+static int ndof_replay_devcount(NDOF_Context *ctx);
+static int ndof_replay_init_first(NDOF_Device *dev, void *param);
+static void ndof_replay_update(NDOF_Device *dev);
+static void ndof_replay_dispose(void *priv);
+static unsigned char ndof_replay_match(void *priv1, void *priv2);
+static int ndof_replay_load(NDOF_ReplayBackend *be, const char *path);
+static void ndof_replay_open(NDOF_Device *dev);
+
+/* -------------------------------------------------------------------------- 
+    `platform_specific' is the path of the recording. */
+static int ndof_replay_libinit(NDOF_Context *ctx,
+                               NDOF_DeviceAddCallback in_add_cb, 
+                               NDOF_DeviceRemovalCallback in_removal_cb,
+                               void *platform_specific, int async)
+{
+    NDOF_ReplayBackend *be;
+    
+    (void) in_removal_cb;
+    (void) async;
+    ndof_replay_cleanup(ctx);
+    be = (NDOF_ReplayBackend *) calloc(1, sizeof(NDOF_ReplayBackend));
+    if (be == NULL)
+        return -1;
+    
+    if (platform_specific == NULL 
+        || ndof_replay_load(be, (const char *) platform_specific) != 0)
+    {
+        fprintf(stderr, "libndofdev: cannot read recording %s\n", 
+                (platform_specific ? (const char *) platform_specific : ""));
+        free(be);
+        return -1;
+    }
+    ctx->backend = be;
+    
+    if (in_add_cb)
+    {
+        NDOF_Device *dev = ndof_context_create_device(ctx);
+        
+        if (dev)
+        {
+            ndof_replay_open(dev);
+            if (ndof_notify_added(in_add_cb, dev) == NDOF_DISCARD_HOTPLUGGED)
+                ndof_destroy(dev);
+        }
+    }
+    
+    ndof_init_done(ctx, 0);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Returns 0 if ok. */
+static int ndof_replay_load(NDOF_ReplayBackend *be, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    const char *base = strrchr(path, '/');
+    size_t capacity = 0;
+    uint64_t first = 0;
+    char line[512];
+    
+    if (f == NULL)
+        return -1;
+    
+    while (fgets(line, sizeof(line), f))
+    {
+        NDOF_Sample s;
+        char *p = line, *end;
+        int i;
+        
+        if (line[0] == '#')
+            continue;
+        
+        memset(&s, 0, sizeof(s));
+        s.time_ns = strtoull(p, &end, 10);
+        if (end == p)
+            continue;   /* blank */
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        {
+            p = end;
+            s.axes[i] = strtol(p, &end, 10);
+        }
+        p = end;
+        s.buttons = strtoul(p, &end, 0);
+        
+        if (be->count == capacity)
+        {
+            size_t grown = (capacity ? 2 * capacity : 256);
+            NDOF_Sample *samples = (NDOF_Sample *) 
+                realloc(be->samples, grown * sizeof(NDOF_Sample));
+            
+            if (samples == NULL)
+                break;
+            be->samples = samples;
+            capacity = grown;
+        }
+        s.seq = be->count + 1;
+        if (be->count == 0)
+            first = s.time_ns;
+        s.time_ns = (s.time_ns > first ? s.time_ns - first : 0);
+        be->samples[be->count++] = s;
+    }
+    
+    fclose(f);
+    snprintf(be->name, sizeof(be->name), "%s", (base ? base + 1 : path));
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_replay_stop(NDOF_Context *ctx)
+{
+    (void) ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_replay_cleanup(NDOF_Context *ctx)
+{
+    NDOF_ReplayBackend *be = (NDOF_ReplayBackend *) ctx->backend;
+    
+    if (be)
+    {
+        free(be->samples);
+        free(be);
+        ctx->backend = NULL;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_replay_devcount(NDOF_Context *ctx)
+{
+    return (ctx->backend ? 1 : 0);
+}
+
+/* -------------------------------------------------------------------------- 
+    The recording must have been read by libinit. */
+static int ndof_replay_init_first(NDOF_Device *dev, void *param)
+{
+    (void) param;
+    if (dev->context->backend == NULL)
+    {
+        fprintf(stderr, "libndofdev: no NDOF HID device found.\n");
+        return -1;
+    }
+    
+    ndof_replay_open(dev);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_replay_open(NDOF_Device *dev)
+{
+    NDOF_ReplayBackend *be = (NDOF_ReplayBackend *) dev->context->backend;
+    NDOF_ReplayPrivate *priv = (NDOF_ReplayPrivate *) dev->private_data;
+    
+    priv->opened = 1;
+    priv->start_ns = ndof_time_ns();
+    priv->next = 0;
+    priv->curr_key = ndof_device_key(0, 0, 0x01, 0x08, 0, be->name);
+    dev->axes_count = NDOF_MAX_AXES_COUNT;
+    dev->btn_count = NDOF_MAX_BUTTONS_COUNT;
+    snprintf(dev->manufacturer, sizeof(dev->manufacturer), "libndofdev");
+    snprintf(dev->product, sizeof(dev->product), "Replay of %.200s", be->name);
+    ndof_stream_identify(dev, &priv->curr_key);
+    ndof_stream_set_valid(dev, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_replay_update(NDOF_Device *dev)
+{
+    NDOF_ReplayBackend *be = (NDOF_ReplayBackend *) dev->context->backend;
+    NDOF_ReplayPrivate *priv = (NDOF_ReplayPrivate *) dev->private_data;
+    uint64_t elapsed;
+    int i;
+    
+    if (!priv->opened || be == NULL)
+        return;
+    
+    elapsed = ndof_time_ns() - priv->start_ns;
+    for (; priv->next < be->count 
+           && be->samples[priv->next].time_ns <= elapsed; priv->next++)
+    {
+        const NDOF_Sample *s = &be->samples[priv->next];
+        
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+            dev->axes[i] = s->axes[i];
+        for (i = 0; i < NDOF_MAX_BUTTONS_COUNT; i++)
+            dev->buttons[i] = (long) ((s->buttons >> i) & 1);
+        ndof_stream_publish(dev);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_replay_dispose(void *priv)
+{
+    free(priv);
+}
+
+/* -------------------------------------------------------------------------- */
+static unsigned char ndof_replay_match(void *priv1, void *priv2)
+{
+    NDOF_ReplayPrivate *d1 = (NDOF_ReplayPrivate *) priv1;
+    NDOF_ReplayPrivate *d2 = (NDOF_ReplayPrivate *) priv2;
+    
+    return (d1 && d2 && ndof_key_equal(&d1->curr_key, &d2->curr_key));
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_Backend ndof_backend_replay = {
+    "replay", sizeof(NDOF_ReplayPrivate), 0,
+    ndof_replay_libinit, ndof_replay_stop, ndof_replay_cleanup,
+    ndof_replay_devcount, ndof_replay_init_first, ndof_replay_update, 
+    ndof_replay_dispose, ndof_replay_match, NULL
+};
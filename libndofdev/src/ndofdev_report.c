@@ -0,0 +1,312 @@
+/*
+ @file ndofdev_report.c
+ @brief Decoding of raw HID input reports into axes and buttons.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ndofdev_report.h"
+
+/* HID 1.11, 6.2.2: item types and tags used here */
+#define HID_TYPE_MAIN           0
+#define HID_TYPE_GLOBAL         1
+#define HID_TYPE_LOCAL          2
+
+#define HID_MAIN_INPUT          0x8
+#define HID_GLOBAL_USAGE_PAGE   0x0
+#define HID_GLOBAL_LOGICAL_MIN  0x1
+#define HID_GLOBAL_LOGICAL_MAX  0x2
+#define HID_GLOBAL_REPORT_SIZE  0x7
+#define HID_GLOBAL_REPORT_ID    0x8
+#define HID_GLOBAL_REPORT_COUNT 0x9
+#define HID_GLOBAL_PUSH         0xa
+#define HID_GLOBAL_POP          0xb
+#define HID_LOCAL_USAGE         0x0
+#define HID_LOCAL_USAGE_MIN     0x1
+#define HID_LOCAL_USAGE_MAX     0x2
+
+#define HID_PAGE_GENERIC_DESKTOP 0x01
+#define HID_PAGE_BUTTON          0x09
+#define HID_USAGE_X              0x30
+#define HID_USAGE_RZ             0x35
+
+#define HID_INPUT_CONSTANT      0x1
+
+#define HID_MAX_USAGES          32
+#define HID_MAX_PUSH            4
+#define HID_MAX_REPORT_BITS     (4096 * 8)  /* reports are at most 4 KiB */
+
+typedef struct HIDGlobals {
+    unsigned long usage_page;
+    long logical_min;
+    long logical_max;
+    unsigned long report_size;
+    unsigned long report_id;
+    unsigned long report_count;
+} HIDGlobals;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static void ndof_report_add_field(NDOF_ReportPlan *plan, const HIDGlobals *g,
+                                  unsigned long usage, unsigned bit_offset);
+
+/* -------------------------------------------------------------------------- */
+int ndof_report_parse(const unsigned char *desc, size_t len, 
+                      NDOF_ReportPlan *plan)
+{
+    HIDGlobals g, stack[HID_MAX_PUSH];
+    int depth = 0;
+    unsigned long usages[HID_MAX_USAGES];
+    int usage_count = 0;
+    unsigned long usage_min = 0, usage_max = 0;
+    unsigned short offsets[256];    /* input bits so far, per report ID */
+    size_t pos = 0;
+    
+    memset(plan, 0, sizeof(NDOF_ReportPlan));
+    memset(&g, 0, sizeof(g));
+    memset(offsets, 0, sizeof(offsets));
+    
+    while (pos < len)
+    {
+        unsigned char prefix = desc[pos++];
+        unsigned size = prefix & 0x3;
+        unsigned type = (prefix >> 2) & 0x3;
+        unsigned tag = prefix >> 4;
+        unsigned long uvalue = 0;
+        long svalue;
+        unsigned i;
+        
+        if (prefix == 0xfe)
+        {
+            /* long item: data size, tag, data */
+            if (pos + 2 > len)
+                return -1;
+            pos += 2 + desc[pos];
+            continue;
+        }
+        
+        if (size == 3)
+            size = 4;
+        if (pos + size > len)
+            return -1;
+        for (i = 0; i < size; i++)
+            uvalue |= (unsigned long) desc[pos + i] << (8 * i);
+        pos += size;
+        
+        /* sign extended value, for the logical range */
+        svalue = (long) uvalue;
+        if (size > 0 && size < 4 && (uvalue & (1UL << (8 * size - 1))))
+            svalue = (long)(uvalue | (~0UL << (8 * size)));
+        else if (size == 4)
+            svalue = (long)(int) uvalue;
+        
+        if (type == HID_TYPE_GLOBAL)
+        {
+            switch (tag)
+            {
+            case HID_GLOBAL_USAGE_PAGE:   g.usage_page = uvalue;   break;
+            case HID_GLOBAL_LOGICAL_MIN:  g.logical_min = svalue;  break;
+            case HID_GLOBAL_LOGICAL_MAX:  g.logical_max = svalue;  break;
+            case HID_GLOBAL_REPORT_SIZE:  g.report_size = uvalue;  break;
+            case HID_GLOBAL_REPORT_COUNT: g.report_count = uvalue; break;
+            case HID_GLOBAL_REPORT_ID:
+                if (uvalue == 0 || uvalue > 255)
+                    return -1;
+                g.report_id = uvalue;
+                plan->uses_report_ids = 1;
+                break;
+            case HID_GLOBAL_PUSH:
+                if (depth == HID_MAX_PUSH)
+                    return -1;
+                stack[depth++] = g;
+                break;
+            case HID_GLOBAL_POP:
+                if (depth == 0)
+                    return -1;
+                g = stack[--depth];
+                break;
+            }
+        }
+        else if (type == HID_TYPE_LOCAL)
+        {
+            /* 4 byte usages carry their own page in the high word */
+            switch (tag)
+            {
+            case HID_LOCAL_USAGE:
+                if (usage_count < HID_MAX_USAGES)
+                    usages[usage_count++] = uvalue;
+                break;
+            case HID_LOCAL_USAGE_MIN: usage_min = uvalue; break;
+            case HID_LOCAL_USAGE_MAX: usage_max = uvalue; break;
+            }
+        }
+        else if (type == HID_TYPE_MAIN)
+        {
+            if (tag == HID_MAIN_INPUT)
+            {
+                unsigned bits;
+                
+                /* bounded before multiplying: hostile descriptors must not
+                   wrap the product around, nor make the loop below long */
+                if (g.report_size == 0 || g.report_size > 32 
+                    || g.report_count > HID_MAX_REPORT_BITS)
+                    return -1;
+                bits = (unsigned)(g.report_size * g.report_count);
+                if (offsets[g.report_id] + bits > HID_MAX_REPORT_BITS)
+                    return -1;
+                
+                if (!(uvalue & HID_INPUT_CONSTANT))
+                {
+                    for (i = 0; i < g.report_count; i++)
+                    {
+                        unsigned long usage;
+                        if (usage_count)
+                            usage = usages[i < (unsigned) usage_count 
+                                           ? i : (unsigned) usage_count - 1];
+                        else if (usage_min + i <= usage_max)
+                            usage = usage_min + i;
+                        else
+                            continue;
+                        
+                        ndof_report_add_field(plan, &g, usage, 
+                            offsets[g.report_id] + i * g.report_size);
+                    }
+                }
+                offsets[g.report_id] += bits;
+            }
+            
+            /* local items only apply to the next main item */
+            usage_count = 0;
+            usage_min = usage_max = 0;
+        }
+    }
+    
+    return (plan->axes_count > 0 ? 0 : -1);
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_report_add_field(NDOF_ReportPlan *plan, const HIDGlobals *g,
+                                  unsigned long usage, unsigned bit_offset)
+{
+    unsigned long page = (usage > 0xffff ? usage >> 16 : g->usage_page);
+    NDOF_ReportField *f;
+    
+    usage &= 0xffff;
+    if (plan->field_count == NDOF_REPORT_MAX_FIELDS)
+        return;
+    
+    f = &plan->fields[plan->field_count];
+    if (page == HID_PAGE_GENERIC_DESKTOP 
+        && usage >= HID_USAGE_X && usage <= HID_USAGE_RZ)
+    {
+        f->target = (unsigned char)(NDOF_FIELD_AXIS + usage - HID_USAGE_X);
+        if (plan->axes_count == 0 || g->logical_min < plan->axes_min)
+            plan->axes_min = g->logical_min;
+        if (plan->axes_count == 0 || g->logical_max > plan->axes_max)
+            plan->axes_max = g->logical_max;
+        plan->axes_count++;
+    }
+    else if (page == HID_PAGE_BUTTON && usage >= 1 
+             && usage <= NDOF_MAX_BUTTONS_COUNT)
+    {
+        f->target = (unsigned char)(NDOF_FIELD_BUTTON + usage - 1);
+        if ((int) usage > plan->btn_count)
+            plan->btn_count = (int) usage;
+    }
+    else
+        return;
+    
+    f->report_id = (unsigned char) g->report_id;
+    f->bit_offset = (unsigned short) bit_offset;
+    f->bit_size = (unsigned char) g->report_size;
+    f->is_signed = (g->logical_min < 0);
+    plan->field_count++;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_report_decode(const NDOF_ReportPlan *plan, 
+                       const unsigned char *report, size_t len,
+                       long *axes, long *buttons)
+{
+    int i, decoded = 0;
+    unsigned char id = 0;
+    
+    if (plan->uses_report_ids)
+    {
+        if (len == 0)
+            return 0;
+        id = report[0];
+        report++;
+        len--;
+    }
+    
+    /* a truncated report is dropped as a whole */
+    for (i = 0; i < plan->field_count; i++)
+    {
+        const NDOF_ReportField *f = &plan->fields[i];
+        if (f->report_id == id 
+            && ((size_t) f->bit_offset + f->bit_size + 7) / 8 > len)
+            return 0;
+    }
+    
+    for (i = 0; i < plan->field_count; i++)
+    {
+        const NDOF_ReportField *f = &plan->fields[i];
+        const unsigned char *p = report + (f->bit_offset >> 3);
+        unsigned shift = f->bit_offset & 7;
+        unsigned n, bytes = (shift + f->bit_size + 7) / 8;
+        uint64_t bits = 0;
+        unsigned long v;
+        
+        if (f->report_id != id)
+            continue;
+        
+        /* little endian bit field, possibly unaligned: at most 5 bytes */
+        for (n = 0; n < bytes; n++)
+            bits |= (uint64_t) p[n] << (8 * n);
+        v = (unsigned long)((bits >> shift) 
+                            & ((((uint64_t) 1) << f->bit_size) - 1));
+        
+        if (f->target >= NDOF_FIELD_BUTTON)
+        {
+            buttons[f->target - NDOF_FIELD_BUTTON] = (long) v;
+            decoded |= NDOF_DECODED_BUTTONS;
+        }
+        else
+        {
+            if (f->is_signed && f->bit_size < 32 
+                && (v & (1UL << (f->bit_size - 1))))
+                v |= ~0UL << f->bit_size;
+            axes[f->target] = (f->is_signed && f->bit_size == 32) 
+                            ? (long)(int) v : (long) v;
+            decoded |= NDOF_DECODED_AXES;
+        }
+    }
+    
+    return decoded;
+}
@@ -0,0 +1,99 @@
+/*
+ @file ndofdev_report.h
+ @brief Decoding of raw HID input reports into axes and buttons.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_report_h__
+#define __ndofdev_report_h__
+
+#include "ndofdev_external.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_REPORT_MAX_FIELDS  (NDOF_MAX_AXES_COUNT + NDOF_MAX_BUTTONS_COUNT)
+
+/* targets of a report field */
+#define NDOF_FIELD_AXIS         0x00    /* + axis index */
+#define NDOF_FIELD_BUTTON       0x40    /* + button index */
+
+/* what ndof_report_decode found in a report */
+#define NDOF_DECODED_AXES       0x1
+#define NDOF_DECODED_BUTTONS    0x2
+
+/** One axis or button of an input report. */
+typedef struct NDOF_ReportField {
+    unsigned char  report_id;   /* 0 if the device uses no report IDs */
+    unsigned char  target;      /* NDOF_FIELD_AXIS/BUTTON + index */
+    unsigned char  bit_size;    /* 1 to 32 */
+    unsigned char  is_signed;   /* logical minimum < 0 */
+    unsigned short bit_offset;  /* from the byte following the report ID */
+} NDOF_ReportField;
+
+/** Where the axes and buttons are in a device's input reports, built once 
+ *  from its HID report descriptor. */
+typedef struct NDOF_ReportPlan {
+    int  uses_report_ids;
+    int  field_count;
+    NDOF_ReportField fields[NDOF_REPORT_MAX_FIELDS];
+    int  axes_count;
+    int  btn_count;
+    long axes_min;              /* logical range of the axes */
+    long axes_max;
+} NDOF_ReportPlan;
+
+/** Decodes one input report into `axes' and `buttons', both laid out as in
+ *  NDOF_Device. Only the values carried by the report are written. 
+ *  Returns a mask of NDOF_DECODED_* flags, 0 for a report with none. */
+typedef int (*NDOF_DecodeFn)(const NDOF_ReportPlan *plan, 
+                             const unsigned char *report, size_t len,
+                             long *axes, long *buttons);
+
+/** Parses a HID report descriptor: axes are the Generic Desktop X to Rz
+ *  usages, buttons the Button page usages, of the input reports.
+ *  Returns 0 on success, -1 on a malformed descriptor or if no axis was 
+ *  found. */
+int ndof_report_parse(const unsigned char *desc, size_t len, 
+                      NDOF_ReportPlan *plan);
+
+/** Generic decoder, following the plan field by field. */
+int ndof_report_decode(const NDOF_ReportPlan *plan, 
+                       const unsigned char *report, size_t len,
+                       long *axes, long *buttons);
+
+/** Returns the decoder to use for a device: a kernel specialized for the
+ *  model's fixed report layout when the plan confirms it (ndofdev_decode.cpp),
+ *  ndof_report_decode otherwise. */
+NDOF_DecodeFn ndof_decode_select(long vendor_id, long product_id,
+                                 const NDOF_ReportPlan *plan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_report_h__ */
@@ -0,0 +1,307 @@
+/*
+ @file ndofdev_resample.c
+ @brief Fixed rate resampling of the irregular sample stream.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ndofdev_external.h"
+
+/*  The resampler is a subscriber of the device's sample ring: it pulls the
+    timestamped samples as they come and produces samples on the grid of
+    times k / rate_hz, in a single pass over the input.
+
+    Samples are interpolated (linearly, or with a Hermite cubic through the
+    two neighbor samples of the segment) when the input is slower than the
+    output. When the input is faster, every output is instead the average
+    of the input signal over the output period, so that motion between two
+    output samples is integrated rather than aliased.                        */
+
+#define NDOF_RESAMPLE_BATCH 32
+
+typedef struct NDOF_ResamplePoint {
+    uint64_t t;
+    double v[NDOF_MAX_AXES_COUNT];
+    unsigned long buttons;
+} NDOF_ResamplePoint;
+
+struct NDOF_Resampler {
+    NDOF_Subscriber *sub;
+    unsigned rate_hz;
+    int mode;
+    
+    /* input window, p[3] being the most recent input. Cubic interpolation
+       works on the p[1]-p[2] segment, linear on the p[2]-p[3] one. */
+    NDOF_ResamplePoint p[4];
+    int primed;
+    double dt_avg;          /* smoothed input interval, in ns */
+    
+    uint64_t k;             /* grid index of the next output */
+    uint64_t next_t;        /* time of the next output */
+    uint64_t acc_start;     /* box filter: start of the current period ... */
+    uint64_t acc_pos;       /* ... time integrated so far ... */
+    double acc[NDOF_MAX_AXES_COUNT]; /* ... and integral of the input */
+    uint64_t out_seq;
+    
+    NDOF_Sample in[NDOF_RESAMPLE_BATCH];
+    size_t in_count, in_pos;
+};
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static uint64_t ndof_grid_time(unsigned rate_hz, uint64_t k);
+static void ndof_resampler_restart(NDOF_Resampler *rs, const NDOF_Sample *s);
+static void ndof_resampler_add(NDOF_Resampler *rs, const NDOF_Sample *s);
+static void ndof_resampler_integrate(NDOF_Resampler *rs, 
+                                     const NDOF_ResamplePoint *a,
+                                     const NDOF_ResamplePoint *b, uint64_t to);
+static void ndof_resampler_emit(NDOF_Resampler *rs, 
+                                const NDOF_ResamplePoint *a,
+                                const NDOF_ResamplePoint *b, NDOF_Sample *out);
+
+/* -------------------------------------------------------------------------- */
+NDOF_Resampler *ndof_resampler_create(NDOF_Device *dev, unsigned rate_hz, 
+                                      int mode)
+{
+    NDOF_Resampler *rs;
+    
+    if (rate_hz == 0 
+        || (mode != NDOF_RESAMPLE_LINEAR && mode != NDOF_RESAMPLE_CUBIC))
+        return NULL;
+    
+    rs = (NDOF_Resampler *) malloc(sizeof(NDOF_Resampler));
+    if (rs == NULL)
+        return NULL;
+    
+    memset(rs, 0, sizeof(NDOF_Resampler));
+    rs->sub = ndof_subscribe(dev);
+    if (rs->sub == NULL)
+    {
+        free(rs);
+        return NULL;
+    }
+    
+    rs->rate_hz = rate_hz;
+    rs->mode = mode;
+    return rs;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_resampler_destroy(NDOF_Resampler *rs)
+{
+    if (rs)
+    {
+        ndof_unsubscribe(rs->sub);
+        free(rs);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ndof_resampler_read(NDOF_Resampler *rs, NDOF_Sample *out, size_t cap)
+{
+    size_t n = 0;
+    
+    if (rs == NULL || out == NULL)
+        return 0;
+    
+    while (n < cap)
+    {
+        const NDOF_ResamplePoint *a, *b;
+        
+        if (rs->primed)
+        {
+            /* current segment */
+            a = (rs->mode == NDOF_RESAMPLE_CUBIC ? &rs->p[1] : &rs->p[2]);
+            b = a + 1;
+            if (rs->next_t <= b->t)
+            {
+                if (rs->next_t > a->t)
+                {
+                    ndof_resampler_emit(rs, a, b, &out[n++]);
+                    continue;
+                }
+            }
+            
+            /* segment exhausted: integrate its remainder */
+            ndof_resampler_integrate(rs, a, b, b->t);
+        }
+        
+        /* need one more input sample */
+        if (rs->in_pos == rs->in_count)
+        {
+            uint64_t dropped = 0;
+            rs->in_pos = 0;
+            rs->in_count = ndof_subscriber_read(rs->sub, rs->in, 
+                                                NDOF_RESAMPLE_BATCH, &dropped);
+            if (dropped)
+                rs->primed = 0;  /* there is a gap: start over */
+            if (rs->in_count == 0)
+                break;
+        }
+        
+        if (rs->primed)
+            ndof_resampler_add(rs, &rs->in[rs->in_pos++]);
+        else
+            ndof_resampler_restart(rs, &rs->in[rs->in_pos++]);
+    }
+    
+    return n;
+}
+
+/* -------------------------------------------------------------------------- 
+    k / rate_hz seconds, in ns, without overflowing 64 bits. */
+static uint64_t ndof_grid_time(unsigned rate_hz, uint64_t k)
+{
+    return (k / rate_hz) * 1000000000ULL 
+           + (k % rate_hz) * 1000000000ULL / rate_hz;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_resampler_restart(NDOF_Resampler *rs, const NDOF_Sample *s)
+{
+    int i, j;
+    
+    for (j = 0; j < 4; j++)
+    {
+        rs->p[j].t = s->time_ns;
+        rs->p[j].buttons = s->buttons;
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+            rs->p[j].v[i] = (double) s->axes[i];
+    }
+    
+    /* first grid point strictly after the sample */
+    rs->k = (s->time_ns / 1000000000ULL) * rs->rate_hz
+          + (s->time_ns % 1000000000ULL) * rs->rate_hz / 1000000000ULL + 1;
+    rs->next_t = ndof_grid_time(rs->rate_hz, rs->k);
+    rs->acc_start = rs->acc_pos = s->time_ns;
+    memset(rs->acc, 0, sizeof(rs->acc));
+    rs->dt_avg = 0.0;
+    rs->primed = 1;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_resampler_add(NDOF_Resampler *rs, const NDOF_Sample *s)
+{
+    int i;
+    double dt;
+    
+    if (s->time_ns <= rs->p[3].t)
+        return; /* no time elapsed, nothing to interpolate */
+    
+    dt = (double)(s->time_ns - rs->p[3].t);
+    rs->dt_avg = (rs->dt_avg == 0.0 ? dt : 0.9 * rs->dt_avg + 0.1 * dt);
+    
+    memmove(&rs->p[0], &rs->p[1], 3 * sizeof(NDOF_ResamplePoint));
+    rs->p[3].t = s->time_ns;
+    rs->p[3].buttons = s->buttons;
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        rs->p[3].v[i] = (double) s->axes[i];
+}
+
+/* -------------------------------------------------------------------------- 
+    Adds the integral of the a-b segment from acc_pos up to `to'. */
+static void ndof_resampler_integrate(NDOF_Resampler *rs, 
+                                     const NDOF_ResamplePoint *a,
+                                     const NDOF_ResamplePoint *b, uint64_t to)
+{
+    int i;
+    double span = (double)(b->t - a->t);
+    double u0, u1, w;
+    
+    if (to <= rs->acc_pos || span <= 0.0)
+        return;
+    
+    /* trapezoid under the line between a and b, from acc_pos to `to' */
+    u0 = (double)(rs->acc_pos - a->t) / span;
+    u1 = (double)(to - a->t) / span;
+    w = (double)(to - rs->acc_pos);
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        double d = b->v[i] - a->v[i];
+        rs->acc[i] += w * (a->v[i] + 0.5 * (u0 + u1) * d);
+    }
+    rs->acc_pos = to;
+}
+
+/* -------------------------------------------------------------------------- 
+    Produces the output at next_t, a->t < next_t <= b->t. */
+static void ndof_resampler_emit(NDOF_Resampler *rs, 
+                                const NDOF_ResamplePoint *a,
+                                const NDOF_ResamplePoint *b, NDOF_Sample *out)
+{
+    int i;
+    double v[NDOF_MAX_AXES_COUNT];
+    double span = (double)(b->t - a->t);
+    double u = (double)(rs->next_t - a->t) / span;
+    double period = 1e9 / rs->rate_hz;
+    
+    ndof_resampler_integrate(rs, a, b, rs->next_t);
+    
+    if (rs->dt_avg > 0.0 && rs->dt_avg < period 
+        && rs->next_t > rs->acc_start)
+    {
+        /* decimating: average over the output period */
+        double len = (double)(rs->next_t - rs->acc_start);
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+            v[i] = rs->acc[i] / len;
+    }
+    else if (rs->mode == NDOF_RESAMPLE_CUBIC)
+    {
+        /* cubic Hermite with Catmull-Rom tangents, for uneven spacing */
+        const NDOF_ResamplePoint *p0 = a - 1, *p3 = b + 1;
+        double u2 = u * u, u3 = u2 * u;
+        double h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u;
+        double h01 = -2 * u3 + 3 * u2,    h11 = u3 - u2;
+        double t02 = (double)(b->t - p0->t), t13 = (double)(p3->t - a->t);
+        
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        {
+            double m1 = t02 > 0 ? (b->v[i] - p0->v[i]) * span / t02 : 0.0;
+            double m2 = t13 > 0 ? (p3->v[i] - a->v[i]) * span / t13 : 0.0;
+            v[i] = h00 * a->v[i] + h10 * m1 + h01 * b->v[i] + h11 * m2;
+        }
+    }
+    else
+    {
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+            v[i] = a->v[i] + u * (b->v[i] - a->v[i]);
+    }
+    
+    out->seq = ++rs->out_seq;
+    out->time_ns = rs->next_t;
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        out->axes[i] = (long) floor(v[i] + 0.5);
+    out->buttons = (rs->next_t == b->t ? b->buttons : a->buttons);
+    
+    /* next output period */
+    memset(rs->acc, 0, sizeof(rs->acc));
+    rs->acc_start = rs->next_t;
+    rs->next_t = ndof_grid_time(rs->rate_hz, ++rs->k);
+}
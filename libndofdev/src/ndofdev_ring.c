@@ -0,0 +1,176 @@
+/*
+ @file ndofdev_ring.c
+ @brief Single producer, multiple consumer broadcast ring of samples.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ndofdev_external.h"
+#include "ndofdev_ring.h"
+
+/* -------------------------------------------------------------------------- */
+NDOF_SampleRing *ndof_ring_create(size_t capacity)
+{
+    NDOF_SampleRing *ring;
+    size_t max = (SIZE_MAX - offsetof(NDOF_SampleRing, slots)) 
+                 / sizeof(NDOF_RingSlot);
+    size_t n = 1;
+    
+    /* neither n nor the size in bytes may wrap around */
+    while (n < capacity && n <= max / 2)
+        n <<= 1;
+    if (n < capacity)
+        return NULL;
+    
+    ring = (NDOF_SampleRing *) malloc(ndof_ring_size(n));
+    if (ring == NULL)
+        return NULL;
+    
+    ndof_ring_init(ring, n);
+    return ring;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_ring_dispose(NDOF_SampleRing *ring)
+{
+    free(ring);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ndof_ring_size(size_t capacity)
+{
+    return offsetof(NDOF_SampleRing, slots) + capacity * sizeof(NDOF_RingSlot);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_ring_init(NDOF_SampleRing *ring, size_t capacity)
+{
+    assert(capacity && (capacity & (capacity - 1)) == 0);
+    memset(ring, 0, ndof_ring_size(capacity));
+    ring->mask = capacity - 1;
+    ring->head = 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_ring_push(NDOF_SampleRing *ring, const NDOF_Sample *sample)
+{
+    NDOF_RingSlot *slot = &ring->slots[(sample->seq - 1) & ring->mask];
+    
+    assert(sample->seq > ring->head);
+    ndof_seqlock_write(&slot->lock, slot->sample, sample, sizeof(NDOF_Sample));
+    ndof_atomic_store64(&ring->head, sample->seq);
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_ring_head(NDOF_SampleRing *ring)
+{
+    return ndof_atomic_load64(&ring->head);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ndof_ring_read(NDOF_SampleRing *ring, uint64_t *cursor,
+                      NDOF_Sample *out, size_t cap, uint64_t *dropped)
+{
+    uint64_t capacity = (uint64_t) ring->mask + 1;
+    uint64_t head = ndof_atomic_load64(&ring->head);
+    uint64_t next = *cursor;
+    size_t n = 0;
+    
+    if (next == 0)
+        next = 1;   /* seqs start at 1 */
+    
+    while (n < cap && next <= head)
+    {
+        NDOF_RingSlot *slot;
+        
+        if (head - next >= capacity)
+        {
+            /* lapped by the producer: skip to the oldest surviving sample */
+            uint64_t oldest = head - capacity + 1;
+            if (dropped)
+                *dropped += oldest - next;
+            next = oldest;
+        }
+        
+        slot = &ring->slots[(next - 1) & ring->mask];
+        ndof_seqlock_read(&slot->lock, slot->sample, &out[n], 
+                          sizeof(NDOF_Sample));
+        if (out[n].seq < next)
+        {
+            /* seq skipped by the producer (ring enabled while streaming) */
+            next++;
+            continue;
+        }
+        if (out[n].seq != next)
+        {
+            /* overwritten while we were getting to it, look at head again */
+            head = ndof_atomic_load64(&ring->head);
+            if (head - next < capacity)
+                head = next + capacity; /* force the skip above */
+            continue;
+        }
+        
+        n++;
+        next++;
+    }
+    
+    *cursor = next;
+    return n;
+}
+
+/* -------------------------------------------------------------------------- 
+    Samples are pushed in time order, so a binary search over the seqs still
+    in the ring finds the first one after since_ns. Slots overwritten while
+    we look at them are older than anything left, treat them as such.
+*/
+uint64_t ndof_ring_find(NDOF_SampleRing *ring, uint64_t since_ns)
+{
+    uint64_t capacity = (uint64_t) ring->mask + 1;
+    uint64_t head = ndof_atomic_load64(&ring->head);
+    uint64_t lo = (head > capacity ? head - capacity + 1 : 1);
+    uint64_t hi = head + 1;
+    
+    while (lo < hi)
+    {
+        NDOF_Sample sample;
+        uint64_t mid = lo + (hi - lo) / 2;
+        NDOF_RingSlot *slot = &ring->slots[(mid - 1) & ring->mask];
+        
+        ndof_seqlock_read(&slot->lock, slot->sample, &sample, 
+                          sizeof(NDOF_Sample));
+        if (sample.seq == mid && sample.time_ns > since_ns)
+            hi = mid;
+        else
+            lo = mid + 1;
+    }
+    
+    return lo;
+}
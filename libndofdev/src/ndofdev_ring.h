@@ -0,0 +1,91 @@
+/*
+ @file ndofdev_ring.h
+ @brief Single producer, multiple consumer broadcast ring of samples.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_ring_h__
+#define __ndofdev_ring_h__
+
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*  The producer writes every sample exactly once into the next slot and
+    never waits for consumers. Each consumer owns a cursor (the seq of the
+    next sample it wants) and copies slots out at its own pace; when it falls
+    more than `capacity' samples behind, the overwritten samples are counted
+    as dropped and the cursor jumps to the oldest sample still available.    */
+
+typedef struct NDOF_RingSlot {
+    NDOF_SeqLock lock;
+    ndof_word_t  sample[NDOF_WORD_COUNT(sizeof(NDOF_Sample))];
+} NDOF_RingSlot;
+
+typedef struct NDOF_SampleRing {
+    volatile uint64_t head;  /* seq of the most recent sample, 0 if none */
+    size_t mask;             /* capacity - 1, capacity is a power of 2 */
+    NDOF_RingSlot slots[1];  /* capacity of them: the ring is one block of 
+                                memory, that may be shared by processes */
+} NDOF_SampleRing;
+
+/** Capacity is rounded up to the next power of two. Returns NULL if out of
+ *  memory. */
+NDOF_SampleRing *ndof_ring_create(size_t capacity);
+void ndof_ring_dispose(NDOF_SampleRing *ring);
+
+/** Bytes taken by a ring of `capacity' samples, a power of two. */
+size_t ndof_ring_size(size_t capacity);
+
+/** Builds an empty ring of `capacity' samples, a power of two, in memory
+ *  allocated by the caller: at least ndof_ring_size(capacity) bytes. */
+void ndof_ring_init(NDOF_SampleRing *ring, size_t capacity);
+
+/** Producer side. sample->seq must be greater than ring->head; normally it
+ *  is ring->head + 1, seqs skipped are never reported to consumers. */
+void ndof_ring_push(NDOF_SampleRing *ring, const NDOF_Sample *sample);
+
+/** Consumer side. Copies up to `cap' samples starting at *cursor into `out',
+ *  advances *cursor past them and adds the number of overwritten samples
+ *  that were skipped to *dropped (if not NULL). Returns the # copied. */
+size_t ndof_ring_read(NDOF_SampleRing *ring, uint64_t *cursor,
+                      NDOF_Sample *out, size_t cap, uint64_t *dropped);
+
+/** Seq of the oldest sample still in the ring with a time_ns greater than 
+ *  since_ns, or ndof_ring_head() + 1 if there is none. O(log capacity). */
+uint64_t ndof_ring_find(NDOF_SampleRing *ring, uint64_t since_ns);
+
+/** Seq of the most recent sample pushed, 0 if none. */
+uint64_t ndof_ring_head(NDOF_SampleRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_ring_h__ */
@@ -0,0 +1,440 @@
+/*
+ @file ndofdev_shm.c
+ @brief State and samples of a device shared with other processes.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_backend.h"
+#include "ndofdev_external.h"
+#include "ndofdev_internal.h"
+#include "ndofdev_shm.h"
+#include "ndofdev_stream.h"
+
+#if NDOF_HAVE_SHM
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define NDOF_SHM_BATCH  32      /* samples copied at once by the readers */
+
+/*  The "shm" backend reads the device a process publishes with 
+    ndof_shm_publish: its one device replays the samples of the segment, 
+    with their original times, at each update. The publisher applied its
+    transform already, the device is identified by the segment name so 
+    that no model default applies twice. */
+typedef struct NDOF_ShmPrivate {
+    int             opened;
+    uint64_t        cursor;     /* seq of the next sample to replay */
+    NDOF_DeviceKey  curr_key;
+} NDOF_ShmPrivate;
+
+typedef struct NDOF_ShmBackend {
+    const NDOF_ShmSegment  *seg;    /* mapped read only */
+    size_t                  size;
+    char                    name[256];
+} NDOF_ShmBackend;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+#if NDOF_HAVE_SHM
+static uint32_t ndof_shm_layout();
+static int ndof_shm_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *platform_specific, int async);
+static void ndof_shm_stop(NDOF_Context *ctx);
+static void ndof_shm_cleanup(NDOF_Context *ctx);
+static int ndof_shm_devcount(NDOF_Context *ctx);
+static int ndof_shm_init_first(NDOF_Device *dev, void *param);
+static void ndof_shm_update(NDOF_Device *dev);
+static void ndof_shm_dispose(void *priv);
+static unsigned char ndof_shm_match(void *priv1, void *priv2);
+static void ndof_shm_dump(FILE *stream, NDOF_Device *dev);
+static int ndof_shm_attach(NDOF_ShmBackend *be, const char *name);
+static void ndof_shm_open(NDOF_Device *dev);
+#endif
+
+#if NDOF_HAVE_SHM
+/* -------------------------------------------------------------------------- 
+    Sizes the two sides must agree on: a 32 bit reader cannot read what a
+    64 bit publisher wrote. */
+static uint32_t ndof_shm_layout()
+{
+    return (uint32_t) (sizeof(NDOF_ShmSegment) 
+                       | sizeof(NDOF_RingSlot) << 12 
+                       | sizeof(ndof_word_t) << 24);
+}
+#endif
+
+/* -------------------------------------------------------------------------- */
+int ndof_shm_publish(NDOF_Device *dev, const char *name)
+{
+#if NDOF_HAVE_SHM
+    NDOF_DeviceStream *s;
+    NDOF_ShmPublisher *pub;
+    NDOF_ShmSegment *seg;
+    NDOF_State state;
+    void *p;
+    int fd;
+    
+    if (dev == NULL || dev->stream_data == NULL || name == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    if (ndof_atomic_loadptr((void **) &s->shm))
+        return 0;
+    
+    pub = (NDOF_ShmPublisher *) calloc(1, sizeof(NDOF_ShmPublisher));
+    if (pub == NULL)
+        return -1;
+    pub->size = offsetof(NDOF_ShmSegment, ring) 
+                + ndof_ring_size(NDOF_SHM_CAPACITY);
+    snprintf(pub->name, sizeof(pub->name), "%s", name);
+    
+    /* an object left by a process that died is not ours to remove */
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "libndofdev: cannot create %s: %s\n", 
+                name, strerror(errno));
+        free(pub);
+        return -1;
+    }
+    p = MAP_FAILED;
+    if (ftruncate(fd, (off_t) pub->size) == 0)
+        p = mmap(NULL, pub->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+    {
+        shm_unlink(name);
+        free(pub);
+        return -1;
+    }
+    
+    seg = pub->seg = (NDOF_ShmSegment *) p;
+    seg->version = NDOF_SHM_VERSION;
+    seg->layout = ndof_shm_layout();
+    seg->capacity = NDOF_SHM_CAPACITY;
+    snprintf(seg->manufacturer, sizeof(seg->manufacturer), "%s", 
+             dev->manufacturer);
+    snprintf(seg->product, sizeof(seg->product), "%s", dev->product);
+    seg->axes_count = (int32_t) dev->axes_count;
+    seg->btn_count = (int32_t) dev->btn_count;
+    seg->axes_min = dev->axes_min;
+    seg->axes_max = dev->axes_max;
+    seg->key = ndof_stream_key(dev);
+    
+    /* samples published before the segment existed are not in its ring,
+       the latest one is its state */
+    ndof_read_state(dev, &state);
+    ndof_seqlock_write(&seg->state_lock, seg->state, &state, sizeof(state));
+    ndof_ring_init(&seg->ring, NDOF_SHM_CAPACITY);
+    seg->ring.head = state.seq;
+    seg->valid = state.valid;
+    ndof_atomic_store32(&seg->magic, NDOF_SHM_MAGIC);
+    
+    /* someone else may have been faster, with another name */
+    if (!ndof_atomic_casptr((void **) &s->shm, NULL, pub))
+        ndof_shm_close(pub);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_shm_write(NDOF_ShmPublisher *pub, const NDOF_Sample *sample)
+{
+    NDOF_ShmSegment *seg = pub->seg;
+    NDOF_State state;
+    
+    memset(&state, 0, sizeof(state));
+    state.seq = sample->seq;
+    state.time_ns = sample->time_ns;
+    memcpy(state.axes, sample->axes, sizeof(state.axes));
+    state.buttons = sample->buttons;
+    state.valid = (unsigned char) ndof_atomic_load32(&seg->valid);
+    ndof_seqlock_write(&seg->state_lock, seg->state, &state, sizeof(state));
+    ndof_ring_push(&seg->ring, sample);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_shm_set_valid(NDOF_ShmPublisher *pub, unsigned char valid)
+{
+    ndof_atomic_store32(&pub->seg->valid, valid);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_shm_close(NDOF_ShmPublisher *pub)
+{
+    if (pub)
+    {
+        ndof_shm_set_valid(pub, 0);
+#if NDOF_HAVE_SHM
+        munmap(pub->seg, pub->size);
+        shm_unlink(pub->name);
+#endif
+        free(pub);
+    }
+}
+
+#if NDOF_HAVE_SHM
+
+/* -------------------------------------------------------------------------- 
+    `platform_specific' is the name the device was published with. */
+static int ndof_shm_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *platform_specific, int async)
+{
+    NDOF_ShmBackend *be;
+    
+    (void) in_removal_cb;
+    (void) async;
+    ndof_shm_cleanup(ctx);
+    be = (NDOF_ShmBackend *) calloc(1, sizeof(NDOF_ShmBackend));
+    if (be == NULL)
+        return -1;
+    
+    if (platform_specific == NULL 
+        || ndof_shm_attach(be, (const char *) platform_specific) != 0)
+    {
+        fprintf(stderr, "libndofdev: no device published as %s\n", 
+                (platform_specific ? (const char *) platform_specific : ""));
+        free(be);
+        return -1;
+    }
+    ctx->backend = be;
+    
+    if (in_add_cb)
+    {
+        NDOF_Device *dev = ndof_context_create_device(ctx);
+        
+        if (dev)
+        {
+            ndof_shm_open(dev);
+            if (ndof_notify_added(in_add_cb, dev) == NDOF_DISCARD_HOTPLUGGED)
+                ndof_destroy(dev);
+        }
+    }
+    
+    ndof_init_done(ctx, 0);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Maps the segment read only and checks it was written by a publisher
+    built alike. Returns 0 if ok. */
+static int ndof_shm_attach(NDOF_ShmBackend *be, const char *name)
+{
+    const NDOF_ShmSegment *seg;
+    struct stat st;
+    void *p;
+    int fd = shm_open(name, O_RDONLY, 0);
+    
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) != 0 
+        || (size_t) st.st_size < offsetof(NDOF_ShmSegment, ring) 
+                                 + ndof_ring_size(1))
+    {
+        close(fd);
+        return -1;
+    }
+    p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -1;
+    
+    seg = (const NDOF_ShmSegment *) p;
+    if (ndof_atomic_load32(&seg->magic) != NDOF_SHM_MAGIC
+        || seg->version != NDOF_SHM_VERSION
+        || seg->layout != ndof_shm_layout()
+        || seg->capacity == 0 || (seg->capacity & (seg->capacity - 1))
+        || seg->ring.mask != seg->capacity - 1
+        || (size_t) st.st_size < offsetof(NDOF_ShmSegment, ring) 
+                                 + ndof_ring_size(seg->capacity))
+    {
+        munmap(p, (size_t) st.st_size);
+        return -1;
+    }
+    
+    be->seg = seg;
+    be->size = (size_t) st.st_size;
+    snprintf(be->name, sizeof(be->name), "%s", name);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_shm_stop(NDOF_Context *ctx)
+{
+    (void) ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_shm_cleanup(NDOF_Context *ctx)
+{
+    NDOF_ShmBackend *be = (NDOF_ShmBackend *) ctx->backend;
+    
+    if (be)
+    {
+        munmap((void *) be->seg, be->size);
+        free(be);
+        ctx->backend = NULL;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_shm_devcount(NDOF_Context *ctx)
+{
+    return (ctx->backend ? 1 : 0);
+}
+
+/* -------------------------------------------------------------------------- 
+    The segment must have been mapped by libinit. */
+static int ndof_shm_init_first(NDOF_Device *dev, void *param)
+{
+    (void) param;
+    if (dev->context->backend == NULL)
+    {
+        fprintf(stderr, "libndofdev: no NDOF HID device found.\n");
+        return -1;
+    }
+    
+    ndof_shm_open(dev);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    The device starts where the publisher's is: dev->axes and dev->buttons
+    hold its state, and the next update replays what came after. */
+static void ndof_shm_open(NDOF_Device *dev)
+{
+    NDOF_ShmBackend *be = (NDOF_ShmBackend *) dev->context->backend;
+    NDOF_ShmPrivate *priv = (NDOF_ShmPrivate *) dev->private_data;
+    const NDOF_ShmSegment *seg = be->seg;
+    NDOF_State state;
+    int i;
+    
+    ndof_seqlock_read(&seg->state_lock, seg->state, &state, sizeof(state));
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        dev->axes[i] = state.axes[i];
+    for (i = 0; i < NDOF_MAX_BUTTONS_COUNT; i++)
+        dev->buttons[i] = (long) ((state.buttons >> i) & 1);
+    
+    priv->opened = 1;
+    priv->cursor = state.seq + 1;
+    priv->curr_key = ndof_device_key(0, 0, 0x01, 0x08, 0, be->name);
+    dev->axes_count = seg->axes_count;
+    dev->btn_count = seg->btn_count;
+    dev->axes_min = (long) seg->axes_min;
+    dev->axes_max = (long) seg->axes_max;
+    snprintf(dev->manufacturer, sizeof(dev->manufacturer), "%s", 
+             seg->manufacturer);
+    snprintf(dev->product, sizeof(dev->product), "%s", seg->product);
+    ndof_stream_identify(dev, &priv->curr_key);
+    ndof_stream_set_valid(dev, 
+        (unsigned char) ndof_atomic_load32(&seg->valid));
+}
+
+/* -------------------------------------------------------------------------- 
+    Plain loads from the mapping: no system call, however many readers. */
+static void ndof_shm_update(NDOF_Device *dev)
+{
+    NDOF_ShmBackend *be = (NDOF_ShmBackend *) dev->context->backend;
+    NDOF_ShmPrivate *priv = (NDOF_ShmPrivate *) dev->private_data;
+    NDOF_SampleRing *ring;
+    NDOF_Sample batch[NDOF_SHM_BATCH];
+    unsigned char valid;
+    size_t n, k;
+    int i;
+    
+    if (!priv->opened || be == NULL)
+        return;
+    
+    valid = (unsigned char) ndof_atomic_load32(&be->seg->valid);
+    if (valid != ndof_stream_is_valid(dev))
+        ndof_stream_set_valid(dev, valid);
+    
+    /* reading the ring writes nothing to it */
+    ring = (NDOF_SampleRing *) &be->seg->ring;
+    while ((n = ndof_ring_read(ring, &priv->cursor, batch, 
+                               NDOF_SHM_BATCH, NULL)) > 0)
+    {
+        for (k = 0; k < n; k++)
+        {
+            for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+                dev->axes[i] = batch[k].axes[i];
+            for (i = 0; i < NDOF_MAX_BUTTONS_COUNT; i++)
+                dev->buttons[i] = (long) ((batch[k].buttons >> i) & 1);
+            ndof_stream_publish_at(dev, batch[k].time_ns);
+        }
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_shm_dispose(void *priv)
+{
+    free(priv);
+}
+
+/* -------------------------------------------------------------------------- */
+static unsigned char ndof_shm_match(void *priv1, void *priv2)
+{
+    NDOF_ShmPrivate *d1 = (NDOF_ShmPrivate *) priv1;
+    NDOF_ShmPrivate *d2 = (NDOF_ShmPrivate *) priv2;
+    
+    return (d1 && d2 && ndof_key_equal(&d1->curr_key, &d2->curr_key));
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_shm_dump(FILE *stream, NDOF_Device *dev)
+{
+    NDOF_ShmBackend *be = (NDOF_ShmBackend *) dev->context->backend;
+    
+    if (be)
+        fprintf(stream, "    segment=%s head=%llu\n", be->name,
+                (unsigned long long) ndof_ring_head(
+                    (NDOF_SampleRing *) &be->seg->ring));
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_Backend ndof_backend_shm = {
+    "shm", sizeof(NDOF_ShmPrivate), 0,
+    ndof_shm_libinit, ndof_shm_stop, ndof_shm_cleanup,
+    ndof_shm_devcount, ndof_shm_init_first, ndof_shm_update, 
+    ndof_shm_dispose, ndof_shm_match, ndof_shm_dump
+};
+
+#endif /* NDOF_HAVE_SHM */
@@ -0,0 +1,101 @@
+/*
+ @file ndofdev_shm.h
+ @brief State and samples of a device shared with other processes.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_shm_h__
+#define __ndofdev_shm_h__
+
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+#include "ndofdev_ring.h"
+#include "ndofdev_identity.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !defined(_WIN32) && !defined(WIN32)
+#define NDOF_HAVE_SHM 1     /* POSIX shared memory */
+#endif
+
+#define NDOF_SHM_MAGIC      0x464f444eu     /* "NDOF" */
+#define NDOF_SHM_VERSION    1
+#define NDOF_SHM_CAPACITY   1024            /* samples in the ring */
+
+/*  The publisher maps the segment read/write, the readers read only: they
+    never write a byte of it, so any number of them cost the publisher
+    nothing, and they read it with plain loads under the seqlocks, with no
+    system call. Everything but `magic' and what follows `valid' is 
+    written once, before `magic' is set. Both sides must be built alike,
+    which `layout' checks. */
+typedef struct NDOF_ShmSegment {
+    volatile uint32_t magic;    /* NDOF_SHM_MAGIC once the rest is ready */
+    uint32_t version;
+    uint32_t layout;            /* see ndof_shm_layout */
+    uint32_t capacity;          /* of the ring, a power of 2 */
+    
+    /* the published device */
+    char            manufacturer[256];
+    char            product[256];
+    int32_t         axes_count;
+    int32_t         btn_count;
+    int64_t         axes_min;
+    int64_t         axes_max;
+    NDOF_DeviceKey  key;
+    
+    /* written by the publisher's updating thread only */
+    volatile uint32_t valid;
+    NDOF_SeqLock      state_lock;
+    ndof_word_t       state[NDOF_WORD_COUNT(sizeof(NDOF_State))];
+    NDOF_SampleRing   ring;     /* last: its slots follow */
+} NDOF_ShmSegment;
+
+/** Publisher side, pointed by the device's stream once ndof_shm_publish
+ *  succeeded. */
+typedef struct NDOF_ShmPublisher {
+    NDOF_ShmSegment *seg;
+    size_t           size;
+    char             name[256];
+} NDOF_ShmPublisher;
+
+/** Mirrors a sample just published by dev into its segment. Called by the
+ *  updating thread only. */
+void ndof_shm_write(NDOF_ShmPublisher *pub, const NDOF_Sample *sample);
+
+/** Mirrors a change of dev->valid. */
+void ndof_shm_set_valid(NDOF_ShmPublisher *pub, unsigned char valid);
+
+/** Marks the device invalid for the readers, then unmaps and removes the
+ *  segment. Readers keep their mapping until they clean up. */
+void ndof_shm_close(NDOF_ShmPublisher *pub);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_shm_h__ */
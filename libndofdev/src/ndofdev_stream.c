@@ -0,0 +1,540 @@
+/*
+ @file ndofdev_stream.c
+ @brief Cross platform sample pipeline shared by all the backends.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ndofdev_external.h"
+#include "ndofdev_stream.h"
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static size_t ndof_format_size(int format);
+static void ndof_stream_push(NDOF_Device *dev, const long *axes_in, 
+                             const long *buttons, long *axes, 
+                             uint64_t time_ns);
+static void ndof_write_bound_state(NDOF_Device *dev, const long *axes,
+                                   const NDOF_Binding *b);
+static void ndof_wake_waiters(NDOF_DeviceStream *s);
+static void ndof_stream_set_transform(NDOF_DeviceStream *s, 
+                                      const float *matrix, const float *offset);
+
+/* -------------------------------------------------------------------------- */
+NDOF_DeviceStream *ndof_stream_create()
+{
+    NDOF_DeviceStream *s = 
+        (NDOF_DeviceStream *) malloc(sizeof(NDOF_DeviceStream));
+    if (s == NULL)
+        return NULL;
+    
+    memset(s, 0, sizeof(NDOF_DeviceStream));
+    ndof_mutex_init(&s->config_lock);
+    ndof_pose_init(&s->pose);
+    return s;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_dispose(NDOF_DeviceStream *s)
+{
+    if (s)
+    {
+        free(s->binding);
+        ndof_ring_dispose(s->ring);
+        ndof_shm_close(s->shm);
+        ndof_pose_dispose(&s->pose);
+        ndof_mutex_destroy(&s->config_lock);
+        free(s);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_publish(NDOF_Device *dev)
+{
+    ndof_stream_publish_at(dev, ndof_time_ns());
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_publish_at(NDOF_Device *dev, uint64_t time_ns)
+{
+    ndof_stream_push(dev, dev->axes, dev->buttons, dev->axes, time_ns);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_publish_values(NDOF_Device *dev, const long *axes,
+                                const long *buttons, uint64_t time_ns)
+{
+    long out[NDOF_MAX_AXES_COUNT];
+    
+    ndof_stream_push(dev, axes, buttons, out, time_ns);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_fetch(NDOF_Device *dev)
+{
+    NDOF_State state;
+    int i;
+    
+    if (ndof_read_state(dev, &state) != 0)
+        return;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        dev->axes[i] = state.axes[i];
+    for (i = 0; i < NDOF_MAX_BUTTONS_COUNT; i++)
+        dev->buttons[i] = (state.buttons >> i) & 1;
+}
+
+/* -------------------------------------------------------------------------- 
+    Publishes a sample of the values `axes_in' and `buttons', the former 
+    transformed into `axes', which may be the same. */
+static void ndof_stream_push(NDOF_Device *dev, const long *axes_in, 
+                             const long *buttons, long *axes, 
+                             uint64_t time_ns)
+{
+    int i;
+    NDOF_Sample sample;
+    NDOF_State state;
+    NDOF_Binding *binding;
+    NDOF_SampleRing *ring;
+    NDOF_ShmPublisher *shm;
+    NDOF_DeviceStream *s = (NDOF_DeviceStream *) dev->stream_data;
+    if (s == NULL)
+        return;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        axes[i] = axes_in[i];
+    
+    if (ndof_atomic_load32(&s->transform_on))
+    {
+        NDOF_Transform t;
+        ndof_seqlock_read(&s->transform_lock, s->transform, &t, sizeof(t));
+        
+        /* axes the device lacks are not refreshed: they still hold the 
+           previous output, which must not feed back */
+        for (i = dev->axes_count; i > 0 && i < NDOF_MAX_AXES_COUNT; i++)
+            axes[i] = 0;
+        ndof_transform_apply(&t, axes, axes, dev->axes_min, dev->axes_max);
+    }
+    
+    /* announced before the binding is looked at, for ndof_bind_state to 
+       know when it is no longer in use */
+    ndof_atomic_add32(&s->bind_seq, 1);
+    ndof_atomic_fence();
+    binding = (NDOF_Binding *) ndof_atomic_loadptr((void **) &s->binding);
+    if (binding)
+        ndof_write_bound_state(dev, axes, binding);
+    ndof_atomic_add32(&s->bind_seq, 1);
+    
+    memset(&sample, 0, sizeof(sample));
+    sample.seq = ++s->seq;
+    sample.time_ns = time_ns;
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        sample.axes[i] = axes[i];
+    for (i = 0; i < dev->btn_count && i < NDOF_MAX_BUTTONS_COUNT; i++)
+    {
+        if (buttons[i])
+            sample.buttons |= 1UL << i;
+    }
+    
+    memset(&state, 0, sizeof(state));
+    state.seq = sample.seq;
+    state.time_ns = sample.time_ns;
+    memcpy(state.axes, sample.axes, sizeof(state.axes));
+    state.buttons = sample.buttons;
+    ndof_seqlock_write(&s->state_lock, s->state, &state, sizeof(state));
+    ndof_predictor_update(&s->predictor, &sample);
+    ndof_pose_integrate(&s->pose, &sample);
+    
+    ring = (NDOF_SampleRing *) ndof_atomic_loadptr((void **) &s->ring);
+    if (ring)
+        ndof_ring_push(ring, &sample);
+    
+    shm = (NDOF_ShmPublisher *) ndof_atomic_loadptr((void **) &s->shm);
+    if (shm)
+        ndof_shm_write(shm, &sample);
+    
+    ndof_wake_waiters(s);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_identify(NDOF_Device *dev, const NDOF_DeviceKey *key)
+{
+    NDOF_DeviceStream *s = (NDOF_DeviceStream *) dev->stream_data;
+    if (s == NULL)
+        return;
+    
+    ndof_mutex_lock(&s->config_lock);
+    s->key = *key;
+    if (!s->transform_custom)
+        ndof_stream_set_transform(s, 
+            ndof_transform_default(NDOF_KEY_VENDOR_ID(*key), 
+                                   NDOF_KEY_PRODUCT_ID(*key)), NULL);
+    ndof_mutex_unlock(&s->config_lock);
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_DeviceKey ndof_stream_key(NDOF_Device *dev)
+{
+    NDOF_DeviceStream *s = (NDOF_DeviceStream *) dev->stream_data;
+    NDOF_DeviceKey key = { 0, 0 };
+    
+    if (s)
+    {
+        ndof_mutex_lock(&s->config_lock);
+        key = s->key;
+        ndof_mutex_unlock(&s->config_lock);
+    }
+    return key;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_set_transform(NDOF_Device *dev, const float *matrix, 
+                       const float *offset)
+{
+    NDOF_DeviceStream *s;
+    
+    if (dev == NULL || dev->stream_data == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    ndof_mutex_lock(&s->config_lock);
+    s->transform_custom = (matrix != NULL || offset != NULL);
+    if (matrix == NULL)
+        matrix = ndof_transform_default(NDOF_KEY_VENDOR_ID(s->key), 
+                                        NDOF_KEY_PRODUCT_ID(s->key));
+    ndof_stream_set_transform(s, matrix, offset);
+    ndof_mutex_unlock(&s->config_lock);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Called under config_lock, which serializes the writers of the seqlock. */
+static void ndof_stream_set_transform(NDOF_DeviceStream *s, 
+                                      const float *matrix, const float *offset)
+{
+    NDOF_Transform t;
+    int identity = ndof_transform_set(&t, matrix, offset);
+    
+    ndof_seqlock_write(&s->transform_lock, s->transform, &t, sizeof(t));
+    ndof_atomic_store32(&s->transform_on, !identity);
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_wake_waiters(NDOF_DeviceStream *s)
+{
+    ndof_atomic_add32(&s->wake_seq, 1);
+    ndof_atomic_fence();
+    
+    /* the common case with nobody waiting costs no system call */
+    if (ndof_atomic_load32(&s->waiters))
+        ndof_wake_address(&s->wake_seq);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_wait(NDOF_Device *dev, uint64_t deadline_ns)
+{
+    NDOF_DeviceStream *s;
+    uint32_t seq;
+    int timedout = 0;
+    
+    if (dev == NULL || dev->stream_data == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    seq = ndof_atomic_load32(&s->wake_seq);
+    ndof_atomic_add32(&s->waiters, 1);
+    ndof_atomic_fence();
+    
+    while (ndof_atomic_load32(&s->wake_seq) == seq)
+    {
+        if (ndof_wait_on_address(&s->wake_seq, seq, deadline_ns))
+        {
+            timedout = (ndof_atomic_load32(&s->wake_seq) == seq);
+            break;
+        }
+    }
+    
+    ndof_atomic_add32(&s->waiters, (uint32_t) -1);
+    return timedout;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_read_state(NDOF_Device *dev, NDOF_State *out)
+{
+    NDOF_DeviceStream *s;
+    
+    if (dev == NULL || dev->stream_data == NULL || out == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    ndof_seqlock_read(&s->state_lock, s->state, out, sizeof(NDOF_State));
+    out->valid = ndof_stream_is_valid(dev);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_enable_ring(NDOF_Device *dev, size_t capacity)
+{
+    NDOF_DeviceStream *s;
+    NDOF_SampleRing *ring;
+    NDOF_State state;
+    
+    if (dev == NULL || dev->stream_data == NULL || capacity == 0)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    if (ndof_atomic_loadptr((void **) &s->ring))
+        return 0;
+    
+    ring = ndof_ring_create(capacity);
+    if (ring == NULL)
+        return -1;
+    
+    /* samples published before the ring existed are not in it */
+    ndof_read_state(dev, &state);
+    ring->head = state.seq;
+    
+    /* someone else may have been faster */
+    if (!ndof_atomic_casptr((void **) &s->ring, NULL, ring))
+        ndof_ring_dispose(ring);
+    
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+NDOF_Subscriber *ndof_subscribe(NDOF_Device *dev)
+{
+    NDOF_Subscriber *sub;
+    NDOF_DeviceStream *s;
+    
+    if (ndof_enable_ring(dev, NDOF_DEFAULT_RING_CAPACITY) != 0)
+        return NULL;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    sub = (NDOF_Subscriber *) malloc(sizeof(NDOF_Subscriber));
+    if (sub == NULL)
+        return NULL;
+    
+    sub->ring = (NDOF_SampleRing *) ndof_atomic_loadptr((void **) &s->ring);
+    sub->cursor = ndof_ring_head(sub->ring) + 1;
+    return sub;
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ndof_subscriber_read(NDOF_Subscriber *sub, NDOF_Sample *out, 
+                            size_t cap, uint64_t *dropped)
+{
+    uint64_t lost = 0;
+    size_t n;
+    
+    if (sub == NULL || out == NULL)
+        return 0;
+    
+    n = ndof_ring_read(sub->ring, &sub->cursor, out, cap, &lost);
+    if (dropped)
+        *dropped = lost;
+    return n;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_unsubscribe(NDOF_Subscriber *sub)
+{
+    if (sub)
+        free(sub);
+}
+
+/* -------------------------------------------------------------------------- */
+size_t ndof_get_history(NDOF_Device *dev, uint64_t since_ns, 
+                        NDOF_Sample *out, size_t cap)
+{
+    NDOF_SampleRing *ring;
+    uint64_t cursor;
+    
+    if (out == NULL || cap == 0 
+        || ndof_enable_ring(dev, NDOF_DEFAULT_RING_CAPACITY) != 0)
+        return 0;
+    
+    ring = (NDOF_SampleRing *) 
+        ndof_atomic_loadptr((void **) &((NDOF_DeviceStream *)dev->stream_data)->ring);
+    cursor = ndof_ring_find(ring, since_ns);
+    return ndof_ring_read(ring, &cursor, out, cap, NULL);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_stream_set_valid(NDOF_Device *dev, unsigned char valid)
+{
+    NDOF_DeviceStream *s = (NDOF_DeviceStream *) dev->stream_data;
+    NDOF_ShmPublisher *shm;
+    
+    ndof_atomic_store8(&dev->valid, valid);
+    if (s)
+    {
+        shm = (NDOF_ShmPublisher *) ndof_atomic_loadptr((void **) &s->shm);
+        if (shm)
+            ndof_shm_set_valid(shm, valid);
+        ndof_wake_waiters(s);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+unsigned char ndof_stream_is_valid(NDOF_Device *dev)
+{
+    return ndof_atomic_load8(&dev->valid);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_bind_state(NDOF_Device *dev, void *dst, size_t stride, int format)
+{
+    NDOF_DeviceStream *s;
+    NDOF_Binding *binding = NULL, *old;
+    size_t elem_size;
+    uint32_t seq;
+    
+    if (dev == NULL || dev->stream_data == NULL)
+        return -1;
+    
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    if (dst)
+    {
+        elem_size = ndof_format_size(format);
+        if (elem_size == 0)
+            return -1;
+        
+        if (stride == 0)
+            stride = elem_size;
+        else if (stride < elem_size)
+            return -1;  /* would overlap consecutive axes */
+        
+        binding = (NDOF_Binding *) malloc(sizeof(NDOF_Binding));
+        if (binding == NULL)
+            return -1;
+        binding->dst = dst;
+        binding->stride = stride;
+        binding->format = format;
+    }
+    
+    old = (NDOF_Binding *) ndof_atomic_xchgptr((void **) &s->binding, binding);
+    
+    /* a sample being written may still use the old binding: waited for, 
+       the caller may then reuse its memory. Never waits on the updating
+       thread itself */
+    seq = ndof_atomic_load32(&s->bind_seq);
+    while ((seq & 1) && ndof_atomic_load32(&s->bind_seq) == seq)
+        ndof_sleep_ns(1000);
+    
+    free(old);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static size_t ndof_format_size(int format)
+{
+    switch (format & ~NDOF_FORMAT_NORMALIZED)
+    {
+    case NDOF_FORMAT_INT16:
+        return sizeof(short);
+    case NDOF_FORMAT_INT32:
+        return sizeof(int);
+    case NDOF_FORMAT_FLOAT32:
+        return sizeof(float);
+    default:
+        return 0;
+    }
+}
+
+/* -------------------------------------------------------------------------- 
+    Converts the axes into the bound format. The destination may be packed
+    or interleaved with other application data, so values are written with
+    memcpy to avoid relying on the alignment of `dst'.
+*/
+static void ndof_write_bound_state(NDOF_Device *dev, const long *axes,
+                                   const NDOF_Binding *b)
+{
+    int i;
+    unsigned char *dst = (unsigned char *) b->dst;
+    int normalized = (b->format & NDOF_FORMAT_NORMALIZED) != 0;
+    double center = 0.5 * ((double)dev->axes_max + (double)dev->axes_min);
+    double half_range = 0.5 * ((double)dev->axes_max - (double)dev->axes_min);
+    
+    if (half_range <= 0.0)
+        half_range = 1.0;
+
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++, dst += b->stride)
+    {
+        double v = (double) axes[i];
+        
+        if (normalized)
+        {
+            v = (v - center) / half_range;
+            if (v > 1.0)
+                v = 1.0;
+            else if (v < -1.0)
+                v = -1.0;
+        }
+        
+        switch (b->format & ~NDOF_FORMAT_NORMALIZED)
+        {
+        case NDOF_FORMAT_INT16:
+        {
+            short out;
+            if (normalized)
+                v *= 32767.0;
+            v = (v < 0.0 ? v - 0.5 : v + 0.5);
+            if (v > 32767.0)
+                v = 32767.0;
+            else if (v < -32768.0)
+                v = -32768.0;
+            out = (short) v;
+            memcpy(dst, &out, sizeof(out));
+            break;
+        }
+        case NDOF_FORMAT_INT32:
+        {
+            int out;
+            if (normalized)
+                v *= 2147483647.0;
+            v = (v < 0.0 ? v - 0.5 : v + 0.5);
+            if (v > 2147483647.0)
+                v = 2147483647.0;
+            else if (v < -2147483648.0)
+                v = -2147483648.0;
+            out = (int) v;
+            memcpy(dst, &out, sizeof(out));
+            break;
+        }
+        case NDOF_FORMAT_FLOAT32:
+        {
+            float out = (float) v;
+            memcpy(dst, &out, sizeof(out));
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,140 @@
+/*
+ @file ndofdev_stream.h
+ @brief Cross platform sample pipeline shared by all the backends.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_stream_h__
+#define __ndofdev_stream_h__
+
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+#include "ndofdev_ring.h"
+#include "ndofdev_predict.h"
+#include "ndofdev_pose.h"
+#include "ndofdev_transform.h"
+#include "ndofdev_identity.h"
+#include "ndofdev_shm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_DEFAULT_RING_CAPACITY  1024  /* 1 sec of samples at 1 kHz */
+
+/** Caller memory bound with ndof_bind_state. Never changed once bound: 
+ *  binding again replaces it. */
+typedef struct NDOF_Binding {
+    void   *dst;
+    size_t  stride;       /* bytes between two axes in dst */
+    int     format;       /* NDOF_StateFormat, possibly NORMALIZED */
+} NDOF_Binding;
+
+/** Per device state of the sample pipeline. Pointed by NDOF_Device's
+ *  stream_data; allocated by ndof_create, released by ndof_destroy. */
+typedef struct NDOF_DeviceStream {
+    /* current binding, NULL if none. bind_seq is odd while the updating 
+       thread writes through it */
+    NDOF_Binding *volatile binding;
+    volatile uint32_t      bind_seq;
+
+    /* device identity, see ndof_stream_identify. Written under config_lock */
+    NDOF_DeviceKey key;
+    
+    /* axes transform, applied first. Set under config_lock, read by the 
+       updating thread through transform_lock */
+    ndof_mutex_t      config_lock;
+    int               transform_custom;
+    volatile uint32_t transform_on;
+    NDOF_SeqLock      transform_lock;
+    ndof_word_t       transform[NDOF_WORD_COUNT(sizeof(NDOF_Transform))];
+
+    /* latest state, written by the updating thread only */
+    uint64_t     seq;
+    NDOF_SeqLock state_lock;
+    ndof_word_t  state[NDOF_WORD_COUNT(sizeof(NDOF_State))];
+    
+    /* motion model of the axes, see ndof_predict */
+    NDOF_Predictor predictor;
+    
+    /* optional pose integration, see ndof_pose_configure */
+    NDOF_PoseIntegrator pose;
+    
+    /* optional ring of all the samples, see ndof_enable_ring */
+    NDOF_SampleRing *volatile ring;
+    
+    /* optional copy for other processes, see ndof_shm_publish */
+    NDOF_ShmPublisher *volatile shm;
+    
+    /* ndof_wait: bumped at every publish, waited on by the waiters */
+    volatile uint32_t wake_seq;
+    volatile uint32_t waiters;
+} NDOF_DeviceStream;
+
+struct NDOF_Subscriber {
+    NDOF_SampleRing *ring;
+    uint64_t cursor;
+};
+
+/** Returns NULL if out of memory. */
+NDOF_DeviceStream *ndof_stream_create();
+void ndof_stream_dispose(NDOF_DeviceStream *stream);
+
+/** Records the identity of dev and applies the defaults of its model, such
+ *  as its axes transform. Backends call this when they open a device. */
+void ndof_stream_identify(NDOF_Device *dev, const NDOF_DeviceKey *key);
+
+/** Identity of dev, or the null key if it was never identified. */
+NDOF_DeviceKey ndof_stream_key(NDOF_Device *dev);
+
+/** Pushes the values just read into dev->axes and dev->buttons through
+ *  the pipeline. Backends call this at the end of every successful read. */
+void ndof_stream_publish(NDOF_Device *dev);
+
+/** Same, for values read at time_ns rather than now: backends passing on
+ *  samples read elsewhere, in the ndof_time_ns() time base. */
+void ndof_stream_publish_at(NDOF_Device *dev, uint64_t time_ns);
+
+/** Same, for values read on a thread other than the one updating dev: 
+ *  dev->axes and dev->buttons are left alone. `buttons' is laid out as in
+ *  NDOF_Device. */
+void ndof_stream_publish_values(NDOF_Device *dev, const long *axes,
+                                const long *buttons, uint64_t time_ns);
+
+/** Copies the latest state published into dev->axes and dev->buttons: 
+ *  the update of backends that publish on a thread of their own. */
+void ndof_stream_fetch(NDOF_Device *dev);
+
+/** Changes dev->valid. Unlike the sample data, validity can be changed by
+ *  the hotplug thread while another thread is updating or reading dev. */
+void ndof_stream_set_valid(NDOF_Device *dev, unsigned char valid);
+unsigned char ndof_stream_is_valid(NDOF_Device *dev);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_stream_h__ */
@@ -0,0 +1,357 @@
+/*
+ @file ndofdev_sync.c
+ @brief Atomics, threads and timing primitives used by the portable code.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "ndofdev_external.h"
+#include "ndofdev_sync.h"
+
+#if defined(_WIN32) || defined(WIN32)
+#include <process.h>
+#else
+#include <time.h>
+#include <errno.h>
+#if TARGET_OS_MAC
+#include <mach/mach_time.h>
+#elif defined(__linux__)
+#include <unistd.h>
+#include <limits.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#define NDOF_HAVE_FUTEX 1
+#endif
+#endif
+
+/* -------------------------------------------------------------------------- */
+void ndof_seqlock_write(NDOF_SeqLock *lock, volatile ndof_word_t *dst,
+                        const void *src, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) src;
+    size_t i, n = NDOF_WORD_COUNT(size);
+    uint32_t seq = ndof_atomic_load_relaxed(&lock->seq);
+
+    /* odd sequence: readers that overlap with us will retry */
+    ndof_atomic_store_relaxed(&lock->seq, seq + 1);
+    ndof_atomic_fence_release();
+
+    for (i = 0; i < n; i++)
+    {
+        ndof_word_t w = 0;
+        size_t len = size - i * sizeof(ndof_word_t);
+        memcpy(&w, bytes + i * sizeof(ndof_word_t), 
+               len < sizeof(w) ? len : sizeof(w));
+        ndof_atomic_store_relaxed(&dst[i], w);
+    }
+
+    ndof_atomic_store32(&lock->seq, seq + 2);
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_seqlock_read(const NDOF_SeqLock *lock, 
+                       const volatile ndof_word_t *src, void *dst, size_t size)
+{
+    unsigned char *bytes = (unsigned char *) dst;
+    size_t i, n = NDOF_WORD_COUNT(size);
+    uint32_t seq0, seq1;
+
+    for (;;)
+    {
+        seq0 = ndof_atomic_load32(&lock->seq);
+        if (seq0 & 1)
+        {
+            ndof_cpu_relax();
+            continue;
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            ndof_word_t w = ndof_atomic_load_relaxed(&src[i]);
+            size_t len = size - i * sizeof(ndof_word_t);
+            memcpy(bytes + i * sizeof(ndof_word_t), &w, 
+                   len < sizeof(w) ? len : sizeof(w));
+        }
+
+        ndof_atomic_fence_acquire();
+        seq1 = ndof_atomic_load_relaxed(&lock->seq);
+        if (seq0 == seq1)
+            break;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+uint64_t ndof_time_ns()
+{
+#if TARGET_OS_MAC
+    static mach_timebase_info_data_t tb = {0, 0};
+    uint64_t t = mach_absolute_time();
+    if (tb.denom == 0)
+        mach_timebase_info(&tb);
+    return (tb.numer == tb.denom) ? t : t / tb.denom * tb.numer 
+                                        + t % tb.denom * tb.numer / tb.denom;
+#elif defined(_WIN32) || defined(WIN32)
+    static LARGE_INTEGER freq = {0};
+    LARGE_INTEGER t;
+    if (freq.QuadPart == 0)
+        QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&t);
+    return (uint64_t)(t.QuadPart / freq.QuadPart) * 1000000000ULL
+         + (uint64_t)(t.QuadPart % freq.QuadPart) * 1000000000ULL 
+           / (uint64_t)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_sleep_ns(uint64_t ns)
+{
+#if defined(_WIN32) || defined(WIN32)
+    Sleep((DWORD)((ns + 999999) / 1000000));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000ULL);
+    ts.tv_nsec = (long)(ns % 1000000000ULL);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR)
+        ;
+#endif
+}
+
+/* --------------------------------------------------------------------------
+    Threads and mutexes: thin wrappers over pthreads and Win32.               */
+
+typedef struct ndof_thread_start {
+    ndof_thread_proc proc;
+    void *arg;
+} ndof_thread_start;
+
+#if defined(_WIN32) || defined(WIN32)
+static unsigned __stdcall ndof_thread_main(void *p)
+#else
+static void *ndof_thread_main(void *p)
+#endif
+{
+    ndof_thread_start start = *(ndof_thread_start *) p;
+    free(p);
+    start.proc(start.arg);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_thread_create(ndof_thread_t *thread, ndof_thread_proc proc, void *arg)
+{
+    ndof_thread_start *start = 
+        (ndof_thread_start *) malloc(sizeof(ndof_thread_start));
+    start->proc = proc;
+    start->arg = arg;
+    
+#if defined(_WIN32) || defined(WIN32)
+    *thread = (HANDLE) _beginthreadex(NULL, 0, ndof_thread_main, start, 0, NULL);
+    if (*thread == 0)
+#else
+    if (pthread_create(thread, NULL, ndof_thread_main, start) != 0)
+#endif
+    {
+        free(start);
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_thread_join(ndof_thread_t thread)
+{
+#if defined(_WIN32) || defined(WIN32)
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_join(thread, NULL);
+#endif
+}
+
+#if defined(_WIN32) || defined(WIN32)
+void ndof_mutex_init(ndof_mutex_t *m)     { InitializeSRWLock(m); }
+void ndof_mutex_destroy(ndof_mutex_t *m)  { (void) m; }
+void ndof_mutex_lock(ndof_mutex_t *m)     { AcquireSRWLockExclusive(m); }
+void ndof_mutex_unlock(ndof_mutex_t *m)   { ReleaseSRWLockExclusive(m); }
+#else
+void ndof_mutex_init(ndof_mutex_t *m)     { pthread_mutex_init(m, NULL); }
+void ndof_mutex_destroy(ndof_mutex_t *m)  { pthread_mutex_destroy(m); }
+void ndof_mutex_lock(ndof_mutex_t *m)     { pthread_mutex_lock(m); }
+void ndof_mutex_unlock(ndof_mutex_t *m)   { pthread_mutex_unlock(m); }
+#endif
+
+/* -------------------------------------------------------------------------- */
+#if defined(_WIN32) || defined(WIN32)
+
+int ndof_wait_on_address(volatile uint32_t *addr, uint32_t expected, 
+                         uint64_t deadline_ns)
+{
+    uint64_t now = ndof_time_ns();
+    DWORD ms = INFINITE;
+    
+    if (now >= deadline_ns)
+        return 1;
+    if (deadline_ns != UINT64_MAX 
+        && deadline_ns - now < (uint64_t)(INFINITE - 1) * 1000000ULL)
+        ms = (DWORD)((deadline_ns - now + 999999) / 1000000);
+    
+    if (!WaitOnAddress(addr, &expected, sizeof(expected), ms)
+        && GetLastError() == ERROR_TIMEOUT)
+        return ndof_time_ns() >= deadline_ns;
+    return 0;
+}
+
+void ndof_wake_address(volatile uint32_t *addr)
+{
+    WakeByAddressAll((PVOID) addr);
+}
+
+#elif NDOF_HAVE_FUTEX
+
+int ndof_wait_on_address(volatile uint32_t *addr, uint32_t expected, 
+                         uint64_t deadline_ns)
+{
+    struct timespec ts, *pts = NULL;
+    
+    if (deadline_ns != UINT64_MAX)
+    {
+        /* FUTEX_WAIT_BITSET takes an absolute CLOCK_MONOTONIC time, the
+           same clock as ndof_time_ns */
+        ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+        ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+        pts = &ts;
+    }
+    
+    if (syscall(SYS_futex, addr, FUTEX_WAIT_BITSET_PRIVATE, expected, pts,
+                NULL, FUTEX_BITSET_MATCH_ANY) != 0 && errno == ETIMEDOUT)
+        return 1;
+    return 0;
+}
+
+void ndof_wake_address(volatile uint32_t *addr)
+{
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+
+#else /* condition variables hashed by address */
+
+#define NDOF_PARKING_BUCKETS 16
+
+typedef struct ndof_parking_bucket {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+} ndof_parking_bucket;
+
+static ndof_parking_bucket s_parking[NDOF_PARKING_BUCKETS];
+static pthread_once_t s_parking_once = PTHREAD_ONCE_INIT;
+
+static void ndof_parking_init()
+{
+    int i;
+    for (i = 0; i < NDOF_PARKING_BUCKETS; i++)
+    {
+        pthread_mutex_init(&s_parking[i].mutex, NULL);
+        pthread_cond_init(&s_parking[i].cond, NULL);
+    }
+}
+
+static ndof_parking_bucket *ndof_parking_bucket_for(volatile uint32_t *addr)
+{
+    uintptr_t h = (uintptr_t) addr;
+    pthread_once(&s_parking_once, ndof_parking_init);
+    h ^= h >> 4;
+    h ^= h >> 9;
+    return &s_parking[h % NDOF_PARKING_BUCKETS];
+}
+
+int ndof_wait_on_address(volatile uint32_t *addr, uint32_t expected, 
+                         uint64_t deadline_ns)
+{
+    int timedout = 0;
+    ndof_parking_bucket *b = ndof_parking_bucket_for(addr);
+    
+    pthread_mutex_lock(&b->mutex);
+    if (ndof_atomic_load32(addr) == expected)
+    {
+        uint64_t now = ndof_time_ns();
+        if (now >= deadline_ns)
+        {
+            timedout = 1;
+        }
+        else if (deadline_ns == UINT64_MAX)
+        {
+            pthread_cond_wait(&b->cond, &b->mutex);
+        }
+        else
+        {
+            struct timespec rel;
+            rel.tv_sec = (time_t)((deadline_ns - now) / 1000000000ULL);
+            rel.tv_nsec = (long)((deadline_ns - now) % 1000000000ULL);
+#if TARGET_OS_MAC
+            timedout = 
+                pthread_cond_timedwait_relative_np(&b->cond, &b->mutex, &rel)
+                == ETIMEDOUT;
+#else
+            {
+                struct timespec abs;
+                clock_gettime(CLOCK_REALTIME, &abs);
+                abs.tv_sec += rel.tv_sec;
+                abs.tv_nsec += rel.tv_nsec;
+                if (abs.tv_nsec >= 1000000000L)
+                {
+                    abs.tv_sec++;
+                    abs.tv_nsec -= 1000000000L;
+                }
+                timedout = 
+                    pthread_cond_timedwait(&b->cond, &b->mutex, &abs) 
+                    == ETIMEDOUT;
+            }
+#endif
+        }
+    }
+    pthread_mutex_unlock(&b->mutex);
+    return timedout;
+}
+
+void ndof_wake_address(volatile uint32_t *addr)
+{
+    ndof_parking_bucket *b = ndof_parking_bucket_for(addr);
+    
+    /* taking the mutex orders us after a waiter's check of *addr */
+    pthread_mutex_lock(&b->mutex);
+    pthread_cond_broadcast(&b->cond);
+    pthread_mutex_unlock(&b->mutex);
+}
+
+#endif
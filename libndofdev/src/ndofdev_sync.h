@@ -0,0 +1,250 @@
+/*
+ @file ndofdev_sync.h
+ @brief Atomics, threads and timing primitives used by the portable code.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_sync_h__
+#define __ndofdev_sync_h__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32) || defined(WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <pthread.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_MSC_VER)
+#define NDOF_INLINE static __inline
+#else
+#define NDOF_INLINE static inline
+#endif
+
+/* --------------------------------------------------------------------------
+    Atomics. Loads have acquire and stores release semantics, read-modify-
+    write operations are sequentially consistent. Only what the library
+    needs is provided.                                                        */
+
+#if defined(_MSC_VER)
+
+#if defined(_M_IX86) || defined(_M_X64)
+/* x86 loads and stores are already acquire/release; keep the compiler away */
+#define NDOF_COMPILER_BARRIER() _ReadWriteBarrier()
+#else
+#define NDOF_COMPILER_BARRIER() __dmb(_ARM64_BARRIER_ISH)
+#endif
+
+NDOF_INLINE unsigned char ndof_atomic_load8(const volatile unsigned char *p)
+{ unsigned char v = *p; NDOF_COMPILER_BARRIER(); return v; }
+NDOF_INLINE void ndof_atomic_store8(volatile unsigned char *p, unsigned char v)
+{ _InterlockedExchange8((volatile char *)p, (char)v); }
+
+NDOF_INLINE uint32_t ndof_atomic_load32(const volatile uint32_t *p)
+{ uint32_t v = *p; NDOF_COMPILER_BARRIER(); return v; }
+NDOF_INLINE void ndof_atomic_store32(volatile uint32_t *p, uint32_t v)
+{ _InterlockedExchange((volatile long *)p, (long)v); }
+NDOF_INLINE uint32_t ndof_atomic_add32(volatile uint32_t *p, uint32_t v)
+{ return (uint32_t)_InterlockedExchangeAdd((volatile long *)p, (long)v) + v; }
+NDOF_INLINE int ndof_atomic_cas32(volatile uint32_t *p, uint32_t e, uint32_t d)
+{ return (uint32_t)_InterlockedCompareExchange((volatile long *)p, 
+                                               (long)d, (long)e) == e; }
+
+NDOF_INLINE uint64_t ndof_atomic_load64(const volatile uint64_t *p)
+{
+#if defined(_M_IX86)
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, 0, 0);
+#else
+    uint64_t v = *p; NDOF_COMPILER_BARRIER(); return v;
+#endif
+}
+NDOF_INLINE uint64_t ndof_atomic_add64(volatile uint64_t *p, uint64_t v)
+{
+    __int64 old, cur = *(volatile __int64 *)p;
+    do { old = cur; cur = _InterlockedCompareExchange64(
+             (volatile __int64 *)p, old + (__int64)v, old); } while (cur != old);
+    return (uint64_t)old + v;
+}
+NDOF_INLINE void ndof_atomic_store64(volatile uint64_t *p, uint64_t v)
+{
+    __int64 old, cur = *(volatile __int64 *)p;
+    do { old = cur; cur = _InterlockedCompareExchange64(
+             (volatile __int64 *)p, (__int64)v, old); } while (cur != old);
+}
+NDOF_INLINE int ndof_atomic_cas64(volatile uint64_t *p, uint64_t e, uint64_t d)
+{ return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)p, 
+                                                 (__int64)d, (__int64)e) == e; }
+
+NDOF_INLINE void *ndof_atomic_loadptr(void *const volatile *p)
+{ void *v = *p; NDOF_COMPILER_BARRIER(); return v; }
+NDOF_INLINE void ndof_atomic_storeptr(void *volatile *p, void *v)
+{ _InterlockedExchangePointer((void *volatile *)p, v); }
+NDOF_INLINE void *ndof_atomic_xchgptr(void *volatile *p, void *v)
+{ return _InterlockedExchangePointer((void *volatile *)p, v); }
+NDOF_INLINE int ndof_atomic_casptr(void *volatile *p, void *e, void *d)
+{ return _InterlockedCompareExchangePointer((void *volatile *)p, d, e) == e; }
+
+/* word sized relaxed accesses, used for seqlock protected payloads */
+#define ndof_atomic_load_relaxed(p)     (*(p))
+#define ndof_atomic_store_relaxed(p, v) (*(p) = (v))
+#define ndof_atomic_fence_acquire()     NDOF_COMPILER_BARRIER()
+#define ndof_atomic_fence_release()     NDOF_COMPILER_BARRIER()
+#define ndof_atomic_fence()             MemoryBarrier()
+
+#if defined(_M_IX86) || defined(_M_X64)
+#define ndof_cpu_relax()                _mm_pause()
+#else
+#define ndof_cpu_relax()                __yield()
+#endif
+
+#else /* gcc, clang */
+
+NDOF_INLINE unsigned char ndof_atomic_load8(const volatile unsigned char *p)
+{ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+NDOF_INLINE void ndof_atomic_store8(volatile unsigned char *p, unsigned char v)
+{ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+NDOF_INLINE uint32_t ndof_atomic_load32(const volatile uint32_t *p)
+{ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+NDOF_INLINE void ndof_atomic_store32(volatile uint32_t *p, uint32_t v)
+{ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+NDOF_INLINE uint32_t ndof_atomic_add32(volatile uint32_t *p, uint32_t v)
+{ return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST); }
+NDOF_INLINE int ndof_atomic_cas32(volatile uint32_t *p, uint32_t e, uint32_t d)
+{ return __atomic_compare_exchange_n(p, &e, d, 0, __ATOMIC_SEQ_CST, 
+                                     __ATOMIC_SEQ_CST); }
+
+NDOF_INLINE uint64_t ndof_atomic_load64(const volatile uint64_t *p)
+{ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+NDOF_INLINE void ndof_atomic_store64(volatile uint64_t *p, uint64_t v)
+{ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+NDOF_INLINE uint64_t ndof_atomic_add64(volatile uint64_t *p, uint64_t v)
+{ return __atomic_add_fetch(p, v, __ATOMIC_SEQ_CST); }
+NDOF_INLINE int ndof_atomic_cas64(volatile uint64_t *p, uint64_t e, uint64_t d)
+{ return __atomic_compare_exchange_n(p, &e, d, 0, __ATOMIC_SEQ_CST, 
+                                     __ATOMIC_SEQ_CST); }
+
+NDOF_INLINE void *ndof_atomic_loadptr(void *const volatile *p)
+{ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+NDOF_INLINE void ndof_atomic_storeptr(void *volatile *p, void *v)
+{ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+NDOF_INLINE void *ndof_atomic_xchgptr(void *volatile *p, void *v)
+{ return __atomic_exchange_n(p, v, __ATOMIC_SEQ_CST); }
+NDOF_INLINE int ndof_atomic_casptr(void *volatile *p, void *e, void *d)
+{ return __atomic_compare_exchange_n(p, &e, d, 0, __ATOMIC_SEQ_CST, 
+                                     __ATOMIC_SEQ_CST); }
+
+#define ndof_atomic_load_relaxed(p)     __atomic_load_n(p, __ATOMIC_RELAXED)
+#define ndof_atomic_store_relaxed(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#define ndof_atomic_fence_acquire()     __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define ndof_atomic_fence_release()     __atomic_thread_fence(__ATOMIC_RELEASE)
+#define ndof_atomic_fence()             __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+#if defined(__i386__) || defined(__x86_64__)
+#define ndof_cpu_relax()                __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define ndof_cpu_relax()                __asm__ __volatile__("yield")
+#else
+#define ndof_cpu_relax()                ((void)0)
+#endif
+
+#endif /* _MSC_VER */
+
+/* --------------------------------------------------------------------------
+    Sequence lock. One writer at a time publishes a payload that any number
+    of readers copy out without locking and without ever delaying the
+    writer. Payloads are stored as arrays of ndof_word_t so that every
+    access is a (relaxed) atomic one.                                         */
+
+typedef uintptr_t ndof_word_t;
+
+#define NDOF_WORD_COUNT(size) \
+    (((size) + sizeof(ndof_word_t) - 1) / sizeof(ndof_word_t))
+
+typedef struct NDOF_SeqLock {
+    volatile uint32_t seq;    /* odd while a write is in progress */
+} NDOF_SeqLock;
+
+/** Copies `size' bytes from `src' into the protected `dst' words. */
+void ndof_seqlock_write(NDOF_SeqLock *lock, volatile ndof_word_t *dst,
+                        const void *src, size_t size);
+
+/** Copies a consistent snapshot of the protected `src' words into `dst'. */
+void ndof_seqlock_read(const NDOF_SeqLock *lock, 
+                       const volatile ndof_word_t *src, void *dst, size_t size);
+
+/* --------------------------------------------------------------------------
+    Threads.                                                                  */
+
+#if defined(_WIN32) || defined(WIN32)
+typedef HANDLE ndof_thread_t;
+typedef SRWLOCK ndof_mutex_t;
+#else
+typedef pthread_t ndof_thread_t;
+typedef pthread_mutex_t ndof_mutex_t;
+#endif
+
+typedef void (*ndof_thread_proc)(void *arg);
+
+/** Returns 0 if the thread was started. */
+int ndof_thread_create(ndof_thread_t *thread, ndof_thread_proc proc, void *arg);
+void ndof_thread_join(ndof_thread_t thread);
+
+void ndof_mutex_init(ndof_mutex_t *m);
+void ndof_mutex_destroy(ndof_mutex_t *m);
+void ndof_mutex_lock(ndof_mutex_t *m);
+void ndof_mutex_unlock(ndof_mutex_t *m);
+
+/** Puts the calling thread to sleep for at least `ns' nanoseconds. */
+void ndof_sleep_ns(uint64_t ns);
+
+/* --------------------------------------------------------------------------
+    Address based wait/wake: a futex on Linux, WaitOnAddress on Windows and
+    a small table of condition variables elsewhere.                           */
+
+/** Blocks while *addr == expected, until woken or until ndof_time_ns()
+ *  reaches deadline_ns. May return spuriously: callers must re-check their
+ *  condition. Returns 1 if the deadline passed, 0 otherwise. */
+int ndof_wait_on_address(volatile uint32_t *addr, uint32_t expected, 
+                         uint64_t deadline_ns);
+
+/** Wakes all the threads blocked on addr in ndof_wait_on_address. */
+void ndof_wake_address(volatile uint32_t *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_sync_h__ */
@@ -0,0 +1,225 @@
+/*
+ @file ndofdev_synthetic.c
+ @brief Backend of generated devices, for tests and machines without one.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ndofdev_backend.h"
+#include "ndofdev_external.h"
+#include "ndofdev_internal.h"
+#include "ndofdev_stream.h"
+
+#define NDOF_SYNTHETIC_MAX  16      /* devices in a context */
+
+/*  The axes of device i follow sine waves of periods 2 + i/4 + axis/2 
+    seconds over 80% of the range, and its buttons count the seconds: as a
+    function of ndof_time_ns, whoever updates it and however often. */
+typedef struct NDOF_SyntheticPrivate {
+    int             index;      /* 1 + # of the device, 0 if not opened */
+    NDOF_DeviceKey  curr_key;
+} NDOF_SyntheticPrivate;
+
+typedef struct NDOF_SyntheticBackend {
+    int count;                  /* devices attached */
+} NDOF_SyntheticBackend;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_synthetic_libinit(NDOF_Context *ctx,
+                                  NDOF_DeviceAddCallback in_add_cb, 
+                                  NDOF_DeviceRemovalCallback in_removal_cb,
+                                  void *platform_specific, int async);
+static void ndof_synthetic_stop(NDOF_Context *ctx);
+static void ndof_synthetic_cleanup(NDOF_Context *ctx);
+static int ndof_synthetic_devcount(NDOF_Context *ctx);
+static int ndof_synthetic_init_first(NDOF_Device *dev, void *param);
+static void ndof_synthetic_update(NDOF_Device *dev);
+static void ndof_synthetic_dispose(void *priv);
+static unsigned char ndof_synthetic_match(void *priv1, void *priv2);
+static void ndof_synthetic_open(NDOF_Device *dev, int index);
+
+/* -------------------------------------------------------------------------- 
+    The devices are there at once: they are reported before returning, 
+    even when `async' is set. */
+static int ndof_synthetic_libinit(NDOF_Context *ctx,
+                                  NDOF_DeviceAddCallback in_add_cb, 
+                                  NDOF_DeviceRemovalCallback in_removal_cb,
+                                  void *platform_specific, int async)
+{
+    NDOF_SyntheticBackend *be;
+    int i;
+    
+    (void) in_removal_cb;
+    (void) async;
+    ndof_synthetic_cleanup(ctx);
+    be = (NDOF_SyntheticBackend *) calloc(1, sizeof(NDOF_SyntheticBackend));
+    if (be == NULL)
+        return -1;
+    
+    be->count = (platform_specific ? atoi((const char *) platform_specific) 
+                                   : 1);
+    if (be->count < 0)
+        be->count = 0;
+    if (be->count > NDOF_SYNTHETIC_MAX)
+        be->count = NDOF_SYNTHETIC_MAX;
+    ctx->backend = be;
+    
+    for (i = 0; i < be->count && in_add_cb; i++)
+    {
+        NDOF_Device *dev = ndof_context_create_device(ctx);
+        
+        if (dev)
+        {
+            ndof_synthetic_open(dev, i);
+            if (ndof_notify_added(in_add_cb, dev) == NDOF_DISCARD_HOTPLUGGED)
+                ndof_destroy(dev);
+        }
+    }
+    
+    ndof_init_done(ctx, 0);
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Nothing is ever unplugged. */
+static void ndof_synthetic_stop(NDOF_Context *ctx)
+{
+    (void) ctx;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_synthetic_cleanup(NDOF_Context *ctx)
+{
+    free(ctx->backend);
+    ctx->backend = NULL;
+}
+
+/* -------------------------------------------------------------------------- */
+static int ndof_synthetic_devcount(NDOF_Context *ctx)
+{
+    NDOF_SyntheticBackend *be = (NDOF_SyntheticBackend *) ctx->backend;
+    
+    return (be ? be->count : 1);
+}
+
+/* -------------------------------------------------------------------------- 
+    As the native backends: opens the first device, or the first whose 
+    product starts with dev->product if set, whether or not other devices
+    of the context read it already. */
+static int ndof_synthetic_init_first(NDOF_Device *dev, void *param)
+{
+    NDOF_SyntheticBackend *be = (NDOF_SyntheticBackend *) dev->context->backend;
+    size_t lenp = strlen(dev->product);
+    int i, count = (be ? be->count : 1);
+    
+    (void) param;
+    for (i = 0; i < count; i++)
+    {
+        char product[32];
+        
+        snprintf(product, sizeof(product), "Synthetic 6DOF #%d", i + 1);
+        if (lenp == 0 || strncmp(dev->product, product, lenp) == 0)
+        {
+            ndof_synthetic_open(dev, i);
+            return 0;
+        }
+    }
+    
+    fprintf(stderr, "libndofdev: no NDOF HID device found.\n");
+    return -1;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_synthetic_open(NDOF_Device *dev, int index)
+{
+    NDOF_SyntheticPrivate *priv = (NDOF_SyntheticPrivate *) dev->private_data;
+    
+    priv->index = index + 1;
+    /* a generic desktop multi-axis controller, at port `index' */
+    priv->curr_key = ndof_device_key(0, 0, 0x01, 0x08, index + 1, NULL);
+    dev->axes_count = NDOF_MAX_AXES_COUNT;
+    dev->btn_count = 2;
+    snprintf(dev->manufacturer, sizeof(dev->manufacturer), "libndofdev");
+    snprintf(dev->product, sizeof(dev->product), "Synthetic 6DOF #%d", 
+             index + 1);
+    ndof_stream_identify(dev, &priv->curr_key);
+    ndof_stream_set_valid(dev, 1);
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_synthetic_update(NDOF_Device *dev)
+{
+    NDOF_SyntheticPrivate *priv = (NDOF_SyntheticPrivate *) dev->private_data;
+    const double pi = 3.14159265358979323846;
+    double t = (double) ndof_time_ns() / 1e9;
+    double mid = (dev->axes_max + dev->axes_min) / 2.0;
+    double amp = 0.4 * (dev->axes_max - dev->axes_min);
+    uint64_t secs = (uint64_t) t;
+    int i;
+    
+    if (priv->index == 0)
+        return;
+    
+    for (i = 0; i < dev->axes_count; i++)
+    {
+        double period = 2 + (priv->index - 1) / 4.0 + i / 2.0;
+        
+        dev->axes[i] = (long) floor(mid + amp * sin(2 * pi * t / period) + 0.5);
+    }
+    dev->buttons[0] = (long) (secs & 1);
+    dev->buttons[1] = (long) ((secs >> 1) & 1);
+    
+    ndof_stream_publish(dev);
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_synthetic_dispose(void *priv)
+{
+    free(priv);
+}
+
+/* -------------------------------------------------------------------------- */
+static unsigned char ndof_synthetic_match(void *priv1, void *priv2)
+{
+    NDOF_SyntheticPrivate *d1 = (NDOF_SyntheticPrivate *) priv1;
+    NDOF_SyntheticPrivate *d2 = (NDOF_SyntheticPrivate *) priv2;
+    
+    return (d1 && d2 && ndof_key_equal(&d1->curr_key, &d2->curr_key));
+}
+
+/* -------------------------------------------------------------------------- */
+const NDOF_Backend ndof_backend_synthetic = {
+    "synthetic", sizeof(NDOF_SyntheticPrivate), 0,
+    ndof_synthetic_libinit, ndof_synthetic_stop, ndof_synthetic_cleanup,
+    ndof_synthetic_devcount, ndof_synthetic_init_first, 
+    ndof_synthetic_update, ndof_synthetic_dispose, ndof_synthetic_match, 
+    NULL
+};
@@ -0,0 +1,517 @@
+/*
+ @file ndofdev_sysfs.c
+ @brief Enumeration of the Linux input devices from sysfs.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ndofdev_external.h"
+#include "ndofdev_quirks.h"
+#include "ndofdev_sysfs.h"
+
+/* application collections of NDOF devices, as usage page << 16 | usage */
+#define NDOF_USAGE_MULTI_AXIS   0x00010008ul    /* Generic Desktop */
+#define NDOF_USAGE_3D_GAME      0x00050001ul    /* Game Controls */
+
+/* evdev codes, see linux/input-event-codes.h */
+#define NDOF_EV_AXES_MASK       0x3ful  /* X Y Z RX RY RZ */
+#define NDOF_EV_BTN_0           0x100
+#define NDOF_EV_BTN_JOYSTICK    0x120   /* joystick and gamepad buttons, */
+#define NDOF_EV_BTN_DIGI        0x140   /* up to this one */
+
+typedef struct NDOF_NodeList {
+    NDOF_SysfsNode *nodes;
+    int             count;
+    int             capacity;
+} NDOF_NodeList;
+
+/* --------------------------------------------------------------------------
+	Static Function Prototypes                                                */
+
+static int ndof_sysfs_numbers(const char *dir, const char *prefix, 
+                              int **out);
+static long ndof_sysfs_read(const char *path, void *buf, size_t size);
+static int ndof_sysfs_text(const char *path, char *buf, size_t size);
+static long ndof_sysfs_hex(const char *path);
+static int ndof_sysfs_bit(const char *bitmap, unsigned bit);
+static unsigned long ndof_sysfs_usage(const unsigned char *desc, size_t len);
+static int ndof_sysfs_match(long vendor_id, long product_id, 
+                            unsigned long usage);
+static uint32_t ndof_sysfs_hash(const char *s);
+static NDOF_SysfsNode *ndof_sysfs_add(NDOF_NodeList *list);
+static void ndof_sysfs_manufacturer(const char *hid, NDOF_SysfsNode *node);
+static int ndof_sysfs_hidraw(const char *root, int n, NDOF_SysfsNode *node);
+static int ndof_sysfs_evdev(const char *root, int n, NDOF_SysfsNode *node);
+
+/* -------------------------------------------------------------------------- */
+int ndof_sysfs_scan(const char *root, NDOF_SysfsNode **out)
+{
+    NDOF_NodeList list = { NULL, 0, 0 };
+    char dir[512];
+    int *numbers, count, found = 0, i;
+    
+    if (root == NULL)
+        root = "";
+    
+    snprintf(dir, sizeof(dir), "%s/sys/class/hidraw", root);
+    if ((count = ndof_sysfs_numbers(dir, "hidraw", &numbers)) >= 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            NDOF_SysfsNode *node = ndof_sysfs_add(&list);
+            
+            if (node && ndof_sysfs_hidraw(root, numbers[i], node) != 0)
+                list.count--;
+        }
+        free(numbers);
+        found = 1;
+    }
+    
+    snprintf(dir, sizeof(dir), "%s/sys/class/input", root);
+    if ((count = ndof_sysfs_numbers(dir, "event", &numbers)) >= 0)
+    {
+        for (i = 0; i < count; i++)
+        {
+            NDOF_SysfsNode *node = ndof_sysfs_add(&list);
+            
+            if (node && ndof_sysfs_evdev(root, numbers[i], node) != 0)
+                list.count--;
+        }
+        free(numbers);
+        found = 1;
+    }
+    
+    *out = list.nodes;
+    return (found ? list.count : -1);
+}
+
+/* -------------------------------------------------------------------------- */
+int ndof_sysfs_node(const char *root, const char *name, NDOF_SysfsNode *node)
+{
+    char *end;
+    long n;
+    
+    if (root == NULL)
+        root = "";
+    
+    if (strncmp(name, "hidraw", 6) == 0)
+    {
+        n = strtol(name + 6, &end, 10);
+        if (end != name + 6 && *end == '\0' && n >= 0)
+            return ndof_sysfs_hidraw(root, (int) n, node);
+    }
+    else if (strncmp(name, "event", 5) == 0)
+    {
+        n = strtol(name + 5, &end, 10);
+        if (end != name + 5 && *end == '\0' && n >= 0)
+            return ndof_sysfs_evdev(root, (int) n, node);
+    }
+    
+    return -1;
+}
+
+/* -------------------------------------------------------------------------- 
+    Reads what the HID core publishes of a hidraw node: IDs and names in
+    the uevent of the HID device, and its report descriptor. */
+static int ndof_sysfs_hidraw(const char *root, int n, NDOF_SysfsNode *node)
+{
+    char base[512], path[600], uevent[4096];
+    char name[256] = "", phys[256] = "", uniq[256] = "";
+    unsigned bus = 0;
+    long vid = -1, pid = -1, desc_len;
+    char *line;
+    
+    snprintf(base, sizeof(base), "%s/sys/class/hidraw/hidraw%d/device", 
+             root, n);
+    snprintf(path, sizeof(path), "%s/uevent", base);
+    if (ndof_sysfs_text(path, uevent, sizeof(uevent)) != 0)
+        return -1;
+    
+    for (line = strtok(uevent, "\n"); line; line = strtok(NULL, "\n"))
+    {
+        if (strncmp(line, "HID_ID=", 7) == 0)
+            sscanf(line + 7, "%x:%lx:%lx", &bus, &vid, &pid);
+        else if (strncmp(line, "HID_NAME=", 9) == 0)
+            snprintf(name, sizeof(name), "%s", line + 9);
+        else if (strncmp(line, "HID_PHYS=", 9) == 0)
+            snprintf(phys, sizeof(phys), "%s", line + 9);
+        else if (strncmp(line, "HID_UNIQ=", 9) == 0)
+            snprintf(uniq, sizeof(uniq), "%s", line + 9);
+    }
+    
+    snprintf(path, sizeof(path), "%s/report_descriptor", base);
+    desc_len = ndof_sysfs_read(path, node->desc, sizeof(node->desc));
+    if (vid < 0 || desc_len <= 0 
+        || !ndof_sysfs_match(vid, pid, ndof_sysfs_usage(node->desc, desc_len)))
+        return -1;
+    
+    snprintf(node->path, sizeof(node->path), "%s/dev/hidraw%d", root, n);
+    node->kind = NDOF_NODE_HIDRAW;
+    node->vendor_id = vid;
+    node->product_id = pid;
+    node->version = 0;
+    node->btn_count = 0;
+    snprintf(node->product, sizeof(node->product), "%s", name);
+    ndof_sysfs_manufacturer(base, node);
+    node->desc_len = desc_len;
+    node->key = ndof_device_key(vid, pid, 0, 0, ndof_sysfs_hash(phys),
+                                (*uniq ? uniq : NULL));
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Reads the attributes of the input device of an event node. Devices that
+    are not known have to look like a 3D mouse: six axes and no joystick or
+    gamepad buttons. */
+static int ndof_sysfs_evdev(const char *root, int n, NDOF_SysfsNode *node)
+{
+    char base[512], path[600], bits[1024];
+    char name[256] = "", phys[256] = "", uniq[256] = "";
+    unsigned long usage = 0;
+    long vid, pid, version, desc_len;
+    int btn_count = 0, code;
+    
+    snprintf(base, sizeof(base), "%s/sys/class/input/event%d/device", 
+             root, n);
+    snprintf(path, sizeof(path), "%s/id/vendor", base);
+    vid = ndof_sysfs_hex(path);
+    snprintf(path, sizeof(path), "%s/id/product", base);
+    pid = ndof_sysfs_hex(path);
+    snprintf(path, sizeof(path), "%s/id/version", base);
+    version = ndof_sysfs_hex(path);
+    if (vid < 0 || pid < 0)
+        return -1;
+    
+    snprintf(path, sizeof(path), "%s/capabilities/key", base);
+    if (ndof_sysfs_text(path, bits, sizeof(bits)) != 0)
+        *bits = '\0';
+    for (code = NDOF_EV_BTN_JOYSTICK; code < NDOF_EV_BTN_DIGI; code++)
+        if (ndof_sysfs_bit(bits, code))
+            break;
+    if (code == NDOF_EV_BTN_DIGI)
+    {
+        char abs[1024], rel[1024];
+        
+        snprintf(path, sizeof(path), "%s/capabilities/abs", base);
+        if (ndof_sysfs_text(path, abs, sizeof(abs)) != 0)
+            *abs = '\0';
+        snprintf(path, sizeof(path), "%s/capabilities/rel", base);
+        if (ndof_sysfs_text(path, rel, sizeof(rel)) != 0)
+            *rel = '\0';
+        for (code = 0; code < NDOF_MAX_AXES_COUNT; code++)
+            if (!ndof_sysfs_bit(abs, code) && !ndof_sysfs_bit(rel, code))
+                break;
+        if (code == NDOF_MAX_AXES_COUNT)
+            usage = NDOF_USAGE_MULTI_AXIS;
+    }
+    if (!ndof_sysfs_match(vid, pid, usage))
+        return -1;
+    
+    while (btn_count < NDOF_MAX_BUTTONS_COUNT 
+           && ndof_sysfs_bit(bits, NDOF_EV_BTN_0 + btn_count))
+        btn_count++;
+    
+    snprintf(path, sizeof(path), "%s/name", base);
+    ndof_sysfs_text(path, name, sizeof(name));
+    snprintf(path, sizeof(path), "%s/phys", base);
+    ndof_sysfs_text(path, phys, sizeof(phys));
+    snprintf(path, sizeof(path), "%s/uniq", base);
+    ndof_sysfs_text(path, uniq, sizeof(uniq));
+    
+    snprintf(node->path, sizeof(node->path), "%s/dev/input/event%d", root, n);
+    node->kind = NDOF_NODE_EVDEV;
+    node->vendor_id = vid;
+    node->product_id = pid;
+    node->version = (version > 0 ? version : 0);
+    node->btn_count = btn_count;
+    snprintf(node->product, sizeof(node->product), "%s", name);
+    
+    /* the HID device, if any, is the parent of the input device */
+    snprintf(path, sizeof(path), "%s/device", base);
+    ndof_sysfs_manufacturer(path, node);
+    snprintf(path, sizeof(path), "%s/device/report_descriptor", base);
+    desc_len = ndof_sysfs_read(path, node->desc, sizeof(node->desc));
+    node->desc_len = (desc_len > 0 ? desc_len : 0);
+    node->key = ndof_device_key(vid, pid, 0, 0, ndof_sysfs_hash(phys),
+                                (*uniq ? uniq : NULL));
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Known models are taken or left as the quirks database says; others by
+    their application collection. */
+static int ndof_sysfs_match(long vendor_id, long product_id, 
+                            unsigned long usage)
+{
+    const NDOF_DeviceQuirks *q = ndof_quirks_lookup(vendor_id, product_id);
+    
+    if (q)
+        return (q->device_class != NDOF_CLASS_NONE);
+    
+    return (vendor_id == NDOF_VENDOR_3DCONNEXION
+            || usage == NDOF_USAGE_MULTI_AXIS
+            || usage == NDOF_USAGE_3D_GAME);
+}
+
+/* -------------------------------------------------------------------------- 
+    Usage of the first collection of a report descriptor, the application 
+    one, as usage page << 16 | usage. 0 if there is none. */
+static unsigned long ndof_sysfs_usage(const unsigned char *desc, size_t len)
+{
+    unsigned long page = 0, usage = 0;
+    size_t i = 0, size, k;
+    
+    while (i < len)
+    {
+        unsigned char prefix = desc[i];
+        unsigned long data = 0;
+        
+        if (prefix == 0xfe)     /* long item */
+        {
+            if (i + 1 >= len)
+                break;
+            i += 3 + desc[i + 1];
+            continue;
+        }
+        
+        size = (prefix & 0x3) == 3 ? 4 : (prefix & 0x3);
+        if (i + 1 + size > len)
+            break;
+        for (k = 0; k < size; k++)
+            data |= (unsigned long) desc[i + 1 + k] << (8 * k);
+        
+        switch (prefix & 0xfc)
+        {
+            case 0x04:          /* Usage Page */
+                page = data;
+                break;
+            case 0x08:          /* Usage, extended if 4 bytes long */
+                usage = (size == 4 ? data : (page << 16) | data);
+                break;
+            case 0xa0:          /* Collection */
+                return usage;
+        }
+        i += 1 + size;
+    }
+    
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Numbers N of the entries `prefix'N of a directory, in increasing order.
+    Returns their count, -1 if the directory cannot be read. */
+static int ndof_sysfs_numbers(const char *dir, const char *prefix, int **out)
+{
+    size_t plen = strlen(prefix);
+    int *numbers = NULL, count = 0, capacity = 0, i, j;
+    struct dirent *entry;
+    DIR *d;
+    
+    *out = NULL;
+    if ((d = opendir(dir)) == NULL)
+        return -1;
+    
+    while ((entry = readdir(d)) != NULL)
+    {
+        char *end;
+        long n;
+        
+        if (strncmp(entry->d_name, prefix, plen) != 0)
+            continue;
+        n = strtol(entry->d_name + plen, &end, 10);
+        if (end == entry->d_name + plen || *end != '\0' || n < 0)
+            continue;
+        
+        if (count == capacity)
+        {
+            int *grown = (int *) realloc(numbers, 
+                (capacity ? 2 * capacity : 16) * sizeof(int));
+            
+            if (grown == NULL)
+                break;
+            numbers = grown;
+            capacity = (capacity ? 2 * capacity : 16);
+        }
+        
+        /* insertion sort: there are a few tens at most */
+        for (i = count; i > 0 && numbers[i - 1] > n; i--)
+            ;
+        for (j = count; j > i; j--)
+            numbers[j] = numbers[j - 1];
+        numbers[i] = (int) n;
+        count++;
+    }
+    
+    closedir(d);
+    *out = numbers;
+    return count;
+}
+
+/* -------------------------------------------------------------------------- 
+    Returns the number of bytes read from a sysfs attribute, -1 on error. */
+static long ndof_sysfs_read(const char *path, void *buf, size_t size)
+{
+    size_t total = 0;
+    int fd;
+    
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    
+    while (total < size)
+    {
+        ssize_t n = read(fd, (char *) buf + total, size - total);
+        
+        if (n < 0)
+        {
+            close(fd);
+            return -1;
+        }
+        if (n == 0)
+            break;
+        total += n;
+    }
+    
+    close(fd);
+    return (long) total;
+}
+
+/* -------------------------------------------------------------------------- 
+    Reads a text attribute without its trailing newline. Returns 0 if ok. */
+static int ndof_sysfs_text(const char *path, char *buf, size_t size)
+{
+    long len = ndof_sysfs_read(path, buf, size - 1);
+    
+    if (len < 0)
+        return -1;
+    while (len > 0 && buf[len - 1] == '\n')
+        len--;
+    buf[len] = '\0';
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- 
+    Value of a hexadecimal attribute, -1 if unreadable. */
+static long ndof_sysfs_hex(const char *path)
+{
+    char text[32];
+    
+    if (ndof_sysfs_text(path, text, sizeof(text)) != 0)
+        return -1;
+    return strtol(text, NULL, 16);
+}
+
+/* -------------------------------------------------------------------------- 
+    Manufacturer of the device whose node's vendor and product IDs are set.
+    The string descriptor is an attribute of the USB device, above the 
+    interface that is the parent of the HID device `hid'. Others, such as
+    Bluetooth devices, have none: known models are then 3Dconnexion's, 
+    whatever their vendor ID. */
+static void ndof_sysfs_manufacturer(const char *hid, NDOF_SysfsNode *node)
+{
+    char path[600];
+    
+    snprintf(path, sizeof(path), "%s/../../manufacturer", hid);
+    if (ndof_sysfs_text(path, node->manufacturer, 
+                        sizeof(node->manufacturer)) == 0
+        && *node->manufacturer)
+        return;
+    
+    snprintf(node->manufacturer, sizeof(node->manufacturer), "%s", 
+             (ndof_quirks_lookup(node->vendor_id, node->product_id) 
+              ? "3Dconnexion" : ""));
+}
+
+/* -------------------------------------------------------------------------- 
+    Tests a bit of a capability bitmap: hexadecimal words the size of a long,
+    the most significant first. */
+static int ndof_sysfs_bit(const char *bitmap, unsigned bit)
+{
+    const unsigned word_bits = 8 * sizeof(unsigned long);
+    unsigned words = 0, skip;
+    const char *p = bitmap;
+    
+    while (*p)
+    {
+        while (*p == ' ')
+            p++;
+        if (*p == '\0')
+            break;
+        words++;
+        while (*p && *p != ' ')
+            p++;
+    }
+    if (bit / word_bits >= words)
+        return 0;
+    
+    for (p = bitmap, skip = words - 1 - bit / word_bits; ; skip--)
+    {
+        while (*p == ' ')
+            p++;
+        if (skip == 0)
+            break;
+        while (*p && *p != ' ')
+            p++;
+    }
+    return (int)((strtoul(p, NULL, 16) >> (bit % word_bits)) & 1);
+}
+
+/* -------------------------------------------------------------------------- 
+    FNV-1a of the physical path, the port of the device. */
+static uint32_t ndof_sysfs_hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+    
+    while (*s)
+        h = (h ^ (unsigned char) *s++) * 16777619u;
+    return h;
+}
+
+/* -------------------------------------------------------------------------- */
+static NDOF_SysfsNode *ndof_sysfs_add(NDOF_NodeList *list)
+{
+    NDOF_SysfsNode *node;
+    
+    if (list->count == list->capacity)
+    {
+        int capacity = (list->capacity ? 2 * list->capacity : 4);
+        NDOF_SysfsNode *grown = (NDOF_SysfsNode *) 
+            realloc(list->nodes, capacity * sizeof(NDOF_SysfsNode));
+        
+        if (grown == NULL)
+            return NULL;
+        list->nodes = grown;
+        list->capacity = capacity;
+    }
+    
+    node = &list->nodes[list->count++];
+    memset(node, 0, sizeof(*node));
+    return node;
+}
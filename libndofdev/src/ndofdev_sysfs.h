@@ -0,0 +1,86 @@
+/*
+ @file ndofdev_sysfs.h
+ @brief Enumeration of the Linux input devices from sysfs.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_sysfs_h__
+#define __ndofdev_sysfs_h__
+
+#include <stddef.h>
+#include "ndofdev_identity.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define NDOF_SYSFS_DESC_MAX     4096    /* HID_MAX_DESCRIPTOR_SIZE */
+
+/** Interfaces through which a device can be read. */
+typedef enum NDOF_NodeKind {
+    NDOF_NODE_HIDRAW = 0,       /* raw input reports, /dev/hidrawN */
+    NDOF_NODE_EVDEV  = 1        /* input events, /dev/input/eventN */
+} NDOF_NodeKind;
+
+/** A device node found in sysfs, not opened yet. The nodes of one device
+ *  share its key. */
+typedef struct NDOF_SysfsNode {
+    char           path[256];   /* of the device node */
+    int            kind;        /* NDOF_NodeKind */
+    long           vendor_id;
+    long           product_id;
+    long           version;     /* 0 if unknown */
+    NDOF_DeviceKey key;
+    char           manufacturer[256];
+    char           product[256];
+    int            btn_count;   /* evdev: BTN_0 onwards, from the key bitmap */
+    size_t         desc_len;    /* report descriptor, 0 if not a HID device */
+    unsigned char  desc[NDOF_SYSFS_DESC_MAX];
+} NDOF_SysfsNode;
+
+/* --------------------------------------------------------------------------
+    Purpose:    Lists the nodes of the NDOF devices attached.
+    Parameters: root - directory holding the "sys" and "dev" trees, NULL 
+                  for "/"; tests pass a fake tree
+                out - set to a malloc-ed array, to be freed by the caller
+    Notes:      Only sysfs attributes are read: IDs, capability bitmaps and
+                report descriptors. No device node is opened, so unrelated
+                devices are neither woken up nor denied to us. Hidraw nodes
+                come first, each kind in the order of its node numbers.
+    Returns:    The number of nodes, -1 if sysfs could not be read.
+*/
+int ndof_sysfs_scan(const char *root, NDOF_SysfsNode **out);
+
+/** Reads the sysfs attributes of the node `name', e.g. "hidraw2" or 
+ *  "event5", as ndof_sysfs_scan does. Returns 0 if it is the node of an 
+ *  NDOF device, -1 otherwise. */
+int ndof_sysfs_node(const char *root, const char *name, NDOF_SysfsNode *node);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_sysfs_h__ */
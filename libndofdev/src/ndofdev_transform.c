@@ -0,0 +1,156 @@
+/*
+ @file ndofdev_transform.c
+ @brief Per device 6x6 affine transform of the axes.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "ndofdev_transform.h"
+#include "ndofdev_quirks.h"
+
+#if defined(__SSE__) || defined(_M_X64) \
+    || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NDOF_TRANSFORM_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define NDOF_TRANSFORM_NEON
+#endif
+
+/* -------------------------------------------------------------------------- */
+static const float kNDOFIdentity[36] = {
+    1, 0, 0, 0, 0, 0,
+    0, 1, 0, 0, 0, 0,
+    0, 0, 1, 0, 0, 0,
+    0, 0, 0, 1, 0, 0,
+    0, 0, 0, 0, 1, 0,
+    0, 0, 0, 0, 0, 1
+};
+
+/* -------------------------------------------------------------------------- */
+int ndof_transform_set(NDOF_Transform *t, const float *matrix, 
+                       const float *offset)
+{
+    int i, j, identity = 1;
+    
+    if (matrix == NULL)
+        matrix = kNDOFIdentity;
+    
+    memset(t, 0, sizeof(NDOF_Transform));
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        for (j = 0; j < NDOF_MAX_AXES_COUNT; j++)
+        {
+            t->cols[j][i] = matrix[i * NDOF_MAX_AXES_COUNT + j];
+            if (t->cols[j][i] != (i == j ? 1.0f : 0.0f))
+                identity = 0;
+        }
+        if (offset)
+        {
+            t->offset[i] = offset[i];
+            if (offset[i] != 0.0f)
+                identity = 0;
+        }
+    }
+    
+    return identity;
+}
+
+/* -------------------------------------------------------------------------- 
+    y = offset + sum of x[j] * column j. */
+static void ndof_transform_kernel(const NDOF_Transform *t, const float *x, 
+                                  float *y)
+{
+    int j;
+    
+#if defined(NDOF_TRANSFORM_SSE)
+    __m128 lo = _mm_loadu_ps(&t->offset[0]);
+    __m128 hi = _mm_loadu_ps(&t->offset[4]);
+    for (j = 0; j < NDOF_MAX_AXES_COUNT; j++)
+    {
+        __m128 xj = _mm_set1_ps(x[j]);
+        lo = _mm_add_ps(lo, _mm_mul_ps(_mm_loadu_ps(&t->cols[j][0]), xj));
+        hi = _mm_add_ps(hi, _mm_mul_ps(_mm_loadu_ps(&t->cols[j][4]), xj));
+    }
+    _mm_storeu_ps(&y[0], lo);
+    _mm_storeu_ps(&y[4], hi);
+#elif defined(NDOF_TRANSFORM_NEON)
+    float32x4_t lo = vld1q_f32(&t->offset[0]);
+    float32x4_t hi = vld1q_f32(&t->offset[4]);
+    for (j = 0; j < NDOF_MAX_AXES_COUNT; j++)
+    {
+        lo = vmlaq_n_f32(lo, vld1q_f32(&t->cols[j][0]), x[j]);
+        hi = vmlaq_n_f32(hi, vld1q_f32(&t->cols[j][4]), x[j]);
+    }
+    vst1q_f32(&y[0], lo);
+    vst1q_f32(&y[4], hi);
+#else
+    int i;
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        float v = t->offset[i];
+        for (j = 0; j < NDOF_MAX_AXES_COUNT; j++)
+            v += t->cols[j][i] * x[j];
+        y[i] = v;
+    }
+#endif
+}
+
+/* -------------------------------------------------------------------------- */
+void ndof_transform_apply(const NDOF_Transform *t, const long *in, long *out,
+                          long lo, long hi)
+{
+    float x[8], y[8];
+    int i;
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        x[i] = (float) in[i];
+    
+    ndof_transform_kernel(t, x, y);
+    
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+    {
+        float v = (float) floor(y[i] + 0.5f);
+        if (lo < hi)
+        {
+            if (v > (float) hi)
+                v = (float) hi;
+            else if (v < (float) lo)
+                v = (float) lo;
+        }
+        out[i] = (long) v;
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+const float *ndof_transform_default(long vendor_id, long product_id)
+{
+    const NDOF_DeviceQuirks *q = ndof_quirks_lookup(vendor_id, product_id);
+    return (q ? q->transform : NULL);
+}
@@ -0,0 +1,64 @@
+/*
+ @file ndofdev_transform.h
+ @brief Per device 6x6 affine transform of the axes.
+ 
+ Copyright (c) 2007, 3Dconnexion, Inc. - All rights reserved.
+ 
+ Redistribution and use in source and binary forms, with or without 
+ modification, are permitted provided that the following conditions are met:
+ - Redistributions of source code must retain the above copyright notice, 
+   this list of conditions and the following disclaimer.
+ - Redistributions in binary form must reproduce the above copyright notice, 
+   this list of conditions and the following disclaimer in the documentation 
+   and/or other materials provided with the distribution.
+ - Neither the name of the 3Dconnexion, Inc. nor the names of its contributors 
+   may be used to endorse or promote products derived from this software 
+   without specific prior written permission.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR 
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES 
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON 
+ ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT 
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __ndofdev_transform_h__
+#define __ndofdev_transform_h__
+
+#include "ndofdev_external.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** axes = matrix * axes + offset, stored by column and padded to 8 lanes so
+ *  that a column is two SIMD registers. */
+typedef struct NDOF_Transform {
+    float cols[NDOF_MAX_AXES_COUNT][8];
+    float offset[8];
+} NDOF_Transform;
+
+/** Builds a transform from a row major 6x6 matrix and an optional offset. 
+ *  Returns 1 if the result is the identity, 0 otherwise. */
+int ndof_transform_set(NDOF_Transform *t, const float *matrix, 
+                       const float *offset);
+
+/** Transforms one set of NDOF_MAX_AXES_COUNT axes. Results are rounded and 
+ *  clamped to [lo, hi] if lo < hi. `in' and `out' may be the same. */
+void ndof_transform_apply(const NDOF_Transform *t, const long *in, long *out,
+                          long lo, long hi);
+
+/** Default row major matrix for a device model, from the quirks database
+ *  (ndofdev_quirks.c); NULL if the model needs none. */
+const float *ndof_transform_default(long vendor_id, long product_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ndofdev_transform_h__ */
@@ -30,22 +30,77 @@
 #if LIBNDOF_UNIT_TESTS
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
+#include <time.h>
 #include "ndofdev_external.h"
+#include "ndofdev_backend.h"
+#include "ndofdev_capcache.h"
+#include "ndofdev_epoch.h"
+#include "ndofdev_hotplug.h"
+#include "ndofdev_identity.h"
+#include "ndofdev_internal.h"
+#include "ndofdev_mpsc.h"
+#include "ndofdev_probe.h"
+#include "ndofdev_quirks.h"
+#include "ndofdev_reconnect.h"
+#include "ndofdev_registry.h"
+#include "ndofdev_report.h"
+#include "ndofdev_shm.h"
+#include "ndofdev_stream.h"
+#include "ndofdev_sync.h"
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/stat.h>
+#include "ndofdev_internal_linux.h"
+#include "ndofdev_sysfs.h"
+#endif
+
+#if NDOF_HAVE_SHM
+#include <sys/mman.h>
+#endif
 
 /* -------------------------------------------------------------------------- */
 /* see ndifdev.c */
 void test_device_list_add();
 
 /* -------------------------------------------------------------------------- */
+static void test_libinit_ready(NDOF_InitStatus status, void *ctx)
+{
+    ndof_atomic_store32((volatile uint32_t *) ctx, (uint32_t) status);
+}
+
 void test_ndof_libinit()
 {
+    volatile uint32_t ready = NDOF_INIT_NONE;
+    uint64_t t0;
     int err;
+    
     fprintf(stderr, "____ test_ndof_libinit _______________________________\n");
-    err = ndof_libinit(NULL, NULL, NULL);
-    fprintf(stderr, "ndof_libinit returned %d\n", err);
+    assert(ndof_init_status() == NDOF_INIT_NONE);
+    assert(ndof_wait_ready(0) == NDOF_INIT_NONE);
+    
+    t0 = ndof_time_ns();
+    err = ndof_libinit_async(NULL, NULL, NULL, test_libinit_ready, 
+                             (void *) &ready);
+    fprintf(stderr, "ndof_libinit_async returned %d after %.1f us\n", err,
+            (double)(ndof_time_ns() - t0) / 1000);
     assert(err == 0);
+    assert(ndof_init_status() != NDOF_INIT_NONE);
+    assert(ndof_wait_ready(10000000000ULL) == NDOF_INIT_READY);
+    fprintf(stderr, "ready after %.1f us\n", 
+            (double)(ndof_time_ns() - t0) / 1000);
+    
+    /* the callback runs right after the status changes */
+    while (ndof_atomic_load32(&ready) == NDOF_INIT_NONE)
+        ndof_sleep_ns(1000000);
+    assert(ndof_atomic_load32(&ready) == NDOF_INIT_READY);
+    assert(ndof_init_status() == NDOF_INIT_READY);
     fprintf(stderr, "  done\n");
 }
 
@@ -122,19 +177,2817 @@ void test_ndof_init_first()
 }
 
 /* -------------------------------------------------------------------------- */
-#ifdef __cplusplus
-extern "C" 
-#endif
-void run_noninteractive_tests()
+typedef struct test_bind_ctx {
+    NDOF_Device *dev;
+    volatile uint32_t done;
+} test_bind_ctx;
+
+static void test_bind_producer(void *arg)
 {
-    test_ndof_libinit();
-	test_device_list_add();
+    test_bind_ctx *ctx = (test_bind_ctx *) arg;
+    
+    while (!ndof_atomic_load32(&ctx->done))
+        ndof_stream_publish(ctx->dev);
+}
 
-    #if TARGET_OS_MAC
-	test_ndof_devcount();
-    #endif
+void test_ndof_bind_state()
+{
+    NDOF_Device *dev;
+    float packed[NDOF_MAX_AXES_COUNT];
+    struct { short v; short pad; } interleaved[NDOF_MAX_AXES_COUNT];
+    int ints[2][NDOF_MAX_AXES_COUNT];
+    test_bind_ctx ctx;
+    ndof_thread_t producer;
+    int i, k;
+    
+    fprintf(stderr, "____ test_ndof_bind_state _____________________________\n");
+    
+    dev = ndof_create();
+    assert(ndof_bind_state(dev, packed, 0, 0) == -1);
+    assert(ndof_bind_state(dev, packed, 2, NDOF_FORMAT_FLOAT32) == -1);
+    assert(ndof_bind_state(dev, packed, 0, 
+                           NDOF_FORMAT_FLOAT32 | NDOF_FORMAT_NORMALIZED) == 0);
+    
+    dev->axes[0] = dev->axes_max;
+    dev->axes[1] = dev->axes_min;
+    dev->axes[2] = 0;
+    dev->axes[3] = dev->axes_max / 2;
+    dev->axes[4] = 10 * dev->axes_max; /* out of range: clamped */
+    dev->axes[5] = 0;
+    ndof_stream_publish(dev);
+    assert(packed[0] == 1.0f);
+    assert(packed[1] == -1.0f);
+    assert(packed[2] == 0.0f);
+    assert(packed[3] == 0.5f);
+    assert(packed[4] == 1.0f);
+    
+    /* rebinding redirects the following samples */
+    assert(ndof_bind_state(dev, &interleaved[0].v, sizeof(interleaved[0]), 
+                           NDOF_FORMAT_INT16) == 0);
+    memset(interleaved, 0x7f, sizeof(interleaved));
+    ndof_stream_publish(dev);
+    assert(interleaved[0].v == dev->axes_max);
+    assert(interleaved[1].v == dev->axes_min);
+    assert(interleaved[4].v == 10 * dev->axes_max);
+    assert(interleaved[0].pad == 0x7f7f);
 
-    test_ndof_create();
+    assert(ndof_bind_state(dev, NULL, 0, 0) == 0);
+    dev->axes[0] = 0;
+    ndof_stream_publish(dev);
+    assert(interleaved[0].v == dev->axes_max);
+    
+    /* rebound while another thread publishes: the memory left is no longer
+       written to once ndof_bind_state returns */
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        dev->axes[i] = 1;
+    ctx.dev = dev;
+    ctx.done = 0;
+    assert(ndof_thread_create(&producer, test_bind_producer, &ctx) == 0);
+    for (k = 0; k < 2000; k++)
+    {
+        assert(ndof_bind_state(dev, ints[k & 1], 0, NDOF_FORMAT_INT32) == 0);
+        memset(ints[~k & 1], 0, sizeof(ints[0]));
+        ndof_sleep_ns(1000);
+        assert(ints[~k & 1][0] == 0 && ints[~k & 1][5] == 0);
+    }
+    assert(ndof_bind_state(dev, NULL, 0, 0) == 0);
+    ndof_atomic_store32(&ctx.done, 1);
+    ndof_thread_join(producer);
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_read_state()
+{
+    NDOF_Device *dev;
+    NDOF_State state;
+    uint64_t t0;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_read_state _____________________________\n");
+    
+    dev = ndof_create();
+    dev->btn_count = 2;
+    assert(ndof_read_state(dev, &state) == 0);
+    assert(state.seq == 0);
+    assert(state.valid == 0);
+    
+    t0 = ndof_time_ns();
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        dev->axes[i] = 10 * i - 20;
+    dev->buttons[1] = 1;
+    ndof_stream_set_valid(dev, 1);
+    ndof_stream_publish(dev);
+    
+    assert(ndof_read_state(dev, &state) == 0);
+    assert(state.seq == 1);
+    assert(state.time_ns >= t0 && state.time_ns <= ndof_time_ns());
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        assert(state.axes[i] == 10 * i - 20);
+    assert(state.buttons == 2);
+    assert(state.valid == 1);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct test_ring_ctx {
+    NDOF_Device *dev;
+    volatile uint32_t done;
+    uint64_t total;
+} test_ring_ctx;
+
+static void test_ring_producer(void *arg)
+{
+    test_ring_ctx *ctx = (test_ring_ctx *) arg;
+    uint64_t i;
+    
+    for (i = 1; i <= ctx->total; i++)
+    {
+        ctx->dev->axes[0] = (long) i;
+        ndof_stream_publish(ctx->dev);
+    }
+    ndof_atomic_store32(&ctx->done, 1);
+}
+
+static void test_ring_consumer(void *arg)
+{
+    test_ring_ctx *ctx = (test_ring_ctx *) arg;
+    NDOF_Sample buf[64];
+    uint64_t seen = 0, dropped_total = 0, dropped, last = 0;
+    size_t i, n;
+    int done;
+    NDOF_Subscriber *sub = ndof_subscribe(ctx->dev);
+    
+    do
+    {
+        done = ndof_atomic_load32(&ctx->done);
+        n = ndof_subscriber_read(sub, buf, 64, &dropped);
+        dropped_total += dropped;
+        for (i = 0; i < n; i++)
+        {
+            assert(buf[i].seq > last);
+            assert(buf[i].axes[0] == (long) buf[i].seq);
+            last = buf[i].seq;
+        }
+        seen += n;
+    } while (!done || n > 0);
+    
+    /* subscribed before the producer started: nothing can be missing */
+    assert(seen + dropped_total == ctx->total);
+    ndof_unsubscribe(sub);
+}
+
+static void test_ring_churn(void *arg)
+{
+    test_ring_ctx *ctx = (test_ring_ctx *) arg;
+    NDOF_Sample buf[8];
+    
+    while (!ndof_atomic_load32(&ctx->done))
+    {
+        NDOF_Subscriber *sub = ndof_subscribe(ctx->dev);
+        ndof_subscriber_read(sub, buf, 8, NULL);
+        ndof_unsubscribe(sub);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_subscribe()
+{
+    NDOF_Device *dev;
+    NDOF_Subscriber *sub1, *sub2;
+    NDOF_Sample buf[32];
+    uint64_t dropped;
+    test_ring_ctx ctx;
+    ndof_thread_t producer, consumers[2], churn;
+    long i;
+    
+    fprintf(stderr, "____ test_ndof_subscribe ______________________________\n");
+    
+    dev = ndof_create();
+    dev->axes[0] = -1;
+    ndof_stream_publish(dev); /* before the ring: not retained */
+    
+    /* no room for that many: refused, rather than wrapped around */
+    assert(ndof_ring_create((size_t) -1) == NULL);
+    assert(ndof_enable_ring(dev, (size_t) -1 / 2) == -1);
+    assert(ndof_enable_ring(dev, 12) == 0);  /* rounded up to 16 */
+    sub1 = ndof_subscribe(dev);
+    for (i = 1; i <= 5; i++)
+    {
+        dev->axes[0] = i;
+        ndof_stream_publish(dev);
+    }
+    sub2 = ndof_subscribe(dev);
+    
+    /* independent cursors */
+    assert(ndof_subscriber_read(sub1, buf, 3, &dropped) == 3);
+    assert(dropped == 0 && buf[0].axes[0] == 1 && buf[2].axes[0] == 3);
+    assert(ndof_subscriber_read(sub2, buf, 32, &dropped) == 0);
+    assert(ndof_subscriber_read(sub1, buf, 32, &dropped) == 2);
+    assert(buf[1].axes[0] == 5 && buf[1].seq == 6);
+    
+    /* sub1 keeps up, sub2 falls behind by more than the capacity */
+    for (i = 6; i <= 25; i++)
+    {
+        dev->axes[0] = i;
+        ndof_stream_publish(dev);
+    }
+    assert(ndof_subscriber_read(sub2, buf, 32, &dropped) == 16);
+    assert(dropped == 4);
+    assert(buf[0].axes[0] == 10 && buf[15].axes[0] == 25);
+    assert(ndof_subscriber_read(sub1, buf, 32, &dropped) == 16);
+    assert(dropped == 4);
+    ndof_unsubscribe(sub1);
+    ndof_unsubscribe(sub2);
+    ndof_destroy(dev);
+    
+    /* concurrent producer, consumers and subscription churn */
+    ctx.dev = ndof_create();
+    ctx.done = 0;
+    ctx.total = 200000;
+    ndof_enable_ring(ctx.dev, 256);
+    ndof_thread_create(&consumers[0], test_ring_consumer, &ctx);
+    ndof_thread_create(&consumers[1], test_ring_consumer, &ctx);
+    ndof_thread_create(&churn, test_ring_churn, &ctx);
+    ndof_sleep_ns(10000000);  /* let the consumers subscribe */
+    ndof_thread_create(&producer, test_ring_producer, &ctx);
+    ndof_thread_join(producer);
+    ndof_thread_join(consumers[0]);
+    ndof_thread_join(consumers[1]);
+    ndof_thread_join(churn);
+    ndof_destroy(ctx.dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_get_history()
+{
+    NDOF_Device *dev;
+    NDOF_State state;
+    NDOF_Sample buf[128];
+    uint64_t times[10];
+    long i;
+    
+    fprintf(stderr, "____ test_ndof_get_history ____________________________\n");
+    
+    dev = ndof_create();
+    ndof_enable_ring(dev, 64);
+    assert(ndof_get_history(dev, 0, buf, 128) == 0);
+    
+    for (i = 0; i < 10; i++)
+    {
+        dev->axes[0] = i;
+        ndof_stream_publish(dev);
+        ndof_read_state(dev, &state);
+        times[i] = state.time_ns;
+        ndof_sleep_ns(1000);
+    }
+    
+    assert(ndof_get_history(dev, 0, buf, 128) == 10);
+    assert(buf[0].axes[0] == 0 && buf[9].axes[0] == 9);
+    assert(ndof_get_history(dev, times[3], buf, 128) == 6);
+    assert(buf[0].axes[0] == 4 && buf[0].time_ns > times[3]);
+    assert(ndof_get_history(dev, times[3], buf, 2) == 2);
+    assert(buf[0].axes[0] == 4 && buf[1].axes[0] == 5);
+    assert(ndof_get_history(dev, times[9], buf, 128) == 0);
+    
+    /* only the last 64 samples are retained */
+    for (i = 10; i < 100; i++)
+    {
+        dev->axes[0] = i;
+        ndof_stream_publish(dev);
+    }
+    assert(ndof_get_history(dev, times[5], buf, 128) == 64);
+    assert(buf[0].axes[0] == 36 && buf[63].axes[0] == 99);
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+static void test_resample_push(NDOF_Device *dev, uint64_t time_ns, long v)
+{
+    NDOF_DeviceStream *s = (NDOF_DeviceStream *) dev->stream_data;
+    NDOF_Sample sample;
+    
+    memset(&sample, 0, sizeof(sample));
+    sample.seq = ++s->seq;
+    sample.time_ns = time_ns;
+    sample.axes[0] = v;
+    sample.axes[1] = -v;
+    ndof_ring_push(s->ring, &sample);
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_resampler()
+{
+    NDOF_Device *dev;
+    NDOF_Resampler *rs;
+    NDOF_Sample out[256];
+    const uint64_t t0 = 1000000000ULL, ms = 1000000ULL;
+    size_t n, i;
+    long k;
+    
+    fprintf(stderr, "____ test_ndof_resampler ______________________________\n");
+    
+    dev = ndof_create();
+    assert(ndof_resampler_create(dev, 0, NDOF_RESAMPLE_LINEAR) == NULL);
+    assert(ndof_resampler_create(dev, 240, 0) == NULL);
+    
+    /* upsampling a ramp, 10 ms to 1 ms: interpolation is exact */
+    rs = ndof_resampler_create(dev, 1000, NDOF_RESAMPLE_LINEAR);
+    assert(ndof_resampler_read(rs, out, 256) == 0);
+    for (k = 0; k <= 5; k++)
+        test_resample_push(dev, t0 + k * 10 * ms, k * 100);
+    n = ndof_resampler_read(rs, out, 10);
+    assert(n == 10);
+    n += ndof_resampler_read(rs, out + 10, 256 - 10);
+    assert(n == 50);
+    for (i = 0; i < n; i++)
+    {
+        assert(out[i].seq == i + 1);
+        assert(out[i].time_ns == t0 + (i + 1) * ms);
+        assert(out[i].axes[0] == (long)(i + 1) * 10);
+        assert(out[i].axes[1] == -(long)(i + 1) * 10);
+    }
+    assert(ndof_resampler_read(rs, out, 256) == 0);
+    ndof_resampler_destroy(rs);
+    
+    /* same in cubic mode, with uneven spacing: still exact on a ramp, one
+       input sample later */
+    rs = ndof_resampler_create(dev, 1000, NDOF_RESAMPLE_CUBIC);
+    test_resample_push(dev, t0 + 100 * ms, 0);
+    test_resample_push(dev, t0 + 104 * ms, 400);
+    test_resample_push(dev, t0 + 110 * ms, 1000);
+    n = ndof_resampler_read(rs, out, 256);
+    assert(n == 4);
+    test_resample_push(dev, t0 + 117 * ms, 1700);
+    n += ndof_resampler_read(rs, out + n, 256 - n);
+    assert(n == 10);
+    for (i = 0; i < n; i++)
+    {
+        assert(out[i].time_ns == t0 + (101 + i) * ms);
+        assert(out[i].axes[0] == (long)(i + 1) * 100);
+    }
+    ndof_resampler_destroy(rs);
+    
+    /* downsampling 1 kHz to 100 Hz: output is the average over 10 ms, the 
+       500 Hz component does not alias into it */
+    rs = ndof_resampler_create(dev, 100, NDOF_RESAMPLE_LINEAR);
+    for (k = 0; k <= 100; k++)
+        test_resample_push(dev, t0 + 200 * ms + k * ms, 50 + (k & 1 ? 30 : -30));
+    n = ndof_resampler_read(rs, out, 256);
+    assert(n == 10);
+    for (i = 0; i < n; i++)
+    {
+        assert(out[i].time_ns == t0 + (210 + i * 10) * ms);
+        assert(out[i].axes[0] >= 48 && out[i].axes[0] <= 52);
+    }
+    
+    /* overrun: the output starts over after the gap */
+    for (k = 0; k < 2000; k++)
+        test_resample_push(dev, t0 + 400 * ms + k * ms, 7);
+    n = ndof_resampler_read(rs, out, 256);
+    assert(n > 0 && out[0].time_ns > t0 + 400 * ms + 900 * ms);
+    assert(out[n - 1].axes[0] == 7);
+    ndof_resampler_destroy(rs);
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_predict()
+{
+    NDOF_Device *dev;
+    NDOF_DeviceStream *s;
+    NDOF_Sample sample;
+    NDOF_State state;
+    const uint64_t t0 = 1000000000ULL, ms = 1000000ULL;
+    long k;
+    
+    fprintf(stderr, "____ test_ndof_predict ________________________________\n");
+    
+    dev = ndof_create();
+    dev->axes_min = -500;
+    dev->axes_max = 500;
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    assert(ndof_predict(dev, t0, NULL) == -1);
+    assert(ndof_predict(dev, t0, &state) == 0);
+    assert(state.seq == 0 && state.axes[0] == 0);
+    
+    /* axis 0 moving at 2.5 units per ms, sampled every 8 ms, axis 1 still */
+    memset(&sample, 0, sizeof(sample));
+    for (k = 0; k < 40; k++)
+    {
+        sample.seq = k + 1;
+        sample.time_ns = t0 + k * 8 * ms;
+        sample.axes[0] = -450 + k * 20;
+        sample.axes[1] = 42;
+        ndof_predictor_update(&s->predictor, &sample);
+    }
+    
+    /* the model converged on the ramp */
+    assert(ndof_predict(dev, sample.time_ns + 20 * ms, &state) == 0);
+    assert(state.seq == 40 && state.time_ns == sample.time_ns + 20 * ms);
+    assert(labs(state.axes[0] - (sample.axes[0] + 50)) <= 2);
+    assert(state.axes[1] == 42);
+    
+    /* the past is not extrapolated, the far future is clamped */
+    assert(ndof_predict(dev, t0, &state) == 0);
+    assert(labs(state.axes[0] - sample.axes[0]) <= 2);
+    assert(ndof_predict(dev, sample.time_ns + 1000 * ms, &state) == 0);
+    assert(labs(state.axes[0] - (sample.axes[0] + 125)) <= 3);
+    
+    /* the axes range bounds the prediction */
+    for (; k < 60; k++)
+    {
+        sample.seq = k + 1;
+        sample.time_ns = t0 + k * 8 * ms;
+        sample.axes[0] = -450 + k * 20;
+        ndof_predictor_update(&s->predictor, &sample);
+    }
+    assert(ndof_predict(dev, sample.time_ns + 40 * ms, &state) == 0);
+    assert(state.axes[0] == 500);
+    
+    /* after a pause, the model restarts at rest */
+    sample.seq++;
+    sample.time_ns += 500 * ms;
+    sample.axes[0] = 0;
+    ndof_predictor_update(&s->predictor, &sample);
+    assert(ndof_predict(dev, sample.time_ns + 20 * ms, &state) == 0);
+    assert(state.axes[0] == 0);
+    
+    /* samples published by the backends feed the model */
+    dev->axes[0] = 123;
+    ndof_stream_publish(dev);
+    ndof_read_state(dev, &state);
+    assert(ndof_predict(dev, state.time_ns, &state) == 0);
+    assert(state.seq == s->seq);
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_pose()
+{
+    NDOF_Device *dev;
+    NDOF_DeviceStream *s;
+    NDOF_PoseConfig config;
+    NDOF_PoseDelta delta;
+    NDOF_Sample sample;
+    const uint64_t t0 = 1000000000ULL, ms = 1000000ULL;
+    const double pi = 3.14159265358979323846;
+    long k;
+    
+    fprintf(stderr, "____ test_ndof_pose ___________________________________\n");
+    
+    dev = ndof_create();
+    s = (NDOF_DeviceStream *) dev->stream_data;
+    assert(ndof_pose_fetch(dev, 0, &delta) == -1);
+    
+    /* 1000 units is 1 unit/s along X, or a quarter turn/s around Z */
+    memset(&config, 0, sizeof(config));
+    for (k = 0; k < 6; k++)
+        config.gains[k] = (k < 3 ? 0.001 : 0.5 * pi / 1000.0);
+    config.frame[0][0] = config.frame[1][1] = config.frame[2][2] = 1.0;
+    assert(ndof_pose_configure(dev, &config) == 0);
+    
+    memset(&sample, 0, sizeof(sample));
+    sample.axes[0] = 1000;
+    sample.time_ns = t0;
+    ndof_pose_integrate(&s->pose, &sample);
+    sample.time_ns = t0 + 10 * ms;
+    ndof_pose_integrate(&s->pose, &sample);
+    assert(ndof_pose_fetch(dev, t0 + 20 * ms, &delta) == 0);
+    assert(fabs(delta.position[0] - 0.02) < 1e-12);
+    assert(delta.position[1] == 0.0 && delta.position[2] == 0.0);
+    assert(delta.orientation[0] == 1.0);
+    assert(delta.samples == 2 && delta.duration_ns == 20 * ms);
+    
+    /* the delta was reset; the velocity is held at most 100 ms */
+    assert(ndof_pose_fetch(dev, t0 + 1000 * ms, &delta) == 0);
+    assert(delta.samples == 0 && delta.duration_ns == 90 * ms);
+    assert(fabs(delta.position[0] - 0.09) < 1e-12);
+    
+    /* translating while turning, at 100 Hz for 1 s: a quarter circle */
+    sample.axes[5] = 1000;
+    for (k = 0; k <= 100; k++)
+    {
+        sample.time_ns = t0 + 2000 * ms + k * 10 * ms;
+        ndof_pose_integrate(&s->pose, &sample);
+    }
+    assert(ndof_pose_fetch(dev, 0, &delta) == 0);
+    assert(delta.samples == 101);
+    assert(fabs(delta.orientation[0] - cos(pi / 4)) < 1e-9);
+    assert(fabs(delta.orientation[3] - sin(pi / 4)) < 1e-9);
+    assert(fabs(delta.position[0] - 2 / pi) < 0.01);
+    assert(fabs(delta.position[1] - 2 / pi) < 0.01);
+    
+    /* the frame maps the device Y on the application Z */
+    memset(config.frame, 0, sizeof(config.frame));
+    config.frame[0][0] = config.frame[1][2] = config.frame[2][1] = 1.0;
+    assert(ndof_pose_configure(dev, &config) == 0);
+    memset(sample.axes, 0, sizeof(sample.axes));
+    sample.axes[1] = 1000;
+    sample.time_ns = t0 + 5000 * ms;
+    ndof_pose_integrate(&s->pose, &sample);
+    assert(ndof_pose_fetch(dev, sample.time_ns + 50 * ms, &delta) == 0);
+    assert(delta.position[1] == 0.0 && fabs(delta.position[2] - 0.05) < 1e-12);
+    
+    /* a sample older than the last fetch: its time is not counted twice */
+    sample.time_ns = t0 + 5030 * ms;
+    ndof_pose_integrate(&s->pose, &sample);
+    assert(ndof_pose_fetch(dev, t0 + 5060 * ms, &delta) == 0);
+    assert(delta.samples == 1 && delta.duration_ns == 10 * ms);
+    assert(fabs(delta.position[2] - 0.01) < 1e-12);
+    
+    /* samples published by the backends are integrated */
+    dev->axes[0] = 1000;
+    ndof_stream_publish(dev);
+    ndof_stream_publish(dev);
+    assert(ndof_pose_fetch(dev, 0, &delta) == 0);
+    assert(delta.samples == 2);
+    
+    assert(ndof_pose_configure(dev, NULL) == 0);
+    ndof_stream_publish(dev);
+    assert(ndof_pose_fetch(dev, 0, &delta) == -1);
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_set_transform()
+{
+    NDOF_Device *dev;
+    NDOF_State state;
+    NDOF_Transform t;
+    NDOF_DeviceKey key;
+    float m[36], off[6];
+    long in[64][NDOF_MAX_AXES_COUNT], out[64][NDOF_MAX_AXES_COUNT];
+    long i, j, k;
+    
+    fprintf(stderr, "____ test_ndof_set_transform _________________________\n");
+    
+    dev = ndof_create();
+    dev->axes_count = 6;
+    dev->axes_min = -350;
+    dev->axes_max = 350;
+    
+    /* the models older than the SpaceTraveler swap and negate Y and Z */
+    assert(ndof_transform_default(0x046d, 0xc626) == NULL);
+    assert(ndof_transform_default(0x1234, 0x5678) == NULL);
+    assert(ndof_transform_default(0x046d, 0xc606) != NULL);
+    key = ndof_device_key(0x046d, 0xc606, 1, 8, 0, NULL);
+    ndof_stream_identify(dev, &key);
+    for (i = 0; i < 6; i++)
+        dev->axes[i] = 10 * (i + 1);
+    ndof_stream_publish(dev);
+    assert(dev->axes[0] == 10 && dev->axes[1] == -30 && dev->axes[2] == -20);
+    assert(dev->axes[3] == 40 && dev->axes[4] == -60 && dev->axes[5] == -50);
+    
+    key = ndof_device_key(0x046d, 0xc626, 1, 8, 0, NULL);
+    ndof_stream_identify(dev, &key);
+    assert(((NDOF_DeviceStream *) dev->stream_data)->transform_on == 0);
+    
+    /* swap X and Y, invert Z, Y leaks 10% into RZ, RX offset by 5 */
+    memset(m, 0, sizeof(m));
+    memset(off, 0, sizeof(off));
+    m[0 * 6 + 1] = 1.0f;
+    m[1 * 6 + 0] = 1.0f;
+    m[2 * 6 + 2] = -1.0f;
+    m[3 * 6 + 3] = m[4 * 6 + 4] = m[5 * 6 + 5] = 1.0f;
+    m[5 * 6 + 1] = 0.1f;
+    off[3] = 5.0f;
+    assert(ndof_set_transform(NULL, m, off) == -1);
+    assert(ndof_set_transform(dev, m, off) == 0);
+    
+    for (i = 0; i < 6; i++)
+        dev->axes[i] = 10 * (i + 1);
+    ndof_stream_publish(dev);
+    assert(dev->axes[0] == 20 && dev->axes[1] == 10 && dev->axes[2] == -30);
+    assert(dev->axes[3] == 45 && dev->axes[4] == 50 && dev->axes[5] == 62);
+    ndof_read_state(dev, &state);
+    assert(state.axes[5] == 62);
+    
+    /* results are limited to the axes range */
+    dev->axes[0] = 0;
+    dev->axes[1] = 0;
+    dev->axes[2] = -350;
+    dev->axes[3] = 350;
+    ndof_stream_publish(dev);
+    assert(dev->axes[2] == 350 && dev->axes[3] == 350);
+    
+    /* missing axes do not feed back the previous output */
+    dev->axes_count = 3;
+    for (i = 0; i < 6; i++)
+        dev->axes[i] = 0;
+    dev->axes[3] = 100;
+    ndof_stream_publish(dev);
+    assert(dev->axes[3] == 5);
+    dev->axes_count = 6;
+    
+    /* back to the model default */
+    assert(ndof_set_transform(dev, NULL, NULL) == 0);
+    dev->axes[0] = 1;
+    ndof_stream_publish(dev);
+    assert(dev->axes[0] == 1);
+    
+    /* the SIMD kernel agrees with a plain evaluation */
+    for (i = 0; i < 36; i++)
+        m[i] = (float)((i * 7) % 11 - 5) / 4.0f;
+    ndof_transform_set(&t, m, off);
+    for (k = 0; k < 64; k++)
+        for (i = 0; i < 6; i++)
+            in[k][i] = (k * 13 + i * 29) % 201 - 100;
+    for (k = 0; k < 64; k++)
+    {
+        ndof_transform_apply(&t, in[k], out[k], 0, 0);
+        for (i = 0; i < 6; i++)
+        {
+            double v = off[i];
+            for (j = 0; j < 6; j++)
+                v += m[i * 6 + j] * in[k][j];
+            assert(labs(out[k][i] - (long) floor(v + 0.5)) <= 1);
+        }
+    }
+    ndof_destroy(dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_quirks()
+{
+    const NDOF_DeviceQuirks *table, *q;
+    size_t count, i;
+    
+    fprintf(stderr, "____ test_ndof_quirks _________________________________\n");
+    
+    /* the binary search relies on the order of the table, which nothing 
+       but this checks: keys strictly increase, so no two entries overlap,
+       and each one is the key of a single model */
+    table = ndof_quirks_table(&count);
+    assert(count > 0);
+    for (i = 0; i < count; i++)
+    {
+        assert(i == 0 || table[i - 1].key < table[i].key);
+        assert(table[i].key == NDOF_QUIRKS_KEY(table[i].key >> 16, 
+                                               table[i].key & 0xffff));
+        assert(table[i].layout < NDOF_LAYOUT_COUNT);
+        assert(table[i].axes_count <= NDOF_MAX_AXES_COUNT);
+        assert(table[i].btn_count <= NDOF_MAX_BUTTONS_COUNT);
+        assert(table[i].logical_min <= table[i].logical_max);
+        assert(ndof_quirks_lookup(table[i].key >> 16, 
+                                  table[i].key & 0xffff) == &table[i]);
+    }
+    
+    q = ndof_quirks_lookup(0x046d, 0xc626);
+    assert(q && q->device_class == NDOF_CLASS_6DOF);
+    assert(q->layout == NDOF_LAYOUT_SPLIT_2 && q->btn_count == 2);
+    assert(q->logical_min == -350 && q->logical_max == 350);
+    assert(ndof_quirks_lookup(0x256f, 0xc652)->device_class 
+           == NDOF_CLASS_RECEIVER);
+    assert(ndof_quirks_lookup(0x046d, 0xc52b) == NULL);
+    assert(ndof_quirks_lookup(0, 0) == NULL);
+    assert(ndof_quirks_lookup(0xffff, 0xffff) == NULL);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_identity()
+{
+    NDOF_DeviceKey a, b, keys[1000];
+    NDOF_KeySet set;
+    NDOF_Device *dev1, *dev2;
+    long i;
+    
+    fprintf(stderr, "____ test_ndof_identity _______________________________\n");
+    
+    a = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14200000, "SN0001");
+    assert(NDOF_KEY_VENDOR_ID(a) == 0x046d && NDOF_KEY_PRODUCT_ID(a) == 0xc626);
+    assert(NDOF_KEY_LOCATION(a) == 0x14200000 && NDOF_KEY_SERIAL(a) != 0);
+    b = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14200000, "SN0001");
+    assert(ndof_key_equal(&a, &b) && ndof_key_hash(&a) == ndof_key_hash(&b));
+    
+    /* same model at the same port, but another unit */
+    b = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14200000, "SN0002");
+    assert(!ndof_key_equal(&a, &b) && NDOF_KEY_MODEL(a) == NDOF_KEY_MODEL(b));
+    b = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14200000, "");
+    assert(NDOF_KEY_SERIAL(b) == 0);
+    b = ndof_device_key(0, 0, 0, 0, 0, NULL);
+    assert(ndof_key_is_null(&b));
+    
+    /* the set survives growing and collisions of the low bits */
+    ndof_keyset_init(&set, 0);
+    for (i = 0; i < 1000; i++)
+    {
+        keys[i] = ndof_device_key(0x256f, 0xc600 + (i % 7), 1, 8, i << 8, NULL);
+        assert(ndof_keyset_insert(&set, &keys[i]) == 1);
+    }
+    assert(set.count == 1000 && 2 * set.count <= set.mask + 1);
+    for (i = 0; i < 1000; i++)
+    {
+        assert(ndof_keyset_contains(&set, &keys[i]));
+        assert(ndof_keyset_insert(&set, &keys[i]) == 0);
+    }
+    assert(!ndof_keyset_contains(&set, &a));
+    ndof_keyset_dispose(&set);
+    
+    /* identified devices are matched on their keys alone */
+    dev1 = ndof_create();
+    dev2 = ndof_create();
+    ndof_stream_identify(dev1, &a);
+    ndof_stream_identify(dev2, &a);
+    assert(ndof_match(dev1, dev2));
+    ndof_stream_identify(dev2, &keys[0]);
+    assert(!ndof_match(dev1, dev2));
+    b = ndof_stream_key(dev2);
+    assert(ndof_key_equal(&b, &keys[0]));
+    ndof_destroy(dev1);
+    ndof_destroy(dev2);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+/* mock enumerator: devices are keyed by their index, built objects count */
+typedef struct test_registry_mock {
+    long built;
+    long released;
+} test_registry_mock;
+
+static void *test_registry_add(void *ctx, const NDOF_DeviceKey *key, 
+                               void *handle)
+{
+    long *object = (long *) malloc(sizeof(long));
+    *object = (long) NDOF_KEY_LOCATION(*key);
+    assert(handle == NULL || *(long *) handle == *object);
+    ((test_registry_mock *) ctx)->built++;
+    return object;
+}
+
+static void test_registry_remove(void *ctx, const NDOF_DeviceKey *key, 
+                                 void *object)
+{
+    assert(*(long *) object == (long) NDOF_KEY_LOCATION(*key));
+    ((test_registry_mock *) ctx)->released++;
+    free(object);
+}
+
+static void test_registry_scan(NDOF_DeviceKey *keys, long *ids, size_t count)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+        keys[i] = ndof_device_key(0x256f, 0xc635, 1, 8, ids[i], NULL);
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_registry()
+{
+    test_registry_mock mock = { 0, 0 };
+    NDOF_Registry reg;
+    NDOF_RegistryDiff diff;
+    NDOF_DeviceKey keys[8];
+    long ids[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    void *handles[8];
+    void *kept;
+    size_t i;
+    
+    fprintf(stderr, "____ test_ndof_registry _______________________________\n");
+    
+    for (i = 0; i < 8; i++)
+        handles[i] = &ids[i];
+    ndof_registry_init(&reg, test_registry_add, test_registry_remove, &mock);
+    
+    test_registry_scan(keys, ids, 3);
+    assert(ndof_registry_reconcile(&reg, keys, handles, 3, &diff) == 0);
+    assert(diff.added == 3 && diff.removed == 0 && diff.unchanged == 0);
+    assert(mock.built == 3 && reg.count == 3);
+    kept = ndof_registry_find(&reg, &keys[1]);
+    assert(kept && *(long *) kept == 2);
+    
+    /* same devices: nothing is rebuilt */
+    assert(ndof_registry_reconcile(&reg, keys, handles, 3, &diff) == 0);
+    assert(diff.added == 0 && diff.removed == 0 && diff.unchanged == 3);
+    assert(mock.built == 3 && ndof_registry_find(&reg, &keys[1]) == kept);
+    
+    /* 1 unplugged, 4 and 5 plugged, 4 listed twice */
+    ids[0] = 5; ids[2] = 4; ids[3] = 4; ids[4] = 3;
+    handles[4] = &ids[4];
+    test_registry_scan(keys, ids, 5);
+    assert(ndof_registry_reconcile(&reg, keys, handles, 5, &diff) == 0);
+    assert(diff.added == 2 && diff.removed == 1 && diff.unchanged == 2);
+    assert(mock.built == 5 && mock.released == 1 && reg.count == 4);
+    assert(ndof_registry_find(&reg, &keys[1]) == kept);
+    assert(*(long *) reg.entries[0].object == 5);
+    assert(*(long *) reg.entries[3].object == 3);
+    keys[5] = ndof_device_key(0x256f, 0xc635, 1, 8, 1, NULL);
+    assert(ndof_registry_find(&reg, &keys[5]) == NULL);
+    
+    /* everything unplugged */
+    assert(ndof_registry_reconcile(&reg, NULL, NULL, 0, &diff) == 0);
+    assert(diff.removed == 4 && reg.count == 0);
+    assert(ndof_registry_find(&reg, &keys[1]) == NULL);
+    
+    test_registry_scan(keys, ids, 2);
+    assert(ndof_registry_reconcile(&reg, keys, NULL, 2, NULL) == 0);
+    ndof_registry_dispose(&reg);
+    assert(mock.built == 7 && mock.released == 7);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void bench_registry()
+{
+    static const size_t sizes[] = { 1, 10, 100, 500 };
+    test_registry_mock mock = { 0, 0 };
+    NDOF_Registry reg;
+    NDOF_DeviceKey *keys;
+    long *ids;
+    size_t k, i;
+    const long rounds = 2000;
+    long r;
+    
+    fprintf(stderr, "____ bench_registry ___________________________________\n");
+    
+    keys = (NDOF_DeviceKey *) malloc(500 * sizeof(NDOF_DeviceKey));
+    ids = (long *) malloc(500 * sizeof(long));
+    for (k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++)
+    {
+        uint64_t t0, t1;
+        long built;
+        
+        for (i = 0; i < sizes[k]; i++)
+            ids[i] = (long) i;
+        test_registry_scan(keys, ids, sizes[k]);
+        ndof_registry_init(&reg, test_registry_add, test_registry_remove, 
+                           &mock);
+        ndof_registry_reconcile(&reg, keys, NULL, sizes[k], NULL);
+        built = mock.built;
+        
+        /* rescans with nothing changed */
+        t0 = ndof_time_ns();
+        for (r = 0; r < rounds; r++)
+            ndof_registry_reconcile(&reg, keys, NULL, sizes[k], NULL);
+        t1 = ndof_time_ns();
+        
+        /* rescans with the last device replaced every time */
+        for (r = 0; r < rounds; r++)
+        {
+            keys[sizes[k] - 1] = ndof_device_key(0x256f, 0xc635, 1, 8, 
+                                                 1000 + r, NULL);
+            ndof_registry_reconcile(&reg, keys, NULL, sizes[k], NULL);
+        }
+        fprintf(stderr, "  %3lu devices: %8.1f ns/rescan, %8.1f ns/rescan "
+                "with 1 change (%ld rebuilt)\n", (unsigned long) sizes[k],
+                (double)(t1 - t0) / rounds, 
+                (double)(ndof_time_ns() - t1) / rounds, mock.built - built);
+        ndof_registry_dispose(&reg);
+    }
+    assert(mock.built == mock.released);
+    free(keys);
+    free(ids);
+}
+
+/* -------------------------------------------------------------------------- */
+/* report descriptor of a SpaceNavigator: axes in reports 1 and 2, buttons in
+   report 3 followed by padding, LEDs in output report 4 */
+static const unsigned char kTestSpaceNavigatorDesc[] = {
+    0x05, 0x01, 0x09, 0x08, 0xa1, 0x01, 
+    0xa1, 0x00, 0x85, 0x01, 0x16, 0xa2, 0xfe, 0x26, 0x5e, 0x01,
+    0x36, 0x88, 0xfa, 0x46, 0x78, 0x05, 0x55, 0x0c, 0x65, 0x11,
+    0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x75, 0x10, 0x95, 0x03, 0x81, 0x06,
+    0xc0,
+    0xa1, 0x00, 0x85, 0x02, 
+    0x09, 0x33, 0x09, 0x34, 0x09, 0x35, 0x75, 0x10, 0x95, 0x03, 0x81, 0x06,
+    0xc0,
+    0xa1, 0x02, 0x85, 0x03, 0x05, 0x09, 0x19, 0x01, 0x29, 0x02, 
+    0x15, 0x00, 0x25, 0x01, 0x35, 0x00, 0x45, 0x01, 0x75, 0x01, 0x95, 0x02,
+    0x81, 0x02, 0x95, 0x0e, 0x81, 0x03,
+    0xc0,
+    0xa1, 0x02, 0x85, 0x04, 0x05, 0x08, 0x09, 0x4b, 0x15, 0x00, 0x25, 0x01,
+    0x95, 0x01, 0x75, 0x01, 0x91, 0x02, 0x95, 0x01, 0x75, 0x07, 0x91, 0x03,
+    0xc0,
+    0xc0
+};
+
+static const unsigned char kTestSpaceNavigatorReports[3][7] = {
+    { 0x01, 0x5e, 0x01, 0x00, 0x00, 0xa2, 0xfe },   /* X 350, Z -350 */
+    { 0x02, 0xff, 0xff, 0x10, 0x00, 0x00, 0x01 },   /* RX -1, RY 16, RZ 256 */
+    { 0x03, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 }    /* button 2 */
+};
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_decode()
+{
+    static const unsigned char huge[2][13] = {
+        /* Report Size 2, Report Count 0x80000000 */
+        { 0x05, 0x01, 0x09, 0x30, 0x75, 0x02, 
+          0x97, 0x00, 0x00, 0x00, 0x80, 0x81, 0x02 },
+        /* Report Size 32, Report Count 0x08000000: 0 bits once truncated */
+        { 0x05, 0x01, 0x09, 0x30, 0x75, 0x20, 
+          0x97, 0x00, 0x00, 0x00, 0x08, 0x81, 0x02 } };
+    NDOF_ReportPlan plan, other;
+    NDOF_DecodeFn fast;
+    long axes[2][NDOF_MAX_AXES_COUNT], buttons[2][NDOF_MAX_BUTTONS_COUNT];
+    int i, k;
+    
+    fprintf(stderr, "____ test_ndof_decode _________________________________\n");
+    
+    assert(ndof_report_parse(kTestSpaceNavigatorDesc, 
+                             sizeof(kTestSpaceNavigatorDesc), &plan) == 0);
+    assert(plan.uses_report_ids && plan.axes_count == 6 && plan.btn_count == 2);
+    assert(plan.axes_min == -350 && plan.axes_max == 350);
+    assert(ndof_report_parse(kTestSpaceNavigatorDesc, 20, &other) == -1);
+    
+    /* report sizes beyond 4 KiB, whose product in bits wraps around */
+    for (i = 0; i < 2; i++)
+        assert(ndof_report_parse(huge[i], sizeof(huge[i]), &other) == -1);
+    
+    /* the known layout gets its kernel, unknown devices the generic plan */
+    fast = ndof_decode_select(0x046d, 0xc626, &plan);
+    assert(fast != NULL && fast != ndof_report_decode);
+    assert(ndof_decode_select(0x046d, 0xc626, NULL) == ndof_report_decode);
+    assert(ndof_decode_select(0x1234, 0xc626, &plan) == ndof_report_decode);
+    other = plan;
+    other.fields[1].bit_offset += 16;   /* a firmware with another layout */
+    assert(ndof_decode_select(0x046d, 0xc626, &other) == ndof_report_decode);
+    
+    /* both decoders agree */
+    memset(axes, 0, sizeof(axes));
+    memset(buttons, 0, sizeof(buttons));
+    for (k = 0; k < 3; k++)
+    {
+        int d0 = ndof_report_decode(&plan, kTestSpaceNavigatorReports[k], 7, 
+                                    axes[0], buttons[0]);
+        int d1 = fast(&plan, kTestSpaceNavigatorReports[k], 7, 
+                      axes[1], buttons[1]);
+        assert(d0 == d1);
+        assert(d0 == (k < 2 ? NDOF_DECODED_AXES : NDOF_DECODED_BUTTONS));
+    }
+    for (i = 0; i < 2; i++)
+    {
+        assert(axes[i][0] == 350 && axes[i][1] == 0 && axes[i][2] == -350);
+        assert(axes[i][3] == -1 && axes[i][4] == 16 && axes[i][5] == 256);
+        assert(buttons[i][0] == 0 && buttons[i][1] == 1);
+    }
+    
+    /* short and unknown reports are ignored */
+    assert(fast(&plan, kTestSpaceNavigatorReports[0], 4, axes[1], buttons[1]) == 0);
+    assert(ndof_report_decode(&plan, kTestSpaceNavigatorReports[0], 4, 
+                              axes[0], buttons[0]) == 0);
+    assert(fast(&plan, (const unsigned char *) "\x04\x01", 2, 
+                axes[1], buttons[1]) == 0);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+void bench_decode()
+{
+    NDOF_ReportPlan plan;
+    NDOF_DecodeFn kernels[2];
+    const char *names[2] = { "generic plan", "specialized kernel" };
+    long axes[NDOF_MAX_AXES_COUNT], buttons[NDOF_MAX_BUTTONS_COUNT];
+    const long n = 3000000;
+    long i, sum;
+    int k;
+    
+    fprintf(stderr, "____ bench_decode _____________________________________\n");
+    
+    ndof_report_parse(kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc),
+                      &plan);
+    kernels[0] = ndof_report_decode;
+    kernels[1] = ndof_decode_select(0x046d, 0xc626, &plan);
+    
+    for (k = 0; k < 2; k++)
+    {
+        uint64_t t0;
+        memset(axes, 0, sizeof(axes));
+        memset(buttons, 0, sizeof(buttons));
+        t0 = ndof_time_ns();
+        sum = 0;
+        for (i = 0; i < n; i++)
+        {
+            kernels[k](&plan, kTestSpaceNavigatorReports[i % 3], 7, 
+                       axes, buttons);
+            sum += axes[i % 6] + buttons[1];
+        }
+        fprintf(stderr, "  %-20s %6.1f ns/report (%ld)\n", names[k],
+                (double)(ndof_time_ns() - t0) / n, sum);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_reconnect()
+{
+    NDOF_ReconnectCache cache;
+    NDOF_DeviceLayout layout, out;
+    NDOF_DeviceKey a, a_moved, b, b_moved;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_reconnect ______________________________\n");
+    
+    ndof_reconnect_init(&cache);
+    memset(&layout, 0, sizeof(layout));
+    layout.axes_count = 6;
+    layout.max_report[0] = 350;
+    
+    /* with a serial number a device is recognized on any port */
+    a = ndof_device_key(0x256f, 0xc635, 1, 8, 0x14100000, "A1");
+    a_moved = ndof_device_key(0x256f, 0xc635, 1, 8, 0x14200000, "A1");
+    b = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14100000, NULL);
+    b_moved = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14200000, NULL);
+    ndof_reconnect_store(&cache, &a, &layout);
+    layout.max_report[0] = 400;
+    ndof_reconnect_store(&cache, &b, &layout);
+    assert(cache.count == 2);
+    assert(ndof_reconnect_take(&cache, &b_moved, &out) == 0);
+    assert(ndof_reconnect_take(&cache, &a_moved, &out) == 1);
+    assert(out.axes_count == 6 && out.max_report[0] == 350);
+    assert(ndof_reconnect_take(&cache, &a, &out) == 0);
+    assert(ndof_reconnect_take(&cache, &b, &out) == 1);
+    assert(out.max_report[0] == 400 && cache.count == 0);
+    
+    /* the same device again replaces its layout; the oldest is evicted */
+    for (i = 0; i < NDOF_RECONNECT_CAPACITY + 2; i++)
+    {
+        NDOF_DeviceKey k = ndof_device_key(0x256f, 0xc635, 1, 8, i, NULL);
+        layout.max_report[0] = i;
+        ndof_reconnect_store(&cache, &k, &layout);
+        ndof_reconnect_store(&cache, &k, &layout);
+    }
+    assert(cache.count == NDOF_RECONNECT_CAPACITY);
+    for (i = 0; i < NDOF_RECONNECT_CAPACITY + 2; i++)
+    {
+        NDOF_DeviceKey k = ndof_device_key(0x256f, 0xc635, 1, 8, i, NULL);
+        assert(ndof_reconnect_take(&cache, &k, &out) == (i >= 2));
+        assert(i < 2 || out.max_report[0] == i);
+    }
+    assert(cache.count == 0);
+    ndof_reconnect_dispose(&cache);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- 
+    Time from plug to first sample of a report based device: a cold plug 
+    parses the report descriptor, a replug takes the cached plan. */
+void bench_reconnect()
+{
+    NDOF_ReconnectCache cache;
+    NDOF_DeviceLayout layout;
+    NDOF_DeviceKey key;
+    NDOF_Device *dev;
+    const long n = 100000;
+    long i;
+    int k;
+    
+    fprintf(stderr, "____ bench_reconnect __________________________________\n");
+    
+    ndof_reconnect_init(&cache);
+    key = ndof_device_key(0x046d, 0xc626, 1, 8, 0x14100000, NULL);
+    dev = ndof_create();
+    dev->axes_count = 6;
+    dev->btn_count = 2;
+    
+    for (k = 0; k < 2; k++)
+    {
+        uint64_t t0 = ndof_time_ns();
+        
+        for (i = 0; i < n; i++)
+        {
+            NDOF_DecodeFn decode;
+            
+            if (k == 0 || !ndof_reconnect_take(&cache, &key, &layout))
+            {
+                memset(&layout, 0, sizeof(layout));
+                ndof_report_parse(kTestSpaceNavigatorDesc, 
+                                  sizeof(kTestSpaceNavigatorDesc), 
+                                  &layout.plan);
+            }
+            decode = ndof_decode_select(0x046d, 0xc626, &layout.plan);
+            decode(&layout.plan, kTestSpaceNavigatorReports[0], 7, 
+                   dev->axes, dev->buttons);
+            ndof_stream_publish(dev);
+            
+            /* unplugged */
+            ndof_reconnect_store(&cache, &key, &layout);
+        }
+        fprintf(stderr, "  %-20s %6.1f ns to the first sample\n", 
+                (k == 0 ? "cold plug" : "replug"),
+                (double)(ndof_time_ns() - t0) / n);
+    }
+    
+    ndof_destroy(dev);
+    ndof_reconnect_dispose(&cache);
+}
+
+/* -------------------------------------------------------------------------- */
+#define TEST_CAPCACHE_PATH "ndofdev_unittests.cache"
+
+void test_ndof_capcache()
+{
+    NDOF_CapCache cache;
+    NDOF_CapRecord rec[2];
+    const NDOF_DeviceLayout *layout;
+    uint64_t h;
+    FILE *f;
+    
+    fprintf(stderr, "____ test_ndof_capcache _______________________________\n");
+    
+    remove(TEST_CAPCACHE_PATH);
+    assert(ndof_capcache_open(&cache, TEST_CAPCACHE_PATH) == -1);
+    assert(cache.count == 0);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0400, 0) == NULL);
+    
+    h = ndof_descriptor_hash(kTestSpaceNavigatorDesc, 
+                             sizeof(kTestSpaceNavigatorDesc));
+    assert(h != ndof_descriptor_hash(kTestSpaceNavigatorDesc, 
+                                     sizeof(kTestSpaceNavigatorDesc) - 1));
+    memset(rec, 0, sizeof(rec));
+    rec[0].model = NDOF_QUIRKS_KEY(0x046d, 0xc626);
+    rec[0].version = 0x0400;
+    rec[0].desc_hash = h;
+    ndof_report_parse(kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc),
+                      &rec[0].layout.plan);
+    rec[0].layout.axes_count = 6;
+    rec[1] = rec[0];
+    rec[1].version = 0x0500;
+    rec[1].layout.axes_count = 3;
+    assert(ndof_capcache_store(&cache, TEST_CAPCACHE_PATH, rec, 2) == 0);
+    assert(cache.count == 2);
+    ndof_capcache_close(&cache);
+    
+    /* cold start: only the mapping */
+    assert(ndof_capcache_open(&cache, TEST_CAPCACHE_PATH) == 0);
+    layout = ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0400, h);
+    assert(layout && layout->axes_count == 6);
+    assert(layout->plan.field_count == rec[0].layout.plan.field_count);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0400, h + 1) == NULL);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc627, 0x0400, h) == NULL);
+    
+    /* another firmware replaces its record, the other one stays */
+    rec[1].layout.axes_count = 4;
+    assert(ndof_capcache_store(&cache, TEST_CAPCACHE_PATH, &rec[1], 1) == 0);
+    assert(cache.count == 2);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0500, h)->axes_count
+           == 4);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0400, h)->axes_count
+           == 6);
+    ndof_capcache_close(&cache);
+    
+    /* truncated files are ignored */
+    f = fopen(TEST_CAPCACHE_PATH, "r+b");
+    assert(f);
+    fseek(f, 2, SEEK_SET);
+    fputc(0, f);
+    fclose(f);
+    assert(ndof_capcache_open(&cache, TEST_CAPCACHE_PATH) == -1);
+    assert(ndof_capcache_find(&cache, 0x046d, 0xc626, 0x0400, h) == NULL);
+    remove(TEST_CAPCACHE_PATH);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- 
+    Time to the first sample of a device at startup, parsing its report 
+    descriptor or finding its plan in the cache file, mapped once. */
+void bench_capcache()
+{
+    NDOF_CapCache cache;
+    NDOF_CapRecord rec;
+    NDOF_Device *dev;
+    uint64_t t0, open_ns = 0;
+    const long n = 20000;
+    long i;
+    int k;
+    
+    fprintf(stderr, "____ bench_capcache ___________________________________\n");
+    
+    memset(&rec, 0, sizeof(rec));
+    rec.model = NDOF_QUIRKS_KEY(0x046d, 0xc626);
+    rec.desc_hash = ndof_descriptor_hash(kTestSpaceNavigatorDesc, 
+                                         sizeof(kTestSpaceNavigatorDesc));
+    ndof_report_parse(kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc),
+                      &rec.layout.plan);
+    remove(TEST_CAPCACHE_PATH);
+    ndof_capcache_open(&cache, TEST_CAPCACHE_PATH);
+    ndof_capcache_store(&cache, TEST_CAPCACHE_PATH, &rec, 1);
+    ndof_capcache_close(&cache);
+    dev = ndof_create();
+    dev->axes_count = 6;
+    
+    for (i = 0; i < 100; i++)
+    {
+        t0 = ndof_time_ns();
+        ndof_capcache_open(&cache, TEST_CAPCACHE_PATH);
+        open_ns += ndof_time_ns() - t0;
+        ndof_capcache_close(&cache);
+    }
+    ndof_capcache_open(&cache, TEST_CAPCACHE_PATH);
+    
+    for (k = 0; k < 2; k++)
+    {
+        t0 = ndof_time_ns();
+        for (i = 0; i < n; i++)
+        {
+            NDOF_ReportPlan parsed;
+            const NDOF_ReportPlan *plan = &parsed;
+            const NDOF_DeviceLayout *layout = NULL;
+            
+            if (k == 1)
+                layout = ndof_capcache_find(&cache, 0x046d, 0xc626, 0, 
+                    ndof_descriptor_hash(kTestSpaceNavigatorDesc, 
+                                         sizeof(kTestSpaceNavigatorDesc)));
+            if (layout)
+                plan = &layout->plan;
+            else
+                ndof_report_parse(kTestSpaceNavigatorDesc, 
+                                  sizeof(kTestSpaceNavigatorDesc), &parsed);
+            ndof_decode_select(0x046d, 0xc626, plan)(plan, 
+                kTestSpaceNavigatorReports[0], 7, dev->axes, dev->buttons);
+            ndof_stream_publish(dev);
+        }
+        fprintf(stderr, "  %-20s %8.1f ns to the first sample\n", 
+                (k == 0 ? "without cache" : "with cache"),
+                (double)(ndof_time_ns() - t0) / n);
+    }
+    fprintf(stderr, "  %-20s %8.1f ns, once\n", "mapping the cache", 
+            (double) open_ns / 100);
+    
+    ndof_capcache_close(&cache);
+    ndof_destroy(dev);
+    remove(TEST_CAPCACHE_PATH);
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct test_probe_ctx {
+    volatile uint32_t running;
+    volatile uint32_t peak;
+    uint64_t delay_ns;
+} test_probe_ctx;
+
+static void *test_probe_item(void *arg, void *item)
+{
+    test_probe_ctx *ctx = (test_probe_ctx *) arg;
+    uint32_t running = ndof_atomic_add32(&ctx->running, 1);
+    uint32_t peak;
+    
+    while ((peak = ndof_atomic_load32(&ctx->peak)) < running
+           && !ndof_atomic_cas32(&ctx->peak, peak, running))
+        ;
+    ndof_sleep_ns(ctx->delay_ns);
+    ndof_atomic_add32(&ctx->running, (uint32_t) -1);
+    return (char *) item + 1;
+}
+
+void test_ndof_probe()
+{
+    char items[64];
+    void *in[64], *out[64];
+    test_probe_ctx ctx;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_probe __________________________________\n");
+    
+    for (i = 0; i < 64; i++)
+        in[i] = &items[i];
+    
+    /* results land at the index of their item */
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.delay_ns = 1000000;
+    memset(out, 0, sizeof(out));
+    ndof_probe_all(test_probe_item, &ctx, in, out, 64, 0);
+    for (i = 0; i < 64; i++)
+        assert(out[i] == &items[i] + 1);
+    assert(ctx.peak > 1 && ctx.peak <= NDOF_PROBE_MAX_WORKERS);
+    assert(ctx.running == 0);
+    
+    /* one worker is the caller probing serially */
+    memset(&ctx, 0, sizeof(ctx));
+    memset(out, 0, sizeof(out));
+    ndof_probe_all(test_probe_item, &ctx, in, out, 8, 1);
+    for (i = 0; i < 8; i++)
+        assert(out[i] == &items[i] + 1);
+    assert(ctx.peak == 1);
+    assert(out[8] == NULL);
+    
+    ndof_probe_all(test_probe_item, &ctx, in, out, 0, 0);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct test_coalesce_ctx {
+    int      calls;             /* bursts applied */
+    int      count;             /* net events of all of them */
+    int      kinds[256];
+    uint64_t ids[256];
+    int      released;          /* payloads */
+    int      plugged[16];       /* what the client sees, for the bench */
+} test_coalesce_ctx;
+
+static void test_coalesce_apply(void *arg, const NDOF_HotplugEvent *events,
+                                size_t count)
+{
+    test_coalesce_ctx *ctx = (test_coalesce_ctx *) arg;
+    size_t i;
+    
+    ctx->calls++;
+    for (i = 0; i < count; i++)
+    {
+        assert(events[i].payload != NULL);
+        if (ctx->count < 256)
+        {
+            ctx->kinds[ctx->count] = events[i].kind;
+            ctx->ids[ctx->count] = events[i].id;
+        }
+        ctx->count++;
+        ctx->plugged[events[i].id & 15] = (events[i].kind == NDOF_HOTPLUG_ADD);
+    }
+}
+
+static void test_coalesce_release(void *arg, void *payload)
+{
+    ((test_coalesce_ctx *) arg)->released++;
+    free(payload);
+}
+
+static void test_coalesce_push(NDOF_Coalescer *c, int kind, uint64_t id, 
+                               uint64_t now_ns)
+{
+    ndof_coalescer_push(c, kind, id, malloc(1), now_ns);
+}
+
+void test_ndof_hotplug_coalesce()
+{
+    const uint64_t ms = 1000000;
+    test_coalesce_ctx ctx;
+    NDOF_Coalescer c;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_hotplug_coalesce _______________________\n");
+    
+    /* plugged and unplugged within the window: nothing happened */
+    memset(&ctx, 0, sizeof(ctx));
+    ndof_coalescer_init(&c, 10 * ms, test_coalesce_apply, 
+                        test_coalesce_release, &ctx);
+    assert(ndof_coalescer_deadline(&c) == 0);
+    assert(ndof_coalescer_flush(&c, 0) == 0);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1, 0);
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 1, 1 * ms);
+    assert(ndof_coalescer_deadline(&c) == 11 * ms);
+    assert(ndof_coalescer_flush(&c, 10 * ms) == 0);
+    assert(ndof_coalescer_flush(&c, 11 * ms) == 1);
+    assert(ctx.calls == 0 && ctx.released == 2);
+    assert(c.bursts == 1 && c.received == 2 && c.applied == 0);
+    
+    /* one reconciliation, removals first, each in the order first seen */
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1, 20 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 2, 21 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1, 22 * ms);   /* attributes */
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 3, 23 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 4, 24 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 4, 25 * ms);   /* replugged */
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 5, 26 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 5, 27 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 5, 28 * ms);
+    assert(ndof_coalescer_flush(&c, 37 * ms) == 0);
+    assert(ndof_coalescer_flush(&c, 38 * ms) == 1);
+    assert(ctx.calls == 1 && ctx.count == 6);
+    assert(ctx.kinds[0] == NDOF_HOTPLUG_REMOVE && ctx.ids[0] == 3);
+    assert(ctx.kinds[1] == NDOF_HOTPLUG_REMOVE && ctx.ids[1] == 4);
+    assert(ctx.kinds[2] == NDOF_HOTPLUG_REMOVE && ctx.ids[2] == 5);
+    assert(ctx.kinds[3] == NDOF_HOTPLUG_ADD && ctx.ids[3] == 1);
+    assert(ctx.kinds[4] == NDOF_HOTPLUG_ADD && ctx.ids[4] == 2);
+    assert(ctx.kinds[5] == NDOF_HOTPLUG_ADD && ctx.ids[5] == 4);
+    assert(ctx.released == 11);
+    
+    /* a storm is applied after NDOF_HOTPLUG_MAX_WINDOWS nonetheless */
+    memset(&ctx, 0, sizeof(ctx));
+    for (i = 0; i < 20; i++)
+        test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 7, 100 * ms + i * 5 * ms);
+    assert(ndof_coalescer_deadline(&c) == 
+           100 * ms + NDOF_HOTPLUG_MAX_WINDOWS * 10 * ms);
+    assert(ndof_coalescer_flush(&c, 179 * ms) == 0);
+    assert(ndof_coalescer_flush(&c, 180 * ms) == 1);
+    assert(ctx.calls == 1 && ctx.count == 1 && ctx.released == 20);
+    
+    /* many devices at once */
+    memset(&ctx, 0, sizeof(ctx));
+    for (i = 0; i < 100; i++)
+        test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1000 + i, 200 * ms);
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 1050, 200 * ms);
+    assert(ndof_coalescer_flush(&c, 210 * ms) == 1);
+    assert(ctx.calls == 1 && ctx.count == 99);
+    for (i = 0; i < 99; i++)
+        assert(ctx.ids[i] == (uint64_t) (1000 + i + (i >= 50)));
+    
+    /* the burst in progress is dropped */
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1, 300 * ms);
+    ndof_coalescer_dispose(&c);
+    assert(ctx.calls == 1 && ctx.released == 102);
+    
+    /* no window: each event is applied at once */
+    memset(&ctx, 0, sizeof(ctx));
+    ndof_coalescer_init(&c, 0, test_coalesce_apply, test_coalesce_release,
+                        &ctx);
+    test_coalesce_push(&c, NDOF_HOTPLUG_ADD, 1, 0);
+    assert(ctx.calls == 1 && ndof_coalescer_deadline(&c) == 0);
+    test_coalesce_push(&c, NDOF_HOTPLUG_REMOVE, 1, 0);
+    assert(ctx.calls == 2 && ctx.count == 2 && ctx.released == 2);
+    ndof_coalescer_dispose(&c);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+#define TEST_MPSC_PRODUCERS 4
+#define TEST_MPSC_ITEMS     20000
+
+typedef struct test_mpsc_item {
+    NDOF_MpscNode node;
+    int producer;
+    int seq;
+} test_mpsc_item;
+
+typedef struct test_mpsc_producer {
+    NDOF_MpscQueue *q;
+    test_mpsc_item *items;
+} test_mpsc_producer;
+
+static void test_mpsc_produce(void *arg)
+{
+    test_mpsc_producer *p = (test_mpsc_producer *) arg;
+    int i;
+    
+    for (i = 0; i < TEST_MPSC_ITEMS; i++)
+        ndof_mpsc_push(p->q, &p->items[i].node);
+}
+
+void test_ndof_mpsc()
+{
+    static test_mpsc_item items[TEST_MPSC_PRODUCERS][TEST_MPSC_ITEMS];
+    test_mpsc_producer producers[TEST_MPSC_PRODUCERS];
+    ndof_thread_t threads[TEST_MPSC_PRODUCERS];
+    int next[TEST_MPSC_PRODUCERS] = { 0 };
+    NDOF_MpscQueue q;
+    test_mpsc_item a, b;
+    int i, j, popped = 0;
+    
+    fprintf(stderr, "____ test_ndof_mpsc ___________________________________\n");
+    
+    ndof_mpsc_init(&q);
+    assert(ndof_mpsc_pop(&q) == NULL);
+    ndof_mpsc_push(&q, &a.node);
+    ndof_mpsc_push(&q, &b.node);
+    assert(ndof_mpsc_pop(&q) == &a.node);
+    assert(ndof_mpsc_pop(&q) == &b.node);
+    assert(ndof_mpsc_pop(&q) == NULL);
+    ndof_mpsc_push(&q, &a.node);
+    assert(ndof_mpsc_pop(&q) == &a.node);
+    assert(ndof_mpsc_pop(&q) == NULL);
+    
+    /* each producer's items come out in order, none lost */
+    for (i = 0; i < TEST_MPSC_PRODUCERS; i++)
+    {
+        for (j = 0; j < TEST_MPSC_ITEMS; j++)
+        {
+            items[i][j].producer = i;
+            items[i][j].seq = j;
+        }
+        producers[i].q = &q;
+        producers[i].items = items[i];
+        assert(ndof_thread_create(&threads[i], test_mpsc_produce, 
+                                  &producers[i]) == 0);
+    }
+    while (popped < TEST_MPSC_PRODUCERS * TEST_MPSC_ITEMS)
+    {
+        test_mpsc_item *item = (test_mpsc_item *) ndof_mpsc_pop(&q);
+        
+        if (item == NULL)
+            continue;
+        assert(item->seq == next[item->producer]);
+        next[item->producer]++;
+        popped++;
+    }
+    for (i = 0; i < TEST_MPSC_PRODUCERS; i++)
+        ndof_thread_join(threads[i]);
+    assert(ndof_mpsc_pop(&q) == NULL);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+static NDOF_Device      *s_dispatch_log[8];
+static int               s_dispatch_count = 0;
+static NDOF_Device      *s_dispatch_discard = NULL;
+
+static NDOF_HotPlugResult test_dispatch_add(NDOF_Device *dev)
+{
+    assert(s_dispatch_count < 8);
+    s_dispatch_log[s_dispatch_count++] = dev;
+    return (dev == s_dispatch_discard ? NDOF_DISCARD_HOTPLUGGED 
+                                      : NDOF_KEEP_HOTPLUGGED);
+}
+
+static void test_dispatch_removal(NDOF_Device *dev)
+{
+    assert(s_dispatch_count < 8);
+    s_dispatch_log[s_dispatch_count++] = dev;
+}
+
+typedef struct test_dispatch_ctx {
+    NDOF_Device *a, *b;
+} test_dispatch_ctx;
+
+/* what the I/O thread of a backend does */
+static void test_dispatch_backend(void *arg)
+{
+    test_dispatch_ctx *ctx = (test_dispatch_ctx *) arg;
+    
+    assert(ndof_notify_added(test_dispatch_add, ctx->a) 
+           == NDOF_KEEP_HOTPLUGGED);
+    assert(ndof_notify_added(test_dispatch_add, ctx->b) 
+           == NDOF_KEEP_HOTPLUGGED);
+    ndof_notify_removed(test_dispatch_removal, ctx->b);
+    ndof_notify_removed(test_dispatch_removal, ctx->a);
+}
+
+void test_ndof_dispatch()
+{
+    test_dispatch_ctx ctx;
+    ndof_thread_t backend;
+    NDOF_DeviceListNode *node;
+    NDOF_EpochGuard guard;
+    
+    fprintf(stderr, "____ test_ndof_dispatch _______________________________\n");
+    
+    ctx.a = ndof_create();
+    ctx.b = ndof_create();
+    
+    /* the default: called by the backend, here directly */
+    assert(ndof_dispatch_events() == 0);
+    assert(ndof_notify_added(test_dispatch_add, ctx.a) 
+           == NDOF_KEEP_HOTPLUGGED);
+    assert(s_dispatch_count == 1 && s_dispatch_log[0] == ctx.a);
+    
+    /* queued: in order, only when asked */
+    s_dispatch_count = 0;
+    ndof_set_callback_mode(NDOF_CALLBACKS_QUEUED);
+    ndof_thread_create(&backend, test_dispatch_backend, &ctx);
+    ndof_thread_join(backend);
+    assert(s_dispatch_count == 0);
+    assert(ndof_dispatch_events() == 4);
+    assert(s_dispatch_count == 4);
+    assert(s_dispatch_log[0] == ctx.a && s_dispatch_log[1] == ctx.b);
+    assert(s_dispatch_log[2] == ctx.b && s_dispatch_log[3] == ctx.a);
+    assert(ndof_dispatch_events() == 0);
+    
+    /* discarded: destroyed, and not heard of again */
+    s_dispatch_count = 0;
+    s_dispatch_discard = ctx.b;
+    ndof_thread_create(&backend, test_dispatch_backend, &ctx);
+    ndof_thread_join(backend);
+    assert(ndof_dispatch_events() == 3);
+    assert(s_dispatch_log[0] == ctx.a && s_dispatch_log[1] == ctx.b);
+    assert(s_dispatch_log[2] == ctx.a);
+    for (node = ndof_devlist_enter(ndof_default_context(), &guard); node; node = node->next)
+        assert(node->dev != ctx.b);
+    ndof_devlist_exit(&guard);
+    s_dispatch_discard = NULL;
+    
+    /* drained by ndof_update */
+    s_dispatch_count = 0;
+    ndof_set_callback_mode(NDOF_CALLBACKS_IN_UPDATE);
+    ndof_notify_removed(test_dispatch_removal, ctx.a);
+    assert(s_dispatch_count == 0);
+    ndof_update(ctx.a);
+    assert(s_dispatch_count == 1 && s_dispatch_log[0] == ctx.a);
+    
+    /* left over at cleanup */
+    ndof_notify_removed(test_dispatch_removal, ctx.a);
+    ndof_libcleanup();
+    assert(s_dispatch_count == 1);
+    ndof_set_callback_mode(NDOF_CALLBACKS_DIRECT);
+    assert(ndof_libinit(NULL, NULL, NULL) == 0);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+static volatile uint32_t s_epoch_reclaimed = 0;
+
+static void test_epoch_reclaim(void *p)
+{
+    ndof_atomic_add32(&s_epoch_reclaimed, 1);
+    free(p);
+}
+
+void test_ndof_epoch()
+{
+    static NDOF_EpochDomain d, other;
+    NDOF_EpochGuard outer, inner;
+    
+    fprintf(stderr, "____ test_ndof_epoch __________________________________\n");
+    
+    ndof_epoch_init(&d);
+    ndof_epoch_init(&other);
+    
+    /* no reader in: freed at once */
+    ndof_epoch_retire(&d, test_epoch_reclaim, malloc(1));
+    assert(s_epoch_reclaimed == 1);
+    
+    /* held until the readers that could see it leave, nested or not */
+    ndof_epoch_enter(&d, &outer);
+    ndof_epoch_enter(&d, &inner);
+    assert(inner.slot != outer.slot);
+    ndof_epoch_retire(&d, test_epoch_reclaim, malloc(1));
+    ndof_epoch_exit(&inner);
+    ndof_epoch_collect(&d);
+    ndof_epoch_collect(&d);
+    assert(s_epoch_reclaimed == 1);
+    ndof_epoch_exit(&outer);
+    ndof_epoch_collect(&d);
+    assert(s_epoch_reclaimed == 2);
+    
+    /* readers coming in later do not hold it */
+    ndof_epoch_retire(&d, test_epoch_reclaim, malloc(1));
+    ndof_epoch_enter(&d, &outer);
+    ndof_epoch_exit(&outer);
+    ndof_epoch_barrier(&d);
+    assert(s_epoch_reclaimed == 3);
+    
+    /* nor do the readers of another domain */
+    ndof_epoch_enter(&other, &outer);
+    ndof_epoch_retire(&d, test_epoch_reclaim, malloc(1));
+    assert(s_epoch_reclaimed == 4);
+    ndof_epoch_exit(&outer);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- 
+    Devices plugged and unplugged on two threads while others walk the 
+    list and update what they find, with no lock. Run under ASAN and TSAN. */
+#define TEST_CHURN_THREADS  2
+#define TEST_WALK_THREADS   3
+#define TEST_CHURN_ROUNDS   5000
+
+static volatile uint32_t s_churning = 0;
+static volatile uint32_t s_walks = 0;
+
+static void test_devlist_churn(void *arg)
+{
+    NDOF_Device *mine[4] = { NULL, NULL, NULL, NULL };
+    int i;
+    
+    (void) arg;
+    for (i = 0; i < TEST_CHURN_ROUNDS; i++)
+    {
+        if (mine[i & 3])
+            ndof_destroy(mine[i & 3]);
+        mine[i & 3] = ndof_create();
+    }
+    for (i = 0; i < 4; i++)
+        ndof_destroy(mine[i]);
+    ndof_atomic_add32(&s_churning, (uint32_t) -1);
+}
+
+static void test_devlist_walk(void *arg)
+{
+    FILE *sink = (FILE *) arg;
+    
+    while (ndof_atomic_load32(&s_churning) > 0)
+    {
+        NDOF_EpochGuard guard;
+        NDOF_DeviceListNode *node;
+        
+        for (node = ndof_devlist_enter(ndof_default_context(), &guard); node; node = node->next)
+        {
+            assert(node->dev->axes_min == -500 && node->dev->btn_count == -1);
+            ndof_update(node->dev);
+        }
+        ndof_devlist_exit(&guard);
+        
+        if (sink && ndof_atomic_add32(&s_walks, 1) % 64 == 0)
+            ndof_dump_list(sink);
+    }
+}
+
+void test_ndof_devlist_stress()
+{
+    ndof_thread_t churn[TEST_CHURN_THREADS], walk[TEST_WALK_THREADS];
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    FILE *sink = tmpfile();
+    uint64_t t0 = ndof_time_ns();
+    int before = 0, after = 0, i;
+    
+    fprintf(stderr, "____ test_ndof_devlist_stress _________________________\n");
+    
+    for (node = ndof_devlist_enter(ndof_default_context(), &guard); node; node = node->next)
+        before++;
+    ndof_devlist_exit(&guard);
+    
+    s_churning = TEST_CHURN_THREADS;
+    for (i = 0; i < TEST_WALK_THREADS; i++)
+        assert(ndof_thread_create(&walk[i], test_devlist_walk, 
+                                  (i == 0 ? sink : NULL)) == 0);
+    for (i = 0; i < TEST_CHURN_THREADS; i++)
+        assert(ndof_thread_create(&churn[i], test_devlist_churn, NULL) == 0);
+    for (i = 0; i < TEST_CHURN_THREADS; i++)
+        ndof_thread_join(churn[i]);
+    for (i = 0; i < TEST_WALK_THREADS; i++)
+        ndof_thread_join(walk[i]);
+    
+    for (node = ndof_devlist_enter(ndof_default_context(), &guard); node; node = node->next)
+        after++;
+    ndof_devlist_exit(&guard);
+    assert(after == before);
+    ndof_epoch_barrier(&ndof_default_context()->epoch);
+    if (sink)
+        fclose(sink);
+    
+    fprintf(stderr, "  %d plugs, %u walks in %.1f ms\n", 
+            TEST_CHURN_THREADS * TEST_CHURN_ROUNDS, 
+            (unsigned) ndof_atomic_load32(&s_walks),
+            (double) (ndof_time_ns() - t0) / 1000000);
+}
+
+/* -------------------------------------------------------------------------- 
+    Two instances of the library used at the same time on their own 
+    threads, as two subsystems would. */
+#define TEST_CONTEXT_ROUNDS 2000
+
+typedef struct test_context_shard {
+    NDOF_Context *ctx;
+    int added;              /* add callbacks called */
+} test_context_shard;
+
+static test_context_shard s_context_shards[2];
+
+static int test_context_count(NDOF_Context *ctx)
+{
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    int n = 0;
+    
+    for (node = ndof_devlist_enter(ctx, &guard); node; node = node->next)
+    {
+        assert(node->dev->context == ctx);
+        n++;
+    }
+    ndof_devlist_exit(&guard);
+    return n;
+}
+
+/* keeps every other device */
+static NDOF_HotPlugResult test_context_add(NDOF_Device *dev)
+{
+    test_context_shard *shard = 
+        &s_context_shards[dev->context == s_context_shards[1].ctx];
+    
+    assert(dev->context == shard->ctx);
+    return (++shard->added % 2 ? NDOF_DISCARD_HOTPLUGGED 
+                               : NDOF_KEEP_HOTPLUGGED);
+}
+
+static void test_context_run(void *arg)
+{
+    test_context_shard *shard = (test_context_shard *) arg;
+    int i;
+    
+    ndof_context_set_callback_mode(shard->ctx, NDOF_CALLBACKS_QUEUED);
+    for (i = 0; i < TEST_CONTEXT_ROUNDS; i++)
+    {
+        NDOF_Device *dev = ndof_context_create_device(shard->ctx);
+        
+        assert(ndof_notify_added(test_context_add, dev) 
+               == NDOF_KEEP_HOTPLUGGED);
+        assert(ndof_context_dispatch_events(shard->ctx) == 1);
+    }
+    assert(shard->added == TEST_CONTEXT_ROUNDS);
+    assert(test_context_count(shard->ctx) == TEST_CONTEXT_ROUNDS / 2);
+}
+
+void test_ndof_context()
+{
+    ndof_thread_t threads[2];
+    NDOF_Context *def = ndof_default_context();
+    int before = test_context_count(def), i;
+    
+    fprintf(stderr, "____ test_ndof_context ________________________________\n");
+    
+    for (i = 0; i < 2; i++)
+    {
+        s_context_shards[i].ctx = ndof_context_create();
+        s_context_shards[i].added = 0;
+        assert(s_context_shards[i].ctx && s_context_shards[i].ctx != def);
+        assert(ndof_context_init_status(s_context_shards[i].ctx) 
+               == NDOF_INIT_NONE);
+    }
+    for (i = 0; i < 2; i++)
+        assert(ndof_thread_create(&threads[i], test_context_run, 
+                                  &s_context_shards[i]) == 0);
+    for (i = 0; i < 2; i++)
+        ndof_thread_join(threads[i]);
+    
+    /* nothing leaked into the default instance, nor its settings */
+    assert(test_context_count(def) == before);
+    assert(ndof_atomic_load32(&def->callback_mode) == NDOF_CALLBACKS_DIRECT);
+    assert(ndof_default_context() == def);
+    
+    /* cleaning one up leaves the other alone */
+    ndof_context_libcleanup(s_context_shards[0].ctx);
+    assert(test_context_count(s_context_shards[0].ctx) == 0);
+    assert(test_context_count(s_context_shards[1].ctx) 
+           == TEST_CONTEXT_ROUNDS / 2);
+    
+    for (i = 0; i < 2; i++)
+        ndof_context_destroy(s_context_shards[i].ctx);
+    ndof_context_destroy(def);
+    assert(test_context_count(def) == before);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+#define TEST_REPLAY_FILE "ndofdev_unittests.replay"
+
+static int s_backend_added = 0;
+
+static NDOF_HotPlugResult test_backend_add(NDOF_Device *dev)
+{
+    (void) dev;
+    s_backend_added++;
+    return NDOF_KEEP_HOTPLUGGED;
+}
+
+void test_ndof_backend()
+{
+    NDOF_Context *synth = ndof_context_create(), *replay = ndof_context_create();
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    NDOF_Device *dev, *extra;
+    NDOF_State state;
+    NDOF_Sample samples[8];
+    FILE *f;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_backend ________________________________\n");
+    
+    assert(ndof_backend_find(NULL) != NULL);
+    assert(ndof_backend_find("synthetic") == &ndof_backend_synthetic);
+    assert(ndof_backend_find("nope") == NULL);
+    assert(ndof_context_set_backend(synth, "nope") == -1);
+    assert(synth->ops == ndof_backend_find(NULL));
+    
+    /* synthetic: reported as hot-plugged, moving without hardware */
+    assert(ndof_context_set_backend(synth, "synthetic") == 0);
+    assert(ndof_context_libinit(synth, test_backend_add, NULL, "3") == 0);
+    assert(ndof_context_init_status(synth) == NDOF_INIT_READY);
+    assert(ndof_context_set_backend(synth, NULL) == -1);
+    assert(s_backend_added == 3);
+    node = ndof_devlist_enter(synth, &guard);
+    dev = node->dev;
+    ndof_devlist_exit(&guard);
+    assert(strncmp(dev->product, "Synthetic 6DOF", 14) == 0);
+    assert(dev->axes_count == NDOF_MAX_AXES_COUNT && dev->valid);
+    ndof_update(dev);
+    assert(ndof_read_state(dev, &state) == 0 && state.seq == 1);
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        assert(state.axes[i] >= dev->axes_min && state.axes[i] <= dev->axes_max);
+    
+    /* as the native backends: the first device of the product asked for,
+       even if another device reads it already */
+    extra = ndof_context_create_device(synth);
+    snprintf(extra->product, sizeof(extra->product), "Synthetic 6DOF #3");
+    assert(ndof_init_first(extra, NULL) == 0);
+    assert(strcmp(extra->product, "Synthetic 6DOF #3") == 0);
+    ndof_destroy(extra);
+    extra = ndof_context_create_device(synth);
+    assert(ndof_init_first(extra, NULL) == 0);
+    assert(strcmp(extra->product, "Synthetic 6DOF #1") == 0);
+    ndof_destroy(extra);
+    extra = ndof_context_create_device(synth);
+    snprintf(extra->product, sizeof(extra->product), "SpaceNavigator");
+    assert(ndof_init_first(extra, NULL) == -1);
+    ndof_destroy(extra);
+    ndof_context_destroy(synth);
+    
+    /* replay: the samples due, in order, at their pace */
+    f = fopen(TEST_REPLAY_FILE, "w");
+    assert(f);
+    fprintf(f, "# time_ns x y z rx ry rz buttons\n"
+               "5000000000 1 2 3 4 5 6 0x1\n"
+               "5000001000 -1 -2 -3 -4 -5 -6 0x2\n"
+               "\n"
+               "5000002000 10 20 30 40 50 60 0x0\n"
+               "65000000000 7 7 7 7 7 7 0x3\n");
+    fclose(f);
+    
+    assert(ndof_context_set_backend(replay, "replay") == 0);
+    assert(ndof_context_libinit(replay, NULL, NULL, "no such file") == -1);
+    assert(ndof_context_init_status(replay) == NDOF_INIT_FAILED);
+    ndof_context_libcleanup(replay);
+    assert(ndof_context_libinit(replay, NULL, NULL, TEST_REPLAY_FILE) == 0);
+    dev = ndof_context_create_device(replay);
+    assert(ndof_init_first(dev, NULL) == 0);
+    assert(ndof_enable_ring(dev, 16) == 0);
+    ndof_sleep_ns(1000000);
+    ndof_update(dev);
+    assert(ndof_get_history(dev, 0, samples, 8) == 3);
+    assert(samples[0].axes[0] == 1 && samples[0].buttons == 0x1);
+    assert(samples[1].axes[5] == -6 && samples[1].buttons == 0x2);
+    assert(samples[2].axes[2] == 30 && samples[2].buttons == 0);
+    assert(dev->axes[1] == 20);
+    
+    /* devices of different backends are never the same */
+    extra = ndof_create();
+    assert(!ndof_match(dev, extra));
+    ndof_destroy(extra);
+    
+    ndof_context_destroy(replay);
+    remove(TEST_REPLAY_FILE);
+    
+    fprintf(stderr, "  done\n");
+}
+
+#if NDOF_HAVE_SHM
+/* -------------------------------------------------------------------------- */
+#define TEST_SHM_NAME   "/ndofdev_unittests"
+#define TEST_SHM_TOTAL  50000
+
+static void test_shm_producer(void *arg)
+{
+    NDOF_Device *dev = (NDOF_Device *) arg;
+    long i;
+    
+    for (i = 1; i <= TEST_SHM_TOTAL; i++)
+    {
+        dev->axes[0] = i;
+        ndof_stream_publish(dev);
+    }
+}
+
+void test_ndof_shm()
+{
+    NDOF_Context *pub = ndof_context_create(), *reader = ndof_context_create();
+    NDOF_Context *late = ndof_context_create();
+    NDOF_EpochGuard guard;
+    NDOF_DeviceListNode *node;
+    NDOF_Device *dev, *other, *rdev;
+    NDOF_Subscriber *sub;
+    NDOF_State state, rstate;
+    NDOF_Sample pubs[8], reads[64];
+    ndof_thread_t producer;
+    uint64_t dropped;
+    long last = 0;
+    size_t n, k;
+    int i;
+    
+    fprintf(stderr, "____ test_ndof_shm ____________________________________\n");
+    
+    shm_unlink(TEST_SHM_NAME);  /* left by a run that failed */
+    assert(ndof_context_set_backend(reader, "shm") == 0);
+    assert(ndof_context_libinit(reader, NULL, NULL, TEST_SHM_NAME) == -1);
+    ndof_context_libcleanup(reader);
+    
+    /* publisher: a synthetic device, already streaming */
+    assert(ndof_context_set_backend(pub, "synthetic") == 0);
+    assert(ndof_context_libinit(pub, test_backend_add, NULL, "2") == 0);
+    node = ndof_devlist_enter(pub, &guard);
+    dev = node->dev;
+    other = node->next->dev;
+    ndof_devlist_exit(&guard);
+    ndof_update(dev);
+    ndof_update(dev);
+    assert(ndof_shm_publish(dev, TEST_SHM_NAME) == 0);
+    assert(ndof_shm_publish(dev, "/ndofdev_unittests.other") == 0); /* no-op */
+    assert(ndof_shm_publish(other, TEST_SHM_NAME) == -1);
+    
+    /* reader: starts at the publisher's state */
+    assert(ndof_context_libinit(reader, NULL, NULL, TEST_SHM_NAME) == 0);
+    rdev = ndof_context_create_device(reader);
+    assert(ndof_init_first(rdev, NULL) == 0);
+    assert(strcmp(rdev->product, dev->product) == 0);
+    assert(rdev->axes_count == dev->axes_count);
+    assert(rdev->axes_min == dev->axes_min && rdev->axes_max == dev->axes_max);
+    assert(rdev->valid);
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        assert(rdev->axes[i] == dev->axes[i]);
+    ndof_update(rdev);
+    assert(ndof_read_state(rdev, &state) == 0 && state.seq == 0);
+    
+    /* then replays every sample, with its time */
+    assert(ndof_enable_ring(dev, 16) == 0);
+    assert(ndof_enable_ring(rdev, 16) == 0);
+    for (i = 0; i < 5; i++)
+        ndof_update(dev);
+    ndof_update(rdev);
+    assert(ndof_get_history(dev, 0, pubs, 8) == 5);
+    assert(ndof_get_history(rdev, 0, reads, 8) == 5);
+    for (i = 0; i < 5; i++)
+    {
+        assert(reads[i].time_ns == pubs[i].time_ns);
+        assert(reads[i].buttons == pubs[i].buttons);
+        assert(memcmp(reads[i].axes, pubs[i].axes, sizeof(reads[i].axes)) == 0);
+    }
+    
+    /* a reader left behind gets the most recent samples */
+    for (i = 0; i < NDOF_SHM_CAPACITY + 100; i++)
+        ndof_update(dev);
+    ndof_update(rdev);
+    ndof_read_state(dev, &state);
+    assert(ndof_read_state(rdev, &rstate) == 0);
+    for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+        assert(rdev->axes[i] == state.axes[i]);
+    assert(rstate.time_ns == state.time_ns);
+    
+    ndof_stream_set_valid(dev, 0);
+    ndof_update(rdev);
+    assert(!rdev->valid);
+    ndof_stream_set_valid(dev, 1);
+    ndof_update(rdev);
+    assert(rdev->valid);
+    
+    /* reading while the publisher streams: in order, none made up */
+    sub = ndof_subscribe(rdev);
+    assert(sub);
+    assert(ndof_thread_create(&producer, test_shm_producer, dev) == 0);
+    while (last < TEST_SHM_TOTAL)
+    {
+        ndof_update(rdev);
+        while ((n = ndof_subscriber_read(sub, reads, 64, &dropped)) > 0)
+        {
+            for (k = 0; k < n; k++)
+            {
+                assert(reads[k].axes[0] > last);
+                last = reads[k].axes[0];
+            }
+        }
+    }
+    ndof_thread_join(producer);
+    ndof_unsubscribe(sub);
+    
+    /* gone with the device: readers see it invalid, no one can attach */
+    ndof_context_destroy(pub);
+    ndof_update(rdev);
+    assert(!rdev->valid);
+    assert(ndof_context_set_backend(late, "shm") == 0);
+    assert(ndof_context_libinit(late, NULL, NULL, TEST_SHM_NAME) == -1);
+    ndof_context_destroy(late);
+    ndof_context_destroy(reader);
+    
+    fprintf(stderr, "  done\n");
+}
+#endif
+
+#ifdef __linux__
+/* -------------------------------------------------------------------------- */
+#define TEST_SYSFS_ROOT "ndofdev_unittests.sysfs"
+
+static char s_sysfs_made[64][160];   /* files and directories created */
+static int  s_sysfs_made_count = 0;
+
+static void test_sysfs_made(const char *path)
+{
+    assert(s_sysfs_made_count < 64);
+    snprintf(s_sysfs_made[s_sysfs_made_count++], sizeof(s_sysfs_made[0]), 
+             "%s", path);
+}
+
+/* Creates a file of the fake tree, and its missing directories. */
+static void test_sysfs_file(const char *path, const void *data, size_t len)
+{
+    char full[512], *p;
+    FILE *f;
+    
+    snprintf(full, sizeof(full), "%s/%s", TEST_SYSFS_ROOT, path);
+    for (p = strchr(full, '/'); p; p = strchr(p + 1, '/'))
+    {
+        *p = '\0';
+        if (mkdir(full, 0755) == 0)
+            test_sysfs_made(full);
+        *p = '/';
+    }
+    f = fopen(full, "wb");
+    assert(f);
+    test_sysfs_made(full);
+    fwrite(data, 1, len, f);
+    fclose(f);
+}
+
+static void test_sysfs_text(const char *path, const char *text)
+{
+    test_sysfs_file(path, text, strlen(text));
+}
+
+/* Writes a capability bitmap as the kernel does: words of a long, the most 
+   significant first. `bits' ends with -1. */
+static void test_sysfs_bitmap(const char *path, const int *bits)
+{
+    const int word_bits = 8 * sizeof(unsigned long);
+    unsigned long words[16] = { 0 };
+    char text[512] = "", *p = text;
+    int i, top = 0;
+    
+    for (i = 0; bits[i] >= 0; i++)
+    {
+        words[bits[i] / word_bits] |= 1ul << (bits[i] % word_bits);
+        if (bits[i] / word_bits > top)
+            top = bits[i] / word_bits;
+    }
+    for (i = top; i >= 0; i--)
+        p += sprintf(p, (i == top ? "%lx" : " %lx"), words[i]);
+    strcat(text, "\n");
+    test_sysfs_text(path, text);
+}
+
+/* Sysfs entries of a SpaceNavigator: hidraw10 and event2. */
+static void test_sysfs_spacenavigator()
+{
+    static const int six_axes[] = { 0, 1, 2, 3, 4, 5, -1 };
+    static const int two_buttons[] = { 0x100, 0x101, -1 };
+    
+    test_sysfs_text("sys/class/hidraw/hidraw10/device/uevent", 
+                    "DRIVER=hid-generic\nHID_ID=0003:0000046D:0000C626\n"
+                    "HID_NAME=3Dconnexion SpaceNavigator\n"
+                    "HID_PHYS=usb-0000:00:14.0-2/input0\nHID_UNIQ=\n");
+    test_sysfs_file("sys/class/hidraw/hidraw10/device/report_descriptor",
+                    kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc));
+    
+    test_sysfs_text("sys/class/input/event2/device/id/vendor", "046d\n");
+    test_sysfs_text("sys/class/input/event2/device/id/product", "c626\n");
+    test_sysfs_text("sys/class/input/event2/device/id/version", "0111\n");
+    test_sysfs_text("sys/class/input/event2/device/name", 
+                    "3Dconnexion SpaceNavigator\n");
+    test_sysfs_text("sys/class/input/event2/device/phys", 
+                    "usb-0000:00:14.0-2/input0\n");
+    test_sysfs_bitmap("sys/class/input/event2/device/capabilities/rel", 
+                      six_axes);
+    test_sysfs_bitmap("sys/class/input/event2/device/capabilities/key", 
+                      two_buttons);
+    test_sysfs_file("sys/class/input/event2/device/device/report_descriptor",
+                    kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc));
+    /* two levels above the HID device, where the USB device is in sysfs */
+    test_sysfs_text("sys/class/input/event2/manufacturer", "3Dconnexion\n");
+}
+
+/* Writes a frame to an event node some time after ndof_wait is called. */
+typedef struct test_sysfs_writer {
+    int fd;
+    uint64_t written_ns;
+} test_sysfs_writer;
+
+static void test_sysfs_write_frame(void *arg)
+{
+    test_sysfs_writer *w = (test_sysfs_writer *) arg;
+    struct input_event ev[2];
+    
+    memset(ev, 0, sizeof(ev));
+    ev[0].type = EV_REL;
+    ev[0].code = REL_Y;
+    ev[0].value = 40;
+    ev[1].type = EV_SYN;
+    ev[1].code = SYN_REPORT;
+    ndof_sleep_ns(20000000);
+    ndof_atomic_store64(&w->written_ns, ndof_time_ns());
+    assert(write(w->fd, ev, sizeof(ev)) == (ssize_t) sizeof(ev));
+}
+
+void test_ndof_sysfs()
+{
+    static const unsigned char keyboard_desc[] = { 
+        0x05, 0x01, 0x09, 0x06, 0xa1, 0x01, 0xc0 };
+    static const unsigned char multi_axis_desc[] = { 
+        0x05, 0x01, 0x09, 0x08, 0xa1, 0x01, 0xc0 };
+    static const int six_axes[] = { 0, 1, 2, 3, 4, 5, -1 };
+    static const int two_buttons[] = { 0x100, 0x101, -1 };
+    static const int gamepad_buttons[] = { 0x130, 0x131, -1 };
+    static const int mouse_axes[] = { 0, 1, 8, -1 };
+    NDOF_SysfsNode *nodes;
+    NDOF_Context *ctx;
+    NDOF_Device *dev;
+    NDOF_CapCache cache;
+    NDOF_CapRecord rec;
+    NDOF_Sample samples[16];
+    struct input_event ev[8];
+    test_sysfs_writer writer;
+    ndof_thread_t thread;
+    char path[256];
+    uint64_t t0, woken;
+    int count, i;
+    
+    fprintf(stderr, "____ test_ndof_sysfs __________________________________\n");
+    
+    assert(ndof_sysfs_scan(TEST_SYSFS_ROOT, &nodes) == -1);
+    free(nodes);
+    
+    /* a keyboard, skipped */
+    test_sysfs_text("sys/class/hidraw/hidraw0/device/uevent", 
+                    "HID_ID=0003:0000046D:0000C31C\nHID_NAME=Keyboard\n");
+    test_sysfs_file("sys/class/hidraw/hidraw0/device/report_descriptor",
+                    keyboard_desc, sizeof(keyboard_desc));
+    /* known model, with its event node */
+    test_sysfs_spacenavigator();
+    /* unknown model, by its application collection */
+    test_sysfs_text("sys/class/hidraw/hidraw3/device/uevent", 
+                    "HID_ID=0005:00001234:00005678\nHID_NAME=Other\n"
+                    "HID_PHYS=bt\nHID_UNIQ=00:11:22:33:44:55\n");
+    test_sysfs_file("sys/class/hidraw/hidraw3/device/report_descriptor",
+                    multi_axis_desc, sizeof(multi_axis_desc));
+    
+    /* a gamepad with six axes, skipped */
+    test_sysfs_text("sys/class/input/event4/device/id/vendor", "045e\n");
+    test_sysfs_text("sys/class/input/event4/device/id/product", "028e\n");
+    test_sysfs_bitmap("sys/class/input/event4/device/capabilities/abs", 
+                      six_axes);
+    test_sysfs_bitmap("sys/class/input/event4/device/capabilities/key", 
+                      gamepad_buttons);
+    /* a mouse, skipped */
+    test_sysfs_text("sys/class/input/event5/device/id/vendor", "046d\n");
+    test_sysfs_text("sys/class/input/event5/device/id/product", "c077\n");
+    test_sysfs_bitmap("sys/class/input/event5/device/capabilities/rel", 
+                      mouse_axes);
+    /* unknown model, by its capabilities; not a HID device */
+    test_sysfs_text("sys/class/input/event6/device/id/vendor", "4321\n");
+    test_sysfs_text("sys/class/input/event6/device/id/product", "0001\n");
+    test_sysfs_text("sys/class/input/event6/device/name", "Spaceball\n");
+    test_sysfs_bitmap("sys/class/input/event6/device/capabilities/abs", 
+                      six_axes);
+    test_sysfs_bitmap("sys/class/input/event6/device/capabilities/key", 
+                      two_buttons);
+    test_sysfs_text("sys/class/input/event6-not-a-node/device/name", "x\n");
+    
+    /* no /dev in the fake tree: nothing is opened */
+    count = ndof_sysfs_scan(TEST_SYSFS_ROOT, &nodes);
+    assert(count == 4);
+    
+    assert(nodes[0].kind == NDOF_NODE_HIDRAW);
+    assert(strcmp(nodes[0].path, TEST_SYSFS_ROOT "/dev/hidraw3") == 0);
+    assert(nodes[0].vendor_id == 0x1234 && nodes[0].product_id == 0x5678);
+    assert(NDOF_KEY_SERIAL(nodes[0].key) != 0);
+    assert(strcmp(nodes[0].manufacturer, "") == 0);
+    
+    /* no USB device above: named after the quirks database */
+    assert(strcmp(nodes[1].path, TEST_SYSFS_ROOT "/dev/hidraw10") == 0);
+    assert(strcmp(nodes[1].manufacturer, "3Dconnexion") == 0);
+    assert(strcmp(nodes[1].product, "3Dconnexion SpaceNavigator") == 0);
+    assert(nodes[1].desc_len == sizeof(kTestSpaceNavigatorDesc));
+    assert(NDOF_KEY_SERIAL(nodes[1].key) == 0);
+    
+    assert(nodes[2].kind == NDOF_NODE_EVDEV);
+    assert(strcmp(nodes[2].path, TEST_SYSFS_ROOT "/dev/input/event2") == 0);
+    assert(nodes[2].version == 0x0111);
+    assert(nodes[2].btn_count == 2);
+    assert(strcmp(nodes[2].manufacturer, "3Dconnexion") == 0);
+    assert(nodes[2].desc_len == sizeof(kTestSpaceNavigatorDesc));
+    assert(ndof_key_equal(&nodes[2].key, &nodes[1].key));
+    
+    assert(strcmp(nodes[3].path, TEST_SYSFS_ROOT "/dev/input/event6") == 0);
+    assert(strcmp(nodes[3].product, "Spaceball") == 0);
+    assert(strcmp(nodes[3].manufacturer, "") == 0);
+    assert(nodes[3].desc_len == 0 && nodes[3].btn_count == 2);
+    assert(!ndof_key_equal(&nodes[3].key, &nodes[1].key));
+    free(nodes);
+    
+    /* an instance reads the tree it was initialized with, enumerating as
+       much as when hot-plugging */
+    test_sysfs_text("dev/hidraw10", "");
+    ctx = ndof_context_create();
+    assert(ndof_context_set_backend(ctx, "linux") == 0);
+    assert(ndof_context_libinit(ctx, NULL, NULL, TEST_SYSFS_ROOT) == 0);
+    assert(ctx->ops->devcount(ctx) == 3);
+    /* known since the last scan: its descriptor is not parsed again */
+    test_sysfs_file("sys/class/hidraw/hidraw10/device/report_descriptor",
+                    multi_axis_desc, sizeof(multi_axis_desc));
+    dev = ndof_context_create_device(ctx);
+    snprintf(dev->manufacturer, sizeof(dev->manufacturer), "3D");
+    snprintf(dev->product, sizeof(dev->product), "3Dconnexion");
+    assert(ndof_init_first(dev, NULL) == 0);
+    assert(strcmp(dev->manufacturer, "3Dconnexion") == 0);
+    assert(strcmp(dev->product, "3Dconnexion SpaceNavigator") == 0);
+    assert(dev->axes_count == 6 && dev->valid);
+    ndof_context_destroy(ctx);
+    test_sysfs_file("sys/class/hidraw/hidraw10/device/report_descriptor",
+                    kTestSpaceNavigatorDesc, sizeof(kTestSpaceNavigatorDesc));
+    
+    /* layouts parsed once, then found in the capability cache */
+    remove(TEST_CAPCACHE_PATH);
+    setenv("NDOF_CAPCACHE", TEST_CAPCACHE_PATH, 1);
+    for (i = 0; i < 2; i++)
+    {
+        ctx = ndof_context_create();
+        assert(ndof_context_set_backend(ctx, "hidraw") == 0);
+        assert(ndof_context_libinit(ctx, NULL, NULL, TEST_SYSFS_ROOT) == 0);
+        dev = ndof_context_create_device(ctx);
+        snprintf(dev->product, sizeof(dev->product), "3Dconnexion");
+        assert(ndof_init_first(dev, NULL) == 0);
+        assert(dev->axes_count == 6);
+        assert(dev->btn_count == (i == 0 ? 2 : 1));
+        ndof_context_destroy(ctx);
+        
+        /* a record told apart from the parsed layout */
+        assert(ndof_capcache_open(&cache, TEST_CAPCACHE_PATH) == 0);
+        assert(cache.count == 1);
+        rec = cache.records[0];
+        assert(rec.model == NDOF_QUIRKS_KEY(0x046d, 0xc626));
+        assert(rec.desc_hash == ndof_descriptor_hash(kTestSpaceNavigatorDesc,
+                                            sizeof(kTestSpaceNavigatorDesc)));
+        rec.layout.plan.btn_count = 1;
+        assert(ndof_capcache_store(&cache, TEST_CAPCACHE_PATH, &rec, 1) == 0);
+        ndof_capcache_close(&cache);
+    }
+    unsetenv("NDOF_CAPCACHE");
+    remove(TEST_CAPCACHE_PATH);
+    
+    /* three frames at once: three samples, published by the I/O thread as
+       they arrive, not one per ndof_update */
+    memset(ev, 0, sizeof(ev));
+    for (i = 0, count = 0; i < 3; i++)
+    {
+        if (i == 2)
+        {
+            ev[count].type = EV_KEY;
+            ev[count].code = BTN_0;
+            ev[count++].value = 1;
+        }
+        ev[count].type = EV_REL;
+        ev[count].code = REL_X;
+        ev[count++].value = 10 * (i + 1);
+        ev[count].type = EV_SYN;
+        ev[count++].code = SYN_REPORT;
+    }
+    snprintf(path, sizeof(path), "%s/dev/input", TEST_SYSFS_ROOT);
+    assert(mkdir(path, 0755) == 0);
+    test_sysfs_made(path);
+    snprintf(path, sizeof(path), "%s/dev/input/event2", TEST_SYSFS_ROOT);
+    assert(mkfifo(path, 0644) == 0);
+    test_sysfs_made(path);
+    ctx = ndof_context_create();
+    assert(ndof_context_set_backend(ctx, "evdev") == 0);
+    assert(ndof_context_libinit(ctx, NULL, NULL, TEST_SYSFS_ROOT) == 0);
+    dev = ndof_context_create_device(ctx);
+    assert(ndof_init_first(dev, NULL) == 0);
+    assert(ndof_enable_ring(dev, 16) == 0);
+    
+    writer.fd = open(path, O_WRONLY);
+    assert(writer.fd >= 0);
+    t0 = ndof_time_ns();
+    assert(write(writer.fd, ev, count * sizeof(ev[0])) 
+           == (ssize_t) (count * sizeof(ev[0])));
+    for (i = 0; i < 1000 && ndof_get_history(dev, 0, samples, 16) < 3; i++)
+        ndof_wait(dev, ndof_time_ns() + 1000000);
+    assert(ndof_get_history(dev, 0, samples, 16) == 3);
+    assert(samples[0].time_ns >= t0);
+    for (i = 1; i < 3; i++)
+    {
+        assert(samples[i].axes[0] > samples[i - 1].axes[0]);
+        assert(samples[i].time_ns >= samples[i - 1].time_ns);
+    }
+    assert(samples[1].buttons == 0 && samples[2].buttons == 1);
+    
+    /* the state published last */
+    ndof_update(dev);
+    assert(dev->axes[0] == samples[2].axes[0] && dev->buttons[0] == 1);
+    
+    /* waiters are woken by the I/O thread, with no ndof_update */
+    writer.written_ns = 0;
+    assert(ndof_thread_create(&thread, test_sysfs_write_frame, &writer) == 0);
+    assert(ndof_wait(dev, ndof_time_ns() + 2000000000ULL) == 0);
+    woken = ndof_time_ns();
+    ndof_thread_join(thread);
+    assert(ndof_get_history(dev, 0, samples, 16) == 4);
+    assert(samples[3].axes[1] > 0 && samples[3].time_ns <= woken);
+    fprintf(stderr, "  wake up latency: %.1f us\n", 
+            (woken - ndof_atomic_load64(&writer.written_ns)) / 1000.0);
+    close(writer.fd);
+    ndof_context_destroy(ctx);
+    
+    while (s_sysfs_made_count > 0)
+        remove(s_sysfs_made[--s_sysfs_made_count]);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+static void *volatile    s_hotplug_dev = NULL;
+static volatile uint32_t s_hotplug_adds = 0;
+static volatile uint32_t s_hotplug_removals = 0;
+static volatile uint32_t s_hotplug_stop = 0;
+
+/* Devices are looked at in the callbacks, on the I/O thread */
+static NDOF_HotPlugResult test_hotplug_add(NDOF_Device *dev)
+{
+    assert(ndof_stream_is_valid(dev));
+    assert(strcmp(dev->product, "3Dconnexion SpaceNavigator") == 0);
+    assert(dev->axes_count == 6);
+    ndof_atomic_storeptr(&s_hotplug_dev, dev);
+    ndof_atomic_add32(&s_hotplug_adds, 1);
+    return NDOF_KEEP_HOTPLUGGED;
+}
+
+static void test_hotplug_removal(NDOF_Device *dev)
+{
+    assert(dev == ndof_atomic_loadptr(&s_hotplug_dev));
+    ndof_atomic_add32(&s_hotplug_removals, 1);
+}
+
+/* Waits up to a second for a count of notifications. */
+static uint32_t test_hotplug_wait(volatile uint32_t *count, uint32_t n)
+{
+    int i;
+    
+    for (i = 0; i < 1000 && ndof_atomic_load32(count) < n; i++)
+        ndof_sleep_ns(1000000);
+    return ndof_atomic_load32(count);
+}
+
+/* Reads the device all along, as the I/O thread replaces its node. */
+static void test_hotplug_updater(void *arg)
+{
+    while (!ndof_atomic_load32(&s_hotplug_stop))
+        ndof_update((NDOF_Device *) arg);
+}
+
+void test_ndof_hotplug()
+{
+    NDOF_Device *dev;
+    ndof_thread_t updater;
+    char path[256];
+    
+    fprintf(stderr, "____ test_ndof_hotplug ________________________________\n");
+    
+    /* restarted on a fake tree, nothing plugged, whatever NDOF_BACKEND is */
+    ndof_libcleanup();
+    assert(ndof_context_set_backend(ndof_default_context(), "linux") == 0);
+    test_sysfs_spacenavigator();
+    snprintf(path, sizeof(path), "%s/dev", TEST_SYSFS_ROOT);
+    assert(mkdir(path, 0755) == 0);
+    test_sysfs_made(path);
+    snprintf(path, sizeof(path), "%s/dev/input", TEST_SYSFS_ROOT);
+    assert(mkdir(path, 0755) == 0);
+    test_sysfs_made(path);
+    assert(ndof_libinit_async(test_hotplug_add, test_hotplug_removal, 
+                              TEST_SYSFS_ROOT, NULL, NULL) == 0);
+    assert(ndof_wait_ready(1000000000ULL) == NDOF_INIT_READY);
+    assert(ndof_atomic_load32(&s_hotplug_adds) == 0);
+    
+    /* gone before the burst is over: never reported */
+    test_sysfs_text("dev/hidraw10", "");
+    snprintf(path, sizeof(path), "%s/dev/hidraw10", TEST_SYSFS_ROOT);
+    remove(path);
+    s_sysfs_made_count--;
+    ndof_sleep_ns(3 * NDOF_HOTPLUG_WINDOW_DEFAULT);
+    assert(ndof_atomic_load32(&s_hotplug_adds) == 0);
+    assert(ndof_atomic_load32(&s_hotplug_removals) == 0);
+    
+    /* Use Case #4 */
+    test_sysfs_text("dev/hidraw10", "");
+    assert(test_hotplug_wait(&s_hotplug_adds, 1) == 1);
+    dev = (NDOF_Device *) ndof_atomic_loadptr(&s_hotplug_dev);
+    assert(ndof_stream_is_valid(dev));
+    assert(ndof_thread_create(&updater, test_hotplug_updater, dev) == 0);
+    
+    /* its other node */
+    test_sysfs_text("dev/input/event2", "");
+    ndof_sleep_ns(3 * NDOF_HOTPLUG_WINDOW_DEFAULT);
+    assert(ndof_atomic_load32(&s_hotplug_adds) == 1);
+    
+    /* Use Case #1 */
+    snprintf(path, sizeof(path), "%s/dev/hidraw10", TEST_SYSFS_ROOT);
+    remove(path);
+    assert(test_hotplug_wait(&s_hotplug_removals, 1) == 1);
+    assert(!ndof_stream_is_valid(dev));
+    
+    /* Use Case #2: plugged again, through the node left, with the plan it
+       had: its report descriptor is not read again */
+    snprintf(path, sizeof(path), "%s/dev/input/event2", TEST_SYSFS_ROOT);
+    remove(path);
+    snprintf(path, sizeof(path), 
+             "%s/sys/class/input/event2/device/device/report_descriptor", 
+             TEST_SYSFS_ROOT);
+    remove(path);
+    test_sysfs_text("dev/input/event2", "");
+    assert(test_hotplug_wait(&s_hotplug_adds, 2) == 2);
+    assert(ndof_atomic_loadptr(&s_hotplug_dev) == dev);
+    assert(ndof_stream_is_valid(dev));
+    assert(((NDOF_DevicePrivate *) dev->private_data)->link->plan.field_count 
+           > 0);
+    assert(ndof_atomic_load32(&s_hotplug_removals) == 1);
+    ndof_atomic_store32(&s_hotplug_stop, 1);
+    ndof_thread_join(updater);
+    
+    ndof_libcleanup();
+    while (s_sysfs_made_count > 0)
+        remove(s_sysfs_made[--s_sysfs_made_count]);
+    assert(ndof_context_set_backend(ndof_default_context(), 
+                                    getenv("NDOF_BACKEND")) == 0);
+    assert(ndof_libinit(NULL, NULL, NULL) == 0);
+    
+    fprintf(stderr, "  done\n");
+}
+#endif
+
+/* -------------------------------------------------------------------------- 
+    Time to enumerate 16 devices that each take 2 ms to open and 
+    interrogate, one after the other or in parallel. */
+void bench_probe()
+{
+    char items[16];
+    void *in[16], *out[16];
+    test_probe_ctx ctx;
+    int i, k;
+    
+    fprintf(stderr, "____ bench_probe ______________________________________\n");
+    
+    for (i = 0; i < 16; i++)
+        in[i] = &items[i];
+    
+    for (k = 0; k < 2; k++)
+    {
+        uint64_t t0;
+        
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.delay_ns = 2000000;
+        t0 = ndof_time_ns();
+        ndof_probe_all(test_probe_item, &ctx, in, out, 16, (k == 0 ? 1 : 0));
+        fprintf(stderr, "  %-20s %6.1f ms for 16 devices\n", 
+                (k == 0 ? "serial" : "parallel"),
+                (double)(ndof_time_ns() - t0) / 1000000);
+    }
+}
+
+/* -------------------------------------------------------------------------- 
+    A flaky hub: 16 devices come and go for a second, each plug creating
+    two nodes whose permissions udev then changes, until half of them are
+    left plugged. Notifications are fed every 20 us of simulated time, as
+    fast as inotify delivers them. */
+void bench_hotplug_storm()
+{
+    const uint64_t windows[2] = { 0, NDOF_HOTPLUG_WINDOW_DEFAULT };
+    const uint64_t step_ns = 20000, storm_ns = 1000000000ULL;
+    int k;
+    
+    fprintf(stderr, "____ bench_hotplug_storm ______________________________\n");
+    
+    for (k = 0; k < 2; k++)
+    {
+        test_coalesce_ctx ctx;
+        NDOF_Coalescer c;
+        uint64_t now = 0, seed = 12345, pushed = 0;
+        int truth[16];
+        clock_t t0;
+        int i;
+        
+        memset(&ctx, 0, sizeof(ctx));
+        memset(truth, 0, sizeof(truth));
+        ndof_coalescer_init(&c, windows[k], test_coalesce_apply, 
+                            test_coalesce_release, &ctx);
+        t0 = clock();
+        
+        while (now < storm_ns)
+        {
+            int dev;
+            
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            dev = (int) (seed >> 60);
+            truth[dev] = !truth[dev];
+            for (i = 0; i < (truth[dev] ? 4 : 2); i++)
+            {
+                test_coalesce_push(&c, (truth[dev] ? NDOF_HOTPLUG_ADD 
+                                                   : NDOF_HOTPLUG_REMOVE), 
+                                   (uint64_t) dev, now);
+                pushed++;
+                now += step_ns;
+                ndof_coalescer_flush(&c, now);
+            }
+        }
+        for (i = 0; i < 16; i++)
+        {
+            if (truth[i] != (i & 1))
+            {
+                test_coalesce_push(&c, (i & 1 ? NDOF_HOTPLUG_ADD 
+                                              : NDOF_HOTPLUG_REMOVE), 
+                                   (uint64_t) i, now);
+                pushed++;
+                truth[i] = (i & 1);
+            }
+        }
+        ndof_coalescer_flush(&c, now + NDOF_HOTPLUG_MAX_WINDOWS * windows[k]);
+        
+        /* the client ends up seeing the devices left plugged */
+        for (i = 0; i < 16; i++)
+            assert(ctx.plugged[i] == truth[i]);
+        fprintf(stderr, "  window %3d ms: %6d callbacks in %4d bursts, "
+                "%6.2f ms CPU, %d leaked\n", (int) (windows[k] / 1000000),
+                ctx.count, ctx.calls, 
+                (double) (clock() - t0) * 1000 / CLOCKS_PER_SEC,
+                (int) (pushed - ctx.released));
+        assert(c.received == pushed && c.applied == (uint64_t) ctx.count);
+        ndof_coalescer_dispose(&c);
+        assert(ctx.released == (int) pushed);
+    }
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct test_wait_ctx {
+    NDOF_Device *dev;
+    uint64_t published_ns;
+} test_wait_ctx;
+
+static void test_wait_publisher(void *arg)
+{
+    test_wait_ctx *ctx = (test_wait_ctx *) arg;
+    
+    ndof_sleep_ns(20000000);
+    ndof_atomic_store64(&ctx->published_ns, ndof_time_ns());
+    ndof_stream_publish(ctx->dev);
+}
+
+/* -------------------------------------------------------------------------- */
+void test_ndof_wait()
+{
+    test_wait_ctx ctx;
+    ndof_thread_t publisher;
+    uint64_t t0, woken;
+    
+    fprintf(stderr, "____ test_ndof_wait ___________________________________\n");
+    
+    ctx.dev = ndof_create();
+    ctx.published_ns = 0;
+    
+    /* nothing published: the deadline is honored */
+    t0 = ndof_time_ns();
+    assert(ndof_wait(ctx.dev, t0) == 1);
+    assert(ndof_wait(ctx.dev, t0 + 5000000) == 1);
+    assert(ndof_time_ns() >= t0 + 5000000);
+    
+    /* woken by the publisher well before the deadline */
+    ndof_thread_create(&publisher, test_wait_publisher, &ctx);
+    assert(ndof_wait(ctx.dev, ndof_time_ns() + 2000000000ULL) == 0);
+    woken = ndof_time_ns();
+    ndof_thread_join(publisher);
+    fprintf(stderr, "  wake up latency: %.1f us\n", 
+            (woken - ndof_atomic_load64(&ctx.published_ns)) / 1000.0);
+    
+    /* a sample published before the call does not count */
+    t0 = ndof_time_ns();
+    assert(ndof_wait(ctx.dev, t0 + 1000000) == 1);
+    ndof_destroy(ctx.dev);
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- */
+typedef struct bench_state_ctx {
+    NDOF_Device *dev;
+    volatile uint32_t stop;
+    uint64_t reads;
+} bench_state_ctx;
+
+static void bench_state_writer(void *arg)
+{
+    bench_state_ctx *ctx = (bench_state_ctx *) arg;
+    long n = 0;
+    int i;
+    
+    while (!ndof_atomic_load32(&ctx->stop))
+    {
+        n++;
+        for (i = 0; i < NDOF_MAX_AXES_COUNT; i++)
+            ctx->dev->axes[i] = n;
+        ndof_stream_publish(ctx->dev);
+        ndof_sleep_ns(1000000); /* 1 kHz */
+    }
+}
+
+static void bench_state_reader(void *arg)
+{
+    bench_state_ctx *ctx = (bench_state_ctx *) arg;
+    NDOF_State state;
+    uint64_t reads = 0;
+    int i;
+    
+    while (!ndof_atomic_load32(&ctx->stop))
+    {
+        ndof_read_state(ctx->dev, &state);
+        for (i = 1; i < NDOF_MAX_AXES_COUNT; i++)
+            assert(state.axes[i] == state.axes[0]); /* no torn reads */
+        reads++;
+    }
+    
+    ndof_atomic_add64(&ctx->reads, reads);
+}
+
+/* -------------------------------------------------------------------------- 
+    Contention benchmark: 1 to 16 threads taking snapshots of a device 
+    updated at 1 kHz. Total reads/s should grow with the number of readers
+    up to the number of cores, since readers never write shared memory.      */
+void bench_read_state_contention()
+{
+    int nreaders, i;
+    ndof_thread_t writer, readers[16];
+    
+    fprintf(stderr, "____ bench_read_state_contention _____________________\n");
+    
+    for (nreaders = 1; nreaders <= 16; nreaders *= 2)
+    {
+        bench_state_ctx ctx;
+        uint64_t t0, t1;
+        
+        ctx.dev = ndof_create();
+        ctx.stop = 0;
+        ctx.reads = 0;
+        
+        t0 = ndof_time_ns();
+        ndof_thread_create(&writer, bench_state_writer, &ctx);
+        for (i = 0; i < nreaders; i++)
+            ndof_thread_create(&readers[i], bench_state_reader, &ctx);
+        
+        ndof_sleep_ns(250000000);
+        ndof_atomic_store32(&ctx.stop, 1);
+        
+        ndof_thread_join(writer);
+        for (i = 0; i < nreaders; i++)
+            ndof_thread_join(readers[i]);
+        t1 = ndof_time_ns();
+        
+        fprintf(stderr, "  %2d readers: %12.0f reads/s total, "
+                "%12.0f reads/s per reader\n", nreaders, 
+                ctx.reads * 1e9 / (t1 - t0), 
+                ctx.reads * 1e9 / (t1 - t0) / nreaders);
+        ndof_destroy(ctx.dev);
+    }
+    
+    fprintf(stderr, "  done\n");
+}
+
+/* -------------------------------------------------------------------------- 
+    Needs a device plugged in, or NDOF_BACKEND=synthetic in the environment
+    to run without one, as on a build server. */
+#ifdef __cplusplus
+extern "C" 
+#endif
+void run_noninteractive_tests()
+{
+    test_ndof_libinit();
+	test_device_list_add();
+
+    #if TARGET_OS_MAC
+	test_ndof_devcount();
+    #endif
+
+    test_ndof_create();
+    test_ndof_bind_state();
+    test_ndof_read_state();
+    test_ndof_subscribe();
+    test_ndof_get_history();
+    test_ndof_resampler();
+    test_ndof_predict();
+    test_ndof_pose();
+    test_ndof_set_transform();
+    test_ndof_quirks();
+    test_ndof_identity();
+    test_ndof_registry();
+    test_ndof_reconnect();
+    test_ndof_capcache();
+    test_ndof_probe();
+    test_ndof_hotplug_coalesce();
+    test_ndof_mpsc();
+    test_ndof_dispatch();
+    test_ndof_epoch();
+    test_ndof_devlist_stress();
+    test_ndof_context();
+    test_ndof_backend();
+    #if NDOF_HAVE_SHM
+    test_ndof_shm();
+    #endif
+    #ifdef __linux__
+    test_ndof_sysfs();
+    test_ndof_hotplug();
+    #endif
+    test_ndof_decode();
+    test_ndof_wait();
+    bench_read_state_contention();
+    bench_decode();
+    bench_registry();
+    bench_reconnect();
+    bench_capcache();
+    bench_probe();
+    bench_hotplug_storm();
     test_ndof_init_first();
     
     ndof_libcleanup();
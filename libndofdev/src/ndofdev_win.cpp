@@ -33,11 +33,38 @@
 #include <tchar.h>
 #include <assert.h>
 #include "ndofdev_external.h"
+#include "ndofdev_internal.h"
 #include "ndofdev_internal_win.h"
+#include "ndofdev_stream.h"
 
-static LPDIRECTINPUT8 gDI = NULL;   // DI interface
 static HWND gDIWnd = NULL;          // window associated with DI
 
+// The backend of a context, its `backend'
+typedef struct NDOF_WinBackend {
+    LPDIRECTINPUT8 di;              // DI interface
+    ndof_thread_t init_thread;      // ndof_libinit_async's DI creation
+    int init_thread_on;
+} NDOF_WinBackend;
+
+/* -------------------------------------------------------------------------- */
+static LPDIRECTINPUT8 ndof_di(NDOF_Device *dev)
+{
+    NDOF_WinBackend *be = (NDOF_WinBackend *)dev->context->backend;
+    return (be ? be->di : NULL);
+}
+
+static int ndof_win_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *param, int async);
+static void ndof_win_stop(NDOF_Context *ctx);
+static void ndof_win_cleanup(NDOF_Context *ctx);
+static int ndof_win_init_first(NDOF_Device *dev, void *diHandle);
+static void ndof_win_update(NDOF_Device *in_dev);
+static void ndof_win_dispose(void *priv);
+static unsigned char ndof_win_match(void *priv1, void *priv2);
+static void ndof_win_dump(FILE *stream, NDOF_Device *dev);
+
 #ifdef NDOF_DEBUG
 void ndof_print_deviceinstance_info(const DIDEVICEINSTANCE *dev_info);
 #endif
@@ -56,12 +83,19 @@ BOOL CALLBACK EnumNDOFDeviceCallback(const DIDEVICEINSTANCE *inst, VOID *inCtx)
 	priv->subtype = GET_DIDEVICE_SUBTYPE(inst->dwDevType);
 
 	// obtain an interface to the enumerated ndof device
-    hr = gDI->CreateDevice(inst->guidInstance, &priv->dev, NULL);
+    hr = ndof_di(dev)->CreateDevice(inst->guidInstance, &priv->dev, NULL);
 
 	//priv->dev->GetDeviceInfo(const_cast<DIDEVICEINSTANCE*>(inst));
 	//ndof_print_deviceinstance_info(inst);
 	
     strncpy(dev->product, inst->tszProductName, sizeof(dev->product));
+    // DirectInput has no port: the instance GUID, stable for a given 
+    // device on a given machine, stands in for it
+    NDOF_DeviceKey key = ndof_device_key(LOWORD(inst->guidProduct.Data1), 
+        HIWORD(inst->guidProduct.Data1), inst->wUsagePage, inst->wUsage, 
+        (long)(inst->guidInstance.Data1 ^ ((DWORD)inst->guidInstance.Data2 << 16)
+               ^ inst->guidInstance.Data3), NULL);
+    ndof_stream_identify(dev, &key);
 
 	// if it failed we can't use this device, so continue to next one
 	if (FAILED(hr)) 
@@ -164,36 +198,77 @@ BOOL CALLBACK EnumNDOFObjectsCallback(const DIDEVICEOBJECTINSTANCE* inst,
 }
 
 /* -------------------------------------------------------------------------- */
-int ndof_libinit(NDOF_DeviceAddCallback in_add_cb, 
-                 NDOF_DeviceRemovalCallback in_removal_cb,
-                 void *param)
+static int ndof_create_di(NDOF_WinBackend *be)
 {
+    if (DirectInput8Create(GetModuleHandle(NULL), 
+                           DIRECTINPUT_VERSION,
+                           IID_IDirectInput8, 
+                           (VOID**)&be->di, 
+                           NULL) != DI_OK)
+    {
+        fprintf(stderr, "libndofdev: Error initializing DirectInput: " \
+                "Direct8InputCreate failed.\n");
+        return -1;
+    }
+    
+    return 0;
+}
+
+/* -------------------------------------------------------------------------- */
+static void ndof_libinit_thread(void *arg)
+{
+    NDOF_Context *ctx = (NDOF_Context *)arg;
+    
+    ndof_init_done(ctx, ndof_create_di((NDOF_WinBackend *)ctx->backend));
+}
+
+/* -------------------------------------------------------------------------- 
+    Devices are enumerated by ndof_init_first: initializing is creating the
+    DirectInput interface of the context, on a thread of its own when 
+    `async' is set. */
+static int ndof_win_libinit(NDOF_Context *ctx,
+                            NDOF_DeviceAddCallback in_add_cb, 
+                            NDOF_DeviceRemovalCallback in_removal_cb,
+                            void *param, int async)
+{
+    NDOF_WinBackend *be;
+    int err = 0;
+    
     fprintf(stderr, "libndofdev: initializing...\n");
 
+    // initialized again
+    ndof_win_cleanup(ctx);
+    be = (NDOF_WinBackend *)calloc(1, sizeof(NDOF_WinBackend));
+    if (be == NULL)
+        return -1;
+    ctx->backend = be;
+
     if (param && *((LPDIRECTINPUT8 *)param))
     {
-        gDI = *((LPDIRECTINPUT8 *)param);
+        be->di = *((LPDIRECTINPUT8 *)param);
     }
-    else if (DirectInput8Create(GetModuleHandle(NULL), 
-                                DIRECTINPUT_VERSION,
-                                IID_IDirectInput8, 
-                                (VOID**)&gDI, 
-                                NULL) != DI_OK)
+    else if (async)
     {
-        fprintf(stderr, "libndofdev: Error initializing DirectInput: " \
-                "Direct8InputCreate failed.\n");
-        return -1;
+        be->init_thread_on = (ndof_thread_create(&be->init_thread, 
+                                                 ndof_libinit_thread, ctx) == 0);
+        return (be->init_thread_on ? 0 : -1);
+    }
+    else
+    {
+        err = ndof_create_di(be);
     }
 
-    return 0;
+    ndof_init_done(ctx, err);
+    return err;
 }
 
 /* -------------------------------------------------------------------------- */
-int ndof_init_first(NDOF_Device *dev, void *diHandle)
+static int ndof_win_init_first(NDOF_Device *dev, void *diHandle)
 {
     int notfound = -1;
     HRESULT hr;
     LPDIRECTINPUTDEVICE8 diDev;
+    LPDIRECTINPUT8 di = ndof_di(dev);
 
     // if a DirectInput handle is being passed in, try to use it and exit if ok
     if (diHandle && *((LPDIRECTINPUTDEVICE8 *)diHandle))
@@ -214,10 +289,10 @@ int ndof_init_first(NDOF_Device *dev, void *diHandle)
     }
     
     // if the input DI handle didn't work, or if none was passed, create new one
-    while(notfound)
+    while(notfound && di)
 	{
 		// Look for a simple joystick we can use for this program.
-		if (FAILED(hr = gDI->EnumDevices(DI8DEVCLASS_GAMECTRL, 
+		if (FAILED(hr = di->EnumDevices(DI8DEVCLASS_GAMECTRL, 
 		                                 EnumNDOFDeviceCallback, dev, 
                                          DIEDFL_ATTACHEDONLY)))
 			break;
@@ -270,6 +345,7 @@ int ndof_init_first(NDOF_Device *dev, void *diHandle)
     
     if (notfound == 0)
 	{
+        ndof_stream_set_valid(dev, 1);
         fprintf(stderr, "libndofdev: using device: " \
                 "manufacturer=%s; product=%s; axes_count=%d; btn_count=%d; " \
                 "opaque=%p; valid=%d\n", dev->manufacturer, dev->product,
@@ -285,7 +361,7 @@ int ndof_init_first(NDOF_Device *dev, void *diHandle)
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_update(NDOF_Device *in_dev)
+static void ndof_win_update(NDOF_Device *in_dev)
 {
     NDOF_DevicePrivate *priv = (NDOF_DevicePrivate*)in_dev->private_data;
     static long last_axes[] = {0,0,0,0,0,0};
@@ -361,21 +437,39 @@ void ndof_update(NDOF_Device *in_dev)
 
 	for (int i = 0; i < in_dev->btn_count; i++)
 		in_dev->buttons[i] = (js.rgbButtons[i] == 0x80);
+
+	ndof_stream_publish(in_dev);
+}
+
+/* -------------------------------------------------------------------------- 
+    Callbacks are ignored: there are no notifications to stop. */
+static void ndof_win_stop(NDOF_Context *ctx)
+{
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_cleanup_internal()
+static void ndof_win_cleanup(NDOF_Context *ctx)
 {
-    if (gDI) 
-    { 
-        gDI->Release(); 
-        gDI = NULL; 
-    }
+    NDOF_WinBackend *be = (NDOF_WinBackend *)ctx->backend;
+
+    if (be == NULL)
+        return;
+
+    if (be->init_thread_on)
+        ndof_thread_join(be->init_thread);
+    
+    if (be->di) 
+        be->di->Release(); 
+
+    free(be);
+    ctx->backend = NULL;
 }
 
 /* -------------------------------------------------------------------------- */
-void ndof_dev_private_dispose(NDOF_DevicePrivate *priv)
+static void ndof_win_dispose(void *p)
 {
+    NDOF_DevicePrivate *priv = (NDOF_DevicePrivate *)p;
+
     if (priv && priv->dev)
     {
         priv->dev->Unacquire();
@@ -388,11 +482,32 @@ void ndof_dev_private_dispose(NDOF_DevicePrivate *priv)
 }
 
 /* -------------------------------------------------------------------------- */
-unsigned char ndof_match_private(NDOF_DevicePrivate *d1, NDOF_DevicePrivate *d2)
+static unsigned char ndof_win_match(void *priv1, void *priv2)
 {
+    NDOF_DevicePrivate *d1 = (NDOF_DevicePrivate *)priv1;
+    NDOF_DevicePrivate *d2 = (NDOF_DevicePrivate *)priv2;
+
 	return (d1 && d2 && d1->type == d2->type && d1->subtype == d2->subtype);
 }
 
+/* -------------------------------------------------------------------------- */
+static void ndof_win_dump(FILE *stream, NDOF_Device *dev)
+{
+	fprintf(stream, "type=%hd; subtype=%hd\n", 
+			((NDOF_DevicePrivate*)dev->private_data)->type,
+			((NDOF_DevicePrivate*)dev->private_data)->subtype);
+}
+
+/* -------------------------------------------------------------------------- 
+    No device count, no hot-plugging: DirectInput is asked by 
+    ndof_init_first. */
+const NDOF_Backend ndof_backend_win = {
+    "win", sizeof(NDOF_DevicePrivate), 0,
+    ndof_win_libinit, ndof_win_stop, ndof_win_cleanup, NULL,
+    ndof_win_init_first, ndof_win_update, ndof_win_dispose, ndof_win_match,
+    ndof_win_dump
+};
+
 #ifdef NDOF_DEBUG
 /* -------------------------------------------------------------------------- */
 void ndof_print_deviceinstance_info(const DIDEVICEINSTANCE *dev_info)